@@ -58,6 +58,12 @@ pub fn should_keep(word: &str) -> bool {
     DICT_KEEP.contains(word_lower.as_str())
 }
 
+/// Build both word sets now instead of on the first lookup
+pub fn warm_up() {
+    LazyLock::force(&DICT_VI);
+    LazyLock::force(&DICT_KEEP);
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -23,6 +23,11 @@ pub fn is_english_word(word: &str) -> bool {
     DICT.contains(lower.as_str())
 }
 
+/// Build the word set now instead of on the first lookup
+pub fn warm_up() {
+    LazyLock::force(&DICT);
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
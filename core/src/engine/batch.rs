@@ -0,0 +1,214 @@
+//! Batched key processing
+//!
+//! Feeds a sequence of key events through the engine and coalesces the
+//! per-key results into one net edit: how many characters to delete before
+//! the cursor, and the final text to insert. Used by hosts that receive key
+//! bursts (paste via xdotool, replayed keystrokes) and want to apply them as a
+//! single text edit instead of one delete+commit per key.
+//!
+//! The coalescing mirrors what a client would show after receiving every
+//! per-key result in order (see `utils::type_word`).
+
+use super::{Action, Engine, UTF8_MAX};
+use crate::data::keys;
+use crate::utils::key_to_char_ext;
+
+/// One key event for batch processing (layout shared with FFI)
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default, PartialEq)]
+pub struct KeyEvent {
+    pub key: u16,
+    pub caps: bool,
+    pub ctrl: bool,
+    pub shift: bool,
+    pub _pad: u8,
+}
+
+impl KeyEvent {
+    pub fn new(key: u16, caps: bool, shift: bool) -> Self {
+        Self {
+            key,
+            caps,
+            ctrl: false,
+            shift,
+            _pad: 0,
+        }
+    }
+}
+
+/// Net edit produced by a batch (layout shared with FFI)
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default, PartialEq)]
+pub struct BatchResult {
+    /// Characters to delete before the cursor (text that existed before the batch)
+    pub backspace: u32,
+    /// Bytes of UTF-8 text written to the output buffer
+    pub len: u32,
+    /// Number of events processed; remaining events must be sent again
+    pub consumed: u32,
+}
+
+/// Output capacity reserved for each key: a batch stops early rather than
+/// start a key whose worst-case result would not fit.
+pub const BATCH_KEY_RESERVE: usize = UTF8_MAX;
+
+/// Character a client would insert for a pass-through key, if any
+fn passthrough_char(key: u16, caps: bool, shift: bool) -> Option<char> {
+    if let Some(c) = key_to_char_ext(key, caps, shift) {
+        return Some(c);
+    }
+    Some(match key {
+        keys::SPACE => ' ',
+        keys::DOT => '.',
+        keys::COMMA => ',',
+        keys::SLASH => '/',
+        keys::SEMICOLON => ';',
+        keys::QUOTE => '\'',
+        keys::LBRACKET => '[',
+        keys::RBRACKET => ']',
+        keys::BACKSLASH => '\\',
+        keys::MINUS => '-',
+        keys::EQUAL => '=',
+        keys::BACKQUOTE => '`',
+        _ => return None,
+    })
+}
+
+/// Whether a key can be folded into a text edit.
+///
+/// Navigation/control keys (arrows, Enter, Tab, ESC) and Ctrl chords have
+/// effects beyond inserting text, so a batch stops before them and the host
+/// handles them individually.
+fn is_batchable(ev: &KeyEvent) -> bool {
+    !ev.ctrl && (ev.key == keys::DELETE || passthrough_char(ev.key, ev.caps, ev.shift).is_some())
+}
+
+/// Process `events` in order and write the coalesced text into `out`.
+///
+/// Stops early (see `BatchResult::consumed`) at the first non-batchable key,
+/// or when `out` has less than `BATCH_KEY_RESERVE` bytes left.
+pub fn process_batch(e: &mut Engine, events: &[KeyEvent], out: &mut [u8]) -> BatchResult {
+    let mut text: Vec<char> = Vec::with_capacity(events.len());
+    let mut text_bytes = 0usize;
+    let mut backspace = 0u32;
+    let mut consumed = 0u32;
+
+    // Delete one char: pending batch text first, then pre-existing text
+    let mut delete = |text: &mut Vec<char>, text_bytes: &mut usize| match text.pop() {
+        Some(c) => *text_bytes -= c.len_utf8(),
+        None => backspace += 1,
+    };
+
+    for ev in events {
+        if !is_batchable(ev) || text_bytes + BATCH_KEY_RESERVE > out.len() {
+            break;
+        }
+        consumed += 1;
+
+        let r = e.on_key_ext(ev.key, ev.caps, ev.ctrl, ev.shift);
+        if r.action == Action::Send as u8 {
+            for _ in 0..r.backspace {
+                delete(&mut text, &mut text_bytes);
+            }
+            for &cp in r.chars.iter().take(r.count as usize) {
+                if let Some(c) = char::from_u32(cp) {
+                    text_bytes += c.len_utf8();
+                    text.push(c);
+                }
+            }
+            // Break keys (punctuation) are still typed after a restore/shortcut
+            if keys::is_break_ext(ev.key, ev.shift) && !r.key_consumed() {
+                if let Some(c) = passthrough_char(ev.key, ev.caps, ev.shift) {
+                    text_bytes += c.len_utf8();
+                    text.push(c);
+                }
+            }
+        } else if ev.key == keys::DELETE {
+            delete(&mut text, &mut text_bytes);
+        } else if let Some(c) = passthrough_char(ev.key, ev.caps, ev.shift) {
+            text_bytes += c.len_utf8();
+            text.push(c);
+        }
+    }
+
+    let mut len = 0;
+    for c in text {
+        len += c.encode_utf8(&mut out[len..]).len();
+    }
+
+    BatchResult {
+        backspace,
+        len: len as u32,
+        consumed,
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::utils::{char_to_key, type_word};
+
+    fn events(input: &str) -> Vec<KeyEvent> {
+        input
+            .chars()
+            .map(|c| KeyEvent::new(char_to_key(c), c.is_uppercase(), false))
+            .collect()
+    }
+
+    fn batch(e: &mut Engine, input: &str) -> (u32, String, u32) {
+        let mut out = vec![0u8; 64 * 1024];
+        let r = process_batch(e, &events(input), &mut out);
+        let text = String::from_utf8(out[..r.len as usize].to_vec()).unwrap();
+        (r.backspace, text, r.consumed)
+    }
+
+    #[test]
+    fn coalesces_word_edits() {
+        let mut e = Engine::new();
+        assert_eq!(batch(&mut e, "vieetj nam"), (0, "việt nam".into(), 10));
+    }
+
+    #[test]
+    fn matches_per_key_typing() {
+        for input in ["dduwowcj khoong", "tesst", "Xin chaof", "as<s"] {
+            let mut batched = Engine::new();
+            let mut per_key = Engine::new();
+            let (bs, text, _) = batch(&mut batched, input);
+            assert_eq!(bs, 0, "{input}");
+            assert_eq!(text, type_word(&mut per_key, input), "{input}");
+        }
+    }
+
+    #[test]
+    fn deletes_past_batch_start() {
+        let mut e = Engine::new();
+        // Word started before the batch: "a" already on screen
+        e.on_key_ext(keys::A, false, false, false);
+        assert_eq!(batch(&mut e, "s"), (1, "á".into(), 1));
+        // Backspaces with no pending text delete pre-existing text
+        assert_eq!(batch(&mut e, "<<"), (2, "".into(), 2));
+    }
+
+    #[test]
+    fn stops_at_control_keys() {
+        let mut e = Engine::new();
+        let mut evs = events("ab");
+        evs.insert(1, KeyEvent::new(keys::LEFT, false, false));
+        let mut out = vec![0u8; 4096];
+        let r = process_batch(&mut e, &evs, &mut out);
+        assert_eq!(r.consumed, 1);
+        assert_eq!(&out[..r.len as usize], b"a");
+    }
+
+    #[test]
+    fn stops_when_output_full() {
+        let mut e = Engine::new();
+        let mut out = vec![0u8; BATCH_KEY_RESERVE + 2];
+        let r = process_batch(&mut e, &events("abcd"), &mut out);
+        assert_eq!(r.consumed, 3);
+        assert_eq!(&out[..r.len as usize], b"abc");
+
+        let mut small = vec![0u8; 8];
+        assert_eq!(process_batch(&mut e, &events("a"), &mut small).consumed, 0);
+    }
+}
@@ -10,7 +10,9 @@
 //! 3. **Shortcut Support**: User-defined abbreviations with priority
 //! 4. **Longest-Match-First**: For diacritic placement
 
+pub mod batch;
 pub mod buffer;
+pub mod reference;
 pub mod shortcut;
 pub mod syllable;
 pub mod transform;
@@ -95,6 +97,126 @@ impl Result {
     }
 }
 
+/// Maximum UTF-8 bytes in a `Utf8Result` (4 bytes per char)
+pub const UTF8_MAX: usize = MAX * 4;
+
+/// Result for FFI with pre-encoded UTF-8 text
+///
+/// Same fields as `Result`, but `bytes[..len]` holds the output as UTF-8 so
+/// UTF-8 hosts (Linux/Fcitx5) can commit it without re-encoding codepoints.
+#[repr(C)]
+pub struct Utf8Result {
+    pub bytes: [u8; UTF8_MAX],
+    pub len: u16,
+    pub action: u8,
+    pub backspace: u8,
+    pub flags: u8,
+    pub _pad: u8,
+}
+
+impl From<&Result> for Utf8Result {
+    fn from(r: &Result) -> Self {
+        let mut out = Self {
+            bytes: [0; UTF8_MAX],
+            len: 0,
+            action: r.action,
+            backspace: r.backspace,
+            flags: r.flags,
+            _pad: 0,
+        };
+        let mut len = 0;
+        for &cp in r.chars.iter().take(r.count as usize) {
+            if cp == 0 {
+                continue;
+            }
+            // Invalid codepoints become U+FFFD, matching the platform encoders
+            let c = char::from_u32(cp).unwrap_or(char::REPLACEMENT_CHARACTER);
+            len += c.encode_utf8(&mut out.bytes[len..]).len();
+        }
+        out.len = len as u16;
+        out
+    }
+}
+
+/// Inline UTF-8 capacity of `CompactResult`: 8 Vietnamese letters (3 bytes
+/// each at most), which covers nearly every key
+pub const COMPACT_INLINE: usize = 24;
+
+/// Layout version of `CompactResult`, negotiated by `ime_result_layout`
+///
+/// 2 adds `state`, which version 1 leaves zero.
+pub const COMPACT_VERSION: u32 = 2;
+
+/// Flag: the text did not fit inline and was written to the spill buffer
+pub const FLAG_SPILLED: u8 = 0x02;
+
+/// `Engine::state_summary` bit: nothing is being composed
+pub const STATE_BUFFER_EMPTY: u8 = 0x01;
+/// `Engine::state_summary` bit: the method is VNI (Telex otherwise)
+pub const STATE_VNI: u8 = 0x02;
+/// `Engine::state_summary` bit: the next DELETE passes through and leaves
+/// the engine as it is
+pub const STATE_PASS_DELETE: u8 = 0x04;
+
+/// Result for FFI in 32 bytes (half a cache line)
+///
+/// Same fields as `Utf8Result`, but only `COMPACT_INLINE` bytes of text are
+/// inline. Longer text (shortcut expansions) goes to a caller-provided
+/// spill buffer and sets `FLAG_SPILLED`; `len` is the full length either way.
+/// `state` is the engine's `state_summary` after the key.
+#[repr(C)]
+pub struct CompactResult {
+    pub bytes: [u8; COMPACT_INLINE],
+    pub len: u16,
+    pub action: u8,
+    pub backspace: u8,
+    pub flags: u8,
+    pub state: u8,
+    pub _pad: [u8; 2],
+}
+
+impl CompactResult {
+    /// Encode `r`, spilling text longer than `COMPACT_INLINE` to `spill`.
+    ///
+    /// Returns `None` if the text is longer than both; `UTF8_MAX` bytes of
+    /// spill always suffice.
+    pub fn encode(r: &Result, spill: &mut [u8]) -> Option<Self> {
+        let mut out = Self {
+            bytes: [0; COMPACT_INLINE],
+            len: 0,
+            action: r.action,
+            backspace: r.backspace,
+            flags: r.flags,
+            state: 0,
+            _pad: [0; 2],
+        };
+        let mut len = 0;
+        let mut buf = [0u8; 4];
+        for &cp in r.chars.iter().take(r.count as usize) {
+            if cp == 0 {
+                continue;
+            }
+            // Invalid codepoints become U+FFFD, as in `Utf8Result`
+            let c = char::from_u32(cp).unwrap_or(char::REPLACEMENT_CHARACTER);
+            let encoded = c.encode_utf8(&mut buf).as_bytes();
+            let end = len + encoded.len();
+            if out.flags & FLAG_SPILLED == 0 && end > COMPACT_INLINE {
+                // Move what is inline so far; the rest is encoded in place
+                spill.get_mut(..len)?.copy_from_slice(&out.bytes[..len]);
+                out.flags |= FLAG_SPILLED;
+            }
+            if out.flags & FLAG_SPILLED != 0 {
+                spill.get_mut(len..end)?.copy_from_slice(encoded);
+            } else {
+                out.bytes[len..end].copy_from_slice(encoded);
+            }
+            len = end;
+        }
+        out.len = len as u16;
+        Some(out)
+    }
+}
+
 /// Transform type for revert tracking
 #[derive(Clone, Copy, Debug, PartialEq)]
 enum Transform {
@@ -119,6 +241,9 @@ enum Transform {
 /// Word history ring buffer capacity (stores last N committed words)
 const HISTORY_CAPACITY: usize = 10;
 
+/// Longest Vietnamese syllable in chars ("nghiêng"), bound for `resume_word`
+pub const MAX_SYLLABLE_CHARS: usize = 7;
+
 /// Ring buffer for word history (stack-allocated, O(1) push/pop)
 ///
 /// Used for backspace-after-space feature: when user presses backspace
@@ -478,6 +603,16 @@ impl Engine {
         &mut self.shortcuts
     }
 
+    /// Bytes this engine owns: the struct itself (buffers and word history
+    /// are inline) plus its growable buffers. Shortcut tables are not
+    /// counted: installed ones are shared between engines.
+    pub fn memory_bytes(&self) -> usize {
+        std::mem::size_of::<Self>()
+            + self.raw_input.capacity() * std::mem::size_of::<(u16, bool, bool)>()
+            + self.shortcut_prefix.capacity()
+            + self.telex_double_raw.as_ref().map_or(0, String::capacity)
+    }
+
     /// Debug: get buffer length
     pub fn debug_buffer_len(&self) -> usize {
         self.buf.len()
@@ -2014,16 +2149,17 @@ impl Engine {
                     let is_gi_initial_here = self.buf.get(0).map(|c| c.key) == Some(keys::G)
                         && self.buf.get(1).is_some_and(|c| c.key == keys::I);
 
-                    // Exclude I from vowel types if it's part of gi-initial
-                    let unique_vowel_types: std::collections::HashSet<u16> = if is_gi_initial_here {
-                        vowel_chars
-                            .iter()
-                            .filter(|c| c.key != keys::I)
-                            .map(|c| c.key)
-                            .collect()
-                    } else {
-                        vowel_chars.iter().map(|c| c.key).collect()
-                    };
+                    // Exclude I from vowel types if it's part of gi-initial.
+                    // Kept in buffer order: "the other vowel" below must not
+                    // depend on hash order (it differed between engines)
+                    let mut unique_vowel_types: Vec<u16> = Vec::with_capacity(vowel_chars.len());
+                    for c in &vowel_chars {
+                        if !(is_gi_initial_here && c.key == keys::I)
+                            && !unique_vowel_types.contains(&c.key)
+                        {
+                            unique_vowel_types.push(c.key);
+                        }
+                    }
                     let has_multiple_vowel_types = unique_vowel_types.len() > 1;
 
                     if has_any_mark && has_multiple_vowel_types {
@@ -4443,6 +4579,39 @@ impl Engine {
         }
     }
 
+    /// Summary of what the next key can do, as `STATE_*` bits.
+    ///
+    /// A `STATE_PASS_*` bit promises that `on_key_ext` of that key (without
+    /// ctrl) returns `Result::none()` and leaves every field as it is, so a
+    /// host may skip the call. Only keys that are such a fixed point qualify:
+    /// letters and numbers always reach the buffer and raw input (Issue
+    /// #162), and symbols extend the shortcut prefix.
+    pub fn state_summary(&self) -> u8 {
+        let mut state = if self.method == 1 { STATE_VNI } else { 0 };
+        if !self.buf.is_empty() {
+            return state;
+        }
+        state |= STATE_BUFFER_EMPTY;
+        if !self.enabled || self.spaces_after_commit != 0 {
+            return state;
+        }
+
+        // DELETE on an empty buffer: only resets flags, so it is a no-op
+        // once they are reset (the first DELETE after a word still goes in)
+        if self.raw_input.is_empty()
+            && self.has_non_letter_prefix
+            && self.last_transform.is_none()
+            && !self.stroke_reverted
+            && self.reverted_circumflex_key.is_none()
+            && !self.had_circumflex_revert
+            && !self.restored_pending_clear
+            && !self.auto_capitalize_used
+        {
+            state |= STATE_PASS_DELETE;
+        }
+        state
+    }
+
     /// Clear buffer and raw input history
     /// Note: Does NOT clear word_history to preserve backspace-after-space feature
     /// Also restores pending_capitalize if auto_capitalize was used (for selection-delete)
@@ -4638,6 +4807,40 @@ impl Engine {
         }
     }
 
+    /// Resume editing the word that ends at the cursor
+    ///
+    /// `before_cursor` is (the tail of) the text before the cursor, e.g. from
+    /// the client's surrounding text after focus-in or a cursor move. Only the
+    /// trailing run of letters is considered, and only if it can be a single
+    /// syllable: longer runs are left alone so the cost stays bounded and a
+    /// long English word is never rebuilt into the buffer.
+    ///
+    /// A word already being composed is kept as is.
+    ///
+    /// Returns the number of chars restored (0 = buffer untouched).
+    pub fn resume_word(&mut self, before_cursor: &str) -> usize {
+        if !self.buf.is_empty() {
+            return 0;
+        }
+        let mut start = before_cursor.len();
+        let mut count = 0;
+        for (i, c) in before_cursor.char_indices().rev() {
+            if chars::parse_char(c).is_none() {
+                break;
+            }
+            count += 1;
+            if count > MAX_SYLLABLE_CHARS {
+                return 0;
+            }
+            start = i;
+        }
+        if count == 0 {
+            return 0;
+        }
+        self.restore_word(&before_cursor[start..]);
+        self.buf.len()
+    }
+
     /// Check if buffer has transforms and is invalid Vietnamese
     /// Returns the raw chars if restore is needed, None otherwise
     ///
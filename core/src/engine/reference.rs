@@ -0,0 +1,75 @@
+//! Reference key trace for differential testing
+//!
+//! Runs key events through the engine and encodes every per-key result
+//! straight from `Result::chars`, without the `Utf8Result` conversion the
+//! hosts use. A host feeding the same events through its FFI path must
+//! produce a byte-identical trace (see platforms/linux `gonhanh_diff`).
+//!
+//! One record per key: backspace (u8), text length (u16, little-endian),
+//! UTF-8 text. Keys without a Send action are recorded as an empty edit.
+
+use super::batch::KeyEvent;
+use super::{Action, Engine, Result};
+
+/// Bytes in front of each record's text
+pub const RECORD_HEADER: usize = 3;
+
+/// Append the record of one key result
+pub fn push_record(out: &mut Vec<u8>, r: &Result) {
+    let start = out.len();
+    out.extend_from_slice(&[0; RECORD_HEADER]);
+    if r.action != Action::Send as u8 {
+        return;
+    }
+    let mut buf = [0u8; 4];
+    for &cp in r.chars.iter().take(r.count as usize).filter(|&&cp| cp != 0) {
+        let c = char::from_u32(cp).unwrap_or(char::REPLACEMENT_CHARACTER);
+        out.extend_from_slice(c.encode_utf8(&mut buf).as_bytes());
+    }
+    let len = (out.len() - start - RECORD_HEADER) as u16;
+    out[start] = r.backspace;
+    out[start + 1..start + RECORD_HEADER].copy_from_slice(&len.to_le_bytes());
+}
+
+/// Feed `events` through `engine`, appending one record per event
+pub fn replay(engine: &mut Engine, events: &[KeyEvent], out: &mut Vec<u8>) {
+    for ev in events {
+        let r = engine.on_key_ext(ev.key, ev.caps, ev.ctrl, ev.shift);
+        push_record(out, &r);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::data::keys;
+
+    fn records(trace: &[u8]) -> Vec<(u8, String)> {
+        let mut out = Vec::new();
+        let mut rest = trace;
+        while !rest.is_empty() {
+            let len = u16::from_le_bytes([rest[1], rest[2]]) as usize;
+            let text = &rest[RECORD_HEADER..RECORD_HEADER + len];
+            out.push((rest[0], String::from_utf8(text.to_vec()).unwrap()));
+            rest = &rest[RECORD_HEADER + len..];
+        }
+        out
+    }
+
+    #[test]
+    fn one_record_per_key() {
+        let mut e = Engine::new();
+        let events: Vec<KeyEvent> = [keys::V, keys::I, keys::E, keys::E, keys::T, keys::J]
+            .iter()
+            .map(|&k| KeyEvent::new(k, false, false))
+            .collect();
+        let mut trace = Vec::new();
+        replay(&mut e, &events, &mut trace);
+
+        let recs = records(&trace);
+        assert_eq!(recs.len(), events.len());
+        assert_eq!(recs[0], (0, String::new())); // "v" passes through
+        assert_eq!(recs[3], (1, "ê".to_string()));
+        assert_eq!(recs[5], (2, "ệt".to_string()));
+    }
+}
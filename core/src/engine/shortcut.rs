@@ -5,6 +5,7 @@
 
 use super::buffer::MAX;
 use std::collections::HashMap;
+use std::sync::Arc;
 
 /// Maximum replacement length in UTF-32 codepoints (matches Result.chars array size)
 /// This limit ensures replacement fits in the FFI result buffer.
@@ -127,6 +128,17 @@ impl Shortcut {
         }
     }
 
+    /// Create a shortcut, picking the trigger type from the trigger text:
+    /// symbol-only triggers ("->", "=>") fire immediately, others
+    /// (abbreviations like "vn") on a word boundary.
+    pub fn auto(trigger: &str, replacement: &str) -> Self {
+        if trigger.chars().all(|c| !c.is_alphabetic()) {
+            Self::immediate(trigger, replacement)
+        } else {
+            Self::new(trigger, replacement)
+        }
+    }
+
     /// Set the input method for this shortcut
     pub fn for_method(mut self, method: InputMethod) -> Self {
         self.input_method = method;
@@ -165,20 +177,22 @@ pub struct ShortcutMatch {
 }
 
 /// Shortcut table manager
-#[derive(Debug, Default)]
+///
+/// Lookups are exact (case-insensitive) hash matches, and buffers longer than
+/// the longest trigger are rejected before hashing: the cost per key does not
+/// depend on the number of shortcuts. Cloning is O(1) - the entries are shared
+/// copy-on-write, so one compiled table can back many engines.
+#[derive(Debug, Default, Clone)]
 pub struct ShortcutTable {
     /// Shortcuts indexed by trigger (lowercase)
-    shortcuts: HashMap<String, Shortcut>,
-    /// Sorted triggers by length (longest first) for matching
-    sorted_triggers: Vec<String>,
+    shortcuts: Arc<HashMap<String, Shortcut>>,
+    /// Longest trigger, in chars
+    max_trigger_chars: usize,
 }
 
 impl ShortcutTable {
     pub fn new() -> Self {
-        Self {
-            shortcuts: HashMap::new(),
-            sorted_triggers: vec![],
-        }
+        Self::default()
     }
 
     /// Create with default Vietnamese shortcuts (common abbreviations)
@@ -229,16 +243,45 @@ impl ShortcutTable {
 
     /// Add a shortcut
     pub fn add(&mut self, shortcut: Shortcut) {
-        let trigger = shortcut.trigger.clone();
-        self.shortcuts.insert(trigger.clone(), shortcut);
-        self.rebuild_sorted_triggers();
+        self.max_trigger_chars = self.max_trigger_chars.max(shortcut.trigger.chars().count());
+        Arc::make_mut(&mut self.shortcuts).insert(shortcut.trigger.clone(), shortcut);
+    }
+
+    /// Add shortcuts from `trigger=replacement` lines (see `Shortcut::auto`)
+    ///
+    /// Blank lines, `#` comments and lines without a trigger or replacement
+    /// are skipped; later lines override earlier ones with the same trigger.
+    /// Returns the number of lines added.
+    pub fn load_lines(&mut self, text: &str) -> usize {
+        let entries = Arc::make_mut(&mut self.shortcuts);
+        entries.reserve(text.len() / 16);
+        let mut added = 0;
+        for line in text.lines() {
+            let line = line.trim();
+            if line.is_empty() || line.starts_with('#') {
+                continue;
+            }
+            let Some((trigger, replacement)) = line.split_once('=') else {
+                continue;
+            };
+            let (trigger, replacement) = (trigger.trim(), replacement.trim());
+            if trigger.is_empty() || replacement.is_empty() {
+                continue;
+            }
+            let shortcut = Shortcut::auto(trigger, replacement);
+            self.max_trigger_chars = self.max_trigger_chars.max(shortcut.trigger.chars().count());
+            entries.insert(shortcut.trigger.clone(), shortcut);
+            added += 1;
+        }
+        added
     }
 
     /// Remove a shortcut (exact match, case-sensitive)
     pub fn remove(&mut self, trigger: &str) -> Option<Shortcut> {
-        let result = self.shortcuts.remove(trigger);
+        let entries = Arc::make_mut(&mut self.shortcuts);
+        let result = entries.remove(trigger);
         if result.is_some() {
-            self.rebuild_sorted_triggers();
+            self.max_trigger_chars = entries.keys().map(|t| t.chars().count()).max().unwrap_or(0);
         }
         result
     }
@@ -259,18 +302,17 @@ impl ShortcutTable {
         buffer: &str,
         method: InputMethod,
     ) -> Option<(&str, &Shortcut)> {
+        // No allocation for buffers that cannot match (the common case)
+        if self.shortcuts.is_empty() || buffer.chars().nth(self.max_trigger_chars).is_some() {
+            return None;
+        }
         let buffer_lower = buffer.to_lowercase();
-        // Longest-match-first, case-insensitive match
-        for trigger in &self.sorted_triggers {
-            if buffer_lower == *trigger {
-                if let Some(shortcut) = self.shortcuts.get(trigger) {
-                    if shortcut.enabled && shortcut.applies_to(method) {
-                        return Some((trigger, shortcut));
-                    }
-                }
-            }
+        let (trigger, shortcut) = self.shortcuts.get_key_value(&buffer_lower)?;
+        if shortcut.enabled && shortcut.applies_to(method) {
+            Some((trigger, shortcut))
+        } else {
+            None
         }
-        None
     }
 
     /// Try to match buffer with trigger key (for any input method)
@@ -369,13 +411,6 @@ impl ShortcutTable {
         }
     }
 
-    /// Rebuild sorted triggers list (longest first)
-    fn rebuild_sorted_triggers(&mut self) {
-        self.sorted_triggers = self.shortcuts.keys().cloned().collect();
-        self.sorted_triggers
-            .sort_by_key(|s| std::cmp::Reverse(s.len()));
-    }
-
     /// Check if shortcut table is empty
     pub fn is_empty(&self) -> bool {
         self.shortcuts.is_empty()
@@ -386,10 +421,9 @@ impl ShortcutTable {
         self.shortcuts.len()
     }
 
-    /// Clear all shortcuts
+    /// Clear all shortcuts (tables sharing the entries keep them)
     pub fn clear(&mut self) {
-        self.shortcuts.clear();
-        self.sorted_triggers.clear();
+        *self = Self::default();
     }
 }
 
@@ -963,4 +997,64 @@ mod tests {
         let table = table_with_shortcut("br", "\n");
         assert_shortcut_match(&table, "br", Some(' '), true, "\n ", 2, InputMethod::All);
     }
+
+    #[test]
+    fn load_lines_parses_shortcut_file() {
+        let mut table = ShortcutTable::new();
+        let added = table.load_lines(
+            "# abbreviations\n\
+             vn = Việt Nam\r\n\
+             \n\
+             ->=→\n\
+             broken line\n\
+             =no trigger\n\
+             empty=\n\
+             vn=Viet Nam\n",
+        );
+        assert_eq!(added, 3);
+        assert_eq!(table.len(), 2);
+        // Later lines override, symbol triggers fire immediately
+        assert_shortcut_match(
+            &table,
+            "vn",
+            Some(' '),
+            true,
+            "Viet Nam ",
+            2,
+            InputMethod::All,
+        );
+        assert_eq!(
+            table.lookup("->").unwrap().1.condition,
+            TriggerCondition::Immediate
+        );
+    }
+
+    #[test]
+    fn lookup_rejects_buffers_longer_than_any_trigger() {
+        let mut table = ShortcutTable::new();
+        table.add(Shortcut::new("hcm", "Hồ Chí Minh"));
+        table.add(Shortcut::new("tphcm", "Thành phố Hồ Chí Minh"));
+        assert!(table.lookup("tphcm").is_some());
+        assert!(table.lookup("xtphcm").is_none());
+
+        // Removing the longest trigger shrinks the bound
+        table.remove("tphcm");
+        assert!(table.lookup("hcm").is_some());
+        assert!(table.lookup("tphcm").is_none());
+    }
+
+    #[test]
+    fn clone_shares_entries_copy_on_write() {
+        let mut table = ShortcutTable::new();
+        table.load_lines("vn=Việt Nam\nhn=Hà Nội\n");
+
+        let mut copy = table.clone();
+        assert!(Arc::ptr_eq(&table.shortcuts, &copy.shortcuts));
+
+        copy.add(Shortcut::new("dc", "được"));
+        table.clear();
+        assert_eq!(copy.len(), 3);
+        assert!(table.is_empty());
+        assert!(copy.lookup("hn").is_some());
+    }
 }
@@ -26,15 +26,117 @@ pub mod input;
 pub mod updater;
 pub mod utils;
 
-use engine::{Engine, Result};
+use engine::batch::{BatchResult, KeyEvent};
+use engine::shortcut::ShortcutTable;
+use engine::{CompactResult, Engine, Result, Utf8Result};
+use std::sync::atomic::{AtomicU32, Ordering};
 use std::sync::Mutex;
 
 // Global engine instance (thread-safe via Mutex)
 static ENGINE: Mutex<Option<Engine>> = Mutex::new(None);
 
-/// Lock the engine mutex, recovering from poisoned state if needed (for tests)
+// Settings of the global engine, written by the setters without the engine
+// lock so a settings change never waits for a key in flight. The method is
+// in bits 0..8 with a "set" bit (`METHOD_SET`), then every `Flag` has a
+// (set, value) bit pair. `lock_engine` applies what changed since the last
+// lock; `ime_init` starts over from nothing set.
+static SETTINGS: AtomicU32 = AtomicU32::new(0);
+// Snapshot the engine was last brought up to (only accessed under the lock)
+static APPLIED_SETTINGS: AtomicU32 = AtomicU32::new(0);
+
+const METHOD_MASK: u32 = 0x1FF;
+const METHOD_SET: u32 = 1 << 8;
+
+/// Boolean settings of the global engine in `SETTINGS`
+#[derive(Clone, Copy)]
+enum Flag {
+    Enabled,
+    SkipWShortcut,
+    BracketShortcut,
+    EscRestore,
+    FreeTone,
+    ModernTone,
+    EnglishAutoRestore,
+    AutoCapitalize,
+    AllowForeignConsonants,
+}
+
+impl Flag {
+    const ALL: [Flag; 9] = [
+        Flag::Enabled,
+        Flag::SkipWShortcut,
+        Flag::BracketShortcut,
+        Flag::EscRestore,
+        Flag::FreeTone,
+        Flag::ModernTone,
+        Flag::EnglishAutoRestore,
+        Flag::AutoCapitalize,
+        Flag::AllowForeignConsonants,
+    ];
+
+    fn set_bit(self) -> u32 {
+        1 << (9 + 2 * self as u32)
+    }
+
+    fn mask(self) -> u32 {
+        self.set_bit() | self.set_bit() << 1
+    }
+
+    /// Record `on` in `SETTINGS` (lock-free)
+    fn store(self, on: bool) {
+        let value = if on { self.mask() } else { self.set_bit() };
+        store_settings(self.mask(), value);
+    }
+
+    fn apply(self, e: &mut Engine, on: bool) {
+        match self {
+            Flag::Enabled => e.set_enabled(on),
+            Flag::SkipWShortcut => e.set_skip_w_shortcut(on),
+            Flag::BracketShortcut => e.set_bracket_shortcut(on),
+            Flag::EscRestore => e.set_esc_restore(on),
+            Flag::FreeTone => e.set_free_tone(on),
+            Flag::ModernTone => e.set_modern_tone(on),
+            Flag::EnglishAutoRestore => e.set_english_auto_restore(on),
+            Flag::AutoCapitalize => e.set_auto_capitalize(on),
+            Flag::AllowForeignConsonants => e.set_allow_foreign_consonants(on),
+        }
+    }
+}
+
+/// Replace the `mask` bits of `SETTINGS` with `value`
+fn store_settings(mask: u32, value: u32) {
+    let _ = SETTINGS.fetch_update(Ordering::Release, Ordering::Relaxed, |s| {
+        Some(s & !mask | value)
+    });
+}
+
+/// Bring `e` from settings snapshot `old` to `new`: settings that changed
+/// and are set are applied, in `Flag` order after the method
+fn apply_settings(e: &mut Engine, new: u32, old: u32) {
+    let changed = new ^ old;
+    if changed & METHOD_MASK != 0 && new & METHOD_SET != 0 {
+        e.set_method(new as u8);
+    }
+    for flag in Flag::ALL {
+        if changed & flag.mask() != 0 && new & flag.set_bit() != 0 {
+            flag.apply(e, new & (flag.set_bit() << 1) != 0);
+        }
+    }
+}
+
+/// Lock the engine mutex, recovering from poisoned state if needed (for tests),
+/// and apply settings stored since the last lock
 fn lock_engine() -> std::sync::MutexGuard<'static, Option<Engine>> {
-    ENGINE.lock().unwrap_or_else(|e| e.into_inner())
+    let mut guard = ENGINE.lock().unwrap_or_else(|e| e.into_inner());
+    let new = SETTINGS.load(Ordering::Acquire);
+    let old = APPLIED_SETTINGS.load(Ordering::Relaxed);
+    if new != old {
+        if let Some(ref mut e) = *guard {
+            apply_settings(e, new, old);
+        }
+        APPLIED_SETTINGS.store(new, Ordering::Relaxed);
+    }
+    guard
 }
 
 // ============================================================
@@ -44,7 +146,8 @@ fn lock_engine() -> std::sync::MutexGuard<'static, Option<Engine>> {
 /// Initialize the IME engine.
 ///
 /// Must be called exactly once before any other `ime_*` functions.
-/// Thread-safe: uses internal mutex.
+/// Thread-safe: uses internal mutex. The engine starts with default
+/// settings; settings stored before (which had no engine) are dropped.
 ///
 /// # Panics
 /// Panics if mutex is poisoned (only if previous call panicked).
@@ -52,6 +155,52 @@ fn lock_engine() -> std::sync::MutexGuard<'static, Option<Engine>> {
 pub extern "C" fn ime_init() {
     let mut guard = lock_engine();
     *guard = Some(Engine::new());
+    SETTINGS.store(0, Ordering::Relaxed);
+    APPLIED_SETTINGS.store(0, Ordering::Relaxed);
+}
+
+/// Build the dictionaries used by auto-restore and spell checking.
+///
+/// They are otherwise built on first use, i.e. inside the first key event.
+/// Safe to call from any thread, any number of times; a key event racing
+/// with it waits for the same build instead of starting another.
+#[no_mangle]
+pub extern "C" fn ime_warm_up() {
+    data::english_dict::warm_up();
+    data::dictionary::warm_up();
+}
+
+/// Run a few words through a scratch engine to page the key path back in.
+///
+/// After a long idle the core's code and tables may have been evicted, and
+/// the first real key pays for the page faults. This types two words (tone,
+/// circumflex, English and Vietnamese lookups) on an engine of its own, so
+/// it never waits for the global lock and leaves every buffer untouched.
+/// Builds the dictionaries first if nobody has yet (see `ime_warm_up`).
+#[no_mangle]
+pub extern "C" fn ime_prefetch() {
+    use data::keys;
+    const WORDS: [&[u16]; 2] = [
+        &[
+            keys::T,
+            keys::I,
+            keys::E,
+            keys::E,
+            keys::N,
+            keys::G,
+            keys::S,
+            keys::SPACE,
+        ],
+        &[keys::T, keys::E, keys::X, keys::T, keys::SPACE],
+    ];
+    ime_warm_up();
+    let mut e = Engine::new();
+    e.set_english_auto_restore(true);
+    for word in WORDS {
+        for &key in word {
+            std::hint::black_box(e.on_key_ext(key, false, false, false));
+        }
+    }
 }
 
 /// Process a key event and return the result.
@@ -114,6 +263,190 @@ pub extern "C" fn ime_key_ext(key: u16, caps: bool, ctrl: bool, shift: bool) ->
     }
 }
 
+/// Process a key event into a caller-provided result buffer.
+///
+/// Allocation-free variant of `ime_key_ext` for hot paths: the result is
+/// written to `out` instead of a heap-allocated `Result`, so no `ime_free`
+/// call is needed.
+///
+/// # Returns
+/// * `true` if `out` was filled
+/// * `false` if engine not initialized or `out` is null (`out` untouched)
+///
+/// # Safety
+/// `out` must point to writable memory for one `Result`, or be null.
+#[no_mangle]
+pub unsafe extern "C" fn ime_key_into(
+    out: *mut Result,
+    key: u16,
+    caps: bool,
+    ctrl: bool,
+    shift: bool,
+) -> bool {
+    if out.is_null() {
+        return false;
+    }
+    let mut guard = lock_engine();
+    if let Some(ref mut e) = *guard {
+        out.write(e.on_key_ext(key, caps, ctrl, shift));
+        true
+    } else {
+        false
+    }
+}
+
+/// Process a key event into a caller-provided UTF-8 result buffer.
+///
+/// Like `ime_key_into`, but the output text is pre-encoded as UTF-8
+/// (`bytes[..len]`), for hosts whose text APIs take UTF-8 directly.
+///
+/// # Returns
+/// * `true` if `out` was filled
+/// * `false` if engine not initialized or `out` is null (`out` untouched)
+///
+/// # Safety
+/// `out` must point to writable memory for one `Utf8Result`, or be null.
+#[no_mangle]
+pub unsafe extern "C" fn ime_key_utf8(
+    out: *mut Utf8Result,
+    key: u16,
+    caps: bool,
+    ctrl: bool,
+    shift: bool,
+) -> bool {
+    if out.is_null() {
+        return false;
+    }
+    let mut guard = lock_engine();
+    if let Some(ref mut e) = *guard {
+        out.write(Utf8Result::from(&e.on_key_ext(key, caps, ctrl, shift)));
+        true
+    } else {
+        false
+    }
+}
+
+/// Negotiate the `CompactResult` layout.
+///
+/// `want` is the highest layout version the host understands. Hosts built
+/// against a newer core than the one they run with see a lower version (or
+/// 0 from cores that know none) and fall back to `ime_key_utf8`; a host that
+/// does not find this symbol at all is talking to a core older than the
+/// compact layout.
+///
+/// # Returns
+/// The version `ime_key_compact` writes: `want` capped to
+/// `COMPACT_VERSION`, 0 if `want` is 0.
+#[no_mangle]
+pub extern "C" fn ime_result_layout(want: u32) -> u32 {
+    want.min(engine::COMPACT_VERSION)
+}
+
+/// Process a key event into a compact result (see `ime_result_layout`).
+///
+/// Like `ime_key_utf8`, but only 32 bytes are written for the common case.
+/// Text longer than `COMPACT_INLINE` bytes goes to `spill[..len]` instead of
+/// `out.bytes` and sets `FLAG_SPILLED`; `UTF8_MAX` bytes of spill (1024)
+/// always suffice.
+///
+/// `out.state` (layout 2) is `Engine::state_summary` after the key: until
+/// the host changes the engine any other way, it may skip the next call for
+/// a key one of its `STATE_PASS_*` bits covers.
+///
+/// # Returns
+/// * `true` if `out` was filled
+/// * `false` if engine not initialized, `out` is null or the text did not
+///   fit `spill` (`out` untouched, the key is still processed)
+///
+/// # Safety
+/// * `out` must point to writable memory for one `CompactResult`, or be null
+/// * `spill` must point to `cap` writable bytes, or be null with `cap` 0
+#[no_mangle]
+pub unsafe extern "C" fn ime_key_compact(
+    out: *mut CompactResult,
+    spill: *mut u8,
+    cap: usize,
+    key: u16,
+    caps: bool,
+    ctrl: bool,
+    shift: bool,
+) -> bool {
+    if out.is_null() {
+        return false;
+    }
+    let mut guard = lock_engine();
+    if let Some(ref mut e) = *guard {
+        let r = e.on_key_ext(key, caps, ctrl, shift);
+        write_compact(out, &r, e.state_summary(), spill, cap)
+    } else {
+        false
+    }
+}
+
+/// Encode `r` and the engine's `state` into `out`, spilling to `spill[..cap]`.
+///
+/// # Safety
+/// As for `ime_key_compact`.
+unsafe fn write_compact(
+    out: *mut CompactResult,
+    r: &Result,
+    state: u8,
+    spill: *mut u8,
+    cap: usize,
+) -> bool {
+    let spill: &mut [u8] = if spill.is_null() {
+        &mut []
+    } else {
+        std::slice::from_raw_parts_mut(spill, cap)
+    };
+    match CompactResult::encode(r, spill) {
+        Some(mut compact) => {
+            compact.state = state;
+            out.write(compact);
+            true
+        }
+        None => false,
+    }
+}
+
+/// Process a sequence of key events under a single lock.
+///
+/// Per-key results are coalesced into one net edit: delete
+/// `result.backspace` characters before the cursor, then insert
+/// `out[..result.len]` (UTF-8). Processing stops early at navigation/control
+/// keys or when `out` runs low on space; `result.consumed` reports how many
+/// events were handled, so the caller can resend the rest.
+///
+/// # Returns
+/// * `true` if `result` was filled
+/// * `false` if engine not initialized or a pointer is null
+///
+/// # Safety
+/// * `events` must point to `n` valid `KeyEvent`s
+/// * `out` must point to `cap` writable bytes
+/// * `result` must point to writable memory for one `BatchResult`
+#[no_mangle]
+pub unsafe extern "C" fn ime_keys_batch(
+    events: *const KeyEvent,
+    n: usize,
+    out: *mut u8,
+    cap: usize,
+    result: *mut BatchResult,
+) -> bool {
+    if events.is_null() || out.is_null() || result.is_null() {
+        return false;
+    }
+    let mut guard = lock_engine();
+    if let Some(ref mut e) = *guard {
+        let events = std::slice::from_raw_parts(events, n);
+        let out = std::slice::from_raw_parts_mut(out, cap);
+        result.write(engine::batch::process_batch(e, events, out));
+        true
+    } else {
+        false
+    }
+}
+
 /// Process a key event with the actual Unicode character.
 ///
 /// Used for Option-modified keys on macOS where the keycode doesn't change
@@ -163,63 +496,49 @@ pub extern "C" fn ime_key_with_char(
 /// # Arguments
 /// * `method` - 0 for Telex, 1 for VNI
 ///
-/// No-op if engine not initialized.
+/// No-op if engine not initialized. Lock-free: applied by the next call
+/// that takes the engine lock (see `SETTINGS`).
 #[no_mangle]
 pub extern "C" fn ime_method(method: u8) {
-    let mut guard = lock_engine();
-    if let Some(ref mut e) = *guard {
-        e.set_method(method);
-    }
+    store_settings(METHOD_MASK, METHOD_SET | u32::from(method));
 }
 
 /// Enable or disable the engine.
 ///
 /// When disabled, `ime_key` returns action=0 (pass through).
-/// No-op if engine not initialized.
+/// No-op if engine not initialized. Lock-free, as `ime_method`.
 #[no_mangle]
 pub extern "C" fn ime_enabled(enabled: bool) {
-    let mut guard = lock_engine();
-    if let Some(ref mut e) = *guard {
-        e.set_enabled(enabled);
-    }
+    Flag::Enabled.store(enabled);
 }
 
 /// Set whether to skip w→ư shortcut in Telex mode.
 ///
 /// When `skip` is true, typing 'w' stays as 'w' instead of
 /// converting to 'ư'. Horn modifier still works: "ow" → "ơ", "uw" → "ư".
-/// No-op if engine not initialized.
+/// No-op if engine not initialized. Lock-free, as `ime_method`.
 #[no_mangle]
 pub extern "C" fn ime_skip_w_shortcut(skip: bool) {
-    let mut guard = lock_engine();
-    if let Some(ref mut e) = *guard {
-        e.set_skip_w_shortcut(skip);
-    }
+    Flag::SkipWShortcut.store(skip);
 }
 
 /// Set whether bracket shortcuts are enabled: ] → ư, [ → ơ (Issue #159)
 ///
 /// When `enabled` is true (default), ] types ư and [ types ơ in Telex mode.
-/// No-op if engine not initialized.
+/// No-op if engine not initialized. Lock-free, as `ime_method`.
 #[no_mangle]
 pub extern "C" fn ime_bracket_shortcut(enabled: bool) {
-    let mut guard = lock_engine();
-    if let Some(ref mut e) = *guard {
-        e.set_bracket_shortcut(enabled);
-    }
+    Flag::BracketShortcut.store(enabled);
 }
 
 /// Set whether ESC key restores raw ASCII input.
 ///
 /// When `enabled` is true (default), pressing ESC restores original keystrokes.
 /// When `enabled` is false, ESC key is passed through without restoration.
-/// No-op if engine not initialized.
+/// No-op if engine not initialized. Lock-free, as `ime_method`.
 #[no_mangle]
 pub extern "C" fn ime_esc_restore(enabled: bool) {
-    let mut guard = lock_engine();
-    if let Some(ref mut e) = *guard {
-        e.set_esc_restore(enabled);
-    }
+    Flag::EscRestore.store(enabled);
 }
 
 /// Set whether to enable free tone placement (skip validation).
@@ -227,26 +546,20 @@ pub extern "C" fn ime_esc_restore(enabled: bool) {
 /// When `enabled` is true, allows placing diacritics anywhere without
 /// spelling validation (e.g., "Zìa" is allowed).
 /// When `enabled` is false (default), validates Vietnamese spelling rules.
-/// No-op if engine not initialized.
+/// No-op if engine not initialized. Lock-free, as `ime_method`.
 #[no_mangle]
 pub extern "C" fn ime_free_tone(enabled: bool) {
-    let mut guard = lock_engine();
-    if let Some(ref mut e) = *guard {
-        e.set_free_tone(enabled);
-    }
+    Flag::FreeTone.store(enabled);
 }
 
 /// Set whether to use modern orthography for tone placement.
 ///
 /// When `modern` is true: hoà, thuý (tone on second vowel - new style)
 /// When `modern` is false (default): hòa, thúy (tone on first vowel - traditional)
-/// No-op if engine not initialized.
+/// No-op if engine not initialized. Lock-free, as `ime_method`.
 #[no_mangle]
 pub extern "C" fn ime_modern(modern: bool) {
-    let mut guard = lock_engine();
-    if let Some(ref mut e) = *guard {
-        e.set_modern_tone(modern);
-    }
+    Flag::ModernTone.store(modern);
 }
 
 /// Enable/disable English auto-restore (experimental feature).
@@ -254,13 +567,10 @@ pub extern "C" fn ime_modern(modern: bool) {
 /// When `enabled` is true, automatically restores English words that were
 /// accidentally transformed (e.g., "tẽt" → "text", "ễpct" → "expect").
 /// When `enabled` is false (default), no auto-restore happens.
-/// No-op if engine not initialized.
+/// No-op if engine not initialized. Lock-free, as `ime_method`.
 #[no_mangle]
 pub extern "C" fn ime_english_auto_restore(enabled: bool) {
-    let mut guard = lock_engine();
-    if let Some(ref mut e) = *guard {
-        e.set_english_auto_restore(enabled);
-    }
+    Flag::EnglishAutoRestore.store(enabled);
 }
 
 /// Enable/disable auto-capitalize after sentence-ending punctuation.
@@ -268,13 +578,10 @@ pub extern "C" fn ime_english_auto_restore(enabled: bool) {
 /// When `enabled` is true, automatically capitalizes the first letter
 /// after sentence-ending punctuation (. ! ? Enter).
 /// When `enabled` is false (default), no auto-capitalize happens.
-/// No-op if engine not initialized.
+/// No-op if engine not initialized. Lock-free, as `ime_method`.
 #[no_mangle]
 pub extern "C" fn ime_auto_capitalize(enabled: bool) {
-    let mut guard = lock_engine();
-    if let Some(ref mut e) = *guard {
-        e.set_auto_capitalize(enabled);
-    }
+    Flag::AutoCapitalize.store(enabled);
 }
 
 /// Enable/disable foreign consonants (z, w, j, f) as valid initial consonants.
@@ -282,13 +589,10 @@ pub extern "C" fn ime_auto_capitalize(enabled: bool) {
 /// When `enabled` is true, allows z, w, j, f as valid Vietnamese consonants
 /// for typing loanwords while still getting Vietnamese diacritics.
 /// When `enabled` is false (default), these letters are treated as invalid initials.
-/// No-op if engine not initialized.
+/// No-op if engine not initialized. Lock-free, as `ime_method`.
 #[no_mangle]
 pub extern "C" fn ime_allow_foreign_consonants(enabled: bool) {
-    let mut guard = lock_engine();
-    if let Some(ref mut e) = *guard {
-        e.set_allow_foreign_consonants(enabled);
-    }
+    Flag::AllowForeignConsonants.store(enabled);
 }
 
 /// Clear the input buffer.
@@ -322,49 +626,438 @@ pub extern "C" fn ime_clear_all() {
 /// Used for "Select All + Replace" injection method where the entire
 /// buffer content is needed instead of incremental backspace + chars.
 ///
-/// # Arguments
-/// * `out` - Pointer to output buffer for UTF-32 codepoints
-/// * `max_len` - Maximum number of codepoints to write
+/// # Arguments
+/// * `out` - Pointer to output buffer for UTF-32 codepoints
+/// * `max_len` - Maximum number of codepoints to write
+///
+/// # Returns
+/// Number of codepoints written to `out`.
+///
+/// # Safety
+/// `out` must point to valid memory of at least `max_len * sizeof(u32)` bytes.
+#[no_mangle]
+pub unsafe extern "C" fn ime_get_buffer(out: *mut u32, max_len: i64) -> i64 {
+    if out.is_null() || max_len <= 0 {
+        return 0;
+    }
+
+    let guard = lock_engine();
+    if let Some(ref e) = *guard {
+        write_buffer_utf32(e, out, max_len)
+    } else {
+        0
+    }
+}
+
+/// Copy the composed buffer of `e` as UTF-32 into `out` (at most `max_len`).
+///
+/// # Safety
+/// `out` must point to valid memory of at least `max_len * sizeof(u32)` bytes.
+unsafe fn write_buffer_utf32(e: &Engine, out: *mut u32, max_len: i64) -> i64 {
+    let full = e.get_buffer_string();
+    let utf32: Vec<u32> = full.chars().map(|c| c as u32).collect();
+    let len = utf32.len().min(max_len as usize);
+    std::ptr::copy_nonoverlapping(utf32.as_ptr(), out, len);
+    len as i64
+}
+
+/// Free a result pointer returned by `ime_key`.
+///
+/// # Safety
+/// * `r` must be a pointer returned by `ime_key`, or null
+/// * Must be called exactly once per non-null `ime_key` return
+/// * Do not use `r` after calling this function
+#[no_mangle]
+pub unsafe extern "C" fn ime_free(r: *mut Result) {
+    if !r.is_null() {
+        drop(Box::from_raw(r));
+    }
+}
+
+// ============================================================
+// Engine Handle FFI
+// ============================================================
+//
+// Independent engine instances for hosts that track several input
+// contexts (e.g. one per Fcitx5 window). Each handle owns its own buffer,
+// word history and settings, and is NOT synchronized: a handle must only
+// be used from one thread at a time. The global `ime_*` functions above
+// are unaffected and keep using the shared `ENGINE`.
+
+/// Create a new engine instance with default settings.
+///
+/// # Returns
+/// Owned handle; release with `ime_engine_free`.
+#[no_mangle]
+pub extern "C" fn ime_engine_new() -> *mut Engine {
+    Box::into_raw(Box::new(Engine::new()))
+}
+
+/// Destroy an engine instance created by `ime_engine_new`.
+///
+/// # Safety
+/// * `h` must be a handle returned by `ime_engine_new`, or null
+/// * Do not use `h` after calling this function
+#[no_mangle]
+pub unsafe extern "C" fn ime_engine_free(h: *mut Engine) {
+    if !h.is_null() {
+        drop(Box::from_raw(h));
+    }
+}
+
+/// Process a key event on an engine instance.
+///
+/// Same semantics as `ime_key_ext`, without taking the global lock.
+///
+/// # Returns
+/// * Pointer to `Result` struct (caller must free with `ime_free`)
+/// * `null` if `h` is null
+///
+/// # Safety
+/// `h` must be a valid handle from `ime_engine_new`, or null.
+#[no_mangle]
+pub unsafe extern "C" fn ime_engine_key_ext(
+    h: *mut Engine,
+    key: u16,
+    caps: bool,
+    ctrl: bool,
+    shift: bool,
+) -> *mut Result {
+    match h.as_mut() {
+        Some(e) => Box::into_raw(Box::new(e.on_key_ext(key, caps, ctrl, shift))),
+        None => std::ptr::null_mut(),
+    }
+}
+
+/// Process a key event on an engine instance into a caller-provided buffer.
+///
+/// Allocation-free variant of `ime_engine_key_ext` (see `ime_key_into`).
+///
+/// # Returns
+/// `true` if `out` was filled, `false` if `h` or `out` is null.
+///
+/// # Safety
+/// * `h` must be a valid handle from `ime_engine_new`, or null
+/// * `out` must point to writable memory for one `Result`, or be null
+#[no_mangle]
+pub unsafe extern "C" fn ime_engine_key_into(
+    h: *mut Engine,
+    out: *mut Result,
+    key: u16,
+    caps: bool,
+    ctrl: bool,
+    shift: bool,
+) -> bool {
+    match h.as_mut() {
+        Some(e) if !out.is_null() => {
+            out.write(e.on_key_ext(key, caps, ctrl, shift));
+            true
+        }
+        _ => false,
+    }
+}
+
+/// Process a key event on an engine instance into a UTF-8 result buffer.
+///
+/// Handle variant of `ime_key_utf8`.
+///
+/// # Returns
+/// `true` if `out` was filled, `false` if `h` or `out` is null.
+///
+/// # Safety
+/// * `h` must be a valid handle from `ime_engine_new`, or null
+/// * `out` must point to writable memory for one `Utf8Result`, or be null
+#[no_mangle]
+pub unsafe extern "C" fn ime_engine_key_utf8(
+    h: *mut Engine,
+    out: *mut Utf8Result,
+    key: u16,
+    caps: bool,
+    ctrl: bool,
+    shift: bool,
+) -> bool {
+    match h.as_mut() {
+        Some(e) if !out.is_null() => {
+            out.write(Utf8Result::from(&e.on_key_ext(key, caps, ctrl, shift)));
+            true
+        }
+        _ => false,
+    }
+}
+
+/// Process a key event on an engine instance into a compact result.
+///
+/// Handle variant of `ime_key_compact`.
+///
+/// # Returns
+/// `true` if `out` was filled, `false` if `h` or `out` is null or the text
+/// did not fit `spill`.
+///
+/// # Safety
+/// * `h` must be a valid handle from `ime_engine_new`, or null
+/// * `out` and `spill` as for `ime_key_compact`
+#[no_mangle]
+pub unsafe extern "C" fn ime_engine_key_compact(
+    h: *mut Engine,
+    out: *mut CompactResult,
+    spill: *mut u8,
+    cap: usize,
+    key: u16,
+    caps: bool,
+    ctrl: bool,
+    shift: bool,
+) -> bool {
+    match h.as_mut() {
+        Some(e) if !out.is_null() => {
+            let r = e.on_key_ext(key, caps, ctrl, shift);
+            write_compact(out, &r, e.state_summary(), spill, cap)
+        }
+        _ => false,
+    }
+}
+
+/// Process a sequence of key events on an engine instance.
+///
+/// Handle variant of `ime_keys_batch`.
+///
+/// # Returns
+/// `true` if `result` was filled, `false` if any pointer is null.
+///
+/// # Safety
+/// * `h` must be a valid handle from `ime_engine_new`, or null
+/// * `events`, `out` and `result` as for `ime_keys_batch`
+#[no_mangle]
+pub unsafe extern "C" fn ime_engine_keys_batch(
+    h: *mut Engine,
+    events: *const KeyEvent,
+    n: usize,
+    out: *mut u8,
+    cap: usize,
+    result: *mut BatchResult,
+) -> bool {
+    if events.is_null() || out.is_null() || result.is_null() {
+        return false;
+    }
+    match h.as_mut() {
+        Some(e) => {
+            let events = std::slice::from_raw_parts(events, n);
+            let out = std::slice::from_raw_parts_mut(out, cap);
+            result.write(engine::batch::process_batch(e, events, out));
+            true
+        }
+        None => false,
+    }
+}
+
+/// Run key events on an engine instance and write the reference trace.
+///
+/// One record per event (see `engine::reference`), encoded in Rust from
+/// the raw results, for checking a host's per-key FFI path against. Space
+/// for `n * (3 + 1024)` bytes always suffices.
+///
+/// # Returns
+/// Trace length in bytes; the trace is written only if it fits in `cap`.
+/// 0 if any pointer is null.
+///
+/// # Safety
+/// * `h` must be a valid handle from `ime_engine_new`, or null
+/// * `events` must point to `n` valid `KeyEvent`s
+/// * `out` must point to `cap` writable bytes
+#[no_mangle]
+pub unsafe extern "C" fn ime_engine_reference_replay(
+    h: *mut Engine,
+    events: *const KeyEvent,
+    n: usize,
+    out: *mut u8,
+    cap: usize,
+) -> usize {
+    let e = match h.as_mut() {
+        Some(e) if !events.is_null() && !out.is_null() => e,
+        _ => return 0,
+    };
+    let mut trace = Vec::with_capacity(n * engine::reference::RECORD_HEADER);
+    engine::reference::replay(e, std::slice::from_raw_parts(events, n), &mut trace);
+    if trace.len() <= cap {
+        std::ptr::copy_nonoverlapping(trace.as_ptr(), out, trace.len());
+    }
+    trace.len()
+}
+
+/// Set the input method of an engine instance (0=Telex, 1=VNI).
+///
+/// # Safety
+/// `h` must be a valid handle from `ime_engine_new`, or null.
+#[no_mangle]
+pub unsafe extern "C" fn ime_engine_method(h: *mut Engine, method: u8) {
+    if let Some(e) = h.as_mut() {
+        e.set_method(method);
+    }
+}
+
+/// Enable or disable an engine instance.
+///
+/// # Safety
+/// `h` must be a valid handle from `ime_engine_new`, or null.
+#[no_mangle]
+pub unsafe extern "C" fn ime_engine_enabled(h: *mut Engine, enabled: bool) {
+    if let Some(e) = h.as_mut() {
+        e.set_enabled(enabled);
+    }
+}
+
+/// Clear the input buffer of an engine instance (see `ime_clear`).
+///
+/// # Safety
+/// `h` must be a valid handle from `ime_engine_new`, or null.
+#[no_mangle]
+pub unsafe extern "C" fn ime_engine_clear(h: *mut Engine) {
+    if let Some(e) = h.as_mut() {
+        e.clear();
+    }
+}
+
+/// Clear buffer and word history of an engine instance (see `ime_clear_all`).
+///
+/// # Safety
+/// `h` must be a valid handle from `ime_engine_new`, or null.
+#[no_mangle]
+pub unsafe extern "C" fn ime_engine_clear_all(h: *mut Engine) {
+    if let Some(e) = h.as_mut() {
+        e.clear_all();
+    }
+}
+
+/// Set modern tone placement of an engine instance (see `ime_modern`).
+///
+/// # Safety
+/// `h` must be a valid handle from `ime_engine_new`, or null.
+#[no_mangle]
+pub unsafe extern "C" fn ime_engine_modern(h: *mut Engine, modern: bool) {
+    if let Some(e) = h.as_mut() {
+        e.set_modern_tone(modern);
+    }
+}
+
+/// Set free tone placement of an engine instance (see `ime_free_tone`).
+///
+/// # Safety
+/// `h` must be a valid handle from `ime_engine_new`, or null.
+#[no_mangle]
+pub unsafe extern "C" fn ime_engine_free_tone(h: *mut Engine, enabled: bool) {
+    if let Some(e) = h.as_mut() {
+        e.set_free_tone(enabled);
+    }
+}
+
+/// Set English auto-restore of an engine instance (see `ime_english_auto_restore`).
+///
+/// # Safety
+/// `h` must be a valid handle from `ime_engine_new`, or null.
+#[no_mangle]
+pub unsafe extern "C" fn ime_engine_english_auto_restore(h: *mut Engine, enabled: bool) {
+    if let Some(e) = h.as_mut() {
+        e.set_english_auto_restore(enabled);
+    }
+}
+
+/// Set auto-capitalize of an engine instance (see `ime_auto_capitalize`).
+///
+/// # Safety
+/// `h` must be a valid handle from `ime_engine_new`, or null.
+#[no_mangle]
+pub unsafe extern "C" fn ime_engine_auto_capitalize(h: *mut Engine, enabled: bool) {
+    if let Some(e) = h.as_mut() {
+        e.set_auto_capitalize(enabled);
+    }
+}
+
+/// Set skip of the w→ư shortcut of an engine instance (see `ime_skip_w_shortcut`).
+///
+/// # Safety
+/// `h` must be a valid handle from `ime_engine_new`, or null.
+#[no_mangle]
+pub unsafe extern "C" fn ime_engine_skip_w_shortcut(h: *mut Engine, skip: bool) {
+    if let Some(e) = h.as_mut() {
+        e.set_skip_w_shortcut(skip);
+    }
+}
+
+/// Set bracket shortcuts of an engine instance (see `ime_bracket_shortcut`).
+///
+/// # Safety
+/// `h` must be a valid handle from `ime_engine_new`, or null.
+#[no_mangle]
+pub unsafe extern "C" fn ime_engine_bracket_shortcut(h: *mut Engine, enabled: bool) {
+    if let Some(e) = h.as_mut() {
+        e.set_bracket_shortcut(enabled);
+    }
+}
+
+/// Set ESC restore of an engine instance (see `ime_esc_restore`).
+///
+/// # Safety
+/// `h` must be a valid handle from `ime_engine_new`, or null.
+#[no_mangle]
+pub unsafe extern "C" fn ime_engine_esc_restore(h: *mut Engine, enabled: bool) {
+    if let Some(e) = h.as_mut() {
+        e.set_esc_restore(enabled);
+    }
+}
+
+/// Set foreign consonants of an engine instance (see `ime_allow_foreign_consonants`).
+///
+/// # Safety
+/// `h` must be a valid handle from `ime_engine_new`, or null.
+#[no_mangle]
+pub unsafe extern "C" fn ime_engine_allow_foreign_consonants(h: *mut Engine, enabled: bool) {
+    if let Some(e) = h.as_mut() {
+        e.set_allow_foreign_consonants(enabled);
+    }
+}
+
+/// Get the composed buffer of an engine instance (see `ime_get_buffer`).
+///
+/// Used by hosts that render the current word as preedit text.
 ///
 /// # Returns
 /// Number of codepoints written to `out`.
 ///
 /// # Safety
-/// `out` must point to valid memory of at least `max_len * sizeof(u32)` bytes.
+/// * `h` must be a valid handle from `ime_engine_new`, or null
+/// * `out` must point to valid memory of at least `max_len * sizeof(u32)` bytes
 #[no_mangle]
-pub unsafe extern "C" fn ime_get_buffer(out: *mut u32, max_len: i64) -> i64 {
+pub unsafe extern "C" fn ime_engine_get_buffer(h: *mut Engine, out: *mut u32, max_len: i64) -> i64 {
     if out.is_null() || max_len <= 0 {
         return 0;
     }
-
-    let guard = lock_engine();
-    if let Some(ref e) = *guard {
-        let full = e.get_buffer_string();
-        let utf32: Vec<u32> = full.chars().map(|c| c as u32).collect();
-        let len = utf32.len().min(max_len as usize);
-        std::ptr::copy_nonoverlapping(utf32.as_ptr(), out, len);
-        len as i64
-    } else {
-        0
+    match h.as_ref() {
+        Some(e) => write_buffer_utf32(e, out, max_len),
+        None => 0,
     }
 }
 
-/// Free a result pointer returned by `ime_key`.
+// ============================================================
+// Shortcut FFI
+// ============================================================
+
+/// Read a C string as UTF-8 (None for null or invalid UTF-8).
 ///
 /// # Safety
-/// * `r` must be a pointer returned by `ime_key`, or null
-/// * Must be called exactly once per non-null `ime_key` return
-/// * Do not use `r` after calling this function
-#[no_mangle]
-pub unsafe extern "C" fn ime_free(r: *mut Result) {
-    if !r.is_null() {
-        drop(Box::from_raw(r));
+/// Pointer must be null or a valid null-terminated string.
+unsafe fn c_str<'a>(p: *const std::os::raw::c_char) -> Option<&'a str> {
+    if p.is_null() {
+        return None;
     }
+    std::ffi::CStr::from_ptr(p).to_str().ok()
 }
 
-// ============================================================
-// Shortcut FFI
-// ============================================================
+/// Add a shortcut to an engine, auto-detecting its trigger type:
+/// - If trigger contains only non-letter chars (like "->", "=>"), use immediate trigger
+/// - Otherwise use word boundary trigger (traditional abbreviations like "vn" → "Việt Nam")
+fn add_shortcut(e: &mut Engine, trigger: &str, replacement: &str) {
+    e.shortcuts_mut()
+        .add(engine::shortcut::Shortcut::auto(trigger, replacement));
+}
 
 /// Add a shortcut to the engine.
 ///
@@ -379,31 +1072,13 @@ pub unsafe extern "C" fn ime_add_shortcut(
     trigger: *const std::os::raw::c_char,
     replacement: *const std::os::raw::c_char,
 ) {
-    if trigger.is_null() || replacement.is_null() {
+    let (Some(trigger), Some(replacement)) = (c_str(trigger), c_str(replacement)) else {
         return;
-    }
-
-    let trigger_str = match std::ffi::CStr::from_ptr(trigger).to_str() {
-        Ok(s) => s,
-        Err(_) => return,
-    };
-    let replacement_str = match std::ffi::CStr::from_ptr(replacement).to_str() {
-        Ok(s) => s,
-        Err(_) => return,
     };
 
     let mut guard = lock_engine();
     if let Some(ref mut e) = *guard {
-        // Auto-detect shortcut type:
-        // - If trigger contains only non-letter chars (like "->", "=>"), use immediate trigger
-        // - Otherwise use word boundary trigger (traditional abbreviations like "vn" → "Việt Nam")
-        let is_symbol_trigger = trigger_str.chars().all(|c| !c.is_alphabetic());
-        let shortcut = if is_symbol_trigger {
-            engine::shortcut::Shortcut::immediate(trigger_str, replacement_str)
-        } else {
-            engine::shortcut::Shortcut::new(trigger_str, replacement_str)
-        };
-        e.shortcuts_mut().add(shortcut);
+        add_shortcut(e, trigger, replacement);
     }
 }
 
@@ -440,6 +1115,167 @@ pub extern "C" fn ime_clear_shortcuts() {
     }
 }
 
+/// Add a shortcut to an engine instance (see `ime_add_shortcut`).
+///
+/// # Safety
+/// * `h` must be a valid handle from `ime_engine_new`, or null
+/// * Both strings must be valid null-terminated UTF-8 strings
+#[no_mangle]
+pub unsafe extern "C" fn ime_engine_add_shortcut(
+    h: *mut Engine,
+    trigger: *const std::os::raw::c_char,
+    replacement: *const std::os::raw::c_char,
+) {
+    if let (Some(e), Some(trigger), Some(replacement)) =
+        (h.as_mut(), c_str(trigger), c_str(replacement))
+    {
+        add_shortcut(e, trigger, replacement);
+    }
+}
+
+/// Clear all shortcuts of an engine instance.
+///
+/// # Safety
+/// `h` must be a valid handle from `ime_engine_new`, or null.
+#[no_mangle]
+pub unsafe extern "C" fn ime_engine_clear_shortcuts(h: *mut Engine) {
+    if let Some(e) = h.as_mut() {
+        e.shortcuts_mut().clear();
+    }
+}
+
+// ============================================================
+// Shared Shortcut Table FFI
+// ============================================================
+//
+// A table is compiled once (e.g. from a memory-mapped shortcut file) and
+// installed into any number of engine instances; installing shares the
+// entries instead of copying them.
+
+/// Create an empty shortcut table. Free with `ime_shortcuts_free`.
+#[no_mangle]
+pub extern "C" fn ime_shortcuts_new() -> *mut ShortcutTable {
+    Box::into_raw(Box::default())
+}
+
+/// Free a table from `ime_shortcuts_new`. Engines it was installed into
+/// keep their shortcuts.
+///
+/// # Safety
+/// `t` must be a handle from `ime_shortcuts_new` (not yet freed), or null.
+#[no_mangle]
+pub unsafe extern "C" fn ime_shortcuts_free(t: *mut ShortcutTable) {
+    if !t.is_null() {
+        drop(Box::from_raw(t));
+    }
+}
+
+/// Add one shortcut to a table (trigger type as in `ime_add_shortcut`).
+///
+/// # Safety
+/// `t` must be a valid table handle, or null. Strings must be valid
+/// null-terminated UTF-8, or null.
+#[no_mangle]
+pub unsafe extern "C" fn ime_shortcuts_add(
+    t: *mut ShortcutTable,
+    trigger: *const std::os::raw::c_char,
+    replacement: *const std::os::raw::c_char,
+) {
+    if let (Some(t), Some(trigger), Some(replacement)) =
+        (t.as_mut(), c_str(trigger), c_str(replacement))
+    {
+        t.add(engine::shortcut::Shortcut::auto(trigger, replacement));
+    }
+}
+
+/// Add `trigger=replacement` lines to a table (see `ShortcutTable::load_lines`).
+///
+/// # Arguments
+/// * `data` - UTF-8 text, not null-terminated (e.g. a mapped file)
+/// * `len` - Length of `data` in bytes
+///
+/// # Returns
+/// Number of shortcuts added (0 if the text is not valid UTF-8)
+///
+/// # Safety
+/// `t` must be a valid table handle, or null. `data` must point to `len`
+/// readable bytes, or be null.
+#[no_mangle]
+pub unsafe extern "C" fn ime_shortcuts_load(
+    t: *mut ShortcutTable,
+    data: *const u8,
+    len: usize,
+) -> u32 {
+    let Some(t) = t.as_mut() else { return 0 };
+    if data.is_null() {
+        return 0;
+    }
+    match std::str::from_utf8(std::slice::from_raw_parts(data, len)) {
+        Ok(text) => t.load_lines(text) as u32,
+        Err(_) => 0,
+    }
+}
+
+/// New table sharing the entries of table `t` (O(1)). Free with
+/// `ime_shortcuts_free`.
+///
+/// # Safety
+/// `t` must be a valid table handle, or null (null is returned).
+#[no_mangle]
+pub unsafe extern "C" fn ime_shortcuts_clone(t: *const ShortcutTable) -> *mut ShortcutTable {
+    match t.as_ref() {
+        Some(t) => Box::into_raw(Box::new(t.clone())),
+        None => std::ptr::null_mut(),
+    }
+}
+
+/// Number of shortcuts in a table.
+///
+/// # Safety
+/// `t` must be a valid table handle, or null.
+#[no_mangle]
+pub unsafe extern "C" fn ime_shortcuts_len(t: *const ShortcutTable) -> u32 {
+    t.as_ref().map_or(0, |t| t.len() as u32)
+}
+
+/// Replace the shortcuts of an engine instance with table `t` (O(1): the
+/// entries are shared; later changes to either side copy on write).
+///
+/// # Safety
+/// `h` must be a valid handle from `ime_engine_new`, or null.
+/// `t` must be a valid table handle, or null.
+#[no_mangle]
+pub unsafe extern "C" fn ime_engine_set_shortcuts(h: *mut Engine, t: *const ShortcutTable) {
+    if let (Some(e), Some(t)) = (h.as_mut(), t.as_ref()) {
+        *e.shortcuts_mut() = t.clone();
+    }
+}
+
+/// New table sharing the shortcuts of an engine instance (O(1)), e.g. to
+/// install them into the engine that replaces it. Free with
+/// `ime_shortcuts_free`.
+///
+/// # Safety
+/// `h` must be a valid handle from `ime_engine_new`, or null (null is
+/// returned).
+#[no_mangle]
+pub unsafe extern "C" fn ime_engine_shortcuts(h: *const Engine) -> *mut ShortcutTable {
+    match h.as_ref() {
+        Some(e) => Box::into_raw(Box::new(e.shortcuts().clone())),
+        None => std::ptr::null_mut(),
+    }
+}
+
+/// Bytes owned by an engine instance (see `Engine::memory_bytes`).
+///
+/// # Safety
+/// `h` must be a valid handle from `ime_engine_new`, or null (0 is
+/// returned).
+#[no_mangle]
+pub unsafe extern "C" fn ime_engine_memory(h: *const Engine) -> usize {
+    h.as_ref().map_or(0, Engine::memory_bytes)
+}
+
 // ============================================================
 // Word Restore FFI
 // ============================================================
@@ -470,6 +1306,46 @@ pub unsafe extern "C" fn ime_restore_word(word: *const std::os::raw::c_char) {
     }
 }
 
+/// Resume editing the word before the cursor on an engine instance.
+///
+/// Seeds the buffer of `h` from the trailing word of `text` (see
+/// `Engine::resume_word`): only words of at most `ime_max_syllable_chars()`
+/// letters are restored, so callers may pass just the last few characters
+/// before the cursor. Does nothing while a word is being composed.
+///
+/// # Arguments
+/// * `h` - Engine handle
+/// * `text` - UTF-8 text before the cursor (not null-terminated)
+/// * `len` - Length of `text` in bytes
+///
+/// # Returns
+/// Number of chars restored (0 = buffer untouched)
+///
+/// # Safety
+/// `h` must be a valid handle from `ime_engine_new`, or null.
+/// `text` must point to `len` readable bytes, or be null.
+#[no_mangle]
+pub unsafe extern "C" fn ime_engine_resume_word(
+    h: *mut Engine,
+    text: *const u8,
+    len: usize,
+) -> u32 {
+    let e = match h.as_mut() {
+        Some(e) if !text.is_null() => e,
+        _ => return 0,
+    };
+    match std::str::from_utf8(std::slice::from_raw_parts(text, len)) {
+        Ok(s) => e.resume_word(s) as u32,
+        Err(_) => 0,
+    }
+}
+
+/// Longest word (in chars) `ime_engine_resume_word` restores.
+#[no_mangle]
+pub extern "C" fn ime_max_syllable_chars() -> u32 {
+    engine::MAX_SYLLABLE_CHARS as u32
+}
+
 // ============================================================
 // Tests
 // ============================================================
@@ -502,6 +1378,45 @@ mod tests {
         ime_clear();
     }
 
+    /// First char of the global engine's result for `keys` typed in turn
+    fn global_type(keys: &[u16]) -> u32 {
+        let mut last = 0;
+        for &k in keys {
+            let r = ime_key(k, false, false);
+            assert!(!r.is_null());
+            unsafe {
+                last = if (*r).action == 0 { 0 } else { (*r).chars[0] };
+                ime_free(r);
+            }
+        }
+        ime_clear();
+        last
+    }
+
+    #[test]
+    #[serial]
+    fn test_settings_do_not_wait_for_keys() {
+        ime_init();
+        let in_flight = lock_engine();
+        // Would deadlock if setters took the engine lock
+        std::thread::spawn(|| {
+            ime_method(1);
+            ime_enabled(false);
+            ime_enabled(true);
+        })
+        .join()
+        .unwrap();
+        drop(in_flight);
+        assert_eq!(global_type(&[keys::A, keys::N1]), 'á' as u32); // VNI
+
+        ime_enabled(false);
+        assert_eq!(global_type(&[keys::A, keys::N1]), 0);
+
+        // A new engine starts from defaults
+        ime_init();
+        assert_eq!(global_type(&[keys::A, keys::S]), 'á' as u32); // Telex
+    }
+
     #[test]
     #[serial]
     fn test_shortcut_ffi_add_and_clear() {
@@ -913,4 +1828,522 @@ mod tests {
         ime_clear_shortcuts();
         ime_clear();
     }
+
+    #[test]
+    fn test_engine_handles_are_independent() {
+        let a = ime_engine_new();
+        let b = ime_engine_new();
+        assert!(!a.is_null() && !b.is_null());
+
+        unsafe {
+            // Start a word on `a`, then type a full syllable on `b`
+            ime_free(ime_engine_key_ext(a, keys::A, false, false, false));
+            ime_free(ime_engine_key_ext(b, keys::A, false, false, false));
+            ime_engine_clear(b);
+
+            // `a` must still hold its buffer after `b` was cleared
+            let r = ime_engine_key_ext(a, keys::S, false, false, false);
+            assert!(!r.is_null());
+            assert_eq!((*r).action, engine::Action::Send as u8);
+            assert_eq!((*r).backspace, 1);
+            assert_eq!((*r).chars[0], 'á' as u32);
+            ime_free(r);
+
+            // Settings are per handle too
+            ime_engine_method(b, 1); // VNI on `b` only
+            ime_free(ime_engine_key_ext(b, keys::A, false, false, false));
+            let r = ime_engine_key_ext(b, keys::N1, false, false, false);
+            assert_eq!((*r).chars[0], 'á' as u32);
+            ime_free(r);
+
+            ime_engine_free(a);
+            ime_engine_free(b);
+        }
+    }
+
+    #[test]
+    fn test_engine_handle_null_safety() {
+        unsafe {
+            assert!(
+                ime_engine_key_ext(std::ptr::null_mut(), keys::A, false, false, false).is_null()
+            );
+            ime_engine_method(std::ptr::null_mut(), 1);
+            ime_engine_enabled(std::ptr::null_mut(), false);
+            ime_engine_clear(std::ptr::null_mut());
+            ime_engine_clear_all(std::ptr::null_mut());
+            ime_engine_free(std::ptr::null_mut());
+        }
+    }
+
+    #[test]
+    #[serial]
+    fn test_key_into_ffi() {
+        ime_init();
+        ime_method(0); // Telex
+
+        let mut r = engine::Result::none();
+        unsafe {
+            assert!(ime_key_into(&mut r, keys::A, false, false, false));
+            assert!(ime_key_into(&mut r, keys::S, false, false, false));
+            assert_eq!(r.action, engine::Action::Send as u8);
+            assert_eq!(r.backspace, 1);
+            assert_eq!(r.chars[0], 'á' as u32);
+            assert!(!ime_key_into(
+                std::ptr::null_mut(),
+                keys::A,
+                false,
+                false,
+                false
+            ));
+        }
+
+        ime_clear();
+    }
+
+    #[test]
+    fn test_engine_key_into_ffi() {
+        let h = ime_engine_new();
+        let mut r = engine::Result::none();
+        unsafe {
+            assert!(ime_engine_key_into(h, &mut r, keys::O, false, false, false));
+            assert!(ime_engine_key_into(h, &mut r, keys::O, false, false, false));
+            assert_eq!(r.backspace, 1);
+            assert_eq!(r.chars[0], 'ô' as u32);
+
+            assert!(!ime_engine_key_into(
+                h,
+                std::ptr::null_mut(),
+                keys::A,
+                false,
+                false,
+                false
+            ));
+            assert!(!ime_engine_key_into(
+                std::ptr::null_mut(),
+                &mut r,
+                keys::A,
+                false,
+                false,
+                false
+            ));
+            ime_engine_free(h);
+        }
+    }
+
+    #[test]
+    fn test_engine_key_utf8_ffi() {
+        let h = ime_engine_new();
+        let mut r = std::mem::MaybeUninit::<Utf8Result>::uninit();
+        unsafe {
+            // "dd" → "đ", then "uw" → "ư": multi-byte output
+            for &k in &[keys::D, keys::D, keys::U] {
+                assert!(ime_engine_key_utf8(
+                    h,
+                    r.as_mut_ptr(),
+                    k,
+                    false,
+                    false,
+                    false
+                ));
+            }
+            assert!(ime_engine_key_utf8(
+                h,
+                r.as_mut_ptr(),
+                keys::W,
+                false,
+                false,
+                false
+            ));
+            let r = r.assume_init_ref();
+            assert_eq!(r.action, engine::Action::Send as u8);
+            assert_eq!(r.backspace, 1);
+            assert_eq!(&r.bytes[..r.len as usize], "ư".as_bytes());
+
+            ime_engine_free(h);
+        }
+    }
+
+    #[test]
+    fn test_utf8_result_matches_chars() {
+        let r = engine::Result::send(2, &['V', 'i', 'ệ', 't', '✅']);
+        let u = Utf8Result::from(&r);
+        assert_eq!(u.backspace, 2);
+        assert_eq!(u.action, r.action);
+        assert_eq!(&u.bytes[..u.len as usize], "Việt✅".as_bytes());
+        assert_eq!(Utf8Result::from(&engine::Result::none()).len, 0);
+    }
+
+    #[test]
+    fn test_compact_result_inline_and_spilled() {
+        assert_eq!(std::mem::size_of::<CompactResult>(), 32);
+        let mut spill = [0u8; engine::UTF8_MAX];
+
+        let r = engine::Result::send(2, &['V', 'i', 'ệ', 't']);
+        let c = CompactResult::encode(&r, &mut spill).unwrap();
+        assert_eq!(c.flags & engine::FLAG_SPILLED, 0);
+        assert_eq!(c.backspace, 2);
+        assert_eq!(&c.bytes[..c.len as usize], "Việt".as_bytes());
+
+        // 8 three-byte letters still fit; one more byte spills everything
+        let long: Vec<char> = "ệệệệệệệệ".chars().collect();
+        let c = CompactResult::encode(&engine::Result::send(0, &long), &mut spill).unwrap();
+        assert_eq!((c.flags & engine::FLAG_SPILLED, c.len), (0, 24));
+        let expansion: Vec<char> = "Thành phố Hồ Chí Minh".chars().collect();
+        let r = engine::Result::send_consumed(5, &expansion);
+        let c = CompactResult::encode(&r, &mut spill).unwrap();
+        assert_ne!(c.flags & engine::FLAG_SPILLED, 0);
+        assert_ne!(c.flags & engine::FLAG_KEY_CONSUMED, 0);
+        assert_eq!(&spill[..c.len as usize], "Thành phố Hồ Chí Minh".as_bytes());
+
+        // Spill too small: nothing to return
+        assert!(CompactResult::encode(&r, &mut [0u8; 8]).is_none());
+        assert_eq!(
+            CompactResult::encode(&engine::Result::none(), &mut [])
+                .unwrap()
+                .len,
+            0
+        );
+    }
+
+    #[test]
+    fn test_state_summary_pass_keys_are_no_ops() {
+        // One engine sees every key; the other skips the keys its summary
+        // lets a host skip. Vowels are only a/e so no word has three vowel
+        // types, whose circumflex check iterates a HashSet.
+        let letters = [
+            keys::A,
+            keys::E,
+            keys::B,
+            keys::D,
+            keys::N,
+            keys::S,
+            keys::F,
+            keys::J,
+            keys::W,
+            keys::T,
+        ];
+        for (method, auto_capitalize) in [(0, false), (1, true)] {
+            let mut full = Engine::new();
+            let mut skipping = Engine::new();
+            for e in [&mut full, &mut skipping] {
+                e.set_method(method);
+                e.set_auto_capitalize(auto_capitalize);
+                e.shortcuts_mut()
+                    .add(engine::shortcut::Shortcut::new("@ab", "x"));
+            }
+            let mut seed: u32 = 2024;
+            let mut skipped = 0;
+            for _ in 0..20000 {
+                seed = seed.wrapping_mul(1103515245).wrapping_add(12345);
+                let (key, shift) = match (seed >> 16) % 16 {
+                    0..=4 => (keys::DELETE, false),
+                    5 => (keys::N2, true),
+                    6 => (keys::N1, true),
+                    7 => (keys::N5, false),
+                    8 => (keys::SPACE, false),
+                    9 => {
+                        // Word break handled by the host
+                        full.clear();
+                        skipping.clear();
+                        continue;
+                    }
+                    n => (
+                        letters[(n as usize + (seed as usize >> 8)) % letters.len()],
+                        false,
+                    ),
+                };
+                let pass = key == keys::DELETE
+                    && skipping.state_summary() & engine::STATE_PASS_DELETE != 0;
+                let expected = full.on_key_ext(key, false, false, shift);
+                if pass {
+                    assert_eq!(expected.action, 0, "key {} passed through", key);
+                    skipped += 1;
+                } else {
+                    let got = skipping.on_key_ext(key, false, false, shift);
+                    assert_eq!(
+                        (got.action, got.backspace, got.flags),
+                        (expected.action, expected.backspace, expected.flags)
+                    );
+                    assert_eq!(
+                        &got.chars[..got.count as usize],
+                        &expected.chars[..expected.count as usize]
+                    );
+                }
+                assert_eq!(skipping.get_buffer_string(), full.get_buffer_string());
+                assert_eq!(skipping.state_summary(), full.state_summary());
+            }
+            assert!(skipped > 100, "only {} DELETEs skipped", skipped);
+        }
+    }
+
+    #[test]
+    fn test_engine_key_compact_ffi() {
+        assert_eq!(ime_result_layout(0), 0);
+        assert_eq!(ime_result_layout(1), 1);
+        assert_eq!(ime_result_layout(u32::MAX), engine::COMPACT_VERSION);
+
+        let h = ime_engine_new();
+        let mut r = std::mem::MaybeUninit::<CompactResult>::uninit();
+        unsafe {
+            for &k in &[keys::D, keys::D] {
+                assert!(ime_engine_key_compact(
+                    h,
+                    r.as_mut_ptr(),
+                    std::ptr::null_mut(),
+                    0,
+                    k,
+                    false,
+                    false,
+                    false
+                ));
+            }
+            let r = r.assume_init_ref();
+            assert_eq!(r.action, engine::Action::Send as u8);
+            assert_eq!(r.backspace, 1);
+            assert_eq!(&r.bytes[..r.len as usize], "đ".as_bytes());
+            assert_eq!(r.state & engine::STATE_BUFFER_EMPTY, 0);
+            ime_engine_free(h);
+        }
+    }
+
+    #[test]
+    fn test_engine_get_buffer_ffi() {
+        let h = ime_engine_new();
+        let mut out = [0u32; 8];
+        unsafe {
+            for &k in &[keys::V, keys::I, keys::E, keys::E, keys::T, keys::J] {
+                ime_free(ime_engine_key_ext(h, k, false, false, false));
+            }
+            let n = ime_engine_get_buffer(h, out.as_mut_ptr(), out.len() as i64);
+            let word: String = out[..n as usize]
+                .iter()
+                .filter_map(|&c| char::from_u32(c))
+                .collect();
+            assert_eq!(word, "việt");
+
+            // Truncated to max_len, null-safe
+            assert_eq!(ime_engine_get_buffer(h, out.as_mut_ptr(), 2), 2);
+            assert_eq!(ime_engine_get_buffer(h, std::ptr::null_mut(), 8), 0);
+            assert_eq!(
+                ime_engine_get_buffer(std::ptr::null_mut(), out.as_mut_ptr(), 8),
+                0
+            );
+            ime_engine_free(h);
+        }
+    }
+
+    #[test]
+    #[serial]
+    fn test_keys_batch_ffi() {
+        ime_init();
+        ime_method(0); // Telex
+
+        let events: Vec<KeyEvent> = [keys::V, keys::I, keys::E, keys::E, keys::T, keys::J]
+            .iter()
+            .map(|&k| KeyEvent::new(k, false, false))
+            .collect();
+        let mut out = [0u8; 2048];
+        let mut r = BatchResult::default();
+        unsafe {
+            assert!(ime_keys_batch(
+                events.as_ptr(),
+                events.len(),
+                out.as_mut_ptr(),
+                out.len(),
+                &mut r
+            ));
+            assert!(!ime_keys_batch(
+                std::ptr::null(),
+                0,
+                out.as_mut_ptr(),
+                out.len(),
+                &mut r
+            ));
+        }
+        assert_eq!(r.consumed, 6);
+        assert_eq!(r.backspace, 0);
+        assert_eq!(&out[..r.len as usize], "việt".as_bytes());
+
+        ime_clear();
+    }
+
+    #[test]
+    fn test_engine_keys_batch_ffi() {
+        let h = ime_engine_new();
+        let events = [
+            KeyEvent::new(keys::D, false, false),
+            KeyEvent::new(keys::D, false, false),
+        ];
+        let mut out = [0u8; 2048];
+        let mut r = BatchResult::default();
+        unsafe {
+            assert!(ime_engine_keys_batch(
+                h,
+                events.as_ptr(),
+                events.len(),
+                out.as_mut_ptr(),
+                out.len(),
+                &mut r
+            ));
+            ime_engine_free(h);
+        }
+        assert_eq!(&out[..r.len as usize], "đ".as_bytes());
+    }
+
+    #[test]
+    fn test_engine_settings_setters() {
+        unsafe {
+            let h = ime_engine_new();
+            ime_engine_modern(h, true);
+            ime_engine_free_tone(h, true);
+            ime_engine_english_auto_restore(h, true);
+            ime_engine_auto_capitalize(h, true);
+            ime_engine_skip_w_shortcut(h, true);
+            ime_engine_bracket_shortcut(h, true);
+            ime_engine_esc_restore(h, true);
+            ime_engine_allow_foreign_consonants(h, true);
+            assert!((*h).allow_foreign_consonants());
+            assert!((*h).shortcuts().is_empty());
+
+            let trigger = std::ffi::CString::new("vn").unwrap();
+            let replacement = std::ffi::CString::new("Việt Nam").unwrap();
+            ime_engine_add_shortcut(h, trigger.as_ptr(), replacement.as_ptr());
+            assert_eq!((*h).shortcuts().len(), 1);
+            ime_engine_clear_shortcuts(h);
+            assert!((*h).shortcuts().is_empty());
+
+            // Null handles and strings are ignored
+            ime_engine_modern(std::ptr::null_mut(), true);
+            ime_engine_add_shortcut(h, std::ptr::null(), replacement.as_ptr());
+            assert!((*h).shortcuts().is_empty());
+            ime_engine_free(h);
+        }
+    }
+
+    #[test]
+    fn test_warm_up_from_another_thread() {
+        let warm = std::thread::spawn(|| ime_warm_up());
+        ime_warm_up();
+        warm.join().unwrap();
+        assert!(data::english_dict::is_english_word("view"));
+        assert!(data::dictionary::is_vietnamese("việt", false));
+    }
+
+    #[test]
+    #[serial]
+    fn test_prefetch_leaves_global_engine_alone() {
+        ime_init();
+        ime_method(0);
+        let _ = ime_key(keys::A, false, false);
+        {
+            // Prefetch does not need the lock a key event holds
+            let _guard = lock_engine();
+            std::thread::spawn(|| ime_prefetch()).join().unwrap();
+        }
+        assert_eq!(global_type(&[keys::S]), 'á' as u32);
+    }
+
+    #[test]
+    fn test_engine_resume_word() {
+        unsafe {
+            let h = ime_engine_new();
+            ime_engine_method(h, 0); // Telex
+
+            // Trailing word of the text before the cursor is restored
+            let text = "tôi là ngươi";
+            assert_eq!(ime_engine_resume_word(h, text.as_ptr(), text.len()), 5);
+            let r = ime_engine_key_ext(h, keys::F, false, false, false);
+            assert!(!r.is_null());
+            assert_eq!((*r).action, engine::Action::Send as u8);
+            assert_eq!((*h).get_buffer_string(), "người");
+            ime_free(r);
+
+            // Cursor after a break, or a word longer than a syllable: untouched
+            ime_engine_clear(h);
+            for text in ["việt ", "shortcuts", ""] {
+                assert_eq!(ime_engine_resume_word(h, text.as_ptr(), text.len()), 0);
+                assert!((*h).get_buffer_string().is_empty());
+            }
+            let longest = "nghiêng";
+            assert_eq!(longest.chars().count() as u32, ime_max_syllable_chars());
+            assert_eq!(
+                ime_engine_resume_word(h, longest.as_ptr(), longest.len()),
+                7
+            );
+
+            // Invalid UTF-8 and null pointers are ignored
+            let bad = [0xE1u8, 0xBA];
+            assert_eq!(ime_engine_resume_word(h, bad.as_ptr(), bad.len()), 0);
+            assert_eq!(ime_engine_resume_word(h, std::ptr::null(), 4), 0);
+            assert_eq!(
+                ime_engine_resume_word(std::ptr::null_mut(), text.as_ptr(), 1),
+                0
+            );
+            ime_engine_free(h);
+        }
+    }
+
+    #[test]
+    fn test_shared_shortcut_table() {
+        unsafe {
+            let t = ime_shortcuts_new();
+            let file = "vn=Việt Nam\n# comment\nhn=Hà Nội\n";
+            assert_eq!(ime_shortcuts_load(t, file.as_ptr(), file.len()), 2);
+            let trigger = std::ffi::CString::new("->").unwrap();
+            let replacement = std::ffi::CString::new("→").unwrap();
+            ime_shortcuts_add(t, trigger.as_ptr(), replacement.as_ptr());
+            assert_eq!(ime_shortcuts_len(t), 3);
+
+            let a = ime_engine_new();
+            let b = ime_engine_new();
+            ime_engine_set_shortcuts(a, t);
+            ime_engine_set_shortcuts(b, t);
+            ime_shortcuts_free(t);
+            assert_eq!((*a).shortcuts().len(), 3);
+            assert!((*b).shortcuts().lookup("hn").is_some());
+
+            // Invalid UTF-8 and null handles are ignored
+            let bad = [b'v', b'=', 0xFF];
+            let empty = ime_shortcuts_new();
+            assert_eq!(ime_shortcuts_load(empty, bad.as_ptr(), 3), 0);
+            ime_shortcuts_free(empty);
+            assert_eq!(
+                ime_shortcuts_load(std::ptr::null_mut(), file.as_ptr(), 1),
+                0
+            );
+            assert_eq!(ime_shortcuts_len(std::ptr::null()), 0);
+            ime_engine_set_shortcuts(a, std::ptr::null());
+            assert_eq!((*a).shortcuts().len(), 3);
+            ime_engine_free(a);
+            ime_engine_free(b);
+        }
+    }
+
+    #[test]
+    fn test_engine_shortcuts_outlive_engine() {
+        unsafe {
+            let h = ime_engine_new();
+            let trigger = std::ffi::CString::new("vn").unwrap();
+            let replacement = std::ffi::CString::new("Việt Nam").unwrap();
+            ime_engine_add_shortcut(h, trigger.as_ptr(), replacement.as_ptr());
+            let before = (*h).shortcuts().len();
+            assert!(ime_engine_memory(h) >= std::mem::size_of::<Engine>());
+
+            // What an evicted engine keeps, and installs into its successor
+            let parked = ime_engine_shortcuts(h);
+            ime_engine_free(h);
+            let copy = ime_shortcuts_clone(parked);
+            ime_shortcuts_free(parked);
+            let h = ime_engine_new();
+            ime_engine_set_shortcuts(h, copy);
+            ime_shortcuts_free(copy);
+            assert_eq!((*h).shortcuts().len(), before);
+            assert!((*h).shortcuts().lookup("vn").is_some());
+            ime_engine_free(h);
+
+            assert!(ime_engine_shortcuts(std::ptr::null()).is_null());
+            assert!(ime_shortcuts_clone(std::ptr::null()).is_null());
+            assert_eq!(ime_engine_memory(std::ptr::null()), 0);
+        }
+    }
 }
@@ -2198,3 +2198,18 @@ fn bug_dayddr_expect_daydr() {
         ("dodf", "đò"),
     ]);
 }
+
+// =============================================================================
+// BUG: "theories" -> "thẻoies" or "thểois" depending on the engine instance
+// With three vowel types in the buffer, the vowel the circumflex check paired
+// with the trigger came from a HashSet, so it followed per-instance hash
+// order. Bulk conversion runs one engine per thread and saw both.
+// =============================================================================
+
+#[test]
+fn bug_theories_same_on_every_engine() {
+    // The second "e" is past "o" and "i": no circumflex on the first
+    for _ in 0..32 {
+        assert_eq!(type_word(&mut Engine::new(), "theories"), "thẻoies");
+    }
+}
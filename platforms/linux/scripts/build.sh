@@ -1,6 +1,8 @@
 #!/bin/bash
 # Build script for Linux platform
-# Usage: ./scripts/build.sh [--release]
+# Usage: ./scripts/build.sh [--debug] [--static] [--lto]
+#   --static  link the Rust core into gonhanh.so (no libgonhanh_core.so)
+#   --lto     --static plus ThinLTO across C++ and Rust (clang, lld)
 
 set -e
 
@@ -9,14 +11,30 @@ LINUX_DIR="$(dirname "$SCRIPT_DIR")"
 ROOT_DIR="$(dirname "$(dirname "$LINUX_DIR")")"
 CORE_DIR="$ROOT_DIR/core"
 BUILD_TYPE="Release"
+STATIC_CORE="OFF"
+CROSS_LTO="OFF"
 
 # Parse arguments
-if [[ "$1" == "--debug" ]]; then
-    BUILD_TYPE="Debug"
+for arg in "$@"; do
+    case "$arg" in
+        --debug) BUILD_TYPE="Debug" ;;
+        --static) STATIC_CORE="ON" ;;
+        --lto) STATIC_CORE="ON"; CROSS_LTO="ON" ;;
+    esac
+done
+
+# Cross-language LTO needs rustc and clang on the same LLVM major version
+if [[ "$CROSS_LTO" == "ON" ]]; then
+    RUST_LLVM=$(rustc -vV | awk '/LLVM version/ {split($3, v, "."); print v[1]}')
+    CLANG_LLVM=$(clang++ --version 2>/dev/null | sed -n 's/.*clang version \([0-9]*\).*/\1/p' | head -1)
+    if [[ -z "$CLANG_LLVM" || "$RUST_LLVM" != "$CLANG_LLVM" ]]; then
+        echo "Warning: rustc uses LLVM $RUST_LLVM, clang++ ${CLANG_LLVM:-not found} - building --static without LTO"
+        CROSS_LTO="OFF"
+    fi
 fi
 
 echo "=== Building Gõ Nhanh Linux (Fcitx5) ==="
-echo "Build type: $BUILD_TYPE"
+echo "Build type: $BUILD_TYPE (static core: $STATIC_CORE, cross-language LTO: $CROSS_LTO)"
 echo ""
 
 # Step 1: Build Rust core
@@ -31,6 +49,11 @@ if [[ -z "$HOST_TRIPLE" ]]; then
 fi
 echo "Host target: $HOST_TRIPLE"
 
+# The staticlib then carries LLVM bitcode for the linker to optimize with the addon
+if [[ "$CROSS_LTO" == "ON" ]]; then
+    export RUSTFLAGS="${RUSTFLAGS:+$RUSTFLAGS }-Clinker-plugin-lto"
+fi
+
 if [[ "$BUILD_TYPE" == "Debug" ]]; then
     cargo build
     RUST_TARGET_DIR="target/debug"
@@ -39,14 +62,17 @@ else
     RUST_TARGET_DIR="target/release"
 fi
 
+RUST_LIB="$RUST_TARGET_DIR/libgonhanh_core.so"
+[[ "$STATIC_CORE" == "ON" ]] && RUST_LIB="$RUST_TARGET_DIR/libgonhanh_core.a"
+
 # Verify library exists
-if [[ ! -f "$RUST_TARGET_DIR/libgonhanh_core.so" ]]; then
-    echo "Error: Rust library not found at $RUST_TARGET_DIR/libgonhanh_core.so"
+if [[ ! -f "$RUST_LIB" ]]; then
+    echo "Error: Rust library not found at $RUST_LIB"
     echo "Build failed. Check cargo output above."
     exit 1
 fi
 
-echo "Rust core built: $RUST_TARGET_DIR/libgonhanh_core.so"
+echo "Rust core built: $RUST_LIB"
 echo ""
 
 # Step 2: Build C++ addon
@@ -55,13 +81,28 @@ cd "$LINUX_DIR"
 mkdir -p build
 cd build
 
-cmake .. -DCMAKE_BUILD_TYPE=$BUILD_TYPE
+CMAKE_ARGS=(-DCMAKE_BUILD_TYPE=$BUILD_TYPE -DGONHANH_STATIC_CORE=$STATIC_CORE -DGONHANH_CROSS_LTO=$CROSS_LTO)
+[[ "$CROSS_LTO" == "ON" ]] && CMAKE_ARGS+=(-DCMAKE_CXX_COMPILER=clang++)
+cmake .. "${CMAKE_ARGS[@]}"
 make -j$(nproc)
 
 echo ""
 echo "=== Build complete ==="
 echo "Addon: $LINUX_DIR/build/gonhanh.so"
 echo ""
+
+# Package size: the libraries an install copies
+echo "=== Package size ==="
+PACKAGE_LIBS=("$LINUX_DIR/build/gonhanh.so")
+[[ "$STATIC_CORE" == "OFF" ]] && PACKAGE_LIBS+=("$CORE_DIR/$RUST_LIB")
+TOTAL=0
+for lib in "${PACKAGE_LIBS[@]}"; do
+    SIZE=$(stat -c %s "$lib")
+    TOTAL=$((TOTAL + SIZE))
+    printf "  %-24s %8d KiB\n" "$(basename "$lib")" $((SIZE / 1024))
+done
+printf "  %-24s %8d KiB\n" "total" $((TOTAL / 1024))
+echo ""
 echo "To install (user-local):"
 echo "  make install-user"
 echo ""
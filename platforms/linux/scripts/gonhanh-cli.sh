@@ -4,14 +4,34 @@
 
 VERSION=$(cat ~/.local/share/gonhanh/version 2>/dev/null || echo "1.0.0")
 CONFIG_DIR="$HOME/.config/gonhanh"
-METHOD_FILE="$CONFIG_DIR/method"
+SETTINGS_FILE="$CONFIG_DIR/settings"
 
 # Colors
 G='\033[0;32m' Y='\033[0;33m' B='\033[0;34m' N='\033[0m'
 
+# Read a top-level key from the settings file
+get_setting() {
+    sed -n "/^\[/q; s/^$1[[:space:]]*=[[:space:]]*//p" "$SETTINGS_FILE" 2>/dev/null | tail -1
+}
+
+# Set a top-level key (the addon reloads the file on change)
+set_setting() {
+    mkdir -p "$CONFIG_DIR"
+    touch "$SETTINGS_FILE"
+    local tmp
+    tmp=$(mktemp "$CONFIG_DIR/.settings.XXXXXX")
+    awk -v key="$1" -v value="$2" '
+        !done && /^\[/ { print key "=" value; done = 1 }
+        !done && $0 ~ "^" key "[[:space:]]*=" { print key "=" value; done = 1; next }
+        { print }
+        END { if (!done) print key "=" value }
+    ' "$SETTINGS_FILE" > "$tmp" && mv "$tmp" "$SETTINGS_FILE"
+}
+
 # Show status: ● BẬT │ telex or ○ TẮT │ telex
 show_status() {
-    METHOD=$(cat "$METHOD_FILE" 2>/dev/null || echo "telex")
+    METHOD=$(get_setting method)
+    [[ -z "$METHOD" ]] && METHOD=$(cat "$CONFIG_DIR/method" 2>/dev/null || echo "telex")
     STATE=$(fcitx5-remote 2>/dev/null)
     if [[ "$STATE" == "2" ]]; then
         echo -e "${G}● BẬT${N} │ $METHOD"
@@ -21,17 +41,21 @@ show_status() {
 }
 
 case "$1" in
-    telex)
-        mkdir -p "$CONFIG_DIR"
-        echo "telex" > "$METHOD_FILE"
-        fcitx5-remote -r 2>/dev/null || fcitx5 -r 2>/dev/null
+    telex|vni)
+        set_setting method "$1"
         show_status
         ;;
-    vni)
-        mkdir -p "$CONFIG_DIR"
-        echo "vni" > "$METHOD_FILE"
-        fcitx5-remote -r 2>/dev/null || fcitx5 -r 2>/dev/null
-        show_status
+    set)
+        case "$2" in
+            method|modern|free_tone|english_auto_restore|auto_capitalize|\
+            allow_foreign_consonants|esc_restore|skip_w_shortcut|bracket_shortcut|terminal_apps|\
+            async_commit|candidates|keep_warm|lock_memory|evict_idle|\
+            key_trace|key_record|key_log_sample) ;;
+            *) echo -e "${Y}[!]${N} Khóa không hợp lệ: $2"; exit 1 ;;
+        esac
+        [[ -z "$3" ]] && { echo -e "${Y}[!]${N} Thiếu giá trị cho $2"; exit 1; }
+        set_setting "$2" "$3"
+        echo -e "${G}[✓]${N} $2=$3"
         ;;
     on)
         fcitx5-remote -o 2>/dev/null
@@ -48,6 +72,40 @@ case "$1" in
     status)
         show_status
         ;;
+    trace)
+        # Key trace ring (needs key_trace=true); binary dump if a file is given
+        if [[ -n "$2" ]]; then
+            dbus-send --session --print-reply=literal --dest=org.fcitx.Fcitx5 \
+                /gonhanh org.fcitx.Fcitx5.GoNhanh.DumpKeyTrace string:"$(realpath -m "$2")" \
+                >/dev/null 2>&1 && echo -e "${G}[✓]${N} $2" \
+                || { echo -e "${Y}[!]${N} Không ghi được $2"; exit 1; }
+        else
+            dbus-send --session --print-reply=literal --dest=org.fcitx.Fcitx5 \
+                /gonhanh org.fcitx.Fcitx5.GoNhanh.KeyTrace 2>/dev/null \
+                || { echo -e "${Y}[!]${N} Fcitx5 chưa chạy?"; exit 1; }
+        fi
+        ;;
+    stats)
+        # Latency histograms exported by the addon on D-Bus
+        METHOD=Stats
+        [[ "$2" == "reset" ]] && METHOD=ResetStats
+        dbus-send --session --print-reply=literal --dest=org.fcitx.Fcitx5 \
+            /gonhanh org.fcitx.Fcitx5.GoNhanh.$METHOD 2>/dev/null \
+            || { echo -e "${Y}[!]${N} Không lấy được thống kê (Fcitx5 chưa chạy?)"; exit 1; }
+        ;;
+    memory)
+        # Bytes per input context (engines of idle ones are evicted)
+        dbus-send --session --print-reply=literal --dest=org.fcitx.Fcitx5 \
+            /gonhanh org.fcitx.Fcitx5.GoNhanh.Memory 2>/dev/null \
+            || { echo -e "${Y}[!]${N} Fcitx5 chưa chạy?"; exit 1; }
+        ;;
+    convert)
+        # Telex/VNI text typed into fresh windows with the current settings
+        shift
+        command -v gonhanh-convert >/dev/null \
+            || { echo -e "${Y}[!]${N} Chưa cài gonhanh-convert"; exit 1; }
+        exec gonhanh-convert "$@"
+        ;;
     version|-v|--version)
         echo "Gõ Nhanh v$VERSION"
         ;;
@@ -75,7 +133,12 @@ case "$1" in
         echo "  off          Tắt tiếng Việt"
         echo "  telex        Chuyển sang Telex"
         echo "  vni          Chuyển sang VNI"
+        echo "  set <khóa> <giá trị>  Đổi cài đặt (xem ~/.config/gonhanh/settings)"
         echo "  status       Xem trạng thái"
+        echo "  stats [reset]  Độ trễ phím (p50/p99/p999, phím chậm)"
+        echo "  trace [tệp]    Các phím gần nhất (cần key_trace=true)"
+        echo "  memory         Bộ nhớ của từng cửa sổ"
+        echo "  convert [tệp]  Chuyển văn bản gõ Telex/VNI sang tiếng Việt"
         echo "  update       Cập nhật phiên bản mới"
         echo "  uninstall    Gỡ cài đặt"
         echo "  version      Xem phiên bản"
@@ -17,18 +17,24 @@ DIR="$(cd "$(dirname "$0")" && pwd)"
 [[ -f "$SRC/lib/gonhanh.so" ]] && LIB="$SRC/lib" || LIB="$SRC/build"
 [[ -f "$SRC/share/fcitx5/addon/gonhanh.conf" ]] && DATA="$SRC/share/fcitx5" || DATA="$SRC/data"
 
-# Find Rust lib
+# Find Rust lib (not needed when the core is linked into gonhanh.so)
 RUST=""
+NEED_RUST=1
+[[ -f "$LIB/gonhanh.so" ]] && ! grep -q "libgonhanh_core.so" "$LIB/gonhanh.so" && NEED_RUST=0
 for p in "$LIB/libgonhanh_core.so" "$SRC/../../core/target/release/libgonhanh_core.so" "$SRC/../../core/target/debug/libgonhanh_core.so"; do
     [[ -f "$p" ]] && RUST="$p" && break
 done
 
-[[ ! -f "$LIB/gonhanh.so" || -z "$RUST" ]] && echo "Error: Build not found" && exit 1
+[[ ! -f "$LIB/gonhanh.so" || ( $NEED_RUST == 1 && -z "$RUST" ) ]] && echo "Error: Build not found" && exit 1
 
 # Install
 mkdir -p ~/.local/lib/fcitx5 ~/.local/share/fcitx5/{addon,inputmethod}
 cp "$LIB/gonhanh.so" ~/.local/lib/fcitx5/
-cp "$RUST" ~/.local/lib/
+if [[ $NEED_RUST == 1 ]]; then
+    cp "$RUST" ~/.local/lib/
+else
+    rm -f ~/.local/lib/libgonhanh_core.so  # Left over from a shared-core install
+fi
 [[ -f "$DATA/addon/gonhanh.conf" ]] && cp "$DATA/addon/gonhanh.conf" ~/.local/share/fcitx5/addon/
 [[ -f "$DATA/inputmethod/gonhanh.conf" ]] && cp "$DATA/inputmethod/gonhanh.conf" ~/.local/share/fcitx5/inputmethod/
 [[ -f "$DATA/gonhanh-addon.conf" ]] && cp "$DATA/gonhanh-addon.conf" ~/.local/share/fcitx5/addon/gonhanh.conf
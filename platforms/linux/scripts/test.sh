@@ -52,5 +52,97 @@ else
     echo "Warning: RustBridge tests not built (Rust library may be missing)"
 fi
 
+# Run key path allocation tests (requires Rust library)
+if [[ -f "allocation_test" ]]; then
+    echo ""
+    echo "--- Allocation Tests ---"
+    LD_LIBRARY_PATH="$CORE_DIR/target/release:$LD_LIBRARY_PATH" ./allocation_test --gtest_color=yes
+fi
+
+# Run settings file tests
+if [[ -f "settings_test" ]]; then
+    echo ""
+    echo "--- Settings Tests ---"
+    LD_LIBRARY_PATH="$CORE_DIR/target/release:$LD_LIBRARY_PATH" ./settings_test --gtest_color=yes
+fi
+
+# Run latency histogram tests
+if [[ -f "latency_test" ]]; then
+    echo ""
+    echo "--- Latency Stats Tests ---"
+    ./latency_test --gtest_color=yes
+fi
+
+# Run key trace tests
+if [[ -f "keytrace_test" ]]; then
+    echo ""
+    echo "--- Key Trace Tests ---"
+    ./keytrace_test --gtest_color=yes
+fi
+
+# Run key recording tests
+if [[ -f "keyrecorder_test" ]]; then
+    echo ""
+    echo "--- Key Recorder Tests ---"
+    ./keyrecorder_test --gtest_color=yes
+fi
+
+# Run edit queue tests
+if [[ -f "editqueue_test" ]]; then
+    echo ""
+    echo "--- Edit Queue Tests ---"
+    ./editqueue_test --gtest_color=yes
+fi
+
+# Run preedit mode tests (requires Rust library)
+if [[ -f "preeditword_test" ]]; then
+    echo ""
+    echo "--- Preedit Word Tests ---"
+    LD_LIBRARY_PATH="$CORE_DIR/target/release:$LD_LIBRARY_PATH" ./preeditword_test --gtest_color=yes
+fi
+
+# Run word history tests
+if [[ -f "wordhistory_test" ]]; then
+    echo ""
+    echo "--- Word History Tests ---"
+    ./wordhistory_test --gtest_color=yes
+fi
+
+# Run word completion dictionary tests
+if [[ -f "worddict_test" ]]; then
+    echo ""
+    echo "--- Word Dictionary Tests ---"
+    ./worddict_test --gtest_color=yes
+fi
+
+# Run engine daemon tests (requires Rust library)
+if [[ -f "engineservice_test" ]]; then
+    echo ""
+    echo "--- Engine Service Tests ---"
+    LD_LIBRARY_PATH="$CORE_DIR/target/release:$LD_LIBRARY_PATH" ./engineservice_test --gtest_color=yes
+fi
+
+# Run bulk conversion tests (requires Rust library)
+if [[ -f "textconverter_test" ]]; then
+    echo ""
+    echo "--- Text Converter Tests ---"
+    LD_LIBRARY_PATH="$CORE_DIR/target/release:$LD_LIBRARY_PATH" ./textconverter_test --gtest_color=yes
+fi
+
+# Run bridge vs core differential check (requires Rust library)
+if [[ -f "gonhanh_diff" ]]; then
+    echo ""
+    echo "--- Bridge vs Core Differential ---"
+    LD_LIBRARY_PATH="$CORE_DIR/target/release:$LD_LIBRARY_PATH" ./gonhanh_diff --keys 200000
+fi
+
+# Replay throughput on 1..nproc threads (requires Rust library)
+if [[ -f "gonhanh-replay" ]]; then
+    echo ""
+    echo "--- Corpus Replay Scaling ---"
+    LD_LIBRARY_PATH="$CORE_DIR/target/release:$LD_LIBRARY_PATH" \
+        ./gonhanh-replay "$CORE_DIR/tests/data/english_100k.txt"
+fi
+
 echo ""
 echo "=== All tests passed ==="
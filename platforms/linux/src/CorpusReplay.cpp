@@ -0,0 +1,259 @@
+// gonhanh-replay: replay a key corpus through per-thread engines
+//
+//   gonhanh-replay [--threads N] [--passes P] [--method telex|vni] <corpus>
+//
+// The corpus is memory-mapped and split at word breaks into one shard per
+// thread; every thread owns a RustEngine (as every input context does in the
+// addon) and replays its shard P times. Runs 1, 2, 4... up to N threads and
+// reports keys/sec and the speedup over one thread.
+//
+// Corpus formats:
+//   - a key trace dump (`gn trace <file>`, KeyTraceHeader + records):
+//     keysyms with their caps/shift flags as the addon saw them
+//   - anything else is typed text: one key per byte, printable ASCII as its
+//     own keysym (uppercase and shifted symbols with Shift), newline as
+//     Return, tab as Tab; other bytes are skipped
+//
+// Keys go through KeycodeMap like GoNhanhEngine::keyEvent (surrounding mode):
+// break keys end the word, unknown keys pass through.
+//
+// Exit status: 0 on success, 1 if the corpus cannot be read, 2 on bad usage.
+
+#include "KeyTrace.h"
+#include "KeycodeMap.h"
+#include "RustBridge.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace GoNhanh;
+
+namespace {
+
+struct Options {
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t passes = 1;
+    InputMethod method = InputMethod::Telex;
+    const char* path = nullptr;
+};
+
+// A keysym with the modifier state the engine sees
+struct Key {
+    uint32_t keysym;
+    bool caps;   // Effective case (Shift XOR CapsLock for letters)
+    bool shift;
+};
+
+// Read-only view of the mapped corpus, decoded one key at a time
+class Corpus {
+public:
+    ~Corpus() {
+        if (map_) munmap(map_, size_);
+    }
+
+    bool open(const char* path) {
+        int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            size_ = static_cast<size_t>(st.st_size);
+            void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            map_ = data == MAP_FAILED ? nullptr : data;
+        }
+        ::close(fd);
+        if (!map_) return false;
+        madvise(map_, size_, MADV_SEQUENTIAL);
+
+        const char* data = static_cast<const char*>(map_);
+        KeyTraceHeader header;
+        if (size_ >= sizeof(header)) {
+            std::memcpy(&header, data, sizeof(header));
+        }
+        if (size_ >= sizeof(header) && std::memcmp(header.magic, "GNKT", 4) == 0) {
+            if (header.version != KeyTrace::FORMAT_VERSION ||
+                header.recordSize != sizeof(KeyTraceRecord) ||
+                size_ - sizeof(header) < size_t{header.count} * sizeof(KeyTraceRecord)) {
+                return false;
+            }
+            records_ = reinterpret_cast<const KeyTraceRecord*>(data + sizeof(header));
+            count_ = header.count;
+        } else {
+            text_ = data;
+            count_ = size_;
+        }
+        return true;
+    }
+
+    bool isTrace() const { return records_ != nullptr; }
+    size_t size() const { return count_; }
+
+    // Returns: false for bytes of a text corpus that are not keys
+    bool key(size_t i, Key& out) const {
+        if (records_) {
+            const KeyTraceRecord& r = records_[i];
+            out = {r.keysym, (r.flags & TRACE_CAPS) != 0, (r.flags & TRACE_SHIFT) != 0};
+            return true;
+        }
+        unsigned char c = static_cast<unsigned char>(text_[i]);
+        if (c == '\n') {
+            out = {XKB_KEY_Return, false, false};
+        } else if (c == '\t') {
+            out = {XKB_KEY_Tab, false, false};
+        } else if (c >= 0x20 && c < 0x7F) {
+            bool upper = c >= 'A' && c <= 'Z';
+            out = {c, upper, upper || std::strchr("~!@#$%^&*()_+{}|:\"<>?", c) != nullptr};
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // First index at or after `i` that follows a break key (a word start)
+    size_t wordStart(size_t i) const {
+        Key k;
+        while (i < count_ && !(key(i, k) && KeycodeMap::isBreakKey(k.keysym))) {
+            ++i;
+        }
+        return std::min(i + 1, count_);
+    }
+
+private:
+    void* map_ = nullptr;
+    size_t size_ = 0;
+    const KeyTraceRecord* records_ = nullptr;
+    const char* text_ = nullptr;
+    size_t count_ = 0;
+};
+
+struct ShardResult {
+    size_t keys = 0;          // Keys sent to the engine (break keys included)
+    size_t outputBytes = 0;   // UTF-8 committed by the engine
+};
+
+// One thread's work: `passes` replays of [begin, end) on a private engine
+ShardResult replay(const Corpus& corpus, size_t begin, size_t end, const Options& opts) {
+    RustEngine engine;
+    engine.setMethod(opts.method);
+    ShardResult result;
+    KeyOutput output;
+    for (size_t pass = 0; pass < opts.passes; ++pass) {
+        engine.clearAll();
+        for (size_t i = begin; i < end; ++i) {
+            Key k;
+            if (!corpus.key(i, k)) {
+                continue;
+            }
+            auto info = KeycodeMap::lookup(k.keysym);
+            ++result.keys;
+            if (info.isBreak()) {
+                engine.clear();
+                continue;
+            }
+            if (info.isUnknown()) {
+                continue;
+            }
+            if (engine.processKey(info.keycode(), k.caps, false, k.shift, output)) {
+                result.outputBytes += output.length;
+            }
+        }
+    }
+    return result;
+}
+
+// Replay the whole corpus on `threads` shards
+// Returns: keys/sec over the wall time of the slowest shard
+double run(const Corpus& corpus, size_t threads, const Options& opts, ShardResult& total) {
+    std::vector<size_t> bounds{0};
+    for (size_t t = 1; t < threads; ++t) {
+        bounds.push_back(std::max(bounds.back(), corpus.wordStart(corpus.size() * t / threads)));
+    }
+    bounds.push_back(corpus.size());
+
+    std::vector<ShardResult> results(threads);
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] { results[t] = replay(corpus, bounds[t], bounds[t + 1], opts); });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    total = {};
+    for (const auto& r : results) {
+        total.keys += r.keys;
+        total.outputBytes += r.outputBytes;
+    }
+    return seconds > 0 ? total.keys / seconds : 0;
+}
+
+bool parseArgs(int argc, char** argv, Options& opts) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (arg[0] != '-') {
+            if (opts.path) return false;
+            opts.path = arg;
+            continue;
+        }
+        const char* value = i + 1 < argc ? argv[++i] : nullptr;
+        if (!value) {
+            return false;
+        }
+        if (std::strcmp(arg, "--threads") == 0) {
+            opts.threads = std::strtoull(value, nullptr, 10);
+        } else if (std::strcmp(arg, "--passes") == 0) {
+            opts.passes = std::strtoull(value, nullptr, 10);
+        } else if (std::strcmp(arg, "--method") == 0 && std::strcmp(value, "telex") == 0) {
+            opts.method = InputMethod::Telex;
+        } else if (std::strcmp(arg, "--method") == 0 && std::strcmp(value, "vni") == 0) {
+            opts.method = InputMethod::VNI;
+        } else {
+            return false;
+        }
+    }
+    return opts.path && opts.threads > 0 && opts.passes > 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opts;
+    if (!parseArgs(argc, argv, opts)) {
+        std::fprintf(stderr, "usage: %s [--threads N] [--passes P] [--method telex|vni] <corpus>\n",
+                     argv[0]);
+        return 2;
+    }
+
+    Corpus corpus;
+    if (!corpus.open(opts.path)) {
+        std::fprintf(stderr, "cannot read %s (missing, empty or a bad key trace)\n", opts.path);
+        return 1;
+    }
+    std::printf("%s: %zu %s, %zu passes\n", opts.path, corpus.size(),
+                corpus.isTrace() ? "traced keys" : "bytes of text", opts.passes);
+    RustBridge::warmUp();  // Keep dictionary builds out of the timings
+
+    double single = 0;
+    for (size_t threads = 1;; threads = std::min(threads * 2, opts.threads)) {
+        ShardResult total;
+        double rate = run(corpus, threads, opts, total);
+        if (threads == 1) single = rate;
+        double speedup = single > 0 ? rate / single : 0;
+        std::printf("%3zu threads: %8.2f Mkeys/s  speedup %5.2fx  efficiency %3.0f%%  (%zu keys, %zu bytes out)\n",
+                    threads, rate / 1e6, speedup, 100 * speedup / threads, total.keys, total.outputBytes);
+        if (threads == opts.threads) break;
+    }
+    return 0;
+}
@@ -0,0 +1,35 @@
+// gonhanh-dictc: compile a word list into a WordDict file
+//
+//   gonhanh-dictc <words.txt> <words.dict>
+//
+// Input lines: `word` or `word<TAB>count` (see WordDict::compile)
+
+#include "WordDict.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::fprintf(stderr, "usage: %s <words.txt> <words.dict>\n", argv[0]);
+        return 2;
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+        std::fprintf(stderr, "cannot read %s\n", argv[1]);
+        return 1;
+    }
+    std::string lines((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    std::string image = GoNhanh::WordDict::compile(lines);
+    std::ofstream out(argv[2], std::ios::binary | std::ios::trunc);
+    out.write(image.data(), static_cast<std::streamsize>(image.size()));
+    if (!out.flush()) {
+        std::fprintf(stderr, "cannot write %s\n", argv[2]);
+        return 1;
+    }
+    return 0;
+}
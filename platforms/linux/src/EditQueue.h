@@ -0,0 +1,97 @@
+#ifndef GONHANH_EDIT_QUEUE_H
+#define GONHANH_EDIT_QUEUE_H
+
+// Outbound edit queue of one input context
+// keyEvent pushes (backspace, text) edits instead of calling
+// deleteSurroundingText + commitString directly; consecutive edits are merged
+// into one delete + one commit, applied on the next event loop iteration
+// (or earlier - see shouldFlushNow). One slow client then gets one round
+// trip per burst instead of two per key.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace GoNhanh {
+
+class EditQueue {
+public:
+    // Pending edits older than this are flushed on the next push
+    static constexpr std::chrono::milliseconds DEADLINE{8};
+    // Pending text longer than this is flushed on the next push (paste bursts)
+    static constexpr size_t MAX_PENDING_BYTES = 1024;
+
+    // Append one edit: delete `backspace` codepoints before the cursor, then
+    // insert `text`. Deletions covering pending text cancel it in place.
+    void push(int backspace, std::string_view text) {
+        if (empty()) {
+            since_ = std::chrono::steady_clock::now();
+        }
+        while (backspace > 0 && textChars_ > 0) {
+            popCodepoint();
+            --backspace;
+        }
+        backspace_ += backspace > 0 ? backspace : 0;
+        text_.append(text);
+        textChars_ += countCodepoints(text);
+    }
+
+    bool empty() const { return backspace_ == 0 && text_.empty(); }
+
+    // Deadline passed or too much text pending: apply before the event loop
+    bool shouldFlushNow() const {
+        return !empty() && (text_.size() > MAX_PENDING_BYTES ||
+                            std::chrono::steady_clock::now() - since_ >= DEADLINE);
+    }
+
+    // Hand the merged edit to `apply(int backspace, const std::string& text)`
+    // and clear the queue. No-op when empty.
+    template <typename Apply>
+    void flush(Apply&& apply) {
+        if (empty()) {
+            return;
+        }
+        int backspace = backspace_;
+        std::string text = std::move(text_);
+        clear();
+        apply(backspace, text);
+    }
+
+    // Drop pending edits
+    void clear() {
+        backspace_ = 0;
+        text_.clear();
+        textChars_ = 0;
+    }
+
+    int backspace() const { return backspace_; }
+    const std::string& text() const { return text_; }
+
+private:
+    static size_t countCodepoints(std::string_view s) {
+        size_t n = 0;
+        for (unsigned char c : s) {
+            n += (c & 0xC0) != 0x80;
+        }
+        return n;
+    }
+
+    void popCodepoint() {
+        size_t end = text_.size();
+        while (end > 0 && (static_cast<unsigned char>(text_[--end]) & 0xC0) == 0x80) {
+        }
+        text_.resize(end);
+        --textChars_;
+    }
+
+    int backspace_ = 0;
+    std::string text_;
+    size_t textChars_ = 0;
+    std::chrono::steady_clock::time_point since_;
+};
+
+} // namespace GoNhanh
+
+#endif // GONHANH_EDIT_QUEUE_H
@@ -1,65 +1,673 @@
 #include "Engine.h"
 #include "KeycodeMap.h"
+#include <fcitx/candidatelist.h>
+#include <fcitx/inputpanel.h>
+#include <fcitx/text.h>
+#include <fcitx-module/dbus/dbus_public.h>
+#include <fcitx-utils/dbus/objectvtable.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <filesystem>
 #include <fstream>
+#include <algorithm>
 #include <cstdlib>
+#include <functional>
+#include <sstream>
+#include <string_view>
+
+// Installed by CMake next to the addon data
+#ifndef GONHANH_WORD_DICT
+#define GONHANH_WORD_DICT "/usr/share/gonhanh/words.dict"
+#endif
+
+FCITX_DEFINE_LOG_CATEGORY(gonhanh, "gonhanh");
 
 namespace GoNhanh {
 
-// Load method from config file
-static InputMethod loadMethodFromConfig() {
-    const char* home = std::getenv("HOME");
-    if (!home) return InputMethod::Telex;
+static uint64_t steadyNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Load programs that use preedit composition (one program name per line)
+static std::unordered_set<std::string> loadPreeditAppsFromConfig(const std::string& dir) {
+    std::unordered_set<std::string> apps;
+    if (dir.empty()) return apps;
 
-    std::string path = std::string(home) + "/.config/gonhanh/method";
-    std::ifstream file(path);
-    if (!file) return InputMethod::Telex;
+    std::ifstream file(dir + "/preedit-apps");
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line[0] != '#') {
+            apps.insert(line);
+        }
+    }
+    return apps;
+}
 
-    std::string method;
-    std::getline(file, method);
+// Drain pending inotify events
+// Returns: true if any of them touched a config file
+static bool drainConfigEvents(int fd) {
+    alignas(inotify_event) char buf[4096];
+    bool changed = false;
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        for (char* p = buf; p < buf + n;) {
+            auto* event = reinterpret_cast<inotify_event*>(p);
+            if (event->len > 0) {
+                std::string_view name(event->name);
+                changed |= name == "settings" || name == "method" || name == "preedit-apps" ||
+                           name == "shortcuts";
+            }
+            p += sizeof(inotify_event) + event->len;
+        }
+    }
+    return changed;
+}
 
-    if (method == "vni" || method == "VNI") {
-        return InputMethod::VNI;
+// Map the completion dictionary: the user's copy (install-user) first,
+// then the system one
+// Returns: path mapped, or empty if none could be
+static std::string openWordDict(WordDict& dict) {
+    std::string user;
+    if (const char* data = std::getenv("XDG_DATA_HOME"); data && *data) {
+        user = data;
+    } else if (const char* home = std::getenv("HOME")) {
+        user = std::string(home) + "/.local/share";
+    }
+    for (std::string path : {user.empty() ? user : user + "/gonhanh/words.dict",
+                             std::string(GONHANH_WORD_DICT)}) {
+        if (!path.empty() && dict.open(path)) {
+            return path;
+        }
     }
-    return InputMethod::Telex;
+    return {};
+}
+
+// Word completion entry; selecting it (click or Tab) replaces the word
+class GoNhanhCandidate : public fcitx::CandidateWord {
+public:
+    GoNhanhCandidate(GoNhanhState* state, size_t index, const std::string& word)
+        : fcitx::CandidateWord(fcitx::Text(word)), state_(state), index_(index) {}
+
+    void select(fcitx::InputContext*) const override {
+        // Accepting replaces the candidate list, destroying this object
+        GoNhanhState* state = state_;
+        size_t index = index_;
+        state->acceptCandidate(index);
+    }
+
+private:
+    GoNhanhState* state_;
+    size_t index_;
+};
+
+// D-Bus interface: org.fcitx.Fcitx5.GoNhanh at /gonhanh (used by `gn stats`)
+class GoNhanhDBus : public fcitx::dbus::ObjectVTable<GoNhanhDBus> {
+public:
+    GoNhanhDBus(const KeyTrace& trace, std::function<std::string()> memory)
+        : trace_(trace), memory_(std::move(memory)) {}
+
+    std::string stats() {
+        if (!LATENCY_STATS_ENABLED) {
+            return "latency stats disabled at build time (GONHANH_LATENCY_STATS=OFF)\n";
+        }
+        return formatLatency(latencySnapshot());
+    }
+
+    void resetStats() { resetLatency(); }
+
+    std::string keyTrace() { return trace_.format(); }
+    bool dumpKeyTrace(const std::string& path) { return trace_.dump(path); }
+    std::string memory() { return memory_(); }
+
+private:
+    const KeyTrace& trace_;
+    std::function<std::string()> memory_;
+
+    FCITX_OBJECT_VTABLE_METHOD(stats, "Stats", "", "s");
+    FCITX_OBJECT_VTABLE_METHOD(resetStats, "ResetStats", "", "");
+    FCITX_OBJECT_VTABLE_METHOD(keyTrace, "KeyTrace", "", "s");
+    FCITX_OBJECT_VTABLE_METHOD(dumpKeyTrace, "DumpKeyTrace", "s", "b");
+    FCITX_OBJECT_VTABLE_METHOD(memory, "Memory", "", "s");
+};
+
+bool GoNhanhState::updatePreedit(const KeyOutput& output) {
+    std::string word;
+    size_t length = engine_.getBuffer(word);
+    bool shown = !preedit_.empty();
+
+    EditQueue commit;
+    bool absorbed =
+        preedit_.update(std::move(word), length, output.backspace, output.view(), commit);
+    if (shown || !preedit_.empty()) {
+        showPreedit();
+    }
+    commit.flush([this](int backspace, const std::string& text) { applyEdit(backspace, text); });
+    return absorbed;
+}
+
+void GoNhanhState::applyEdit(int backspace, const std::string& text) {
+    if (backspace > 0 && !text.empty() && atomicEdit_) {
+        // Both requests are held until the blocker goes out of scope
+        fcitx::InputContextEventBlocker blocker(ic_);
+        ic_->deleteSurroundingText(-backspace, backspace);
+        ic_->commitString(text);
+        return;
+    }
+    if (backspace > 0) {
+        ic_->deleteSurroundingText(-backspace, backspace);
+    }
+    if (!text.empty()) {
+        ic_->commitString(text);
+    }
+}
+
+void GoNhanhState::resumeIfPending() {
+    if (!resumePending_) {
+        return;
+    }
+    resumePending_ = false;
+    flushEdits();  // The surrounding text must include them
+
+    // Preedit mode composes off-screen: committed words are not resumed
+    auto caps = ic_->capabilityFlags();
+    if (mode() != CompositionMode::Surrounding ||
+        !caps.test(fcitx::CapabilityFlag::SurroundingText) ||
+        caps.test(fcitx::CapabilityFlag::Password)) {
+        return;
+    }
+    const auto& surrounding = ic_->surroundingText();
+    if (!surrounding.isValid() || surrounding.anchor() != surrounding.cursor()) {
+        return;  // No text, or a selection the next key replaces
+    }
+    size_t restored = engine_.resumeWord(surrounding.text(), surrounding.cursor());
+    if (restored > 0) {
+        history().breakOpenWord();
+    }
+    GONHANH_DEBUG() << "Resumed " << restored << " chars before cursor";
+}
+
+void GoNhanhState::commitHistory() {
+    if (!history_ || !keepsHistory()) {
+        return;
+    }
+    std::string word;
+    if (history_->composing()) {
+        engine_.getBuffer(word);
+    }
+    history_->commit(word);
+}
+
+bool GoNhanhState::backspaceErasesGap() {
+    if (!history_ || !keepsHistory()) {
+        return false;
+    }
+    if (history_->composing()) {
+        std::string word;
+        if (engine_.getBuffer(word) > 0) {
+            return false;
+        }
+        history_->dropOpenWord();  // Erased entirely: this backspace goes before it
+    }
+    return history_->erasesGap();
+}
+
+void GoNhanhState::eraseGap() {
+    const WordHistory::Word* word = history_->eraseGap();
+    if (!word) {
+        return;
+    }
+    engine_.clear();
+    engine_.processKeys(word->keys, word->keyCount);
+    GONHANH_DEBUG() << "Rejoined " << word->text() << " from history";
+}
+
+void GoNhanhState::commitPreedit() {
+    if (preedit_.empty()) {
+        return;
+    }
+    std::string text = preedit_.take();
+    showPreedit();
+    ic_->commitString(text);
+}
+
+void GoNhanhState::setPreedit(std::string text, size_t length) {
+    preedit_.set(std::move(text), length);
+    showPreedit();
+}
+
+void GoNhanhState::showPreedit() {
+    fcitx::Text preedit;
+    if (!preedit_.empty()) {
+        preedit.append(preedit_.text(), fcitx::TextFormatFlag::Underline);
+        preedit.setCursor(static_cast<int>(preedit_.text().size()));
+    }
+
+    if (ic_->capabilityFlags().test(fcitx::CapabilityFlag::Preedit)) {
+        ic_->inputPanel().setClientPreedit(preedit);
+    } else {
+        ic_->inputPanel().setPreedit(preedit);
+    }
+    ic_->updatePreedit();
+    ic_->updateUserInterface(fcitx::UserInterfaceComponent::InputPanel);
+}
+
+void GoNhanhState::showCandidates(const WordDict& dict, size_t k) {
+    std::string word;
+    std::string_view found[Settings::MAX_CANDIDATES];
+    size_t n = 0;
+    if (engine_.getBuffer(word) > 0) {
+        n = dict.lookup(word, std::min<size_t>(k, Settings::MAX_CANDIDATES), found);
+    }
+    if (n == 0) {
+        hideCandidates();
+        return;
+    }
+
+    candidates_.clear();
+    auto list = std::make_unique<fcitx::CommonCandidateList>();
+    list->setLayoutHint(fcitx::CandidateLayoutHint::Horizontal);
+    list->setPageSize(static_cast<int>(n));
+    for (size_t i = 0; i < n; ++i) {
+        candidates_.push_back(WordDict::matchCase(found[i], word));
+        list->append<GoNhanhCandidate>(this, i, candidates_.back());
+    }
+    list->setGlobalCursorIndex(0);
+    ic_->inputPanel().setCandidateList(std::move(list));
+    ic_->updateUserInterface(fcitx::UserInterfaceComponent::InputPanel);
+}
+
+void GoNhanhState::hideCandidates() {
+    if (candidates_.empty()) {
+        return;
+    }
+    candidates_.clear();
+    ic_->inputPanel().setCandidateList(nullptr);
+    ic_->updateUserInterface(fcitx::UserInterfaceComponent::InputPanel);
+}
+
+void GoNhanhState::acceptCandidate(size_t index) {
+    if (index >= candidates_.size()) {
+        return;
+    }
+    std::string text = std::move(candidates_[index]);
+    if (mode() == CompositionMode::Preedit) {
+        setPreedit({}, 0);
+        ic_->commitString(text);
+    } else {
+        // The word is on screen: edits still queued put it there first
+        std::string word;
+        size_t length = engine_.getBuffer(word);
+        flushEdits();
+        applyEdit(static_cast<int>(length), text);
+    }
+    engine_.clear();
+    if (history_) {
+        history_->reset();  // The word on screen is not the one its keys typed
+        history_->dropOpenWord();
+    }
+    hideCandidates();
+}
+
+bool GoNhanhState::evict() {
+    if (!edits_.empty() || hasCandidates() || !engine_.evict()) {
+        return false;
+    }
+    if (history_ && !history_->composing()) {
+        history_.reset();  // A word in progress keeps it: its keys are in there
+    }
+    return true;
+}
+
+size_t GoNhanhState::memoryBytes() const {
+    size_t bytes = sizeof(*this) - sizeof(engine_) + engine_.memoryBytes() +
+                   edits_.text().capacity() + preedit_.capacity();
+    if (history_) {
+        bytes += sizeof(WordHistory);
+    }
+    for (const auto& candidate : candidates_) {
+        bytes += sizeof(candidate) + candidate.capacity();
+    }
+    return bytes;
 }
 
 GoNhanhEngine::GoNhanhEngine(fcitx::Instance* instance)
     : fcitxInstance_(instance)
-    , factory_([](fcitx::InputContext& ic) {
-        return new GoNhanhState(&ic);
+    , startTime_(std::chrono::steady_clock::now())
+    , factory_([this](fcitx::InputContext& ic) {
+        auto* state = new GoNhanhState(&ic, settings_, profileFor(ic), enabled_);
+        state->engine().setShortcuts(shortcuts_);
+        state->setSerial(++contextSerial_);
+        return state;
     })
-    , currentMethod_(loadMethodFromConfig())
 {
-    // Initialize Rust core
-    RustBridge::initialize();
-    RustBridge::setMethod(currentMethod_);
-    GONHANH_INFO() << "GoNhanh engine initialized (method: "
-                   << (currentMethod_ == InputMethod::Telex ? "Telex" : "VNI") << ")";
+    // Engines are created per input context by factory_
+    GONHANH_INFO() << "GoNhanh engine initialized";
 
     // Register input context property factory
     instance->inputContextManager().registerProperty("goNhanhState", &factory_);
+    logStartup("registered");
+
+    // The core's dictionaries (auto-restore, spell check) are built on a
+    // worker while fcitx loads the other addons. Keys arriving earlier
+    // still work: the core waits for the build instead of repeating it.
+    // With gonhanh-engined they are its job (an engine falling back to
+    // in-process builds them on its first key).
+    dispatcher_.attach(&instance->eventLoop());
+    if (RustBridge::service()) {
+        GONHANH_INFO() << "Engines run in gonhanh-engined";
+    } else {
+        warmUp_ = std::thread([this] {
+            RustBridge::warmUp();
+            dispatcher_.schedule([this] {
+                coreWarm_ = true;
+                logStartup("dictionaries ready");
+            });
+        });
+    }
+
+    // Config is read on the first event loop iteration, not while fcitx
+    // is loading addons; later edits are picked up live by watchConfig()
+    deferredLoad_ = instance->eventLoop().addDeferEvent([this](fcitx::EventSource*) {
+        loadConfig();
+        watchConfig();
+        exportDBus();
+        logStartup("config loaded");
+        return true;
+    });
+
+    // One-shot per keyEvent burst; edits of all contexts go out together
+    flushEvent_ = instance->eventLoop().addDeferEvent([this](fcitx::EventSource*) {
+        fcitxInstance_->inputContextManager().foreach([this](fcitx::InputContext* ic) {
+            if (auto* state = getState(ic)) {
+                state->flushEdits();
+            }
+            return true;
+        });
+        return true;
+    });
+    flushEvent_->setEnabled(false);
 }
 
 GoNhanhEngine::~GoNhanhEngine() {
+    // Join before detaching: the worker's last act is dispatcher_.schedule()
+    if (warmUp_.joinable()) {
+        warmUp_.join();
+    }
+    dispatcher_.detach();
+    dbusObject_.reset();
+    evictTimer_.reset();
+    flushEvent_.reset();
+    configWatch_.reset();
+    if (inotifyFd_ >= 0) {
+        close(inotifyFd_);
+    }
     GONHANH_INFO() << "GoNhanh engine destroyed";
 }
 
+void GoNhanhEngine::logStartup(const char* stage) const {
+    auto elapsed = std::chrono::steady_clock::now() - startTime_;
+    GONHANH_INFO() << "Startup: " << stage << " after "
+                   << std::chrono::duration<double, std::milli>(elapsed).count() << " ms";
+}
+
+void GoNhanhEngine::openRecorder() {
+    if (!settings_.keyRecord) {
+        recorder_.close();
+        GONHANH_INFO() << "Key recording stopped";
+        return;
+    }
+    std::string path = recordingPath();
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+    if (path.empty() || !recorder_.open(path)) {
+        GONHANH_WARN() << "Cannot map key recording " << path;
+        return;
+    }
+    GONHANH_INFO() << "Recording keys to " << path;
+}
+
+void GoNhanhEngine::exportDBus() {
+    auto* dbusAddon = dbus();
+    if (!dbusAddon) {
+        return;
+    }
+    auto* bus = dbusAddon->call<fcitx::IDBusModule::bus>();
+    dbusObject_ = std::make_unique<GoNhanhDBus>(keyTrace_, [this] { return memoryReport(); });
+    if (!bus->addObjectVTable("/gonhanh", "org.fcitx.Fcitx5.GoNhanh", *dbusObject_)) {
+        GONHANH_WARN() << "Cannot export /gonhanh on D-Bus";
+        dbusObject_.reset();
+    }
+}
+
+void GoNhanhEngine::scheduleEviction() {
+    if (!settings_.evictIdle) {
+        evictTimer_.reset();
+        return;
+    }
+    // Swept at half the timeout: a context is evicted within 1.5x of it
+    uint64_t interval = settings_.evictIdle * 500000ULL;
+    if (evictTimer_) {
+        evictTimer_->setNextInterval(interval);
+        return;
+    }
+    evictTimer_ = fcitxInstance_->eventLoop().addTimeEvent(
+        CLOCK_MONOTONIC, fcitx::now(CLOCK_MONOTONIC) + interval, 0,
+        [this](fcitx::EventSourceTime* source, uint64_t) {
+            evictIdle();
+            source->setNextInterval(settings_.evictIdle * 500000ULL);
+            source->setOneShot();
+            return true;
+        });
+}
+
+void GoNhanhEngine::evictIdle() {
+    auto cutoff = std::chrono::steady_clock::now() - std::chrono::seconds(settings_.evictIdle);
+    size_t evicted = 0;
+    fcitxInstance_->inputContextManager().foreach([&](fcitx::InputContext* ic) {
+        auto* state = getState(ic);
+        if (state && !state->evicted() && state->lastKey() <= cutoff && state->evict()) {
+            ++evicted;
+        }
+        return true;
+    });
+    if (evicted) {
+        GONHANH_DEBUG() << "Evicted " << evicted << " idle engine(s)";
+    }
+}
+
+std::string GoNhanhEngine::memoryReport() {
+    std::ostringstream out;
+    size_t total = 0;
+    size_t contexts = 0;
+    fcitxInstance_->inputContextManager().foreach([&](fcitx::InputContext* ic) {
+        if (auto* state = getState(ic)) {
+            size_t bytes = state->memoryBytes();
+            total += bytes;
+            ++contexts;
+            out << '#' << state->serial() << ' '
+                << (ic->program().empty() ? "-" : ic->program()) << ": " << bytes << " B"
+                << (state->evicted() ? " (evicted)" : "")
+                << (state->engine().remote() ? " (gonhanh-engined)" : "") << '\n';
+        }
+        return true;
+    });
+    out << "total: " << total << " B in " << contexts << " context(s)\n";
+    return out.str();
+}
+
+void GoNhanhEngine::loadConfig() {
+    std::string dir = configDir();
+    preeditApps_ = loadPreeditAppsFromConfig(dir);
+    Settings settings = loadSettings(dir);
+
+    // Recompiled on every load: the shortcut file may change on its own
+    shortcuts_ = loadShortcuts(dir, settings);
+    fcitxInstance_->inputContextManager().foreach([this](fcitx::InputContext* ic) {
+        if (auto* state = getState(ic)) {
+            state->engine().setShortcuts(shortcuts_);
+        }
+        return true;
+    });
+    applySettings(settings);
+}
+
+void GoNhanhEngine::applySettings(const Settings& settings) {
+    if (settings == settings_) {
+        return;
+    }
+    settings_ = settings;
+    fcitxInstance_->inputContextManager().foreach([this](fcitx::InputContext* ic) {
+        if (auto* state = getState(ic)) {
+            state->applySettings(settings_, profileFor(*ic), enabled_);
+        }
+        return true;
+    });
+
+    config_.method.setValue(settings_.method);
+    config_.modern.setValue(settings_.modern);
+    config_.freeTone.setValue(settings_.freeTone);
+    config_.englishAutoRestore.setValue(settings_.englishAutoRestore);
+    config_.autoCapitalize.setValue(settings_.autoCapitalize);
+    config_.allowForeignConsonants.setValue(settings_.allowForeignConsonants);
+    config_.escRestore.setValue(settings_.escRestore);
+    config_.skipWShortcut.setValue(settings_.skipWShortcut);
+    config_.bracketShortcut.setValue(settings_.bracketShortcut);
+    config_.terminalApps.setValue(settings_.terminalApps);
+    config_.asyncCommit.setValue(settings_.asyncCommit);
+    config_.candidates.setValue(static_cast<int>(settings_.candidates));
+    config_.keepWarm.setValue(settings_.keepWarm);
+    config_.lockMemory.setValue(settings_.lockMemory);
+    config_.evictIdle.setValue(static_cast<int>(settings_.evictIdle));
+    config_.keyTrace.setValue(settings_.keyTrace);
+    config_.keyRecord.setValue(settings_.keyRecord);
+    config_.keyLogSample.setValue(static_cast<int>(settings_.keyLogSample));
+    if (!settings_.keyTrace) {
+        keyTrace_.clear();
+    }
+    if (settings_.keyRecord != recorder_.isOpen()) {
+        openRecorder();
+    }
+    if (settings_.lockMemory != (lockedBytes_ > 0)) {
+        size_t bytes = RustBridge::lockCoreMemory(settings_.lockMemory);
+        lockedBytes_ = settings_.lockMemory ? bytes : 0;
+        if (settings_.lockMemory && !bytes) {
+            GONHANH_WARN() << "Could not lock the core in memory (RLIMIT_MEMLOCK?)";
+        } else if (settings_.lockMemory) {
+            GONHANH_INFO() << "Core locked in memory: " << bytes / 1024 << " KiB";
+        }
+    }
+    scheduleEviction();
+    if (settings_.candidates > 0 && words_.empty()) {
+        std::string path = openWordDict(words_);
+        if (path.empty()) {
+            GONHANH_WARN() << "No word dictionary found - completions disabled";
+        } else {
+            GONHANH_INFO() << "Word dictionary: " << path << " (" << words_.size() << " words)";
+        }
+    }
+    GONHANH_INFO() << "Settings applied (method: "
+                   << (settings_.method == InputMethod::Telex ? "Telex" : "VNI")
+                   << ", shortcuts: " << shortcuts_.size() << ")";
+}
+
+void GoNhanhEngine::setConfig(const fcitx::RawConfig& raw) {
+    config_.load(raw, true);
+
+    Settings settings = settings_;  // Shortcuts are not part of config_
+    settings.method = *config_.method;
+    settings.modern = *config_.modern;
+    settings.freeTone = *config_.freeTone;
+    settings.englishAutoRestore = *config_.englishAutoRestore;
+    settings.autoCapitalize = *config_.autoCapitalize;
+    settings.allowForeignConsonants = *config_.allowForeignConsonants;
+    settings.escRestore = *config_.escRestore;
+    settings.skipWShortcut = *config_.skipWShortcut;
+    settings.bracketShortcut = *config_.bracketShortcut;
+    settings.terminalApps = *config_.terminalApps;
+    settings.asyncCommit = *config_.asyncCommit;
+    settings.candidates = static_cast<uint32_t>(*config_.candidates);
+    settings.keepWarm = *config_.keepWarm;
+    settings.lockMemory = *config_.lockMemory;
+    settings.evictIdle = static_cast<uint32_t>(*config_.evictIdle);
+    settings.keyTrace = *config_.keyTrace;
+    settings.keyRecord = *config_.keyRecord;
+    settings.keyLogSample = static_cast<uint32_t>(*config_.keyLogSample);
+
+    // Apply right away; the file write then reloads as a no-op
+    applySettings(settings);
+    if (!saveSettings(configDir(), settings_)) {
+        GONHANH_WARN() << "Cannot save settings to " << configDir();
+    }
+}
+
+void GoNhanhEngine::watchConfig() {
+    std::string dir = configDir();
+    if (dir.empty()) {
+        return;
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd_ < 0) {
+        GONHANH_WARN() << "inotify unavailable - config changes need a restart";
+        return;
+    }
+    // Watch the directory, not the files: `echo >` and editors replace files
+    if (inotify_add_watch(inotifyFd_, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE) < 0) {
+        GONHANH_WARN() << "Cannot watch " << dir << " - config changes need a restart";
+        close(inotifyFd_);
+        inotifyFd_ = -1;
+        return;
+    }
+
+    configWatch_ = fcitxInstance_->eventLoop().addIOEvent(
+        inotifyFd_, fcitx::IOEventFlag::In,
+        [this](fcitx::EventSourceIO*, int fd, fcitx::IOEventFlags) {
+            if (drainConfigEvents(fd)) {
+                loadConfig();
+            }
+            return true;
+        });
+}
+
 void GoNhanhEngine::activate(const fcitx::InputMethodEntry& entry,
                               fcitx::InputContextEvent& event) {
     GONHANH_DEBUG() << "Activate: " << entry.uniqueName();
 
-    // Clear buffer on activation
-    RustBridge::clear();
-    RustBridge::setEnabled(enabled_);
-    RustBridge::setMethod(currentMethod_);
+    // Sync settings only - composition state of this context is kept
+    // so focus can move away and back without losing the current word
+    // (without one, the word before the cursor is resumed on the next key)
+    auto* state = getState(event.inputContext());
+    if (state) {
+        state->engine().setEnabled(enabled_ && state->profile().enabled);
+        state->engine().setMethod(state->profile().method);
+        state->requestResume();
+    }
+
+    // Focus-in activates too: the key path is paged back in before the
+    // first key after an idle period needs it. Not before the startup
+    // warm-up is done, which the prefetch would wait for on this thread.
+    if (settings_.keepWarm && coreWarm_ && state && state->profile().enabled) {
+        RustBridge::prefetch();
+    }
 }
 
 void GoNhanhEngine::deactivate(const fcitx::InputMethodEntry& entry,
                                 fcitx::InputContextEvent& event) {
     GONHANH_DEBUG() << "Deactivate: " << entry.uniqueName();
 
-    // Clear buffer on deactivation
-    RustBridge::clear();
+    // Buffer is per input context - other windows are unaffected,
+    // and this one resumes where it left off on the next activate.
+    // A pending preedit cannot survive deactivation, so commit it.
+    auto* state = getState(event.inputContext());
+    if (state && state->mode() == CompositionMode::Preedit) {
+        state->endWord();
+    } else if (state) {
+        state->flushEdits();
+        state->hideCandidates();
+    }
 }
 
 void GoNhanhEngine::reset(const fcitx::InputMethodEntry& entry,
@@ -87,37 +695,75 @@ void GoNhanhEngine::keyEvent(const fcitx::InputMethodEntry& entry,
         return;
     }
 
+    auto* state = getState(ic);
+    if (!state || !state->profile().enabled) {
+        return;  // Profile-disabled apps (e.g. terminals, IDEs) skip the pipeline
+    }
+    auto& engine = state->engine();
+    state->touch(std::chrono::steady_clock::now());
+    KeyLatencyProbe probe;  // Compiles to nothing without GONHANH_LATENCY_STATS
+    uint64_t keyStart = recorder_.isOpen() ? steadyNs() : 0;
+
     // Handle modifier-only events
     auto key = keyEvent.key();
     if (key.isModifier()) {
         // Issue #150: Control key alone clears buffer (rhythm break like EVKey)
         uint32_t keysym = key.sym();
         if (keysym == XKB_KEY_Control_L || keysym == XKB_KEY_Control_R) {
-            RustBridge::clear();
+            state->endWord();
+            state->forgetHistory();
+            recordKey(ic, *state, keyStart, keysym, KeycodeMap::MacKey::UNKNOWN, TRACE_WORD_BREAK);
         }
         return;
     }
 
-    // Check for word break keys (space, punctuation, arrows)
+    // Tab takes the first word completion while the list is shown
     uint32_t keysym = key.sym();
-    if (KeycodeMap::isBreakKey(keysym)) {
-        RustBridge::clear();
+    auto states = key.states();
+    if (keysym == XKB_KEY_Tab && state->hasCandidates() &&
+        !states.test(fcitx::KeyState::Shift) && !states.test(fcitx::KeyState::Ctrl) &&
+        !states.test(fcitx::KeyState::Alt) && !states.test(fcitx::KeyState::Super)) {
+        state->acceptCandidate(0);
+        keyEvent.filterAndAccept();
+        recordKey(ic, *state, keyStart, keysym, KeycodeMap::MacKey::UNKNOWN, TRACE_WORD_BREAK);
+        return;
+    }
+
+    // Check for word break keys (space, punctuation, arrows)
+    auto keyInfo = KeycodeMap::lookup(keysym);  // Keycode + class in one lookup
+    if (keyInfo.isBreak()) {
+        traceKey(ic, keysym, KeycodeMap::MacKey::UNKNOWN, TRACE_WORD_BREAK);
+        state->endWord();
+        state->typedBreak(keysym);
+        // Arrow keys may land right after a word
+        if (keysym >= XKB_KEY_Left && keysym <= XKB_KEY_Down) {
+            state->requestResume();
+        }
+        recordKey(ic, *state, keyStart, keysym, KeycodeMap::MacKey::UNKNOWN, TRACE_WORD_BREAK);
         return;  // Let the key pass through
     }
 
     // Skip if Ctrl or Alt is held (shortcuts)
-    auto states = key.states();
     if (states.test(fcitx::KeyState::Ctrl) ||
         states.test(fcitx::KeyState::Alt) ||
         states.test(fcitx::KeyState::Super)) {
-        RustBridge::clear();
+        state->endWord();
+        state->forgetHistory();
+        recordKey(ic, *state, keyStart, keysym, KeycodeMap::MacKey::UNKNOWN, TRACE_WORD_BREAK);
         return;
     }
 
     // Convert keysym to macOS keycode
-    uint16_t macKeycode = KeycodeMap::keysymToMacKeycode(keysym);
-    if (macKeycode == KeycodeMap::MacKey::UNKNOWN) {
-        // Unknown key - pass through
+    uint16_t macKeycode = keyInfo.keycode();
+    if (keyInfo.isUnknown()) {
+        // Unknown key (Home, Delete, a non-ASCII letter) - pass through after
+        // the word: a preedit left open would be committed where it lands
+        if (state->mode() == CompositionMode::Preedit) {
+            state->endWord();
+        } else {
+            state->flushEdits();
+        }
+        state->forgetHistory();
         return;
     }
 
@@ -127,48 +773,117 @@ void GoNhanhEngine::keyEvent(const fcitx::InputMethodEntry& entry,
     bool shift = states.test(fcitx::KeyState::Shift);
 
     // For letters: Shift XORs CapsLock (Shift+A with CapsLock = lowercase)
-    if (KeycodeMap::isLetterKey(keysym)) {
+    if (keyInfo.isLetter()) {
         caps = caps != shift;  // XOR: true if exactly one is set
     }
 
-    GONHANH_DEBUG() << "Key: keysym=" << keysym
-                     << " macKey=" << macKeycode
-                     << " caps=" << caps
-                     << " shift=" << shift;
+    bool sampled = KEY_DEBUG_LOG_ENABLED && sampleKeyLog();
+    GONHANH_KEY_DEBUG(sampled) << "Key: keysym=" << keysym
+                               << " macKey=" << macKeycode
+                               << " caps=" << caps
+                               << " shift=" << shift;
+
+    state->resumeIfPending();
+    bool erasesGap = macKeycode == KeycodeMap::MacKey::DELETE && state->backspaceErasesGap();
+
+    // Process through Rust core (allocation-free: output lives on the stack);
+    // keys the previous result proved to pass through never leave C++
+    KeyOutput output;
+    bool changed = engine.processKey(macKeycode, caps, ctrl, shift, output);
+    if (erasesGap && !changed) {
+        state->eraseGap();
+    } else if (erasesGap) {
+        state->forgetHistory();  // The core had more to say than the history knows
+    } else {
+        state->historyKey(macKeycode, caps, shift);
+    }
+    probe.mark(LatencyStage::Ffi);
+
+    uint8_t flags = (caps ? TRACE_CAPS : 0) | (shift ? TRACE_SHIFT : 0) |
+                    (changed ? TRACE_CHANGED : 0) |
+                    (state->mode() == CompositionMode::Preedit ? TRACE_PREEDIT : 0);
+    traceKey(ic, keysym, macKeycode, flags, &output);
+
+    // Completions follow the buffer; never shown for password fields
+    if (settings_.candidates > 0 && !words_.empty() &&
+        !ic->capabilityFlags().test(fcitx::CapabilityFlag::Password)) {
+        state->showCandidates(words_, settings_.candidates);
+    } else {
+        state->hideCandidates();
+    }
 
-    // Process through Rust core
-    auto [backspace, text] = RustBridge::processKey(macKeycode, caps, ctrl, shift);
+    // Preedit mode: the composed word is rendered from the engine buffer
+    if (state->mode() == CompositionMode::Preedit) {
+        if (state->updatePreedit(output)) {
+            keyEvent.filterAndAccept();
+        }
+        probe.mark(LatencyStage::Commit);
+        recordKey(ic, *state, keyStart, keysym, macKeycode, flags, &output);
+        return;
+    }
 
-    // If no action needed, pass through
-    if (text.empty() && backspace == 0) {
+    if (!changed) {
+        // No action needed, pass through (after the edits it follows)
+        state->flushEdits();
+        recordKey(ic, *state, keyStart, keysym, macKeycode, flags);
         return;
     }
 
-    GONHANH_DEBUG() << "Result: backspace=" << backspace << " text=\"" << text << "\"";
+    // UTF-8 comes pre-encoded from the core; fcitx takes a std::string
+    std::string text(output.view());
+    probe.mark(LatencyStage::Utf8);
 
-    // Delete characters (backspace)
-    if (backspace > 0) {
-        ic->deleteSurroundingText(-backspace, backspace);
-    }
+    GONHANH_KEY_DEBUG(sampled) << "Result: backspace=" << output.backspace
+                               << " text=\"" << text << "\"";
 
-    // Commit new text
-    if (!text.empty()) {
-        ic->commitString(text);
+    // Delete characters (backspace) + commit new text, merged with edits
+    // still queued from earlier keys of this burst
+    state->queueEdit(output.backspace, text);
+    if (!settings_.asyncCommit || state->edits().shouldFlushNow()) {
+        state->flushEdits();
+    } else {
+        scheduleFlush();
     }
+    probe.mark(LatencyStage::Commit);
+    recordKey(ic, *state, keyStart, keysym, macKeycode, flags, &output);
 
     // Filter the key (don't let original key through)
     keyEvent.filterAndAccept();
 }
 
+void GoNhanhEngine::recordKey(fcitx::InputContext* ic, GoNhanhState& state, uint64_t startNs,
+                              uint32_t keysym, uint16_t macKey, uint8_t flags,
+                              const KeyOutput* output) {
+    if (!recorder_.isOpen() || ic->capabilityFlags().test(fcitx::CapabilityFlag::Password)) {
+        return;
+    }
+    recorder_.record(startNs, steadyNs() - startNs, keysym, macKey, flags,
+                     recorder_.programId(ic->program()), static_cast<uint8_t>(state.serial()),
+                     static_cast<uint8_t>(state.profile().method),
+                     output ? output->backspace : 0, output ? output->view() : std::string_view());
+}
+
 void GoNhanhEngine::setMethod(InputMethod method) {
-    currentMethod_ = method;
-    RustBridge::setMethod(method);
+    settings_.method = method;
+    config_.method.setValue(method);
+    fcitxInstance_->inputContextManager().foreach([this](fcitx::InputContext* ic) {
+        if (auto* state = getState(ic)) {
+            // Re-resolved: apps with a method of their own keep it
+            state->applySettings(settings_, profileFor(*ic), enabled_);
+        }
+        return true;
+    });
     GONHANH_INFO() << "Method set to: " << (method == InputMethod::Telex ? "Telex" : "VNI");
 }
 
 void GoNhanhEngine::setEnabled(bool enabled) {
     enabled_ = enabled;
-    RustBridge::setEnabled(enabled);
+    fcitxInstance_->inputContextManager().foreach([this, enabled](fcitx::InputContext* ic) {
+        if (auto* state = getState(ic)) {
+            state->engine().setEnabled(enabled && state->profile().enabled);
+        }
+        return true;
+    });
     GONHANH_INFO() << "Enabled: " << (enabled ? "true" : "false");
 }
 
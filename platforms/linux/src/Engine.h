@@ -6,31 +6,256 @@
 #include <fcitx/instance.h>
 #include <fcitx/addonfactory.h>
 #include <fcitx/addonmanager.h>
+#include <fcitx-config/configuration.h>
+#include <fcitx-config/option.h>
+#include <fcitx-utils/event.h>
+#include <fcitx-utils/eventdispatcher.h>
+#include <fcitx-utils/i18n.h>
 #include <fcitx-utils/log.h>
 
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "EditQueue.h"
+#include "EngineService.h"
+#include "KeyRecorder.h"
+#include "KeyTrace.h"
+#include "LatencyStats.h"
+#include "PreeditWord.h"
 #include "RustBridge.h"
+#include "Settings.h"
+#include "WordDict.h"
+#include "WordHistory.h"
 
-FCITX_DEFINE_LOG_CATEGORY(gonhanh, "gonhanh");
+FCITX_DECLARE_LOG_CATEGORY(gonhanh);
 #define GONHANH_DEBUG() FCITX_LOGC(gonhanh, Debug)
 #define GONHANH_INFO() FCITX_LOGC(gonhanh, Info)
 #define GONHANH_WARN() FCITX_LOGC(gonhanh, Warn)
 #define GONHANH_ERROR() FCITX_LOGC(gonhanh, Error)
 
+// Per-key logging: compiled in only with the GONHANH_KEY_DEBUG_LOG build
+// option, and then only for sampled keys (settings: key_log_sample).
+// Without the option the stream expression is dead code.
+#ifdef GONHANH_KEY_DEBUG_LOG
+constexpr bool KEY_DEBUG_LOG_ENABLED = true;
+#else
+constexpr bool KEY_DEBUG_LOG_ENABLED = false;
+#endif
+// The empty branch keeps a caller's unbraced else from binding to this if
+#define GONHANH_KEY_DEBUG(sampled) \
+    if (!(KEY_DEBUG_LOG_ENABLED && (sampled))) {} else GONHANH_DEBUG()
+
+FCITX_CONFIG_ENUM_NAME_WITH_I18N(InputMethod, N_("Telex"), N_("VNI"));
+
 namespace GoNhanh {
 
+// Typed view of Settings for fcitx5-configtool
+// Stored in ~/.config/gonhanh/settings (shared with gn and hot reloaded),
+// so shortcuts and the CLI keep working alongside the GUI
+FCITX_CONFIGURATION(
+    GoNhanhConfig,
+    fcitx::OptionWithAnnotation<InputMethod, InputMethodI18NAnnotation> method{
+        this, "Method", _("Input method"), InputMethod::Telex};
+    fcitx::Option<bool> modern{this, "Modern", _("Modern tone placement (hoà, thuý)"), true};
+    fcitx::Option<bool> freeTone{this, "FreeTone", _("Free tone placement (no spelling check)"), false};
+    fcitx::Option<bool> englishAutoRestore{
+        this, "EnglishAutoRestore", _("Restore English words (tẽt -> text)"), false};
+    fcitx::Option<bool> autoCapitalize{
+        this, "AutoCapitalize", _("Capitalize after sentence end"), false};
+    fcitx::Option<bool> allowForeignConsonants{
+        this, "AllowForeignConsonants", _("Allow z, w, j, f as initial consonants"), false};
+    fcitx::Option<bool> escRestore{this, "EscRestore", _("ESC restores typed keys"), false};
+    fcitx::Option<bool> skipWShortcut{this, "SkipWShortcut", _("Keep w as w (no w -> ư)"), false};
+    fcitx::Option<bool> bracketShortcut{
+        this, "BracketShortcut", _("Brackets type ư and ơ ([ -> ơ, ] -> ư)"), false};
+    fcitx::Option<std::vector<std::string>> terminalApps{
+        this, "TerminalApps", _("Programs without English auto-restore"),
+        Settings::defaultTerminalApps()};
+    fcitx::Option<bool> asyncCommit{
+        this, "AsyncCommit", _("Apply edits after the key (merged per window)"), true};
+    fcitx::Option<int, fcitx::IntConstrain> candidates{
+        this, "Candidates", _("Word completions shown (0 = off, Tab accepts)"), 0,
+        {0, static_cast<int>(Settings::MAX_CANDIDATES)}};
+    fcitx::Option<bool> keepWarm{
+        this, "KeepWarm", _("Keep the engine warm (faster first key after idle)"), false};
+    fcitx::Option<bool> lockMemory{
+        this, "LockMemory", _("Lock the engine in memory (mlock)"), false};
+    fcitx::Option<int, fcitx::IntConstrain> evictIdle{
+        this, "EvictIdle", _("Free idle windows' engines after seconds (0 = never)"), 300,
+        {0, static_cast<int>(Settings::MAX_EVICT_IDLE)}};
+    fcitx::Option<bool> keyTrace{this, "KeyTrace", _("Keep a trace of recent keys (debug)"), false};
+    fcitx::Option<bool> keyRecord{
+        this, "KeyRecord", _("Record keys and results to a file for replay (debug)"), false};
+    fcitx::Option<int, fcitx::IntConstrain> keyLogSample{
+        this, "KeyLogSample", _("Log 1 of every N keys (debug builds)"), 1, {0, 1000000}};);
+
 // Input context state
+// Each input context owns its own engine, so switching focus between
+// windows never wipes another window's composition buffer
 class GoNhanhState : public fcitx::InputContextProperty {
 public:
-    GoNhanhState(fcitx::InputContext* ic) : ic_(ic) {}
+    GoNhanhState(fcitx::InputContext* ic, const Settings& settings,
+                 const ResolvedProfile& profile, bool enabled)
+        : ic_(ic), profile_(profile), atomicEdit_(supportsAtomicEdit(ic->frontendName())) {
+        applySettings(settings, profile, enabled);
+    }
+
+    // `profile`: this context's program, resolved by the caller. The
+    // composition mode is kept from creation (a live preedit cannot switch).
+    void applySettings(const Settings& settings, ResolvedProfile profile, bool enabled) {
+        profile.mode = profile_.mode;
+        profile_ = profile;
+        settings.applyTo(engine_, profile_);
+        engine_.setEnabled(enabled && profile_.enabled);
+        forgetHistory();  // Replayed keys would compose differently
+    }
 
     void reset() {
-        RustBridge::clear();
+        endWord();
+        requestResume();
+    }
+
+    // Frontends that send the text-input requests raised while events are
+    // blocked in one commit: the input-method-v2 frontend (wlroots, KDE)
+    // turns them into one text-input-v3 `done` for the client
+    static bool supportsAtomicEdit(const std::string& frontend) {
+        return frontend == "wayland_v2";
+    }
+
+    RustEngine& engine() { return engine_; }
+    const ResolvedProfile& profile() const { return profile_; }
+    // Creation order among contexts (KeyRecord::context)
+    uint32_t serial() const { return serial_; }
+    void setSerial(uint32_t serial) { serial_ = serial; }
+    CompositionMode mode() const { return profile_.mode; }
+
+    // Word boundary: apply queued edits, commit pending preedit (if any)
+    // and clear the buffer
+    void endWord() {
+        flushEdits();
+        commitPreedit();
+        commitHistory();
+        engine_.clear();
+        hideCandidates();
+    }
+
+    // Word history (surrounding mode, never for password fields): what the
+    // key that ended the word typed after it. Printable break keys insert
+    // one character; anything else may have moved the cursor.
+    void typedBreak(uint32_t keysym) {
+        if (!history_) {
+            return;
+        }
+        if (keysym >= 0x20 && keysym <= 0x7e) {
+            history_->typeGap();
+        } else {
+            history_->reset();
+        }
+    }
+    // Text changed in a way the history cannot follow
+    void forgetHistory() {
+        if (history_) {
+            history_->reset();
+        }
+    }
+    // A key the engine processed
+    void historyKey(uint16_t macKey, bool caps, bool shift) {
+        if (keepsHistory()) {
+            history().type(macKey, caps, shift);
+        }
+    }
+    // Backspace, before the engine sees it: true if it erases a character
+    // typed after the previous word rather than part of the current one
+    bool backspaceErasesGap();
+    // After the engine passed that backspace through: back at the end of
+    // the previous word, its keys are replayed so it can be edited again
+    void eraseGap();
+
+    // Surrounding mode: queue a delete + commit, merged with pending edits
+    void queueEdit(int backspace, std::string_view text) { edits_.push(backspace, text); }
+    const EditQueue& edits() const { return edits_; }
+
+    // Apply queued edits to the client. Must run before any key reaches the
+    // client unfiltered, so edits and typed keys stay in order.
+    void flushEdits() {
+        edits_.flush([this](int backspace, const std::string& text) { applyEdit(backspace, text); });
+    }
+
+    // Delete `backspace` codepoints before the cursor, then insert `text`
+    // Atomic frontends get both in one client update (see atomicEdit_)
+    void applyEdit(int backspace, const std::string& text);
+
+    // Cursor moved or focus returned: on the next key, seed the engine from
+    // the word before the cursor (the client has sent the new surrounding
+    // text by then, which is not guaranteed at reset/focus-in time)
+    void requestResume() {
+        resumePending_ = true;
+        forgetHistory();
     }
+    void resumeIfPending();
+
+    // Preedit mode: re-render the composed word after a key was processed,
+    // committing it if the key ended it (see PreeditWord::update)
+    // Returns: true if the key was absorbed, false if it must reach the client
+    bool updatePreedit(const KeyOutput& output);
+
+    // Preedit mode: commit the composed word to the client
+    void commitPreedit();
+
+    // Word completion: show up to `k` dictionary words extending the word
+    // being composed (the list is hidden when there are none)
+    void showCandidates(const WordDict& dict, size_t k);
+    void hideCandidates();
+    bool hasCandidates() const { return !candidates_.empty(); }
+    // Replace the word being composed with candidate `index` and end the word
+    void acceptCandidate(size_t index);
+
+    // Idle eviction: a key arrived (keyEvent)
+    void touch(std::chrono::steady_clock::time_point now) { lastKey_ = now; }
+    std::chrono::steady_clock::time_point lastKey() const { return lastKey_; }
+    // Free the core engine (rebuilt by the next key) and the word history
+    // between words. Not while edits are queued or completions are shown.
+    // Returns: true if the engine was evicted
+    bool evict();
+    bool evicted() const { return engine_.evicted(); }
+    // Bytes held by this context: the state, its engine and buffers
+    size_t memoryBytes() const;
 
 private:
+    void setPreedit(std::string text, size_t length);
+    void showPreedit();  // Render preedit_ in the client (or the input panel)
+    bool keepsHistory() const {
+        return mode() == CompositionMode::Surrounding &&
+               !ic_->capabilityFlags().test(fcitx::CapabilityFlag::Password);
+    }
+    void commitHistory();
+    // Allocated by the first key it records (evict() frees it)
+    WordHistory& history() {
+        if (!history_) {
+            history_ = std::make_unique<WordHistory>();
+        }
+        return *history_;
+    }
+
     fcitx::InputContext* ic_;
+    RustEngine engine_;
+    ResolvedProfile profile_;    // Cached: program() is looked up once per context
+    EditQueue edits_;            // Surrounding mode edits not yet sent
+    std::unique_ptr<WordHistory> history_;  // Keys of the last committed words
+    bool atomicEdit_;            // Frontend sends delete + commit as one client update
+    PreeditWord preedit_;        // Word currently shown as preedit
+    bool resumePending_ = false;
+    uint32_t serial_ = 0;
+    std::chrono::steady_clock::time_point lastKey_ = std::chrono::steady_clock::now();
+    std::vector<std::string> candidates_;  // Shown in the input panel, case-matched
 };
 
+class GoNhanhDBus;
+
 // Main Fcitx5 engine class
 // Note: Fcitx5 manages addon lifecycle - no singleton pattern needed
 class GoNhanhEngine : public fcitx::InputMethodEngineV2 {
@@ -48,15 +273,90 @@ public:
     void reset(const fcitx::InputMethodEntry& entry,
                fcitx::InputContextEvent& event) override;
 
+    // AddonInstance config interface (fcitx5-configtool)
+    const fcitx::Configuration* getConfig() const override { return &config_; }
+    void setConfig(const fcitx::RawConfig& raw) override;
+    void reloadConfig() override { loadConfig(); }
+
     // Configuration
     void setMethod(InputMethod method);
     void setEnabled(bool enabled);
 
 private:
+    // Read config files (deferred to the event loop, re-run on change)
+    void loadConfig();
+    // Push settings to every input context engine
+    void applySettings(const Settings& settings);
+    // Profile of the program behind `ic` (settings_ + preedit-apps)
+    ResolvedProfile profileFor(const fcitx::InputContext& ic) const {
+        return settings_.profileFor(ic.program(), preeditApps_.count(ic.program()) > 0);
+    }
+    // Watch the config directory with inotify on the fcitx event loop
+    void watchConfig();
+    // Key path debugging: sampled log decision and trace recording
+    bool sampleKeyLog() {
+        return settings_.keyLogSample && ++keyLogCounter_ % settings_.keyLogSample == 0;
+    }
+    void traceKey(fcitx::InputContext* ic, uint32_t keysym, uint16_t macKey, uint8_t flags,
+                  const KeyOutput* output = nullptr) {
+        if (!settings_.keyTrace ||
+            ic->capabilityFlags().test(fcitx::CapabilityFlag::Password)) {
+            return;
+        }
+        keyTrace_.record(keysym, macKey, flags, output ? output->backspace : 0,
+                         output ? output->length : 0);
+    }
+
+    // Session recording (settings_.keyRecord): open or close the ring file,
+    // and append one key that reached the engine (password fields never are)
+    void openRecorder();
+    void recordKey(fcitx::InputContext* ic, GoNhanhState& state, uint64_t startNs,
+                   uint32_t keysym, uint16_t macKey, uint8_t flags,
+                   const KeyOutput* output = nullptr);
+
+    // Flush every context's EditQueue on the next event loop iteration
+    void scheduleFlush() { flushEvent_->setOneShot(); }
+
+    // Export the /gonhanh D-Bus object (stats) if the dbus addon is loaded
+    void exportDBus();
+
+    // Idle eviction (settings_.evictIdle): arm or drop the sweep timer, and
+    // evict the engines of contexts without a key for that long
+    void scheduleEviction();
+    void evictIdle();
+    // Per-context memory, one line each plus a total (`gn memory`)
+    std::string memoryReport();
+
+    // Cold-start log line: milliseconds since the constructor started
+    void logStartup(const char* stage) const;
+
+    FCITX_ADDON_DEPENDENCY_LOADER(dbus, fcitxInstance_->addonManager());
+
     fcitx::Instance* fcitxInstance_;
+    std::chrono::steady_clock::time_point startTime_;  // First member initialized (logStartup)
     fcitx::FactoryFor<GoNhanhState> factory_;
-    InputMethod currentMethod_ = InputMethod::Telex;
+    Settings settings_;
+    GoNhanhConfig config_;  // Mirrors settings_
+    ShortcutTable shortcuts_;  // Shared by every context's engine
     bool enabled_ = true;
+    std::unordered_set<std::string> preeditApps_;  // Programs using CompositionMode::Preedit
+    WordDict words_;  // Mapped on first use (settings_.candidates > 0)
+
+    std::unique_ptr<fcitx::EventSource> deferredLoad_;
+    std::unique_ptr<fcitx::EventSource> flushEvent_;  // Disabled until scheduleFlush()
+    std::unique_ptr<fcitx::EventSourceIO> configWatch_;
+    std::unique_ptr<fcitx::EventSourceTime> evictTimer_;  // Null while evictIdle == 0
+    int inotifyFd_ = -1;
+    std::unique_ptr<GoNhanhDBus> dbusObject_;
+    KeyTrace keyTrace_;
+    KeyRecorder recorder_;
+    uint32_t contextSerial_ = 0;
+    size_t lockedBytes_ = 0;  // Core memory locked for settings_.lockMemory
+    uint32_t keyLogCounter_ = 0;
+
+    fcitx::EventDispatcher dispatcher_;  // Worker -> main thread
+    std::thread warmUp_;                 // Builds the core dictionaries off the main thread
+    bool coreWarm_ = false;              // warmUp_ is done (set on the main thread)
 
     // Get state for input context
     GoNhanhState* getState(fcitx::InputContext* ic) {
@@ -68,6 +368,9 @@ private:
 class GoNhanhEngineFactory : public fcitx::AddonFactory {
 public:
     fcitx::AddonInstance* create(fcitx::AddonManager* manager) override {
+        // Before the engine exists: its shortcut table and every context's
+        // engine then live in gonhanh-engined, if it runs
+        RustBridge::connectService(servicePath());
         return new GoNhanhEngine(manager->instance());
     }
 };
@@ -0,0 +1,63 @@
+// gonhanh-engined: run the engines of every GoNhanh frontend in one process
+//
+//   gonhanh-engined [path]
+//
+// Builds the core's dictionaries once and serves engines over shared-memory
+// rings at `path` (default $XDG_RUNTIME_DIR/gonhanh-engine, see
+// EngineService.h; created 0600). Frontends started while it runs (the
+// fcitx5 addon connects when it loads) create their engines here; without
+// it, or once it exits, they run them in-process. SIGTERM or SIGINT stops it.
+//
+// Exit status: 0 after a signal, 1 if the path is served by another daemon
+// or cannot be created, 2 on bad usage or without a path.
+
+#include "EngineService.h"
+
+#include <signal.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+using namespace GoNhanh;
+
+namespace {
+
+EngineService* g_service = nullptr;
+
+void onSignal(int) {
+    g_service->stop();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string path = servicePath();
+    if (argc > 2 || (argc == 2 && argv[1][0] == '-')) {
+        std::fprintf(stderr, "usage: %s [path]\n", argv[0]);
+        return 2;
+    }
+    if (argc == 2) {
+        path = argv[1];
+    }
+    if (path.empty()) {
+        std::fprintf(stderr, "XDG_RUNTIME_DIR is not set; give the path to serve\n");
+        return 2;
+    }
+
+    EngineService service;
+    if (!service.open(path)) {
+        std::fprintf(stderr, "cannot serve %s (another gonhanh-engined, or not writable)\n",
+                     path.c_str());
+        return 1;
+    }
+    g_service = &service;
+    struct sigaction action {};
+    action.sa_handler = onSignal;
+    sigaction(SIGTERM, &action, nullptr);
+    sigaction(SIGINT, &action, nullptr);
+
+    std::fprintf(stderr, "serving engines at %s\n", path.c_str());
+    service.serve();
+    return 0;
+}
@@ -0,0 +1,735 @@
+#include "EngineService.h"
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <thread>
+
+namespace GoNhanh {
+
+using Clock = std::chrono::steady_clock;
+
+// Busy-wait before sleeping: a reply or the next key of a burst usually
+// arrives well within it, without a futex round trip. Not on a single CPU,
+// where the other side cannot run while we spin.
+static const Clock::duration SPIN = std::thread::hardware_concurrency() > 1
+                                        ? Clock::duration(std::chrono::microseconds(50))
+                                        : Clock::duration::zero();
+
+std::string servicePath() {
+    if (const char* runtime = std::getenv("XDG_RUNTIME_DIR"); runtime && *runtime) {
+        return std::string(runtime) + "/gonhanh-engine";
+    }
+    return {};
+}
+
+static size_t fileSize() {
+    return sizeof(ServiceHeader) + size_t{EngineService::SLOTS} * sizeof(ServiceSlot);
+}
+
+// Only a file of ours that nobody else can open carries keys: whoever can
+// write it reads every key sent and chooses the text committed
+static bool trustedFile(int fd) {
+    struct stat st;
+    return fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_uid == geteuid() &&
+           (st.st_mode & 077) == 0 && static_cast<size_t>(st.st_size) == fileSize();
+}
+
+static bool validHeader(const ServiceHeader& header, size_t size) {
+    return std::memcmp(header.magic, "GNES", 4) == 0 &&
+           header.version == EngineService::FORMAT_VERSION &&
+           header.slotCount == EngineService::SLOTS && header.slotSize == sizeof(ServiceSlot) &&
+           size == fileSize();
+}
+
+static bool processAlive(int32_t pid) {
+    return pid > 0 && (kill(pid, 0) == 0 || errno != ESRCH);
+}
+
+// Pid of the live daemon serving `path`, 0 if none
+static int32_t servingPid(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    void* data = MAP_FAILED;
+    if (trustedFile(fd)) {
+        data = mmap(nullptr, fileSize(), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (data == MAP_FAILED) return 0;
+    const auto* header = static_cast<const ServiceHeader*>(data);
+    int32_t pid = validHeader(*header, fileSize())
+                      ? header->daemonPid.load(std::memory_order_acquire) : 0;
+    munmap(data, fileSize());
+    return processAlive(pid) ? pid : 0;
+}
+
+// Shared (not FUTEX_PRIVATE): the other side is another process
+static void futexWait(std::atomic<uint32_t>& word, uint32_t expected, std::chrono::nanoseconds timeout) {
+    timespec ts{static_cast<time_t>(timeout.count() / 1000000000),
+                static_cast<long>(timeout.count() % 1000000000)};
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+
+static void futexWake(std::atomic<uint32_t>& word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// =============================================================================
+// ServiceRing
+// =============================================================================
+
+static void copyIn(uint8_t* data, uint32_t at, const void* src, size_t n) {
+    if (n == 0) return;
+    size_t offset = at & (ServiceRing::BYTES - 1);
+    size_t first = std::min(n, ServiceRing::BYTES - offset);
+    std::memcpy(data + offset, src, first);
+    std::memcpy(data, static_cast<const uint8_t*>(src) + first, n - first);
+}
+
+static void copyOut(const uint8_t* data, uint32_t at, void* dst, size_t n) {
+    if (n == 0) return;
+    size_t offset = at & (ServiceRing::BYTES - 1);
+    size_t first = std::min(n, ServiceRing::BYTES - offset);
+    std::memcpy(dst, data + offset, first);
+    std::memcpy(static_cast<uint8_t*>(dst) + first, data, n - first);
+}
+
+bool ServiceRing::push(uint16_t op, uint32_t id, const void* payload, size_t size,
+                       const void* more, size_t moreSize) {
+    size_t total = size + moreSize;
+    if (total > MAX_PAYLOAD) {
+        return false;
+    }
+    uint32_t at = head.load(std::memory_order_relaxed);
+    uint32_t used = at - tail.load(std::memory_order_acquire);
+    if (BYTES - used < sizeof(ServiceMessage) + total) {
+        return false;
+    }
+    ServiceMessage message{op, static_cast<uint16_t>(total), id};
+    copyIn(data, at, &message, sizeof(message));
+    copyIn(data, at + sizeof(message), payload, size);
+    copyIn(data, at + sizeof(message) + size, more, moreSize);
+    head.store(at + static_cast<uint32_t>(sizeof(message) + total), std::memory_order_release);
+    return true;
+}
+
+bool ServiceRing::pop(ServiceMessage& message, uint8_t* payload) {
+    uint32_t at = tail.load(std::memory_order_relaxed);
+    uint32_t end = head.load(std::memory_order_acquire);
+    uint32_t available = end - at;
+    if (available == 0) {
+        return false;
+    }
+    if (available >= sizeof(message) && available <= BYTES) {
+        copyOut(data, at, &message, sizeof(message));
+        if (message.size <= MAX_PAYLOAD && sizeof(message) + message.size <= available) {
+            copyOut(data, at + sizeof(message), payload, message.size);
+            tail.store(at + static_cast<uint32_t>(sizeof(message) + message.size),
+                       std::memory_order_release);
+            return true;
+        }
+    }
+    tail.store(end, std::memory_order_release);
+    return false;
+}
+
+void ServiceRing::notify() {
+    // Pairs with the reader's store to `waiting` before it rereads head
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting.load(std::memory_order_relaxed)) {
+        futexWake(head);
+    }
+}
+
+void ServiceRing::reset() {
+    head.store(0, std::memory_order_relaxed);
+    tail.store(0, std::memory_order_relaxed);
+    waiting.store(0, std::memory_order_relaxed);
+}
+
+// =============================================================================
+// EngineClient
+// =============================================================================
+
+std::shared_ptr<EngineClient> EngineClient::connect(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0) return nullptr;
+    if (!trustedFile(fd)) {
+        ::close(fd);
+        return nullptr;
+    }
+    void* data = mmap(nullptr, fileSize(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) return nullptr;
+
+    std::shared_ptr<EngineClient> client(new EngineClient);
+    client->map_ = data;
+    client->mapSize_ = fileSize();
+    client->header_ = static_cast<ServiceHeader*>(data);
+    client->daemonPid_ = client->header_->daemonPid.load(std::memory_order_acquire);
+    if (!validHeader(*client->header_, client->mapSize_) || !processAlive(client->daemonPid_)) {
+        return nullptr;
+    }
+
+    auto* slots = reinterpret_cast<ServiceSlot*>(static_cast<char*>(data) + sizeof(ServiceHeader));
+    for (size_t i = 0; i < EngineService::SLOTS && !client->slot_; ++i) {
+        int32_t free = 0;
+        if (slots[i].owner.compare_exchange_strong(free, getpid())) {
+            client->slot_ = &slots[i];
+        }
+    }
+    std::lock_guard<std::mutex> lock(client->mutex_);
+    if (!client->slot_ || !client->post(ServiceOp::Hello, 0)) {
+        return nullptr;
+    }
+    return client;
+}
+
+EngineClient::~EngineClient() {
+    close();
+    if (map_) {
+        munmap(map_, mapSize_);
+    }
+}
+
+void EngineClient::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (slot_ && alive()) {
+        post(ServiceOp::Bye, 0);
+    }
+    dead_ = true;
+}
+
+bool EngineClient::daemonGone() const {
+    return header_->daemonPid.load(std::memory_order_relaxed) != daemonPid_ ||
+           !processAlive(daemonPid_);
+}
+
+bool EngineClient::fail() {
+    dead_ = true;
+    return false;
+}
+
+bool EngineClient::post(ServiceOp op, uint32_t id, const void* payload, size_t size,
+                        const void* more, size_t moreSize) {
+    if (!alive()) {
+        return false;
+    }
+    if (size + moreSize > ServiceRing::MAX_PAYLOAD) {
+        return false;  // Never fits; the connection itself is fine
+    }
+    if (header_->daemonPid.load(std::memory_order_relaxed) != daemonPid_) {
+        return fail();
+    }
+    ServiceRing& ring = slot_->requests;
+    auto deadline = Clock::now() + std::chrono::milliseconds(REPLY_TIMEOUT_MS);
+    while (!ring.push(static_cast<uint16_t>(op), id, payload, size, more, moreSize)) {
+        if (daemonGone() || Clock::now() > deadline) {
+            return fail();
+        }
+        std::this_thread::yield();  // Full: the daemon is behind on this client
+    }
+    header_->doorbell.fetch_add(1);
+    if (header_->sleeping.load()) {
+        futexWake(header_->doorbell);
+    }
+    return true;
+}
+
+bool EngineClient::call(ServiceOp op, uint32_t id, const void* payload, size_t size,
+                        ServiceMessage& reply, const void* more, size_t moreSize) {
+    if (!post(op, id, payload, size, more, moreSize)) {
+        return false;
+    }
+    ServiceRing& ring = slot_->replies;
+    auto start = Clock::now();
+    auto deadline = start + std::chrono::milliseconds(REPLY_TIMEOUT_MS);
+    bool answered = false;
+    while (!(answered = ring.pop(reply, reply_))) {
+        auto now = Clock::now();
+        if (now - start < SPIN) {
+            cpuRelax();
+            continue;
+        }
+        if (now > deadline || daemonGone()) {
+            break;
+        }
+        ring.waiting.store(1);
+        uint32_t seen = ring.head.load();
+        if (seen == ring.tail.load(std::memory_order_relaxed)) {
+            futexWait(ring.head, seen, std::chrono::milliseconds(1));
+        }
+    }
+    ring.waiting.store(0, std::memory_order_relaxed);
+    // Any other reply means the rings are out of step: give up on them
+    return answered && reply.op == static_cast<uint16_t>(op) ? true : fail();
+}
+
+uint32_t EngineClient::newEngine() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t id = ++nextId_;
+    return post(ServiceOp::NewEngine, id) ? id : 0;
+}
+
+void EngineClient::freeEngine(uint32_t engine) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    post(ServiceOp::FreeEngine, engine);
+}
+
+uint32_t EngineClient::newTable() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t id = ++nextId_;
+    return post(ServiceOp::NewTable, id) ? id : 0;
+}
+
+void EngineClient::freeTable(uint32_t table) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    post(ServiceOp::FreeTable, table);
+}
+
+bool EngineClient::configure(uint32_t engine, const ServiceConfig& config) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return post(ServiceOp::Config, engine, &config, sizeof(config));
+}
+
+bool EngineClient::key(uint32_t engine, const ImeKeyEvent& key, KeyOutput& out, uint8_t& state) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ServiceMessage reply;
+    if (!call(ServiceOp::Key, engine, &key, sizeof(key), reply)) {
+        return false;
+    }
+    if (reply.size < sizeof(ServiceKeyReply)) {
+        return fail();
+    }
+    ServiceKeyReply result;
+    std::memcpy(&result, reply_, sizeof(result));
+    state = result.state;
+    if (result.action != static_cast<uint8_t>(ImeAction::Send)) {
+        out.backspace = 0;
+        out.length = 0;
+        return true;
+    }
+    out.backspace = result.backspace;
+    out.length = std::min<size_t>(reply.size - sizeof(result), IME_MAX_UTF8);
+    std::memcpy(out.text, reply_ + sizeof(result), out.length);
+    return true;
+}
+
+bool EngineClient::keys(uint32_t engine, const ImeKeyEvent* events, size_t n, char* out,
+                        size_t cap, ImeBatchResult* result) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t want = static_cast<uint32_t>(
+        std::min(cap, ServiceRing::MAX_PAYLOAD - sizeof(ImeBatchResult)));
+    size_t count = std::min(n, MAX_BATCH);
+    ServiceMessage reply;
+    if (!call(ServiceOp::Keys, engine, &want, sizeof(want), reply, events,
+              count * sizeof(ImeKeyEvent))) {
+        return false;
+    }
+    if (reply.size < sizeof(ImeBatchResult)) {
+        return fail();
+    }
+    std::memcpy(result, reply_, sizeof(ImeBatchResult));
+    result->len = std::min<uint32_t>(result->len, want);
+    std::memcpy(out, reply_ + sizeof(ImeBatchResult), result->len);
+    return true;
+}
+
+bool EngineClient::clear(uint32_t engine, bool all) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return post(all ? ServiceOp::ClearAll : ServiceOp::Clear, engine);
+}
+
+bool EngineClient::resume(uint32_t engine, std::string_view word, size_t& restored) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ServiceMessage reply;
+    if (!call(ServiceOp::Resume, engine, word.data(), word.size(), reply)) {
+        return false;
+    }
+    restored = reply.id;
+    return true;
+}
+
+bool EngineClient::buffer(uint32_t engine, std::string& out, size_t& count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ServiceMessage reply;
+    if (!call(ServiceOp::Buffer, engine, nullptr, 0, reply)) {
+        return false;
+    }
+    out.assign(reinterpret_cast<const char*>(reply_), reply.size);
+    count = reply.id;
+    return true;
+}
+
+// Payload: trigger '\0' replacement (c_str() supplies the separator)
+bool EngineClient::addShortcut(uint32_t engine, const std::string& trigger,
+                               const std::string& replacement) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return post(ServiceOp::AddShortcut, engine, trigger.c_str(), trigger.size() + 1,
+                replacement.data(), replacement.size());
+}
+
+bool EngineClient::clearShortcuts(uint32_t engine) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return post(ServiceOp::ClearShortcuts, engine);
+}
+
+bool EngineClient::setShortcuts(uint32_t engine, uint32_t table) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return post(ServiceOp::SetShortcuts, engine, &table, sizeof(table));
+}
+
+bool EngineClient::tableAdd(uint32_t table, const std::string& trigger,
+                            const std::string& replacement) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return post(ServiceOp::TableAdd, table, trigger.c_str(), trigger.size() + 1,
+                replacement.data(), replacement.size());
+}
+
+bool EngineClient::tableLoad(uint32_t table, std::string_view text) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t at = 0; at < text.size(); at += ServiceRing::MAX_PAYLOAD) {
+        size_t part = std::min(text.size() - at, ServiceRing::MAX_PAYLOAD);
+        if (!post(ServiceOp::TableLoad, table, text.data() + at, part)) {
+            return false;
+        }
+    }
+    return post(ServiceOp::TableLoaded, table);
+}
+
+// =============================================================================
+// EngineService
+// =============================================================================
+
+bool EngineService::open(const std::string& path) {
+    close();
+    if (servingPid(path) != 0) {
+        return false;
+    }
+    unlink(path.c_str());
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0) return false;
+    size_t size = fileSize();
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        ::close(fd);
+        unlink(path.c_str());
+        return false;
+    }
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        unlink(path.c_str());
+        return false;
+    }
+
+    path_ = path;
+    map_ = data;
+    mapSize_ = size;
+    header_ = static_cast<ServiceHeader*>(data);
+    slots_ = reinterpret_cast<ServiceSlot*>(static_cast<char*>(data) + sizeof(ServiceHeader));
+    std::memcpy(header_->magic, "GNES", 4);  // The rest is zero-filled by ftruncate
+    header_->version = FORMAT_VERSION;
+    header_->slotCount = SLOTS;
+    header_->slotSize = sizeof(ServiceSlot);
+    clients_.assign(SLOTS, Client{});
+    stop_ = false;
+
+    // Clients only see the daemon once its first key will not build them
+    RustBridge::warmUp();
+    header_->daemonPid.store(getpid(), std::memory_order_release);
+    return true;
+}
+
+void EngineService::close() {
+    if (!header_) {
+        return;
+    }
+    header_->daemonPid.store(0, std::memory_order_release);
+    for (size_t i = 0; i < SLOTS; ++i) {
+        release(i);
+    }
+    munmap(map_, mapSize_);
+    unlink(path_.c_str());
+    map_ = nullptr;
+    header_ = nullptr;
+    slots_ = nullptr;
+    clients_.clear();
+}
+
+void EngineService::serve() {
+    auto lastReap = Clock::now();
+    auto lastWork = lastReap;
+    while (!stop_.load()) {
+        uint32_t bell = header_->doorbell.load();
+        bool worked = false;
+        for (size_t i = 0; i < SLOTS; ++i) {
+            if (slots_[i].owner.load(std::memory_order_acquire) != 0) {
+                worked |= drain(i);
+            }
+        }
+
+        auto now = Clock::now();
+        if (now - lastReap >= std::chrono::seconds(1)) {
+            reap();
+            lastReap = now;
+        }
+        if (worked) {
+            lastWork = now;
+        } else if (now - lastWork < SPIN) {
+            cpuRelax();
+        } else {
+            header_->sleeping.store(1);
+            if (header_->doorbell.load() == bell && !stop_.load()) {
+                futexWait(header_->doorbell, bell, std::chrono::seconds(1));
+            }
+            header_->sleeping.store(0);
+        }
+    }
+}
+
+void EngineService::stop() {
+    stop_ = true;
+    if (header_) {
+        header_->doorbell.fetch_add(1);
+        futexWake(header_->doorbell);
+    }
+}
+
+size_t EngineService::clients() const {
+    size_t count = 0;
+    for (size_t i = 0; header_ && i < SLOTS; ++i) {
+        count += slots_[i].owner.load(std::memory_order_relaxed) != 0;
+    }
+    return count;
+}
+
+bool EngineService::drain(size_t slot) {
+    ServiceSlot& s = slots_[slot];
+    bool worked = false;
+    ServiceMessage message;
+    while (s.owner.load(std::memory_order_relaxed) != 0 && s.requests.pop(message, payload_)) {
+        handle(slot, message);
+        worked = true;
+    }
+    return worked;
+}
+
+// Payload "a\0b" as two C strings (b is terminated here, a by the sender)
+static bool splitPair(uint8_t* payload, size_t size, const char*& a, std::string& b) {
+    const void* nul = std::memchr(payload, '\0', size);
+    if (!nul) return false;
+    size_t first = static_cast<const uint8_t*>(nul) - payload;
+    a = reinterpret_cast<const char*>(payload);
+    b.assign(reinterpret_cast<const char*>(payload) + first + 1, size - first - 1);
+    return true;
+}
+
+void EngineService::handle(size_t slot, const ServiceMessage& message) {
+    Client& client = clients_[slot];
+    ServiceRing& replies = slots_[slot].replies;
+    auto found = client.engines.find(message.id);
+    ImeEngine* engine = found != client.engines.end() ? found->second : nullptr;
+    std::string replacement;
+    const char* trigger = nullptr;
+
+    switch (static_cast<ServiceOp>(message.op)) {
+    case ServiceOp::Hello:
+        break;
+    case ServiceOp::Bye:
+        release(slot);
+        return;
+    case ServiceOp::NewEngine:
+        if (!engine) {
+            client.engines.emplace(message.id, ime_engine_new());
+        }
+        return;
+    case ServiceOp::FreeEngine:
+        if (engine) {
+            ime_engine_free(engine);
+            client.engines.erase(found);
+        }
+        return;
+    case ServiceOp::Config:
+        if (engine && message.size == sizeof(ServiceConfig)) {
+            ServiceConfig config;
+            std::memcpy(&config, payload_, sizeof(config));
+            auto on = [&](uint16_t flag) { return (config.flags & flag) != 0; };
+            ime_engine_method(engine, config.method);
+            ime_engine_enabled(engine, on(ServiceConfig::ENABLED));
+            ime_engine_modern(engine, on(ServiceConfig::MODERN));
+            ime_engine_free_tone(engine, on(ServiceConfig::FREE_TONE));
+            ime_engine_english_auto_restore(engine, on(ServiceConfig::ENGLISH_AUTO_RESTORE));
+            ime_engine_auto_capitalize(engine, on(ServiceConfig::AUTO_CAPITALIZE));
+            ime_engine_allow_foreign_consonants(engine, on(ServiceConfig::FOREIGN_CONSONANTS));
+            ime_engine_esc_restore(engine, on(ServiceConfig::ESC_RESTORE));
+            ime_engine_skip_w_shortcut(engine, on(ServiceConfig::SKIP_W_SHORTCUT));
+            ime_engine_bracket_shortcut(engine, on(ServiceConfig::BRACKET_SHORTCUT));
+        }
+        return;
+    case ServiceOp::Key: {
+        // Always answered: the client is waiting
+        ServiceKeyReply result{};
+        size_t len = 0;
+        ImeKeyEvent key;
+        if (engine && message.size == sizeof(key)) {
+            std::memcpy(&key, payload_, sizeof(key));
+            if (RustBridge::compactResults()) {
+                ImeCompactResult r;
+                if (ime_engine_key_compact(engine, &r, text_, IME_MAX_UTF8, key.key, key.caps,
+                                           key.ctrl, key.shift)) {
+                    result = {r.action, r.backspace, r.state, 0};
+                    len = r.len;
+                    if (!(r.flags & IME_FLAG_SPILLED)) {
+                        std::memcpy(text_, r.bytes, len);
+                    }
+                }
+            } else {
+                ImeUtf8Result r;
+                if (ime_engine_key_utf8(engine, &r, key.key, key.caps, key.ctrl, key.shift)) {
+                    result = {r.action, r.backspace, 0, 0};
+                    len = std::min<size_t>(r.len, IME_MAX_UTF8);
+                    std::memcpy(text_, r.bytes, len);
+                }
+            }
+        }
+        replies.push(message.op, 0, &result, sizeof(result), text_, len);
+        break;
+    }
+    case ServiceOp::Keys: {
+        ImeBatchResult result{};
+        uint32_t cap = 0;
+        if (message.size >= sizeof(cap)) {
+            std::memcpy(&cap, payload_, sizeof(cap));
+        }
+        cap = std::min<uint32_t>(cap, ServiceRing::MAX_PAYLOAD - sizeof(result));
+        size_t count = message.size >= sizeof(cap)
+                           ? (message.size - sizeof(cap)) / sizeof(ImeKeyEvent) : 0;
+        // payload_ is aligned and the events follow a uint32_t
+        auto* events = reinterpret_cast<const ImeKeyEvent*>(payload_ + sizeof(cap));
+        if (!engine || !ime_engine_keys_batch(engine, events, count, text_, cap, &result)) {
+            result = {};
+        }
+        replies.push(message.op, 0, &result, sizeof(result), text_, result.len);
+        break;
+    }
+    case ServiceOp::Clear:
+    case ServiceOp::ClearAll:
+        if (engine && static_cast<ServiceOp>(message.op) == ServiceOp::Clear) {
+            ime_engine_clear(engine);
+        } else if (engine) {
+            ime_engine_clear_all(engine);
+        }
+        return;
+    case ServiceOp::Resume: {
+        uint32_t restored = engine ? ime_engine_resume_word(
+            engine, reinterpret_cast<const char*>(payload_), message.size) : 0;
+        replies.push(message.op, restored, nullptr, 0);
+        break;
+    }
+    case ServiceOp::Buffer: {
+        uint32_t chars[IME_MAX_CHARS];
+        int64_t count = engine ? ime_engine_get_buffer(engine, chars, IME_MAX_CHARS) : 0;
+        size_t len = 0;
+        for (int64_t i = 0; i < count; ++i) {
+            len += RustBridge::encodeUtf8(chars[i], text_ + len);
+        }
+        replies.push(message.op, count > 0 ? static_cast<uint32_t>(count) : 0, text_, len);
+        break;
+    }
+    case ServiceOp::AddShortcut:
+        if (engine && splitPair(payload_, message.size, trigger, replacement)) {
+            ime_engine_add_shortcut(engine, trigger, replacement.c_str());
+        }
+        return;
+    case ServiceOp::ClearShortcuts:
+        if (engine) {
+            ime_engine_clear_shortcuts(engine);
+        }
+        return;
+    case ServiceOp::SetShortcuts:
+        if (engine && message.size == sizeof(uint32_t)) {
+            uint32_t id;
+            std::memcpy(&id, payload_, sizeof(id));
+            auto table = client.tables.find(id);
+            if (table != client.tables.end()) {
+                ime_engine_set_shortcuts(engine, table->second.handle);
+            }
+        }
+        return;
+    case ServiceOp::NewTable:
+        if (!client.tables.count(message.id)) {
+            client.tables[message.id].handle = ime_shortcuts_new();
+        }
+        return;
+    case ServiceOp::FreeTable:
+    case ServiceOp::TableAdd:
+    case ServiceOp::TableLoad:
+    case ServiceOp::TableLoaded: {
+        auto table = client.tables.find(message.id);
+        if (table == client.tables.end()) {
+            return;
+        }
+        Table& t = table->second;
+        auto op = static_cast<ServiceOp>(message.op);
+        if (op == ServiceOp::FreeTable) {
+            ime_shortcuts_free(t.handle);
+            client.tables.erase(table);
+        } else if (op == ServiceOp::TableAdd &&
+                   splitPair(payload_, message.size, trigger, replacement)) {
+            ime_shortcuts_add(t.handle, trigger, replacement.c_str());
+        } else if (op == ServiceOp::TableLoad) {
+            t.pending.append(reinterpret_cast<const char*>(payload_), message.size);
+        } else if (op == ServiceOp::TableLoaded) {
+            ime_shortcuts_load(t.handle, t.pending.data(), t.pending.size());
+            std::string().swap(t.pending);
+        }
+        return;
+    }
+    }
+    replies.notify();
+}
+
+void EngineService::release(size_t slot) {
+    Client& client = clients_[slot];
+    for (auto& [id, engine] : client.engines) {
+        ime_engine_free(engine);
+    }
+    for (auto& [id, table] : client.tables) {
+        ime_shortcuts_free(table.handle);
+    }
+    client = Client{};
+    slots_[slot].requests.reset();
+    slots_[slot].replies.reset();
+    slots_[slot].owner.store(0, std::memory_order_release);
+}
+
+void EngineService::reap() {
+    for (size_t i = 0; i < SLOTS; ++i) {
+        int32_t owner = slots_[i].owner.load(std::memory_order_acquire);
+        if (owner != 0 && !processAlive(owner)) {
+            release(i);
+        }
+    }
+}
+
+} // namespace GoNhanh
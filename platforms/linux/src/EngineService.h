@@ -0,0 +1,263 @@
+#ifndef GONHANH_ENGINE_SERVICE_H
+#define GONHANH_ENGINE_SERVICE_H
+
+// Out-of-process engines (gonhanh-engined)
+// One daemon per user builds the core's dictionaries once and runs the
+// engines of every client process (the fcitx5 addon, other frontends), so
+// those processes never build them. The daemon maps a file on tmpfs; each
+// client claims a slot in it holding two single-producer single-consumer
+// rings, requests (client -> daemon) and replies (daemon -> client). A key
+// is a ring write, a futex wake only if the other side sleeps, and a ring
+// read: no socket and no syscall per key while both sides are busy.
+//
+// File layout (host layout, both sides built from this tree):
+//   ServiceHeader
+//   ServiceSlot slots[SLOTS]
+//
+// Messages are a ServiceMessage followed by `size` payload bytes. Settings,
+// clears and shortcut edits are posted without a reply; keys, batches,
+// buffer reads and resumes wait for theirs. A client whose daemon stops
+// answering (exited, killed, hung past REPLY_TIMEOUT) is dead for good, and
+// RustEngine carries on in-process (see RustEngine::detach).
+
+#include "RustBridge.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace GoNhanh {
+
+enum class ServiceOp : uint16_t {
+    Hello = 1,        // Slot claimed (daemon drops whatever it still held for it)
+    Bye,              // Client closing: free its engines and the slot
+    NewEngine,        // id: engine chosen by the client
+    FreeEngine,
+    Config,           // ServiceConfig
+    Key,              // ImeKeyEvent -> ServiceKeyReply + UTF-8
+    Keys,             // uint32_t cap + ImeKeyEvent[] -> ImeBatchResult + UTF-8
+    Clear,
+    ClearAll,
+    Resume,           // UTF-8 word -> id: characters restored
+    Buffer,           // -> id: characters, payload: UTF-8
+    AddShortcut,      // trigger '\0' replacement
+    ClearShortcuts,
+    NewTable,         // id: table chosen by the client
+    FreeTable,
+    TableAdd,         // trigger '\0' replacement
+    TableLoad,        // Next part of `trigger=replacement` lines
+    TableLoaded,      // All parts sent: compile them
+    SetShortcuts,     // uint32_t table
+};
+
+struct ServiceMessage {
+    uint16_t op;      // ServiceOp (replies repeat the request's)
+    uint16_t size;    // Payload bytes that follow
+    uint32_t id;      // Engine or table of a request; the result of a reply
+};
+
+static_assert(sizeof(ServiceMessage) == 8, "ServiceMessage is part of the service format");
+
+// Engine settings (RustEngine's Config), sent whole on every change
+struct ServiceConfig {
+    enum Flag : uint16_t {
+        ENABLED = 1 << 0,
+        MODERN = 1 << 1,
+        FREE_TONE = 1 << 2,
+        ENGLISH_AUTO_RESTORE = 1 << 3,
+        AUTO_CAPITALIZE = 1 << 4,
+        FOREIGN_CONSONANTS = 1 << 5,
+        ESC_RESTORE = 1 << 6,
+        SKIP_W_SHORTCUT = 1 << 7,
+        BRACKET_SHORTCUT = 1 << 8,
+    };
+    uint8_t method;   // InputMethod
+    uint8_t _pad;
+    uint16_t flags;
+};
+
+struct ServiceKeyReply {
+    uint8_t action;     // ImeAction
+    uint8_t backspace;
+    uint8_t state;      // IME_STATE_* after the key
+    uint8_t _pad;       // UTF-8 text follows
+};
+
+// Byte ring in shared memory. Positions only grow (wrapping at 2^32);
+// the producer owns head, the consumer tail, so neither ever waits on a
+// lock. A reader sleeps on `head` after setting `waiting`.
+struct ServiceRing {
+    static constexpr uint32_t BYTES = 64 * 1024;  // Power of two
+    static constexpr size_t MAX_PAYLOAD = 8192 - sizeof(ServiceMessage);
+
+    alignas(64) std::atomic<uint32_t> head;
+    std::atomic<uint32_t> waiting;
+    alignas(64) std::atomic<uint32_t> tail;
+    alignas(64) uint8_t data[BYTES];
+
+    // Producer: append a message of `size` bytes of `payload` then `more`.
+    // Returns: false if it does not fit yet (or ever: size > MAX_PAYLOAD)
+    bool push(uint16_t op, uint32_t id, const void* payload, size_t size,
+              const void* more = nullptr, size_t moreSize = 0);
+
+    // Consumer: take the oldest message, payload into `payload`
+    // (MAX_PAYLOAD bytes). A malformed message empties the ring.
+    // Returns: false if there is none
+    bool pop(ServiceMessage& message, uint8_t* payload);
+
+    // Wake a reader asleep on head (after push)
+    void notify();
+
+    // Both sides idle (daemon, on a free slot)
+    void reset();
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "rings are shared between processes");
+
+struct ServiceHeader {
+    char magic[4];                    // "GNES"
+    uint16_t version;                 // EngineService::FORMAT_VERSION
+    uint16_t slotCount;
+    uint32_t slotSize;                // sizeof(ServiceSlot)
+    std::atomic<int32_t> daemonPid;   // Set once tables are built, 0 after exit
+    std::atomic<uint32_t> doorbell;   // Bumped after every request
+    std::atomic<uint32_t> sleeping;   // Daemon waits on doorbell
+};
+
+struct ServiceSlot {
+    alignas(64) std::atomic<int32_t> owner;  // Client pid, 0 = free
+    ServiceRing requests;
+    ServiceRing replies;
+};
+
+// Service file: $XDG_RUNTIME_DIR/gonhanh-engine (a per-user 0700 directory),
+// empty without one: a shared directory would let other users serve it.
+// Clients only use a file owned by this user with no group/other access.
+std::string servicePath();
+
+// Client side: one per process, shared by its RustEngines and
+// ShortcutTables. Thread-safe; calls are serialized (one in flight).
+class EngineClient {
+public:
+    static constexpr int REPLY_TIMEOUT_MS = 250;
+    // Events per Keys request; longer batches take several
+    static constexpr size_t MAX_BATCH = 64;
+
+    // Claim a slot of the daemon at `path`
+    // Returns: null if no daemon runs there or every slot is taken
+    static std::shared_ptr<EngineClient> connect(const std::string& path);
+    ~EngineClient();
+
+    EngineClient(const EngineClient&) = delete;
+    EngineClient& operator=(const EngineClient&) = delete;
+
+    // False once the daemon failed to answer or close() was called; every
+    // call then fails
+    bool alive() const { return !dead_.load(std::memory_order_relaxed); }
+    // Give the slot back (the daemon frees this client's engines)
+    void close();
+
+    // Engines and shared shortcut tables in the daemon (0 = dead)
+    uint32_t newEngine();
+    void freeEngine(uint32_t engine);
+    uint32_t newTable();
+    void freeTable(uint32_t table);
+
+    // Each returns false if the daemon is gone (nothing was done)
+    bool configure(uint32_t engine, const ServiceConfig& config);
+    bool key(uint32_t engine, const ImeKeyEvent& key, KeyOutput& out, uint8_t& state);
+    bool keys(uint32_t engine, const ImeKeyEvent* events, size_t n, char* out, size_t cap,
+              ImeBatchResult* result);
+    bool clear(uint32_t engine, bool all);
+    bool resume(uint32_t engine, std::string_view word, size_t& restored);
+    bool buffer(uint32_t engine, std::string& out, size_t& count);
+    bool addShortcut(uint32_t engine, const std::string& trigger, const std::string& replacement);
+    bool clearShortcuts(uint32_t engine);
+    bool setShortcuts(uint32_t engine, uint32_t table);
+    bool tableAdd(uint32_t table, const std::string& trigger, const std::string& replacement);
+    bool tableLoad(uint32_t table, std::string_view text);
+
+private:
+    EngineClient() = default;
+
+    // Caller holds mutex_
+    bool post(ServiceOp op, uint32_t id, const void* payload = nullptr, size_t size = 0,
+              const void* more = nullptr, size_t moreSize = 0);
+    bool call(ServiceOp op, uint32_t id, const void* payload, size_t size, ServiceMessage& reply,
+              const void* more = nullptr, size_t moreSize = 0);
+    bool daemonGone() const;
+    bool fail();
+
+    void* map_ = nullptr;
+    size_t mapSize_ = 0;
+    ServiceHeader* header_ = nullptr;
+    ServiceSlot* slot_ = nullptr;
+    int32_t daemonPid_ = 0;
+    std::atomic<bool> dead_{false};
+    uint32_t nextId_ = 0;  // Engines and tables share the numbering
+    std::mutex mutex_;
+    alignas(8) uint8_t reply_[ServiceRing::MAX_PAYLOAD];  // Payload of the last reply
+};
+
+// Daemon side. Not synchronized: serve() runs the engines on one thread.
+class EngineService {
+public:
+    static constexpr uint16_t FORMAT_VERSION = 1;
+    static constexpr uint16_t SLOTS = 32;
+
+    EngineService() = default;
+    ~EngineService() { close(); }
+    EngineService(const EngineService&) = delete;
+    EngineService& operator=(const EngineService&) = delete;
+
+    // Create the service file at `path`, replacing a stale one. Clients can
+    // connect once the dictionaries are built (done here, before return).
+    // Returns: false if another daemon serves `path` or it cannot be mapped
+    bool open(const std::string& path);
+    // Tell clients the daemon is gone, free every engine, remove the file
+    void close();
+
+    // Answer requests until stop(); slots of exited clients are reclaimed
+    void serve();
+    // Safe from any thread and from signal handlers
+    void stop();
+
+    // Clients holding a slot (tests, logging)
+    size_t clients() const;
+
+private:
+    struct Table {
+        ImeShortcutTable* handle = nullptr;
+        std::string pending;  // TableLoad parts not compiled yet
+    };
+    struct Client {
+        std::unordered_map<uint32_t, ImeEngine*> engines;
+        std::unordered_map<uint32_t, Table> tables;
+    };
+
+    // Returns: true if a request was handled
+    bool drain(size_t slot);
+    void handle(size_t slot, const ServiceMessage& message);
+    void release(size_t slot);  // Free the slot's engines, then the slot
+    void reap();                // release() the slots of exited clients
+
+    std::string path_;
+    void* map_ = nullptr;
+    size_t mapSize_ = 0;
+    ServiceHeader* header_ = nullptr;
+    ServiceSlot* slots_ = nullptr;
+    std::vector<Client> clients_;
+    std::atomic<bool> stop_{false};
+    alignas(8) uint8_t payload_[ServiceRing::MAX_PAYLOAD];
+    char text_[ServiceRing::MAX_PAYLOAD];  // UTF-8 of the reply being built
+};
+
+} // namespace GoNhanh
+
+#endif // GONHANH_ENGINE_SERVICE_H
@@ -0,0 +1,162 @@
+// gonhanh-playback: re-feed a key recording (`key_record`) through the engine
+//
+//   gonhanh-playback [--settings DIR] [--realtime] [--show N] [recording]
+//
+// Each input context of the session gets its own RustEngine, configured
+// like the addon did: settings and shortcuts from DIR (default
+// ~/.config/gonhanh) with the recorded program's profile, and the method the
+// context used. Records are replayed in order; word breaks clear the buffer
+// and every other key must produce the recorded edit. --realtime keeps the
+// session's gaps between keys (capped at 1 s). Prints the first N (default
+// 10) mismatches, then the session's keyEvent latency next to the replay's
+// core-only latency.
+//
+// A word resumed from the surrounding text (cursor moved into it) cannot be
+// replayed: its next key shows up as a mismatch.
+//
+// Exit status: 0 if every key matched, 1 on a mismatch or unreadable
+// recording, 2 on bad usage.
+
+#include "KeyRecorder.h"
+#include "RustBridge.h"
+#include "Settings.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace GoNhanh;
+
+namespace {
+
+struct Options {
+    std::string settingsDir = configDir();
+    std::string path = recordingPath();
+    bool realtime = false;
+    size_t show = 10;
+};
+
+bool parseArgs(int argc, char** argv, Options& opts) {
+    bool pathSeen = false;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (std::strcmp(arg, "--realtime") == 0) {
+            opts.realtime = true;
+        } else if (std::strcmp(arg, "--settings") == 0 && i + 1 < argc) {
+            opts.settingsDir = argv[++i];
+        } else if (std::strcmp(arg, "--show") == 0 && i + 1 < argc) {
+            opts.show = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg[0] != '-' && !pathSeen) {
+            opts.path = arg;
+            pathSeen = true;
+        } else {
+            return false;
+        }
+    }
+    return !opts.path.empty();
+}
+
+// "p50 12.3 us  p99 45.6 us  max 78.9 us" of `ns` (sorted in place)
+std::string summarize(std::vector<uint64_t>& ns) {
+    if (ns.empty()) {
+        return "no keys";
+    }
+    std::sort(ns.begin(), ns.end());
+    auto at = [&](double q) { return ns[static_cast<size_t>(q * (ns.size() - 1))] / 1e3; };
+    char line[96];
+    std::snprintf(line, sizeof(line), "p50 %7.1f us  p99 %7.1f us  max %7.1f us",
+                  at(0.5), at(0.99), ns.back() / 1e3);
+    return line;
+}
+
+std::string quoted(const char* text, size_t len) {
+    return "\"" + std::string(text, len) + "\"";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opts;
+    if (!parseArgs(argc, argv, opts)) {
+        std::fprintf(stderr, "usage: %s [--settings DIR] [--realtime] [--show N] [recording]\n",
+                     argv[0]);
+        return 2;
+    }
+
+    KeyRecording recording;
+    if (!recording.open(opts.path)) {
+        std::fprintf(stderr, "cannot read %s (missing or not a key recording)\n", opts.path.c_str());
+        return 1;
+    }
+    Settings settings = loadSettings(opts.settingsDir);
+    ShortcutTable shortcuts = loadShortcuts(opts.settingsDir, settings);
+    RustBridge::warmUp();  // Keep dictionary builds out of the timings
+
+    std::map<uint8_t, std::unique_ptr<RustEngine>> engines;  // By KeyRecord::context
+    std::vector<uint64_t> session;
+    std::vector<uint64_t> replay;
+    session.reserve(recording.size());
+    replay.reserve(recording.size());
+    size_t mismatches = 0;
+    KeyOutput output;
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < recording.size(); ++i) {
+        const KeyRecord& r = recording[i];
+        if (opts.realtime && i > 0) {
+            uint64_t gap = std::min<uint64_t>(r.timeNs - recording[i - 1].timeNs, 1000000000);
+            std::this_thread::sleep_for(std::chrono::nanoseconds(gap));
+        }
+
+        auto& engine = engines[r.context];
+        if (!engine) {
+            engine = std::make_unique<RustEngine>();
+            settings.applyTo(*engine, settings.profileFor(recording.program(r.program)));
+            engine->setMethod(static_cast<InputMethod>(r.method));
+            engine->setShortcuts(shortcuts);
+        }
+        session.push_back(r.latencyNs);
+        if (r.flags & TRACE_WORD_BREAK) {
+            engine->clear();
+            continue;
+        }
+
+        auto keyStart = std::chrono::steady_clock::now();
+        bool changed = engine->processKey(r.macKey, r.flags & TRACE_CAPS, false,
+                                          r.flags & TRACE_SHIFT, output);
+        replay.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now() - keyStart).count());
+
+        // Preedit contexts record the output of unchanged keys too: only
+        // edits the core reported are compared
+        bool expected = r.flags & TRACE_CHANGED;
+        size_t compared = std::min<size_t>(output.length, r.textBytes);
+        bool same = changed == expected &&
+                    (!changed || (output.backspace == r.backspace &&
+                                  (r.flags & RECORD_TRUNCATED ? output.length >= r.textBytes
+                                                              : output.length == r.textBytes) &&
+                                  std::memcmp(output.text, r.text, compared) == 0));
+        if (!same && mismatches++ < opts.show) {
+            std::printf("key %zu (%s, context %u, keysym 0x%04x): recorded bs=%u %s, replay %s\n",
+                        i, recording.program(r.program).c_str(), r.context, r.keysym, r.backspace,
+                        expected ? quoted(r.text, r.textBytes).c_str() : "(unchanged)",
+                        changed ? ("bs=" + std::to_string(output.backspace) + " " +
+                                   quoted(output.text, output.length)).c_str()
+                                : "(unchanged)");
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%s: %zu keys, %zu contexts, %zu mismatches, replayed in %.3f s\n",
+                opts.path.c_str(), recording.size(), engines.size(), mismatches, seconds);
+    std::printf("  session keyEvent: %s\n", summarize(session).c_str());
+    std::printf("  replay core:      %s\n", summarize(replay).c_str());
+    return mismatches == 0 ? 0 : 1;
+}
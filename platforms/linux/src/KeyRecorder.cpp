@@ -0,0 +1,178 @@
+#include "KeyRecorder.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace GoNhanh {
+
+std::string recordingPath() {
+    if (const char* state = std::getenv("XDG_STATE_HOME"); state && *state) {
+        return std::string(state) + "/gonhanh/keys.rec";
+    }
+    const char* home = std::getenv("HOME");
+    if (!home) return {};
+    return std::string(home) + "/.local/state/gonhanh/keys.rec";
+}
+
+static size_t fileSize(uint32_t capacity) {
+    return sizeof(KeyRecordHeader) + size_t{capacity} * sizeof(KeyRecord);
+}
+
+static bool validHeader(const KeyRecordHeader& header, size_t size) {
+    return std::memcmp(header.magic, "GNKR", 4) == 0 &&
+           header.version == KeyRecorder::FORMAT_VERSION &&
+           header.recordSize == sizeof(KeyRecord) && header.capacity > 0 &&
+           header.programCount <= KeyRecordHeader::MAX_PROGRAMS &&
+           size == fileSize(header.capacity);
+}
+
+// =============================================================================
+// KeyRecorder
+// =============================================================================
+
+bool KeyRecorder::open(const std::string& path, uint32_t capacity) {
+    close();
+    if (capacity == 0) return false;
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) return false;
+
+    size_t size = fileSize(capacity);
+    struct stat st;
+    bool resize = fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) != size;
+    if (resize && (ftruncate(fd, 0) != 0 || ftruncate(fd, static_cast<off_t>(size)) != 0)) {
+        ::close(fd);
+        return false;
+    }
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) return false;
+
+    map_ = data;
+    mapSize_ = size;
+    header_ = static_cast<KeyRecordHeader*>(data);
+    records_ = reinterpret_cast<KeyRecord*>(static_cast<char*>(data) + sizeof(KeyRecordHeader));
+
+    if (!validHeader(*header_, size) || header_->capacity != capacity) {
+        std::memset(header_, 0, sizeof(KeyRecordHeader));
+        std::memcpy(header_->magic, "GNKR", 4);
+        header_->version = FORMAT_VERSION;
+        header_->recordSize = sizeof(KeyRecord);
+        header_->capacity = capacity;
+    }
+    for (uint32_t i = 0; i < header_->programCount; ++i) {
+        const char* name = header_->programs[i];
+        programIds_.emplace(std::string(name, strnlen(name, KeyRecordHeader::PROGRAM_BYTES)),
+                            static_cast<uint8_t>(i + 1));
+    }
+    return true;
+}
+
+void KeyRecorder::close() {
+    if (map_) {
+        munmap(map_, mapSize_);
+    }
+    map_ = nullptr;
+    mapSize_ = 0;
+    header_ = nullptr;
+    records_ = nullptr;
+    programIds_.clear();
+}
+
+uint8_t KeyRecorder::programId(const std::string& program) {
+    auto it = programIds_.find(program);
+    if (it != programIds_.end()) {
+        return it->second;
+    }
+    // Names are stored truncated: look up the stored form too
+    std::string stored = program.substr(0, KeyRecordHeader::PROGRAM_BYTES);
+    it = programIds_.find(stored);
+    if (it == programIds_.end()) {
+        if (program.empty() || header_->programCount == KeyRecordHeader::MAX_PROGRAMS) {
+            return 0;
+        }
+        uint32_t index = header_->programCount++;
+        std::memcpy(header_->programs[index], stored.data(), stored.size());
+        it = programIds_.emplace(stored, static_cast<uint8_t>(index + 1)).first;
+    }
+    return programIds_[program] = it->second;
+}
+
+void KeyRecorder::record(uint64_t timeNs, uint64_t latencyNs, uint32_t keysym, uint16_t macKey,
+                         uint8_t flags, uint8_t program, uint8_t context, uint8_t method,
+                         int backspace, std::string_view text) {
+    uint64_t n = header_->next;
+    KeyRecord& r = records_[n % header_->capacity];
+    size_t length = std::min(text.size(), sizeof(r.text));
+    r.timeNs = timeNs;
+    r.keysym = keysym;
+    r.latencyNs = static_cast<uint32_t>(std::min<uint64_t>(latencyNs, UINT32_MAX));
+    r.macKey = macKey;
+    r.flags = static_cast<uint8_t>(flags | (length < text.size() ? RECORD_TRUNCATED : 0));
+    r.program = program;
+    r.context = context;
+    r.method = method;
+    r.backspace = static_cast<uint8_t>(std::clamp(backspace, 0, 255));
+    r.textBytes = static_cast<uint8_t>(length);
+    std::memcpy(r.text, text.data(), length);
+    std::memset(r.text + length, 0, sizeof(r.text) - length);
+    header_->next = n + 1;  // Readers of a live file see the record once counted
+}
+
+// =============================================================================
+// KeyRecording
+// =============================================================================
+
+KeyRecording::~KeyRecording() {
+    if (map_) {
+        munmap(map_, mapSize_);
+    }
+}
+
+bool KeyRecording::open(const std::string& path) {
+    if (map_) {
+        munmap(map_, mapSize_);
+        map_ = nullptr;
+    }
+    header_ = nullptr;
+    size_ = 0;
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(KeyRecordHeader)) {
+        void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        if (data != MAP_FAILED) {
+            map_ = data;
+            mapSize_ = static_cast<size_t>(st.st_size);
+        }
+    }
+    ::close(fd);
+    if (!map_) return false;
+
+    header_ = static_cast<const KeyRecordHeader*>(map_);
+    if (!validHeader(*header_, mapSize_)) {
+        header_ = nullptr;
+        return false;
+    }
+    records_ = reinterpret_cast<const KeyRecord*>(static_cast<const char*>(map_) + sizeof(KeyRecordHeader));
+    capacity_ = header_->capacity;
+    size_ = static_cast<size_t>(std::min<uint64_t>(header_->next, capacity_));
+    first_ = header_->next - size_;
+    return true;
+}
+
+std::string KeyRecording::program(uint8_t id) const {
+    if (!header_ || id == 0 || id > header_->programCount) {
+        return {};
+    }
+    const char* name = header_->programs[id - 1];
+    return std::string(name, strnlen(name, KeyRecordHeader::PROGRAM_BYTES));
+}
+
+} // namespace GoNhanh
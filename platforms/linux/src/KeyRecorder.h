@@ -0,0 +1,128 @@
+#ifndef GONHANH_KEY_RECORDER_H
+#define GONHANH_KEY_RECORDER_H
+
+// Session recording (`key_record` setting) for offline replay
+// Fixed-size records go into a ring file mapped MAP_SHARED: recording a key
+// is a struct store plus an index store into the mapping, no syscalls; the
+// kernel writes the pages back and the file survives a crash of fcitx.
+// gonhanh-playback re-feeds a recording through RustEngine.
+//
+// File layout (little-endian host layout):
+//   KeyRecordHeader
+//   KeyRecord records[capacity]   records[n % capacity] is the n-th key
+
+#include "KeyTrace.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace GoNhanh {
+
+// Flags beyond KeyTraceFlag (same byte)
+enum KeyRecordFlag : uint8_t {
+    RECORD_TRUNCATED = 1 << 7   // Output longer than KeyRecord::text
+};
+
+struct KeyRecord {
+    uint64_t timeNs;       // steady_clock at keyEvent entry
+    uint32_t keysym;
+    uint32_t latencyNs;    // keyEvent entry to edits queued/applied
+    uint16_t macKey;
+    uint8_t flags;         // KeyTraceFlag | KeyRecordFlag bits
+    uint8_t program;       // KeyRecordHeader::programs index + 1, 0 = unknown
+    uint8_t context;       // Input context serial (low byte): one engine each
+    uint8_t method;        // InputMethod of the context
+    uint8_t backspace;
+    uint8_t textBytes;     // Bytes used in text
+    char text[40];         // UTF-8 committed by the core (first bytes if truncated)
+};
+
+static_assert(sizeof(KeyRecord) == 64, "KeyRecord is part of the recording format");
+
+struct KeyRecordHeader {
+    static constexpr size_t MAX_PROGRAMS = 63;
+    static constexpr size_t PROGRAM_BYTES = 32;
+
+    char magic[4];         // "GNKR"
+    uint16_t version;      // KeyRecorder::FORMAT_VERSION
+    uint16_t recordSize;   // sizeof(KeyRecord)
+    uint32_t capacity;     // Records in the ring
+    uint32_t programCount;
+    uint64_t next;         // Keys recorded so far (published after the record)
+    char programs[MAX_PROGRAMS][PROGRAM_BYTES];  // NUL-padded, truncated names
+    uint8_t _pad[8];
+};
+
+static_assert(sizeof(KeyRecordHeader) == 2048, "KeyRecordHeader is part of the recording format");
+
+// Recording file: $XDG_STATE_HOME/gonhanh/keys.rec (~/.local/state/...),
+// empty if neither XDG_STATE_HOME nor HOME is set
+std::string recordingPath();
+
+// Writer. Not synchronized: owned by the fcitx main thread.
+class KeyRecorder {
+public:
+    static constexpr uint16_t FORMAT_VERSION = 1;
+    static constexpr uint32_t DEFAULT_CAPACITY = 65536;  // 4 MiB
+
+    KeyRecorder() = default;
+    ~KeyRecorder() { close(); }
+    KeyRecorder(const KeyRecorder&) = delete;
+    KeyRecorder& operator=(const KeyRecorder&) = delete;
+
+    // Map `path`, creating or resizing it. A valid recording of the same
+    // capacity is appended to; anything else is started over.
+    // Returns: false if the file cannot be created or mapped
+    bool open(const std::string& path, uint32_t capacity = DEFAULT_CAPACITY);
+    void close();
+    bool isOpen() const { return header_ != nullptr; }
+
+    // KeyRecord::program for `program`, registered on first use
+    uint8_t programId(const std::string& program);
+
+    void record(uint64_t timeNs, uint64_t latencyNs, uint32_t keysym, uint16_t macKey,
+                uint8_t flags, uint8_t program, uint8_t context, uint8_t method,
+                int backspace, std::string_view text);
+
+private:
+    void* map_ = nullptr;
+    size_t mapSize_ = 0;
+    KeyRecordHeader* header_ = nullptr;
+    KeyRecord* records_ = nullptr;
+    std::unordered_map<std::string, uint8_t> programIds_;
+};
+
+// Read-only view of a recording (gonhanh-playback, tests)
+class KeyRecording {
+public:
+    KeyRecording() = default;
+    ~KeyRecording();
+    KeyRecording(const KeyRecording&) = delete;
+    KeyRecording& operator=(const KeyRecording&) = delete;
+
+    // Returns: false if missing or not a valid recording
+    bool open(const std::string& path);
+
+    // Records still in the ring, oldest first
+    size_t size() const { return size_; }
+    const KeyRecord& operator[](size_t i) const { return records_[(first_ + i) % capacity_]; }
+
+    // Name of KeyRecord::program `id` (empty for 0 or unknown ids)
+    std::string program(uint8_t id) const;
+
+private:
+    void* map_ = nullptr;
+    size_t mapSize_ = 0;
+    const KeyRecordHeader* header_ = nullptr;
+    const KeyRecord* records_ = nullptr;
+    uint64_t first_ = 0;
+    size_t size_ = 0;
+    uint32_t capacity_ = 1;
+};
+
+} // namespace GoNhanh
+
+#endif // GONHANH_KEY_RECORDER_H
@@ -0,0 +1,52 @@
+#include "KeyTrace.h"
+
+#include <cstdio>
+#include <fstream>
+
+namespace GoNhanh {
+
+std::vector<KeyTraceRecord> KeyTrace::records() const {
+    std::vector<KeyTraceRecord> out;
+    out.reserve(size());
+    for (uint64_t i = next_ - size(); i < next_; ++i) {
+        out.push_back(records_[i & (CAPACITY - 1)]);
+    }
+    return out;
+}
+
+bool KeyTrace::dump(const std::string& path) const {
+    std::vector<KeyTraceRecord> recs = records();
+    KeyTraceHeader header = {{'G', 'N', 'K', 'T'}, FORMAT_VERSION,
+                             sizeof(KeyTraceRecord), static_cast<uint32_t>(recs.size())};
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(recs.data()),
+              static_cast<std::streamsize>(recs.size() * sizeof(KeyTraceRecord)));
+    return static_cast<bool>(out.flush());
+}
+
+std::string KeyTrace::format() const {
+    std::vector<KeyTraceRecord> recs = records();
+    if (recs.empty()) {
+        return "key trace empty\n";
+    }
+
+    uint64_t newest = recs.back().timeNs;
+    std::string out;
+    char line[128];
+    for (const auto& r : recs) {
+        std::snprintf(line, sizeof(line), "%+10.3fms keysym=0x%04x mac=%3u bs=%u out=%uB %s%s%s%s%s\n",
+                      -static_cast<double>(newest - r.timeNs) / 1e6, r.keysym, r.macKey,
+                      r.backspace, r.outputBytes,
+                      (r.flags & TRACE_CAPS) ? " caps" : "",
+                      (r.flags & TRACE_SHIFT) ? " shift" : "",
+                      (r.flags & TRACE_CHANGED) ? " changed" : "",
+                      (r.flags & TRACE_PREEDIT) ? " preedit" : "",
+                      (r.flags & TRACE_WORD_BREAK) ? " break" : "");
+        out += line;
+    }
+    return out;
+}
+
+} // namespace GoNhanh
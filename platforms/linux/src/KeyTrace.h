@@ -0,0 +1,85 @@
+#ifndef GONHANH_KEY_TRACE_H
+#define GONHANH_KEY_TRACE_H
+
+// Binary ring buffer of the last keys seen by GoNhanhEngine::keyEvent
+// Recording is a fixed-size struct store (no formatting, no allocation);
+// text or binary dumps are produced on demand (D-Bus / `gn trace`).
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace GoNhanh {
+
+enum KeyTraceFlag : uint8_t {
+    TRACE_CAPS = 1 << 0,
+    TRACE_SHIFT = 1 << 1,
+    TRACE_CHANGED = 1 << 2,     // Core replaced text
+    TRACE_PREEDIT = 1 << 3,     // Context uses CompositionMode::Preedit
+    TRACE_WORD_BREAK = 1 << 4   // Break key (buffer cleared, no core call)
+};
+
+struct KeyTraceRecord {
+    uint64_t timeNs;       // steady_clock
+    uint32_t keysym;
+    uint16_t macKey;
+    uint8_t flags;         // KeyTraceFlag bits
+    uint8_t backspace;
+    uint16_t outputBytes;  // UTF-8 bytes committed by the core
+    uint8_t _pad[6];
+};
+
+static_assert(sizeof(KeyTraceRecord) == 24, "KeyTraceRecord is part of the dump format");
+
+// Dump file header (little-endian host layout), followed by `count` records
+struct KeyTraceHeader {
+    char magic[4];         // "GNKT"
+    uint16_t version;      // KeyTrace::FORMAT_VERSION
+    uint16_t recordSize;   // sizeof(KeyTraceRecord)
+    uint32_t count;
+};
+
+static_assert(sizeof(KeyTraceHeader) == 12, "KeyTraceHeader is part of the dump format");
+
+// Not synchronized: owned and written by the fcitx main thread
+class KeyTrace {
+public:
+    static constexpr size_t CAPACITY = 4096;  // Power of two
+    static constexpr uint16_t FORMAT_VERSION = 1;
+
+    void record(uint32_t keysym, uint16_t macKey, uint8_t flags,
+                int backspace, size_t outputBytes) {
+        KeyTraceRecord& r = records_[next_++ & (CAPACITY - 1)];
+        r.timeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        r.keysym = keysym;
+        r.macKey = macKey;
+        r.flags = flags;
+        r.backspace = static_cast<uint8_t>(backspace > 255 ? 255 : backspace);
+        r.outputBytes = static_cast<uint16_t>(outputBytes);
+    }
+
+    size_t size() const { return next_ < CAPACITY ? next_ : CAPACITY; }
+    void clear() { next_ = 0; }
+
+    // Recorded keys, oldest first
+    std::vector<KeyTraceRecord> records() const;
+
+    // Write header + records to `path`
+    // Returns: false if the file could not be written
+    bool dump(const std::string& path) const;
+
+    // One line per key, times relative to the newest record
+    std::string format() const;
+
+private:
+    std::array<KeyTraceRecord, CAPACITY> records_{};
+    uint64_t next_ = 0;
+};
+
+} // namespace GoNhanh
+
+#endif // GONHANH_KEY_TRACE_H
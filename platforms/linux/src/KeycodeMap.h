@@ -73,117 +73,207 @@ namespace MacKey {
     constexpr uint16_t UNKNOWN = 0xFF;
 }
 
-// Convert XKB keysym to macOS keycode
-inline uint16_t keysymToMacKeycode(uint32_t keysym) {
-    // Handle both lowercase and uppercase letters
-    switch (keysym) {
-        // Letters (lowercase and uppercase)
-        case XKB_KEY_a: case XKB_KEY_A: return MacKey::A;
-        case XKB_KEY_b: case XKB_KEY_B: return MacKey::B;
-        case XKB_KEY_c: case XKB_KEY_C: return MacKey::C;
-        case XKB_KEY_d: case XKB_KEY_D: return MacKey::D;
-        case XKB_KEY_e: case XKB_KEY_E: return MacKey::E;
-        case XKB_KEY_f: case XKB_KEY_F: return MacKey::F;
-        case XKB_KEY_g: case XKB_KEY_G: return MacKey::G;
-        case XKB_KEY_h: case XKB_KEY_H: return MacKey::H;
-        case XKB_KEY_i: case XKB_KEY_I: return MacKey::I;
-        case XKB_KEY_j: case XKB_KEY_J: return MacKey::J;
-        case XKB_KEY_k: case XKB_KEY_K: return MacKey::K;
-        case XKB_KEY_l: case XKB_KEY_L: return MacKey::L;
-        case XKB_KEY_m: case XKB_KEY_M: return MacKey::M;
-        case XKB_KEY_n: case XKB_KEY_N: return MacKey::N;
-        case XKB_KEY_o: case XKB_KEY_O: return MacKey::O;
-        case XKB_KEY_p: case XKB_KEY_P: return MacKey::P;
-        case XKB_KEY_q: case XKB_KEY_Q: return MacKey::Q;
-        case XKB_KEY_r: case XKB_KEY_R: return MacKey::R;
-        case XKB_KEY_s: case XKB_KEY_S: return MacKey::S;
-        case XKB_KEY_t: case XKB_KEY_T: return MacKey::T;
-        case XKB_KEY_u: case XKB_KEY_U: return MacKey::U;
-        case XKB_KEY_v: case XKB_KEY_V: return MacKey::V;
-        case XKB_KEY_w: case XKB_KEY_W: return MacKey::W;
-        case XKB_KEY_x: case XKB_KEY_X: return MacKey::X;
-        case XKB_KEY_y: case XKB_KEY_Y: return MacKey::Y;
-        case XKB_KEY_z: case XKB_KEY_Z: return MacKey::Z;
-
-        // Numbers
-        case XKB_KEY_0: case XKB_KEY_parenright: return MacKey::N0;
-        case XKB_KEY_1: case XKB_KEY_exclam: return MacKey::N1;
-        case XKB_KEY_2: case XKB_KEY_at: return MacKey::N2;
-        case XKB_KEY_3: case XKB_KEY_numbersign: return MacKey::N3;
-        case XKB_KEY_4: case XKB_KEY_dollar: return MacKey::N4;
-        case XKB_KEY_5: case XKB_KEY_percent: return MacKey::N5;
-        case XKB_KEY_6: case XKB_KEY_asciicircum: return MacKey::N6;
-        case XKB_KEY_7: case XKB_KEY_ampersand: return MacKey::N7;
-        case XKB_KEY_8: case XKB_KEY_asterisk: return MacKey::N8;
-        case XKB_KEY_9: case XKB_KEY_parenleft: return MacKey::N9;
-
-        // Punctuation
-        case XKB_KEY_space: return MacKey::SPACE;
-        case XKB_KEY_Return: return MacKey::RETURN;
-        case XKB_KEY_Tab: return MacKey::TAB;
-        case XKB_KEY_BackSpace: return MacKey::DELETE;
-        case XKB_KEY_Escape: return MacKey::ESC;
-        case XKB_KEY_comma: case XKB_KEY_less: return MacKey::COMMA;
-        case XKB_KEY_period: case XKB_KEY_greater: return MacKey::DOT;
-        case XKB_KEY_slash: case XKB_KEY_question: return MacKey::SLASH;
-        case XKB_KEY_semicolon: case XKB_KEY_colon: return MacKey::SEMICOLON;
-        case XKB_KEY_apostrophe: case XKB_KEY_quotedbl: return MacKey::QUOTE;
-        case XKB_KEY_bracketleft: case XKB_KEY_braceleft: return MacKey::LBRACKET;
-        case XKB_KEY_bracketright: case XKB_KEY_braceright: return MacKey::RBRACKET;
-        case XKB_KEY_backslash: case XKB_KEY_bar: return MacKey::BACKSLASH;
-        case XKB_KEY_minus: case XKB_KEY_underscore: return MacKey::MINUS;
-        case XKB_KEY_equal: case XKB_KEY_plus: return MacKey::EQUAL;
-        case XKB_KEY_grave: case XKB_KEY_asciitilde: return MacKey::BACKQUOTE;
-
-        // Arrow keys
-        case XKB_KEY_Left: return MacKey::LEFT;
-        case XKB_KEY_Right: return MacKey::RIGHT;
-        case XKB_KEY_Up: return MacKey::UP;
-        case XKB_KEY_Down: return MacKey::DOWN;
-
-        default: return MacKey::UNKNOWN;
+// Reference classification, evaluated at compile time to build the lookup
+// tables below (and used by the microbenchmark as the baseline)
+namespace detail {
+
+    // Convert XKB keysym to macOS keycode
+    constexpr uint16_t switchKeycode(uint32_t keysym) {
+        // Handle both lowercase and uppercase letters
+        switch (keysym) {
+            // Letters (lowercase and uppercase)
+            case XKB_KEY_a: case XKB_KEY_A: return MacKey::A;
+            case XKB_KEY_b: case XKB_KEY_B: return MacKey::B;
+            case XKB_KEY_c: case XKB_KEY_C: return MacKey::C;
+            case XKB_KEY_d: case XKB_KEY_D: return MacKey::D;
+            case XKB_KEY_e: case XKB_KEY_E: return MacKey::E;
+            case XKB_KEY_f: case XKB_KEY_F: return MacKey::F;
+            case XKB_KEY_g: case XKB_KEY_G: return MacKey::G;
+            case XKB_KEY_h: case XKB_KEY_H: return MacKey::H;
+            case XKB_KEY_i: case XKB_KEY_I: return MacKey::I;
+            case XKB_KEY_j: case XKB_KEY_J: return MacKey::J;
+            case XKB_KEY_k: case XKB_KEY_K: return MacKey::K;
+            case XKB_KEY_l: case XKB_KEY_L: return MacKey::L;
+            case XKB_KEY_m: case XKB_KEY_M: return MacKey::M;
+            case XKB_KEY_n: case XKB_KEY_N: return MacKey::N;
+            case XKB_KEY_o: case XKB_KEY_O: return MacKey::O;
+            case XKB_KEY_p: case XKB_KEY_P: return MacKey::P;
+            case XKB_KEY_q: case XKB_KEY_Q: return MacKey::Q;
+            case XKB_KEY_r: case XKB_KEY_R: return MacKey::R;
+            case XKB_KEY_s: case XKB_KEY_S: return MacKey::S;
+            case XKB_KEY_t: case XKB_KEY_T: return MacKey::T;
+            case XKB_KEY_u: case XKB_KEY_U: return MacKey::U;
+            case XKB_KEY_v: case XKB_KEY_V: return MacKey::V;
+            case XKB_KEY_w: case XKB_KEY_W: return MacKey::W;
+            case XKB_KEY_x: case XKB_KEY_X: return MacKey::X;
+            case XKB_KEY_y: case XKB_KEY_Y: return MacKey::Y;
+            case XKB_KEY_z: case XKB_KEY_Z: return MacKey::Z;
+
+            // Numbers
+            case XKB_KEY_0: case XKB_KEY_parenright: return MacKey::N0;
+            case XKB_KEY_1: case XKB_KEY_exclam: return MacKey::N1;
+            case XKB_KEY_2: case XKB_KEY_at: return MacKey::N2;
+            case XKB_KEY_3: case XKB_KEY_numbersign: return MacKey::N3;
+            case XKB_KEY_4: case XKB_KEY_dollar: return MacKey::N4;
+            case XKB_KEY_5: case XKB_KEY_percent: return MacKey::N5;
+            case XKB_KEY_6: case XKB_KEY_asciicircum: return MacKey::N6;
+            case XKB_KEY_7: case XKB_KEY_ampersand: return MacKey::N7;
+            case XKB_KEY_8: case XKB_KEY_asterisk: return MacKey::N8;
+            case XKB_KEY_9: case XKB_KEY_parenleft: return MacKey::N9;
+
+            // Punctuation
+            case XKB_KEY_space: return MacKey::SPACE;
+            case XKB_KEY_Return: return MacKey::RETURN;
+            case XKB_KEY_Tab: return MacKey::TAB;
+            case XKB_KEY_BackSpace: return MacKey::DELETE;
+            case XKB_KEY_Escape: return MacKey::ESC;
+            case XKB_KEY_comma: case XKB_KEY_less: return MacKey::COMMA;
+            case XKB_KEY_period: case XKB_KEY_greater: return MacKey::DOT;
+            case XKB_KEY_slash: case XKB_KEY_question: return MacKey::SLASH;
+            case XKB_KEY_semicolon: case XKB_KEY_colon: return MacKey::SEMICOLON;
+            case XKB_KEY_apostrophe: case XKB_KEY_quotedbl: return MacKey::QUOTE;
+            case XKB_KEY_bracketleft: case XKB_KEY_braceleft: return MacKey::LBRACKET;
+            case XKB_KEY_bracketright: case XKB_KEY_braceright: return MacKey::RBRACKET;
+            case XKB_KEY_backslash: case XKB_KEY_bar: return MacKey::BACKSLASH;
+            case XKB_KEY_minus: case XKB_KEY_underscore: return MacKey::MINUS;
+            case XKB_KEY_equal: case XKB_KEY_plus: return MacKey::EQUAL;
+            case XKB_KEY_grave: case XKB_KEY_asciitilde: return MacKey::BACKQUOTE;
+
+            // Arrow keys
+            case XKB_KEY_Left: return MacKey::LEFT;
+            case XKB_KEY_Right: return MacKey::RIGHT;
+            case XKB_KEY_Up: return MacKey::UP;
+            case XKB_KEY_Down: return MacKey::DOWN;
+
+            default: return MacKey::UNKNOWN;
+        }
+    }
+
+    // Check if key is a word break (space, punctuation, arrows, etc.)
+    constexpr bool switchIsBreak(uint32_t keysym) {
+        switch (keysym) {
+            case XKB_KEY_space:
+            case XKB_KEY_Tab:
+            case XKB_KEY_Return:
+            case XKB_KEY_Escape:
+            case XKB_KEY_Left:
+            case XKB_KEY_Right:
+            case XKB_KEY_Up:
+            case XKB_KEY_Down:
+            case XKB_KEY_comma: case XKB_KEY_less:
+            case XKB_KEY_period: case XKB_KEY_greater:
+            case XKB_KEY_slash: case XKB_KEY_question:
+            case XKB_KEY_semicolon: case XKB_KEY_colon:
+            case XKB_KEY_apostrophe: case XKB_KEY_quotedbl:
+            case XKB_KEY_bracketleft: case XKB_KEY_braceleft:
+            case XKB_KEY_bracketright: case XKB_KEY_braceright:
+            case XKB_KEY_backslash: case XKB_KEY_bar:
+            case XKB_KEY_minus: case XKB_KEY_underscore:
+            case XKB_KEY_equal: case XKB_KEY_plus:
+            case XKB_KEY_grave: case XKB_KEY_asciitilde:
+                return true;
+            default:
+                return false;
+        }
     }
+
+    // Check if key is a letter (for IME processing)
+    constexpr bool rangeIsLetter(uint32_t keysym) {
+        return (keysym >= XKB_KEY_a && keysym <= XKB_KEY_z) ||
+               (keysym >= XKB_KEY_A && keysym <= XKB_KEY_Z);
+    }
+
+    // Check if key is a number (for VNI mode)
+    constexpr bool rangeIsNumber(uint32_t keysym) {
+        return (keysym >= XKB_KEY_0 && keysym <= XKB_KEY_9);
+    }
+
+} // namespace detail
+
+// Packed table entry: low byte = macOS keycode, high byte = KeyFlag bits
+namespace KeyFlag {
+    constexpr uint16_t LETTER = 1 << 8;
+    constexpr uint16_t NUMBER = 1 << 9;
+    constexpr uint16_t BREAK = 1 << 10;
+    constexpr uint16_t UPPER = 1 << 11;  // Uppercase letter
 }
 
-// Check if key is a word break (space, punctuation, arrows, etc.)
-inline bool isBreakKey(uint32_t keysym) {
-    switch (keysym) {
-        case XKB_KEY_space:
-        case XKB_KEY_Tab:
-        case XKB_KEY_Return:
-        case XKB_KEY_Escape:
-        case XKB_KEY_Left:
-        case XKB_KEY_Right:
-        case XKB_KEY_Up:
-        case XKB_KEY_Down:
-        case XKB_KEY_comma: case XKB_KEY_less:
-        case XKB_KEY_period: case XKB_KEY_greater:
-        case XKB_KEY_slash: case XKB_KEY_question:
-        case XKB_KEY_semicolon: case XKB_KEY_colon:
-        case XKB_KEY_apostrophe: case XKB_KEY_quotedbl:
-        case XKB_KEY_bracketleft: case XKB_KEY_braceleft:
-        case XKB_KEY_bracketright: case XKB_KEY_braceright:
-        case XKB_KEY_backslash: case XKB_KEY_bar:
-        case XKB_KEY_minus: case XKB_KEY_underscore:
-        case XKB_KEY_equal: case XKB_KEY_plus:
-        case XKB_KEY_grave: case XKB_KEY_asciitilde:
-            return true;
-        default:
-            return false;
+// Result of a single table lookup
+struct KeyInfo {
+    uint16_t packed;
+
+    constexpr uint16_t keycode() const { return packed & 0xFF; }
+    constexpr bool isLetter() const { return packed & KeyFlag::LETTER; }
+    constexpr bool isNumber() const { return packed & KeyFlag::NUMBER; }
+    constexpr bool isBreak() const { return packed & KeyFlag::BREAK; }
+    constexpr bool isUpper() const { return packed & KeyFlag::UPPER; }
+    constexpr bool isUnknown() const { return keycode() == MacKey::UNKNOWN; }
+};
+
+namespace detail {
+    constexpr uint16_t pack(uint32_t keysym) {
+        return static_cast<uint16_t>(
+            switchKeycode(keysym) |
+            (rangeIsLetter(keysym) ? KeyFlag::LETTER : 0) |
+            (rangeIsNumber(keysym) ? KeyFlag::NUMBER : 0) |
+            (switchIsBreak(keysym) ? KeyFlag::BREAK : 0) |
+            (keysym >= XKB_KEY_A && keysym <= XKB_KEY_Z ? KeyFlag::UPPER : 0));
+    }
+
+    // 256 entries for keysyms base + 0x00..0xFF
+    struct Page {
+        uint16_t entries[256];
+    };
+
+    constexpr Page makePage(uint32_t base) {
+        Page page{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            page.entries[i] = pack(base + i);
+        }
+        return page;
     }
+
+    // Latin-1 (letters, digits, punctuation) and the 0xFF00 function key
+    // page (Return, Tab, BackSpace, Escape, arrows) cover every mapped key
+    inline constexpr Page LATIN1 = makePage(0x0000);
+    inline constexpr Page FUNCTION = makePage(0xFF00);
+    constexpr uint16_t UNKNOWN_ENTRY = MacKey::UNKNOWN;
+}
+
+// Classify a keysym with one table lookup
+constexpr KeyInfo lookup(uint32_t keysym) {
+    if (keysym < 0x100) return {detail::LATIN1.entries[keysym]};
+    if ((keysym >> 8) == 0xFF) return {detail::FUNCTION.entries[keysym & 0xFF]};
+    return {detail::UNKNOWN_ENTRY};
+}
+
+// Convert XKB keysym to macOS keycode
+constexpr uint16_t keysymToMacKeycode(uint32_t keysym) {
+    return lookup(keysym).keycode();
+}
+
+// Check if key is a word break (space, punctuation, arrows, etc.)
+constexpr bool isBreakKey(uint32_t keysym) {
+    return lookup(keysym).isBreak();
 }
 
 // Check if key is a letter (for IME processing)
-inline bool isLetterKey(uint32_t keysym) {
-    return (keysym >= XKB_KEY_a && keysym <= XKB_KEY_z) ||
-           (keysym >= XKB_KEY_A && keysym <= XKB_KEY_Z);
+constexpr bool isLetterKey(uint32_t keysym) {
+    return lookup(keysym).isLetter();
 }
 
 // Check if key is a number (for VNI mode)
-inline bool isNumberKey(uint32_t keysym) {
-    return (keysym >= XKB_KEY_0 && keysym <= XKB_KEY_9);
+constexpr bool isNumberKey(uint32_t keysym) {
+    return lookup(keysym).isNumber();
 }
 
+// Table and switch must agree; checked at compile time on sample keys
+static_assert(keysymToMacKeycode(XKB_KEY_z) == MacKey::Z, "table mismatch");
+static_assert(keysymToMacKeycode(XKB_KEY_Down) == MacKey::DOWN, "table mismatch");
+static_assert(isBreakKey(XKB_KEY_Return) && !isBreakKey(XKB_KEY_BackSpace), "table mismatch");
+static_assert(lookup(XKB_KEY_Q).isUpper() && !lookup(XKB_KEY_q).isUpper(), "table mismatch");
+static_assert(keysymToMacKeycode(0x1000000 + 0x1EA1) == MacKey::UNKNOWN, "table mismatch");
+
 } // namespace KeycodeMap
 
 #endif // GONHANH_KEYCODE_MAP_H
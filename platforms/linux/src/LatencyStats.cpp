@@ -0,0 +1,125 @@
+#include "LatencyStats.h"
+
+#include <cstdio>
+#include <vector>
+
+namespace GoNhanh {
+
+// Lock-free list of every thread's histograms (push-only)
+static std::atomic<ThreadLatency*> g_threads{nullptr};
+
+ThreadLatency& threadLatency() {
+    thread_local ThreadLatency* stats = [] {
+        auto* t = new ThreadLatency();
+        t->next = g_threads.load(std::memory_order_relaxed);
+        while (!g_threads.compare_exchange_weak(t->next, t, std::memory_order_release,
+                                                std::memory_order_relaxed)) {
+        }
+        return t;
+    }();
+    return *stats;
+}
+
+// Upper bound of the bucket holding the q-th fraction of `total` values
+static uint64_t percentile(const std::vector<uint64_t>& counts, uint64_t total, double q) {
+    uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(total - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < counts.size(); ++b) {
+        seen += counts[b];
+        if (seen >= rank) {
+            return LatencyHistogram::bucketFloor(b + 1) - 1;
+        }
+    }
+    return 0;
+}
+
+// Merge the histogram `pick` selects from every thread
+template <typename Pick>
+static LatencySummary summarize(ThreadLatency* head, Pick pick) {
+    std::vector<uint64_t> counts(LatencyHistogram::BUCKETS, 0);
+    uint64_t total = 0;
+    for (ThreadLatency* t = head; t; t = t->next) {
+        const LatencyHistogram& h = pick(*t);
+        for (size_t b = 0; b < LatencyHistogram::BUCKETS; ++b) {
+            uint64_t c = h.count(b);
+            counts[b] += c;
+            total += c;
+        }
+    }
+
+    LatencySummary summary;
+    summary.count = total;
+    if (total == 0) return summary;
+    summary.p50 = percentile(counts, total, 0.50);
+    summary.p99 = percentile(counts, total, 0.99);
+    summary.p999 = percentile(counts, total, 0.999);
+    summary.max = percentile(counts, total, 1.0);
+    return summary;
+}
+
+LatencySnapshot latencySnapshot() {
+    LatencySnapshot snapshot;
+    ThreadLatency* head = g_threads.load(std::memory_order_acquire);
+
+    for (size_t s = 0; s < LATENCY_STAGES; ++s) {
+        snapshot.stages[s] =
+            summarize(head, [s](const ThreadLatency& t) -> const auto& { return t.stages[s]; });
+    }
+    snapshot.afterIdle =
+        summarize(head, [](const ThreadLatency& t) -> const auto& { return t.afterIdle; });
+
+    for (ThreadLatency* t = head; t; t = t->next) {
+        snapshot.slowKeys += t->slowKeys.load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
+
+void resetLatency() {
+    for (ThreadLatency* t = g_threads.load(std::memory_order_acquire); t; t = t->next) {
+        for (auto& stage : t->stages) stage.reset();
+        t->afterIdle.reset();
+        t->slowKeys.store(0, std::memory_order_relaxed);
+    }
+}
+
+static std::string formatNs(uint64_t ns) {
+    char buf[32];
+    if (ns < 1000) {
+        std::snprintf(buf, sizeof(buf), "%lluns", static_cast<unsigned long long>(ns));
+    } else if (ns < 1000000) {
+        std::snprintf(buf, sizeof(buf), "%.1fus", ns / 1e3);
+    } else {
+        std::snprintf(buf, sizeof(buf), "%.2fms", ns / 1e6);
+    }
+    return buf;
+}
+
+std::string formatLatency(const LatencySnapshot& snapshot) {
+    static const char* names[LATENCY_STAGES] = {"ffi", "utf8", "commit", "total"};
+
+    std::string out;
+    char line[128];
+    std::snprintf(line, sizeof(line), "%-8s %10s %10s %10s %10s %10s\n",
+                  "stage", "count", "p50", "p99", "p999", "max");
+    out += line;
+    auto row = [&](const char* name, const LatencySummary& st) {
+        std::snprintf(line, sizeof(line), "%-8s %10llu %10s %10s %10s %10s\n", name,
+                      static_cast<unsigned long long>(st.count), formatNs(st.p50).c_str(),
+                      formatNs(st.p99).c_str(), formatNs(st.p999).c_str(),
+                      formatNs(st.max).c_str());
+        out += line;
+    };
+    for (size_t s = 0; s < LATENCY_STAGES; ++s) {
+        row(names[s], snapshot.stages[s]);
+    }
+    row("idle", snapshot.afterIdle);  // Total of the first key after IDLE_KEY_NS
+    std::snprintf(line, sizeof(line), "slow keys (> %s): %llu\n", formatNs(SLOW_KEY_NS).c_str(),
+                  static_cast<unsigned long long>(snapshot.slowKeys));
+    out += line;
+    std::snprintf(line, sizeof(line), "idle: first keys after %llus without keys\n",
+                  static_cast<unsigned long long>(IDLE_KEY_NS / 1000000000));
+    out += line;
+    return out;
+}
+
+} // namespace GoNhanh
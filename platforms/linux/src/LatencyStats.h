@@ -0,0 +1,162 @@
+#ifndef GONHANH_LATENCY_STATS_H
+#define GONHANH_LATENCY_STATS_H
+
+// Keystroke latency instrumentation for GoNhanhEngine::keyEvent
+// Enabled by the GONHANH_LATENCY_STATS build option. When it is off,
+// KeyLatencyProbe is an empty inline type: the key path has no timing code.
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace GoNhanh {
+
+// Parts of keyEvent timed separately
+enum class LatencyStage : uint8_t {
+    Ffi = 0,     // Rust core call
+    Utf8 = 1,    // Building the UTF-8 string handed to fcitx
+    Commit = 2,  // deleteSurroundingText + commitString, queueing them (async_commit)
+                 // or the preedit update
+    Total = 3    // Whole keyEvent
+};
+constexpr size_t LATENCY_STAGES = 4;
+
+// Keys slower than this end-to-end are counted as slow
+constexpr uint64_t SLOW_KEY_NS = 1000000;
+
+// A key this long after the thread's previous one is also recorded as a
+// first key after idle (its caches and pages may have gone cold)
+constexpr uint64_t IDLE_KEY_NS = 10000000000;
+
+// HDR-style log-linear histogram of nanosecond values: 16 linear
+// sub-buckets per power of two (~6% precision) over the full uint64 range.
+// Single writer (the owning thread); readers may run concurrently.
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BITS = 4;
+    static constexpr size_t SUB_COUNT = size_t(1) << SUB_BITS;
+    static constexpr size_t BUCKETS = (64 - SUB_BITS + 1) * SUB_COUNT;
+
+    static size_t bucketFor(uint64_t ns) {
+        if (ns < SUB_COUNT) return static_cast<size_t>(ns);
+        int shift = 63 - __builtin_clzll(ns) - SUB_BITS;
+        return (shift + 1) * SUB_COUNT + ((ns >> shift) & (SUB_COUNT - 1));
+    }
+
+    // Smallest value that falls into `bucket`
+    static uint64_t bucketFloor(size_t bucket) {
+        if (bucket < SUB_COUNT) return bucket;
+        size_t shift = bucket / SUB_COUNT - 1;
+        return (SUB_COUNT + bucket % SUB_COUNT) << shift;
+    }
+
+    void record(uint64_t ns) {
+        // Only the owning thread writes: no read-modify-write needed
+        auto& slot = counts_[bucketFor(ns)];
+        slot.store(slot.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    uint64_t count(size_t bucket) const {
+        return counts_[bucket].load(std::memory_order_relaxed);
+    }
+
+    void reset() {
+        for (auto& slot : counts_) slot.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKETS> counts_{};
+};
+
+// Histograms of one thread. Registered on first use and never freed
+// (keyEvent runs on a handful of long-lived threads).
+struct ThreadLatency {
+    LatencyHistogram stages[LATENCY_STAGES];
+    LatencyHistogram afterIdle;  // Total of first keys after IDLE_KEY_NS
+    std::atomic<uint64_t> slowKeys{0};
+    uint64_t lastKeyNs = 0;      // Start of the previous key (owner thread only)
+    ThreadLatency* next = nullptr;
+};
+
+// Histograms of the calling thread (lock-free registration)
+ThreadLatency& threadLatency();
+
+struct LatencySummary {
+    uint64_t count = 0;
+    uint64_t p50 = 0;   // Upper bucket bounds, in ns
+    uint64_t p99 = 0;
+    uint64_t p999 = 0;
+    uint64_t max = 0;
+};
+
+struct LatencySnapshot {
+    LatencySummary stages[LATENCY_STAGES];
+    LatencySummary afterIdle;
+    uint64_t slowKeys = 0;
+};
+
+// Merge the histograms of all threads
+LatencySnapshot latencySnapshot();
+
+// Clear all histograms (racing recordings may survive)
+void resetLatency();
+
+// Human-readable table (for D-Bus / `gn stats`)
+std::string formatLatency(const LatencySnapshot& snapshot);
+
+#ifdef GONHANH_LATENCY_STATS
+constexpr bool LATENCY_STATS_ENABLED = true;
+
+// Times one keyEvent: each mark() records the time since the previous
+// mark (or construction); the destructor records the total.
+class KeyLatencyProbe {
+public:
+    KeyLatencyProbe() : stats_(threadLatency()), start_(now()), last_(start_) {}
+
+    ~KeyLatencyProbe() {
+        uint64_t total = now() - start_;
+        stats_.stages[static_cast<size_t>(LatencyStage::Total)].record(total);
+        if (stats_.lastKeyNs && start_ - stats_.lastKeyNs > IDLE_KEY_NS) {
+            stats_.afterIdle.record(total);
+        }
+        stats_.lastKeyNs = start_;
+        if (total > SLOW_KEY_NS) {
+            stats_.slowKeys.store(stats_.slowKeys.load(std::memory_order_relaxed) + 1,
+                                  std::memory_order_relaxed);
+        }
+    }
+
+    void mark(LatencyStage stage) {
+        uint64_t t = now();
+        stats_.stages[static_cast<size_t>(stage)].record(t - last_);
+        last_ = t;
+    }
+
+    KeyLatencyProbe(const KeyLatencyProbe&) = delete;
+    KeyLatencyProbe& operator=(const KeyLatencyProbe&) = delete;
+
+private:
+    static uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    ThreadLatency& stats_;
+    uint64_t start_;
+    uint64_t last_;
+};
+#else
+constexpr bool LATENCY_STATS_ENABLED = false;
+
+class KeyLatencyProbe {
+public:
+    void mark(LatencyStage) {}
+};
+#endif
+
+} // namespace GoNhanh
+
+#endif // GONHANH_LATENCY_STATS_H
@@ -0,0 +1,77 @@
+#ifndef GONHANH_PREEDIT_WORD_H
+#define GONHANH_PREEDIT_WORD_H
+
+// Word shown as preedit by one input context (preedit mode)
+// The word being composed stays in the preedit and reaches the client only
+// when it ends. After each key, update() decides from the engine buffer and
+// the key's output what is shown, what is committed, and whether the client
+// sees the key.
+
+#include "EditQueue.h"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace GoNhanh {
+
+class PreeditWord {
+public:
+    const std::string& text() const { return text_; }
+    size_t length() const { return length_; }  // Codepoints
+    bool empty() const { return length_ == 0; }
+    size_t capacity() const { return text_.capacity(); }
+
+    void set(std::string text, size_t length) {
+        text_ = std::move(text);
+        length_ = length;
+    }
+
+    // Clear the word and return it (for committing)
+    std::string take() {
+        std::string text = std::move(text_);
+        set({}, 0);
+        return text;
+    }
+
+    // After a key the engine processed: `word` (`length` codepoints) is its
+    // buffer, `backspace`/`text` the key's output. Edits for the client go to
+    // `commit`, to be applied after the preedit is re-rendered.
+    // Returns: true if the key was absorbed (filtered), false if the client
+    // must still see it, after the committed edits
+    bool update(std::string word, size_t length, int backspace, std::string_view text,
+                EditQueue& commit) {
+        bool changed = backspace > 0 || !text.empty();
+
+        // Nothing composing before or after this key: plain pass-through
+        if (length == 0 && empty()) {
+            commit.push(backspace, text);
+            return changed;
+        }
+
+        // The word ended without a break key (Telex "!" after a letter): it
+        // leaves the preedit as committed text, edited by the output; a key
+        // the engine did not change then reaches the client after it
+        if (length == 0) {
+            commit.push(0, take());
+            commit.push(backspace, text);
+            return changed;
+        }
+
+        // Deletions beyond the preedit reach into already committed text
+        if (static_cast<size_t>(backspace) > length_) {
+            commit.push(backspace - static_cast<int>(length_), {});
+        }
+        set(std::move(word), length);
+        return true;
+    }
+
+private:
+    std::string text_;
+    size_t length_ = 0;
+};
+
+} // namespace GoNhanh
+
+#endif // GONHANH_PREEDIT_WORD_H
@@ -1,26 +1,20 @@
 #include "RustBridge.h"
+#include "EngineService.h"
+#include "KeycodeMap.h"
+#include <link.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
 #include <codecvt>
+#include <cstring>
 #include <locale>
 
-bool RustBridge::initialized_ = false;
+std::once_flag RustBridge::initOnce_;
+std::shared_ptr<GoNhanh::EngineClient> RustBridge::service_;
 
-void RustBridge::initialize() {
-    if (initialized_) return;
-    ime_init();
-    initialized_ = true;
-}
-
-std::pair<int, std::string> RustBridge::processKey(
-    uint16_t keyCode,
-    bool caps,
-    bool ctrl,
-    bool shift
-) {
-    if (!initialized_) {
-        initialize();
-    }
-
-    ImeResult* result = ime_key_ext(keyCode, caps, ctrl, shift);
+// Convert an FFI result to (backspace, UTF-8 text) and release it
+static std::pair<int, std::string> takeResult(ImeResult* result) {
     if (!result) {
         return {0, ""};
     }
@@ -31,9 +25,9 @@ std::pair<int, std::string> RustBridge::processKey(
         output.first = result->backspace;
 
         // Convert UTF-32 chars to UTF-8 string
-        for (uint8_t i = 0; i < result->count && i < 32; ++i) {
+        for (int i = 0; i < result->count && i < IME_MAX_CHARS; ++i) {
             if (result->chars[i] > 0) {
-                output.second += codePointToUtf8(result->chars[i]);
+                output.second += RustBridge::codePointToUtf8(result->chars[i]);
             }
         }
     }
@@ -42,11 +36,187 @@ std::pair<int, std::string> RustBridge::processKey(
     return output;
 }
 
+// Copy a filled UTF-8 FFI result into caller-owned output (no allocations)
+static bool fillOutput(const ImeUtf8Result& result, KeyOutput& out) {
+    if (result.action != static_cast<uint8_t>(ImeAction::Send)) {
+        out.backspace = 0;
+        out.length = 0;
+        return false;
+    }
+
+    out.backspace = result.backspace;
+    out.length = result.len < IME_MAX_UTF8 ? result.len : IME_MAX_UTF8;
+    std::memcpy(out.text, result.bytes, out.length);
+    return !out.empty();
+}
+
+// Compact result: inline text is copied, spilled text is already in out.text
+static bool fillOutput(const ImeCompactResult& result, KeyOutput& out) {
+    if (result.action != static_cast<uint8_t>(ImeAction::Send)) {
+        out.backspace = 0;
+        out.length = 0;
+        return false;
+    }
+
+    out.backspace = result.backspace;
+    out.length = result.len;
+    if (!(result.flags & IME_FLAG_SPILLED)) {
+        std::memcpy(out.text, result.bytes, out.length);
+    }
+    return !out.empty();
+}
+
+// Output chunk per batch FFI call (the core reserves IME_MAX_UTF8 per key)
+constexpr size_t BATCH_CHUNK = IME_MAX_UTF8 * 4;
+
+// Drive a batch FFI call over chunks until every batchable event is consumed
+template <typename BatchFn>
+static BatchOutput runBatch(const ImeKeyEvent* events, size_t n, BatchFn batch) {
+    BatchOutput output;
+    char chunk[BATCH_CHUNK];
+
+    while (output.consumed < n) {
+        ImeBatchResult result;
+        if (!batch(events + output.consumed, n - output.consumed, chunk, BATCH_CHUNK, &result) ||
+            result.consumed == 0) {
+            break;  // Not initialized, or next event is a control key
+        }
+
+        // Backspaces of a later chunk delete text of earlier chunks first
+        for (uint32_t i = 0; i < result.backspace; ++i) {
+            if (output.text.empty()) {
+                ++output.backspace;
+                continue;
+            }
+            // Drop one UTF-8 character (skip continuation bytes)
+            size_t end = output.text.size() - 1;
+            while (end > 0 && (static_cast<uint8_t>(output.text[end]) & 0xC0) == 0x80) {
+                --end;
+            }
+            output.text.resize(end);
+        }
+
+        output.text.append(chunk, result.len);
+        output.consumed += result.consumed;
+    }
+    return output;
+}
+
+void RustBridge::initialize() {
+    std::call_once(initOnce_, ime_init);
+}
+
+void RustBridge::warmUp() {
+    ime_warm_up();
+}
+
+void RustBridge::prefetch() {
+    if (ime_prefetch) {
+        ime_prefetch();
+    } else {
+        ime_warm_up();
+    }
+}
+
+size_t RustBridge::lockCoreMemory(bool lock) {
+    // Address span of the object that defines ime_init (the core .so, or the
+    // addon itself with a static core)
+    struct Span {
+        uintptr_t symbol;
+        uintptr_t start = 0;
+        uintptr_t end = 0;
+    } span{reinterpret_cast<uintptr_t>(&ime_init)};
+
+    dl_iterate_phdr([](dl_phdr_info* info, size_t, void* data) {
+        auto& span = *static_cast<Span*>(data);
+        uintptr_t start = UINTPTR_MAX;
+        uintptr_t end = 0;
+        for (int i = 0; i < info->dlpi_phnum; ++i) {
+            const ElfW(Phdr)& ph = info->dlpi_phdr[i];
+            if (ph.p_type == PT_LOAD) {
+                start = std::min<uintptr_t>(start, info->dlpi_addr + ph.p_vaddr);
+                end = std::max<uintptr_t>(end, info->dlpi_addr + ph.p_vaddr + ph.p_memsz);
+            }
+        }
+        if (span.symbol < start || span.symbol >= end) {
+            return 0;
+        }
+        span.start = start;
+        span.end = end;
+        return 1;
+    }, &span);
+    if (span.end == 0) {
+        return 0;
+    }
+
+    // One call for the whole span: code, tables and the (small) data segment
+    // succeed or fail together
+    uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t start = span.start & ~(page - 1);
+    size_t length = span.end - start;
+    void* at = reinterpret_cast<void*>(start);
+    return (lock ? mlock(at, length) : munlock(at, length)) == 0 ? length : 0;
+}
+
+std::pair<int, std::string> RustBridge::processKey(
+    uint16_t keyCode,
+    bool caps,
+    bool ctrl,
+    bool shift
+) {
+    initialize();
+
+    return takeResult(ime_key_ext(keyCode, caps, ctrl, shift));
+}
+
+bool RustBridge::processKey(
+    uint16_t keyCode,
+    bool caps,
+    bool ctrl,
+    bool shift,
+    KeyOutput& out
+) {
+    initialize();
+
+    if (compactResults()) {
+        ImeCompactResult result;
+        if (!ime_key_compact(&result, out.text, sizeof(out.text), keyCode, caps, ctrl, shift)) {
+            out.backspace = 0;
+            out.length = 0;
+            return false;
+        }
+        return fillOutput(result, out);
+    }
+
+    ImeUtf8Result result;
+    if (!ime_key_utf8(&result, keyCode, caps, ctrl, shift)) {
+        out.backspace = 0;
+        out.length = 0;
+        return false;
+    }
+    return fillOutput(result, out);
+}
+
+BatchOutput RustBridge::processKeys(const ImeKeyEvent* events, size_t n) {
+    initialize();
+    return runBatch(events, n, ime_keys_batch);
+}
+
+bool RustBridge::compactResults() {
+    // Layout 2 only adds ImeCompactResult::state, which layout 1 leaves 0
+    static const bool compact = ime_result_layout && ime_key_compact && ime_engine_key_compact &&
+                                ime_result_layout(IME_COMPACT_VERSION) >= 1;
+    return compact;
+}
+
+// Settings before the first key need the engine they apply to
 void RustBridge::setMethod(InputMethod method) {
+    initialize();
     ime_method(static_cast<uint8_t>(method));
 }
 
 void RustBridge::setEnabled(bool enabled) {
+    initialize();
     ime_enabled(enabled);
 }
 
@@ -54,34 +224,544 @@ void RustBridge::clear() {
     ime_clear();
 }
 
+bool RustBridge::connectService(const std::string& path) {
+    auto client = GoNhanh::EngineClient::connect(path);
+    if (!client) {
+        return false;
+    }
+    disconnectService();
+    std::atomic_store(&service_, std::move(client));
+    return true;
+}
+
+void RustBridge::disconnectService() {
+    if (auto client = std::atomic_exchange(&service_, {})) {
+        client->close();
+    }
+}
+
+std::shared_ptr<GoNhanh::EngineClient> RustBridge::service() {
+    auto client = std::atomic_load(&service_);
+    return client && client->alive() ? client : nullptr;
+}
+
+RustEngine::RustEngine() : handle_(nullptr), remote_(RustBridge::service()) {
+    remoteId_ = remote_ ? remote_->newEngine() : 0;
+    if (!remoteId_) {
+        remote_.reset();
+        handle_ = ime_engine_new();
+    }
+}
+
+RustEngine::~RustEngine() {
+    if (remote_) {
+        remote_->freeEngine(remoteId_);
+    }
+    ime_engine_free(handle_);
+    ime_shortcuts_free(parkedShortcuts_);
+}
+
+std::pair<int, std::string> RustEngine::processKey(
+    uint16_t keyCode,
+    bool caps,
+    bool ctrl,
+    bool shift
+) {
+    dropState();
+    if (remote_) {
+        KeyOutput out;
+        uint8_t state;
+        if (remote_->key(remoteId_, ImeKeyEvent{keyCode, caps, ctrl, shift, 0}, out, state)) {
+            logKey(keyCode, caps, ctrl, shift);
+            return {out.backspace, std::string(out.view())};
+        }
+        detach();
+    }
+    ImeEngine* engine = core();  // A rebuild replays the keys logged before this one
+    logKey(keyCode, caps, ctrl, shift);
+    return takeResult(ime_engine_key_ext(engine, keyCode, caps, ctrl, shift));
+}
+
+bool RustEngine::processKey(
+    uint16_t keyCode,
+    bool caps,
+    bool ctrl,
+    bool shift,
+    KeyOutput& out
+) {
+    // The core would return "no action" and stay as it is: the summary
+    // still holds for the next key
+    if (passesThrough(keyCode, ctrl)) {
+        ++skippedKeys_;
+        out.backspace = 0;
+        out.length = 0;
+        return false;
+    }
+
+    if (remote_) {
+        if (remote_->key(remoteId_, ImeKeyEvent{keyCode, caps, ctrl, shift, 0}, out, state_)) {
+            logKey(keyCode, caps, ctrl, shift);
+            return !out.empty();
+        }
+        detach();
+    }
+    ImeEngine* engine = core();
+    logKey(keyCode, caps, ctrl, shift);
+    if (RustBridge::compactResults()) {
+        ImeCompactResult result;
+        if (!ime_engine_key_compact(engine, &result, out.text, sizeof(out.text),
+                                    keyCode, caps, ctrl, shift)) {
+            dropState();
+            out.backspace = 0;
+            out.length = 0;
+            return false;
+        }
+        state_ = result.state;
+        return fillOutput(result, out);
+    }
+
+    ImeUtf8Result result;
+    if (!ime_engine_key_utf8(engine, &result, keyCode, caps, ctrl, shift)) {
+        out.backspace = 0;
+        out.length = 0;
+        return false;
+    }
+    return fillOutput(result, out);
+}
+
+bool RustEngine::passesThrough(uint16_t keyCode, bool ctrl) const {
+    return !ctrl && keyCode == KeycodeMap::MacKey::DELETE && (state_ & IME_STATE_PASS_DELETE);
+}
+
+BatchOutput RustEngine::processKeys(const ImeKeyEvent* events, size_t n) {
+    dropState();
+    return runBatch(events, n, [this](const ImeKeyEvent* ev, size_t count, char* out,
+                                      size_t cap, ImeBatchResult* result) {
+        bool done = remote_ && remote_->keys(remoteId_, ev, count, out, cap, result);
+        if (!done) {
+            if (remote_) {
+                detach();  // Earlier chunks are logged: the rebuild replays them
+            }
+            done = ime_engine_keys_batch(core(), ev, count, out, cap, result);
+        }
+        for (size_t i = 0; done && i < result->consumed; ++i) {
+            logKey(ev[i].key, ev[i].caps, ev[i].ctrl, ev[i].shift);
+        }
+        return done;
+    });
+}
+
+void RustEngine::setMethod(InputMethod method) {
+    dropState();
+    config_.method = method;
+    if (handle_) {
+        ime_engine_method(handle_, static_cast<uint8_t>(method));
+    } else {
+        pushConfig();
+    }
+}
+
+void RustEngine::setEnabled(bool enabled) {
+    dropState();
+    config_.enabled = enabled;
+    if (handle_) {
+        ime_engine_enabled(handle_, enabled);
+    } else {
+        pushConfig();
+    }
+}
+
+void RustEngine::setModern(bool modern) {
+    dropState();
+    config_.modern = modern;
+    if (handle_) {
+        ime_engine_modern(handle_, modern);
+    } else {
+        pushConfig();
+    }
+}
+
+void RustEngine::setFreeTone(bool enabled) {
+    dropState();
+    config_.freeTone = enabled;
+    if (handle_) {
+        ime_engine_free_tone(handle_, enabled);
+    } else {
+        pushConfig();
+    }
+}
+
+void RustEngine::setEnglishAutoRestore(bool enabled) {
+    dropState();
+    config_.englishAutoRestore = enabled;
+    if (handle_) {
+        ime_engine_english_auto_restore(handle_, enabled);
+    } else {
+        pushConfig();
+    }
+}
+
+void RustEngine::setAutoCapitalize(bool enabled) {
+    dropState();
+    config_.autoCapitalize = enabled;
+    if (handle_) {
+        ime_engine_auto_capitalize(handle_, enabled);
+    } else {
+        pushConfig();
+    }
+}
+
+void RustEngine::setAllowForeignConsonants(bool enabled) {
+    dropState();
+    config_.allowForeignConsonants = enabled;
+    if (handle_) {
+        ime_engine_allow_foreign_consonants(handle_, enabled);
+    } else {
+        pushConfig();
+    }
+}
+
+void RustEngine::setEscRestore(bool enabled) {
+    dropState();
+    config_.escRestore = enabled;
+    if (handle_) {
+        ime_engine_esc_restore(handle_, enabled);
+    } else {
+        pushConfig();
+    }
+}
+
+void RustEngine::setSkipWShortcut(bool skip) {
+    dropState();
+    config_.skipWShortcut = skip;
+    if (handle_) {
+        ime_engine_skip_w_shortcut(handle_, skip);
+    } else {
+        pushConfig();
+    }
+}
+
+void RustEngine::setBracketShortcut(bool enabled) {
+    dropState();
+    config_.bracketShortcut = enabled;
+    if (handle_) {
+        ime_engine_bracket_shortcut(handle_, enabled);
+    } else {
+        pushConfig();
+    }
+}
+
+// In the daemon, the parked shortcuts mirror its engine's for a fallback
+void RustEngine::addShortcut(const std::string& trigger, const std::string& replacement) {
+    dropState();
+    if (!remote_) {
+        ime_engine_add_shortcut(core(), trigger.c_str(), replacement.c_str());
+        return;
+    }
+    if (!parkedShortcuts_) {
+        parkedShortcuts_ = ime_shortcuts_new();
+    }
+    ime_shortcuts_add(parkedShortcuts_, trigger.c_str(), replacement.c_str());
+    if (!remote_->addShortcut(remoteId_, trigger, replacement)) {
+        detach();
+    }
+}
+
+void RustEngine::clearShortcuts() {
+    dropState();
+    if (!remote_) {
+        ime_engine_clear_shortcuts(core());
+        return;
+    }
+    ime_shortcuts_free(parkedShortcuts_);
+    parkedShortcuts_ = nullptr;
+    if (!remote_->clearShortcuts(remoteId_)) {
+        detach();
+    }
+}
+
+void RustEngine::setShortcuts(const ShortcutTable& table) {
+    dropState();
+    if (handle_) {
+        ime_engine_set_shortcuts(handle_, table.handle());
+        return;
+    }
+    // Evicted or remote: swap the parked shortcuts instead of rebuilding for them
+    ime_shortcuts_free(parkedShortcuts_);
+    parkedShortcuts_ = ime_shortcuts_clone ? ime_shortcuts_clone(table.handle()) : nullptr;
+    // A table the daemon does not have (built before connecting) means in-process
+    if (remote_ && !(table.remote_ == remote_ && remote_->setShortcuts(remoteId_, table.remoteId_))) {
+        detach();
+    }
+}
+
+ShortcutTable::ShortcutTable() : handle_(ime_shortcuts_new()), remote_(RustBridge::service()) {
+    remoteId_ = remote_ ? remote_->newTable() : 0;
+    if (!remoteId_) {
+        remote_.reset();
+    }
+}
+
+ShortcutTable::~ShortcutTable() {
+    ime_shortcuts_free(handle_);
+    if (remote_) {
+        remote_->freeTable(remoteId_);
+    }
+}
+
+ShortcutTable::ShortcutTable(ShortcutTable&& other) noexcept
+    : handle_(other.handle_), remote_(std::move(other.remote_)), remoteId_(other.remoteId_) {
+    other.handle_ = nullptr;
+    other.remoteId_ = 0;
+}
+
+ShortcutTable& ShortcutTable::operator=(ShortcutTable&& other) noexcept {
+    if (this != &other) {
+        ime_shortcuts_free(handle_);
+        if (remote_) {
+            remote_->freeTable(remoteId_);
+        }
+        handle_ = other.handle_;
+        remote_ = std::move(other.remote_);
+        remoteId_ = other.remoteId_;
+        other.handle_ = nullptr;
+        other.remoteId_ = 0;
+    }
+    return *this;
+}
+
+// A daemon that stopped answering misses the edit; engines installing the
+// table then leave it (see RustEngine::setShortcuts)
+void ShortcutTable::add(const std::string& trigger, const std::string& replacement) {
+    ime_shortcuts_add(handle_, trigger.c_str(), replacement.c_str());
+    if (remote_) {
+        remote_->tableAdd(remoteId_, trigger, replacement);
+    }
+}
+
+size_t ShortcutTable::load(std::string_view text) {
+    size_t added = ime_shortcuts_load(handle_, text.data(), text.size());
+    if (remote_ && added > 0) {
+        remote_->tableLoad(remoteId_, text);
+    }
+    return added;
+}
+
+size_t ShortcutTable::size() const {
+    return ime_shortcuts_len(handle_);
+}
+
+// An evicted engine has nothing to clear: the rebuilt one starts empty
+void RustEngine::clear() {
+    dropState();
+    endReplay();
+    if (handle_) {
+        ime_engine_clear(handle_);
+    } else if (remote_ && !remote_->clear(remoteId_, false)) {
+        detach();
+    }
+}
+
+void RustEngine::clearAll() {
+    dropState();
+    endReplay();
+    if (handle_) {
+        ime_engine_clear_all(handle_);
+    } else if (remote_ && !remote_->clear(remoteId_, true)) {
+        detach();
+    }
+}
+
+void RustEngine::logKey(uint16_t keyCode, bool caps, bool ctrl, bool shift) {
+    if (!replayable_) {
+        return;
+    }
+    if (replayCount_ == MAX_REPLAY_KEYS) {
+        replayable_ = false;
+        replayCount_ = 0;
+        return;
+    }
+    replay_[replayCount_++] = ImeKeyEvent{keyCode, caps, ctrl, shift, 0};
+}
+
+bool RustEngine::evict() {
+    if (!handle_ || !replayable_ || !ime_engine_shortcuts || !ime_shortcuts_clone) {
+        return false;
+    }
+    parkedShortcuts_ = ime_engine_shortcuts(handle_);
+    ime_engine_free(handle_);
+    handle_ = nullptr;
+    dropState();
+    return true;
+}
+
+void RustEngine::detach() const {
+    remote_->freeEngine(remoteId_);  // Still answering, if the table was the reason
+    remote_.reset();
+    remoteId_ = 0;
+}
+
+void RustEngine::pushConfig() {
+    if (!remote_) {
+        return;  // Evicted: config_ is applied on rebuild
+    }
+    uint16_t flags = 0;
+    auto flag = [&flags](bool on, uint16_t bit) { flags |= on ? bit : 0; };
+    flag(config_.enabled, GoNhanh::ServiceConfig::ENABLED);
+    flag(config_.modern, GoNhanh::ServiceConfig::MODERN);
+    flag(config_.freeTone, GoNhanh::ServiceConfig::FREE_TONE);
+    flag(config_.englishAutoRestore, GoNhanh::ServiceConfig::ENGLISH_AUTO_RESTORE);
+    flag(config_.autoCapitalize, GoNhanh::ServiceConfig::AUTO_CAPITALIZE);
+    flag(config_.allowForeignConsonants, GoNhanh::ServiceConfig::FOREIGN_CONSONANTS);
+    flag(config_.escRestore, GoNhanh::ServiceConfig::ESC_RESTORE);
+    flag(config_.skipWShortcut, GoNhanh::ServiceConfig::SKIP_W_SHORTCUT);
+    flag(config_.bracketShortcut, GoNhanh::ServiceConfig::BRACKET_SHORTCUT);
+    if (!remote_->configure(remoteId_, {static_cast<uint8_t>(config_.method), 0, flags})) {
+        detach();
+    }
+}
+
+void RustEngine::rebuild() const {
+    handle_ = ime_engine_new();
+    ime_engine_method(handle_, static_cast<uint8_t>(config_.method));
+    ime_engine_enabled(handle_, config_.enabled);
+    ime_engine_modern(handle_, config_.modern);
+    ime_engine_free_tone(handle_, config_.freeTone);
+    ime_engine_english_auto_restore(handle_, config_.englishAutoRestore);
+    ime_engine_auto_capitalize(handle_, config_.autoCapitalize);
+    ime_engine_allow_foreign_consonants(handle_, config_.allowForeignConsonants);
+    ime_engine_esc_restore(handle_, config_.escRestore);
+    ime_engine_skip_w_shortcut(handle_, config_.skipWShortcut);
+    ime_engine_bracket_shortcut(handle_, config_.bracketShortcut);
+    ime_engine_set_shortcuts(handle_, parkedShortcuts_);
+    ime_shortcuts_free(parkedShortcuts_);
+    parkedShortcuts_ = nullptr;
+
+    if (!seed_.empty()) {
+        ime_engine_resume_word(handle_, seed_.data(), seed_.size());
+    }
+    ImeUtf8Result result;
+    for (size_t i = 0; i < replayCount_; ++i) {
+        const ImeKeyEvent& k = replay_[i];
+        ime_engine_key_utf8(handle_, &result, k.key, k.caps, k.ctrl, k.shift);
+    }
+}
+
+size_t RustEngine::memoryBytes() const {
+    size_t bytes = sizeof(*this) + seed_.capacity();
+    if (handle_ && ime_engine_memory) {
+        bytes += ime_engine_memory(handle_);
+    }
+    return bytes;
+}
+
+// Byte offset of the codepoint before `end` (UTF-8 continuation bytes skipped)
+static size_t prevCodepoint(std::string_view text, size_t end) {
+    while (end > 0 && (static_cast<unsigned char>(text[--end]) & 0xC0) == 0x80) {
+    }
+    return end;
+}
+
+size_t RustEngine::resumeWord(std::string_view text, size_t cursor) {
+    static const size_t maxChars = ime_max_syllable_chars();
+
+    size_t end = 0;
+    for (size_t i = 0; i < cursor && end < text.size(); ++i) {
+        end += (static_cast<unsigned char>(text[end]) & 0x80) == 0 ? 1
+             : (static_cast<unsigned char>(text[end]) & 0xE0) == 0xC0 ? 2
+             : (static_cast<unsigned char>(text[end]) & 0xF0) == 0xE0 ? 3 : 4;
+    }
+    end = std::min(end, text.size());
+
+    // Cursor inside a word: rebuilding only its first half would be wrong
+    if (end < text.size()) {
+        unsigned char next = static_cast<unsigned char>(text[end]);
+        if (next >= 0x80 || std::isalnum(next)) {
+            return 0;
+        }
+    }
+
+    // One character more than a syllable, so the core can reject longer words
+    size_t begin = end;
+    for (size_t i = 0; i <= maxChars && begin > 0; ++i) {
+        begin = prevCodepoint(text, begin);
+    }
+    dropState();
+    std::string_view word = text.substr(begin, end - begin);
+    size_t restored = 0;
+    if (!(remote_ && remote_->resume(remoteId_, word, restored))) {
+        if (remote_) {
+            detach();
+        }
+        restored = ime_engine_resume_word(core(), word.data(), word.size());
+    }
+    if (restored > 0 && replayCount_ == 0 && replayable_) {
+        seed_.assign(word);  // What brings the word back
+    } else if (restored > 0) {
+        replayable_ = false;
+        replayCount_ = 0;
+    }
+    return restored;
+}
+
+size_t RustEngine::getBuffer(std::string& out) const {
+    size_t remoteCount;
+    if (remote_ && remote_->buffer(remoteId_, out, remoteCount)) {
+        return remoteCount;
+    }
+    if (remote_) {
+        detach();
+    }
+    out.clear();
+    if (!handle_ && replayCount_ == 0 && seed_.empty()) {
+        return 0;  // Evicted between words: nothing to rebuild for
+    }
+    uint32_t chars[IME_MAX_CHARS];
+    int64_t count = ime_engine_get_buffer(core(), chars, IME_MAX_CHARS);
+
+    char utf8[4];
+    for (int64_t i = 0; i < count; ++i) {
+        out.append(utf8, RustBridge::encodeUtf8(chars[i], utf8));
+    }
+    return count > 0 ? static_cast<size_t>(count) : 0;
+}
+
 std::string RustBridge::codePointToUtf8(uint32_t cp) {
-    std::string result;
+    char buf[4];
+    return std::string(buf, encodeUtf8(cp, buf));
+}
 
+size_t RustBridge::encodeUtf8(uint32_t cp, char* out) {
     // Check for invalid codepoints (out of range or surrogates)
     if (cp >= 0x110000 || (cp >= 0xD800 && cp <= 0xDFFF)) {
-        // Return replacement character U+FFFD for invalid codepoints
-        return "\xEF\xBF\xBD";
+        // Write replacement character U+FFFD for invalid codepoints
+        out[0] = '\xEF';
+        out[1] = '\xBF';
+        out[2] = '\xBD';
+        return 3;
     }
 
     if (cp < 0x80) {
         // 1-byte UTF-8
-        result += static_cast<char>(cp);
+        out[0] = static_cast<char>(cp);
+        return 1;
     } else if (cp < 0x800) {
         // 2-byte UTF-8
-        result += static_cast<char>(0xC0 | (cp >> 6));
-        result += static_cast<char>(0x80 | (cp & 0x3F));
+        out[0] = static_cast<char>(0xC0 | (cp >> 6));
+        out[1] = static_cast<char>(0x80 | (cp & 0x3F));
+        return 2;
     } else if (cp < 0x10000) {
         // 3-byte UTF-8
-        result += static_cast<char>(0xE0 | (cp >> 12));
-        result += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
-        result += static_cast<char>(0x80 | (cp & 0x3F));
+        out[0] = static_cast<char>(0xE0 | (cp >> 12));
+        out[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = static_cast<char>(0x80 | (cp & 0x3F));
+        return 3;
     } else {
         // 4-byte UTF-8
-        result += static_cast<char>(0xF0 | (cp >> 18));
-        result += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
-        result += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
-        result += static_cast<char>(0x80 | (cp & 0x3F));
+        out[0] = static_cast<char>(0xF0 | (cp >> 18));
+        out[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out[3] = static_cast<char>(0x80 | (cp & 0x3F));
+        return 4;
     }
-
-    return result;
 }
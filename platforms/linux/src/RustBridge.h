@@ -1,33 +1,135 @@
 #ifndef GONHANH_RUST_BRIDGE_H
 #define GONHANH_RUST_BRIDGE_H
 
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <vector>
 
 // FFI Result structure - must match core/src/engine/mod.rs
 // #[repr(C)]
 // pub struct Result {
-//     pub chars: [u32; 32],
+//     pub chars: [u32; MAX],   // MAX = 256 (core/src/engine/buffer.rs)
 //     pub action: u8,
 //     pub backspace: u8,
 //     pub count: u8,
-//     pub _pad: u8,
+//     pub flags: u8,
 // }
 //
 // Note: Rust #[repr(C)] uses C ABI layout, which matches C++ struct layout
-// for this specific arrangement. The array (128 bytes) is followed by
-// 4 bytes of u8 fields = 132 bytes total with no implicit padding needed.
+// for this specific arrangement. The array (1024 bytes) is followed by
+// 4 bytes of u8 fields = 1028 bytes total with no implicit padding needed.
+constexpr int IME_MAX_CHARS = 256;
+
 struct ImeResult {
-    uint32_t chars[32];  // 128 bytes
-    uint8_t action;      // 1 byte
-    uint8_t backspace;   // 1 byte
-    uint8_t count;       // 1 byte
-    uint8_t _pad;        // 1 byte (explicit padding to 4-byte boundary)
+    uint32_t chars[IME_MAX_CHARS];  // 1024 bytes
+    uint8_t action;                 // 1 byte
+    uint8_t backspace;              // 1 byte
+    uint8_t count;                  // 1 byte
+    uint8_t flags;                  // 1 byte (bit 0: key consumed by shortcut)
 };
 
 // Verify struct size matches Rust at compile time
-static_assert(sizeof(ImeResult) == 132, "ImeResult size mismatch with Rust core");
+static_assert(sizeof(ImeResult) == 1028, "ImeResult size mismatch with Rust core");
+
+// FFI UTF-8 result structure - must match Utf8Result in core/src/engine/mod.rs
+// Same fields as ImeResult, but text arrives pre-encoded as UTF-8 in
+// bytes[0..len], so it can be committed without per-codepoint conversion.
+constexpr int IME_MAX_UTF8 = IME_MAX_CHARS * 4;
+
+struct ImeUtf8Result {
+    uint8_t bytes[IME_MAX_UTF8];  // 1024 bytes
+    uint16_t len;                 // 2 bytes
+    uint8_t action;               // 1 byte
+    uint8_t backspace;            // 1 byte
+    uint8_t flags;                // 1 byte
+    uint8_t _pad;                 // 1 byte
+};
+
+static_assert(sizeof(ImeUtf8Result) == 1030, "ImeUtf8Result size mismatch with Rust core");
+static_assert(offsetof(ImeUtf8Result, len) == IME_MAX_UTF8, "ImeUtf8Result layout mismatch with Rust core");
+
+// FFI compact result - must match CompactResult in core/src/engine/mod.rs
+// The common case in 32 bytes: up to IME_COMPACT_INLINE bytes of UTF-8
+// inline; longer text is written to the caller's spill buffer and sets
+// IME_FLAG_SPILLED (`len` is the full length either way). Negotiated with
+// ime_result_layout(); see RustBridge::compactResults(). Layout 2 adds
+// `state`, the engine's summary after the key (IME_STATE_* bits, left 0 by
+// layout 1 cores).
+constexpr int IME_COMPACT_INLINE = 24;
+constexpr uint32_t IME_COMPACT_VERSION = 2;
+constexpr uint8_t IME_FLAG_SPILLED = 0x02;
+
+// ImeCompactResult::state bits - must match STATE_* in core/src/engine/mod.rs
+constexpr uint8_t IME_STATE_BUFFER_EMPTY = 0x01;
+constexpr uint8_t IME_STATE_VNI = 0x02;
+constexpr uint8_t IME_STATE_PASS_DELETE = 0x04;  // Next Backspace passes through untouched
+
+struct ImeCompactResult {
+    uint8_t bytes[IME_COMPACT_INLINE];  // 24 bytes
+    uint16_t len;                       // 2 bytes
+    uint8_t action;                     // 1 byte
+    uint8_t backspace;                  // 1 byte
+    uint8_t flags;                      // 1 byte (IME_FLAG_SPILLED: text in spill)
+    uint8_t state;                      // 1 byte (IME_STATE_* after the key)
+    uint8_t _pad[2];                    // 2 bytes
+};
+
+static_assert(sizeof(ImeCompactResult) == 32, "ImeCompactResult size mismatch with Rust core");
+static_assert(offsetof(ImeCompactResult, len) == IME_COMPACT_INLINE, "ImeCompactResult layout mismatch with Rust core");
+static_assert(offsetof(ImeCompactResult, flags) == 28, "ImeCompactResult layout mismatch with Rust core");
+static_assert(offsetof(ImeCompactResult, state) == 29, "ImeCompactResult layout mismatch with Rust core");
+
+// FFI batch structures - must match core/src/engine/batch.rs
+struct ImeKeyEvent {
+    uint16_t key;    // macOS keycode
+    bool caps;
+    bool ctrl;
+    bool shift;
+    uint8_t _pad;
+};
+
+struct ImeBatchResult {
+    uint32_t backspace;  // Characters to delete before the cursor
+    uint32_t len;        // UTF-8 bytes written to the output buffer
+    uint32_t consumed;   // Events processed (batch stops at control keys)
+};
+
+static_assert(sizeof(ImeKeyEvent) == 6, "ImeKeyEvent size mismatch with Rust core");
+static_assert(sizeof(ImeBatchResult) == 12, "ImeBatchResult size mismatch with Rust core");
+
+// Coalesced net edit of a key batch: delete `backspace`, then insert `text`
+struct BatchOutput {
+    int backspace = 0;
+    std::string text;
+    size_t consumed = 0;  // Events handled; the rest start with a control key
+};
+
+// Opaque engine instance created by ime_engine_new()
+struct ImeEngine;
+
+// Opaque shortcut table created by ime_shortcuts_new()
+struct ImeShortcutTable;
+
+// Connection to gonhanh-engined (EngineService.h)
+namespace GoNhanh {
+class EngineClient;
+}
+
+// Fixed-capacity key output for the allocation-free processKey overloads.
+// Sized for the worst case (256 codepoints x 4 UTF-8 bytes), so it can live
+// on the stack or in per-context state and be reused for every keystroke.
+struct KeyOutput {
+    int backspace = 0;
+    size_t length = 0;
+    char text[IME_MAX_UTF8];
+
+    std::string_view view() const { return {text, length}; }
+    bool empty() const { return backspace == 0 && length == 0; }
+};
 
 // Action types
 enum class ImeAction : uint8_t {
@@ -42,22 +144,114 @@ enum class InputMethod : uint8_t {
     VNI = 1
 };
 
+// Core functions newer than some cores the addon may load with: weak, so
+// an older libgonhanh_core.so still loads and they compare equal to null.
+// A static core is linked from this tree and always has them.
+#ifdef GONHANH_STATIC_CORE
+#define GONHANH_CORE_OPTIONAL
+#else
+#define GONHANH_CORE_OPTIONAL __attribute__((weak))
+#endif
+
 // FFI function declarations (from core/src/lib.rs)
 extern "C" {
     void ime_init();
+    void ime_warm_up();
     ImeResult* ime_key_ext(uint16_t key, bool caps, bool ctrl, bool shift);
+    bool ime_key_into(ImeResult* out, uint16_t key, bool caps, bool ctrl, bool shift);
+    bool ime_key_utf8(ImeUtf8Result* out, uint16_t key, bool caps, bool ctrl, bool shift);
+    bool ime_keys_batch(const ImeKeyEvent* events, size_t n, char* out, size_t cap, ImeBatchResult* result);
     void ime_method(uint8_t method);
     void ime_enabled(bool enabled);
+    void ime_modern(bool modern);
+    void ime_free_tone(bool enabled);
+    void ime_english_auto_restore(bool enabled);
+    void ime_auto_capitalize(bool enabled);
+    void ime_allow_foreign_consonants(bool enabled);
+    void ime_esc_restore(bool enabled);
+    void ime_skip_w_shortcut(bool skip);
+    void ime_bracket_shortcut(bool enabled);
     void ime_clear();
+    void ime_clear_all();
     void ime_free(ImeResult* result);
+
+    // Per-instance engine handles (not synchronized - one thread per handle)
+    ImeEngine* ime_engine_new();
+    void ime_engine_free(ImeEngine* engine);
+    ImeResult* ime_engine_key_ext(ImeEngine* engine, uint16_t key, bool caps, bool ctrl, bool shift);
+    bool ime_engine_key_into(ImeEngine* engine, ImeResult* out, uint16_t key, bool caps, bool ctrl, bool shift);
+    bool ime_engine_key_utf8(ImeEngine* engine, ImeUtf8Result* out, uint16_t key, bool caps, bool ctrl, bool shift);
+    void ime_engine_method(ImeEngine* engine, uint8_t method);
+    void ime_engine_enabled(ImeEngine* engine, bool enabled);
+    void ime_engine_modern(ImeEngine* engine, bool modern);
+    void ime_engine_free_tone(ImeEngine* engine, bool enabled);
+    void ime_engine_english_auto_restore(ImeEngine* engine, bool enabled);
+    void ime_engine_auto_capitalize(ImeEngine* engine, bool enabled);
+    void ime_engine_allow_foreign_consonants(ImeEngine* engine, bool enabled);
+    void ime_engine_esc_restore(ImeEngine* engine, bool enabled);
+    void ime_engine_skip_w_shortcut(ImeEngine* engine, bool skip);
+    void ime_engine_bracket_shortcut(ImeEngine* engine, bool enabled);
+    void ime_engine_add_shortcut(ImeEngine* engine, const char* trigger, const char* replacement);
+    void ime_engine_clear_shortcuts(ImeEngine* engine);
+    void ime_engine_clear(ImeEngine* engine);
+    void ime_engine_clear_all(ImeEngine* engine);
+    int64_t ime_engine_get_buffer(ImeEngine* engine, uint32_t* out, int64_t max_len);
+    bool ime_engine_keys_batch(ImeEngine* engine, const ImeKeyEvent* events, size_t n,
+                               char* out, size_t cap, ImeBatchResult* result);
+    uint32_t ime_engine_resume_word(ImeEngine* engine, const char* text, size_t len);
+    size_t ime_engine_reference_replay(ImeEngine* engine, const ImeKeyEvent* events, size_t n,
+                                       uint8_t* out, size_t cap);
+    uint32_t ime_max_syllable_chars();
+
+    // Compact results: without them (older core) the UTF-8 results are used
+    GONHANH_CORE_OPTIONAL uint32_t ime_result_layout(uint32_t want);
+    GONHANH_CORE_OPTIONAL bool ime_key_compact(ImeCompactResult* out, char* spill, size_t cap,
+                                               uint16_t key, bool caps, bool ctrl, bool shift);
+    GONHANH_CORE_OPTIONAL bool ime_engine_key_compact(ImeEngine* engine, ImeCompactResult* out,
+                                                      char* spill, size_t cap, uint16_t key,
+                                                      bool caps, bool ctrl, bool shift);
+
+    // Keep-warm: without it (older core) prefetch only builds the dictionaries
+    GONHANH_CORE_OPTIONAL void ime_prefetch();
+
+    // Idle eviction and accounting: without them (older core) engines stay
+    GONHANH_CORE_OPTIONAL size_t ime_engine_memory(const ImeEngine* engine);
+    GONHANH_CORE_OPTIONAL ImeShortcutTable* ime_engine_shortcuts(const ImeEngine* engine);
+    GONHANH_CORE_OPTIONAL ImeShortcutTable* ime_shortcuts_clone(const ImeShortcutTable* table);
+
+    // Shared shortcut tables (built once, installed into many engines)
+    ImeShortcutTable* ime_shortcuts_new();
+    void ime_shortcuts_free(ImeShortcutTable* table);
+    void ime_shortcuts_add(ImeShortcutTable* table, const char* trigger, const char* replacement);
+    uint32_t ime_shortcuts_load(ImeShortcutTable* table, const char* data, size_t len);
+    uint32_t ime_shortcuts_len(const ImeShortcutTable* table);
+    void ime_engine_set_shortcuts(ImeEngine* engine, const ImeShortcutTable* table);
 }
 
-// C++ wrapper class for Rust bridge
+// C++ wrapper class for Rust bridge (the global engine)
+// Safe to call from any thread: keys are serialized by the core's engine
+// lock, initialization runs once, and settings are stored lock-free, so
+// changing them never waits for a key in flight.
 class RustBridge {
 public:
-    // Initialize the IME engine (call once at startup)
+    // Initialize the IME engine (first call only; keys and settings call it)
     static void initialize();
 
+    // Build the core's dictionaries (otherwise built inside the first key)
+    // Thread-safe; a key event racing with it waits for the same build
+    static void warmUp();
+
+    // Page the core's key path back in after an idle period: a couple of
+    // words on a scratch engine (no engine lock, no buffer touched)
+    static void prefetch();
+
+    // mlock (or munlock) the core library's mapped code, tables and data
+    // so they survive memory pressure. The dictionaries built at run time
+    // live on the heap and are not covered.
+    // Returns: bytes (un)locked, 0 if the core was not found or mlock failed
+    // (typically RLIMIT_MEMLOCK)
+    static size_t lockCoreMemory(bool lock = true);
+
     // Process a keystroke and return result
     // Returns: (backspace_count, output_text) or empty if no action needed
     static std::pair<int, std::string> processKey(
@@ -67,6 +261,21 @@ public:
         bool shift
     );
 
+    // Allocation-free variant: writes into caller-owned output
+    // Text comes pre-encoded as UTF-8 from the core (no conversion here)
+    // Returns: true if an action is needed (out.backspace / out.text valid)
+    static bool processKey(
+        uint16_t keyCode,
+        bool caps,
+        bool ctrl,
+        bool shift,
+        KeyOutput& out
+    );
+
+    // Process a key burst (paste, replay) under one lock and return the
+    // coalesced edit, so it can be applied as one surrounding-text change
+    static BatchOutput processKeys(const ImeKeyEvent* events, size_t n);
+
     // Set input method (Telex=0, VNI=1)
     static void setMethod(InputMethod method);
 
@@ -76,11 +285,214 @@ public:
     // Clear the input buffer (call on word boundaries)
     static void clear();
 
+    // Whether keys use ImeCompactResult (the loaded core speaks layout 1 or
+    // later); negotiated once, on first use
+    static bool compactResults();
+
     // Convert UTF-32 codepoint to UTF-8 string (public for testing)
     static std::string codePointToUtf8(uint32_t cp);
 
+    // Encode UTF-32 codepoint as UTF-8 into out (room for 4 bytes)
+    // Returns: number of bytes written
+    static size_t encodeUtf8(uint32_t cp, char* out);
+
+    // Run RustEngines and ShortcutTables created from now on in the engine
+    // daemon serving `path` (GoNhanh::servicePath()), if one does, instead
+    // of in this process. Once it stops answering, they carry on in-process.
+    // Returns: true if connected
+    static bool connectService(const std::string& path);
+
+    // New engines run in-process; those in the daemon move back on their
+    // next call
+    static void disconnectService();
+
+    // The daemon new engines go to, null if none (or it stopped answering)
+    static std::shared_ptr<GoNhanh::EngineClient> service();
+
 private:
-    static bool initialized_;
+    static std::once_flag initOnce_;
+    static std::shared_ptr<GoNhanh::EngineClient> service_;  // std::atomic_load/store
+};
+
+// Compiled shortcut table. Installing it into a RustEngine shares the
+// entries (O(1) per engine), so thousands of shortcuts cost the same memory
+// however many input contexts exist, and lookups do not depend on its size.
+// With the engine daemon connected it is built there too; this copy stays
+// for engines that fall back to in-process.
+class ShortcutTable {
+public:
+    ShortcutTable();
+    ~ShortcutTable();
+
+    ShortcutTable(ShortcutTable&& other) noexcept;
+    ShortcutTable& operator=(ShortcutTable&& other) noexcept;
+    ShortcutTable(const ShortcutTable&) = delete;
+    ShortcutTable& operator=(const ShortcutTable&) = delete;
+
+    void add(const std::string& trigger, const std::string& replacement);
+
+    // Add `trigger=replacement` lines ('#' comments), e.g. a mapped file;
+    // `text` need not be null-terminated. Later lines override earlier ones.
+    // Returns: number of shortcuts added (0 if `text` is not UTF-8)
+    size_t load(std::string_view text);
+
+    size_t size() const;
+    const ImeShortcutTable* handle() const { return handle_; }
+
+private:
+    friend class RustEngine;  // Installs remoteId_ into engines in the daemon
+
+    ImeShortcutTable* handle_;
+    std::shared_ptr<GoNhanh::EngineClient> remote_;
+    uint32_t remoteId_ = 0;
+};
+
+// Owned engine instance - one per input context, so each window keeps its
+// own composition state and keystrokes never contend on the global engine lock.
+// An idle one can be evicted to a few bytes (see evict) and is rebuilt by the
+// next call that needs the core. One created while the engine daemon is
+// connected runs there instead, and is rebuilt the same way in-process if
+// the daemon stops answering.
+class RustEngine {
+public:
+    RustEngine();
+    ~RustEngine();
+
+    RustEngine(const RustEngine&) = delete;
+    RustEngine& operator=(const RustEngine&) = delete;
+
+    // Process a keystroke (same contract as RustBridge::processKey)
+    std::pair<int, std::string> processKey(
+        uint16_t keyCode,
+        bool caps,
+        bool ctrl,
+        bool shift
+    );
+
+    // Allocation-free variant (same contract as RustBridge's overload).
+    // Keys the state summary of the previous key proves to pass through
+    // (see passesThrough) return false without calling into the core.
+    bool processKey(
+        uint16_t keyCode,
+        bool caps,
+        bool ctrl,
+        bool shift,
+        KeyOutput& out
+    );
+
+    // Process a key burst (same contract as RustBridge::processKeys)
+    BatchOutput processKeys(const ImeKeyEvent* events, size_t n);
+
+    void setMethod(InputMethod method);
+    void setEnabled(bool enabled);
+    void setModern(bool modern);
+    void setFreeTone(bool enabled);
+    void setEnglishAutoRestore(bool enabled);
+    void setAutoCapitalize(bool enabled);
+    void setAllowForeignConsonants(bool enabled);
+    void setEscRestore(bool enabled);
+    void setSkipWShortcut(bool skip);
+    void setBracketShortcut(bool enabled);
+
+    // Shortcuts (abbreviations like "vn" -> "Việt Nam")
+    void addShortcut(const std::string& trigger, const std::string& replacement);
+    void clearShortcuts();
+    // Replace all shortcuts with `table` (shared, not copied)
+    void setShortcuts(const ShortcutTable& table);
+
+    // Clear the input buffer (word boundary)
+    void clear();
+
+    // Clear buffer and word history (cursor moved, focus changed)
+    void clearAll();
+
+    // Seed the buffer from the word ending at `cursor` (codepoint offset into
+    // `text`, as in fcitx::SurroundingText) so it can be edited again without
+    // retyping. Only the last syllable-length characters are examined; nothing
+    // is restored when the cursor is inside a word or a word is being composed.
+    // Returns: number of characters restored (0 = buffer untouched)
+    size_t resumeWord(std::string_view text, size_t cursor);
+
+    // Current composed word as UTF-8 (for preedit rendering)
+    // Returns: number of codepoints in the word
+    size_t getBuffer(std::string& out) const;
+
+    // Whether the core would pass this key through and stay as it is, going
+    // by the IME_STATE_* summary of the last processKey. Anything else done
+    // to the engine drops the summary, so this is false until the next key.
+    bool passesThrough(uint16_t keyCode, bool ctrl) const;
+
+    // Keys processKey answered without the core since construction
+    uint64_t skippedKeys() const { return skippedKeys_; }
+
+    // Free the core engine, keeping what rebuilds it: the settings, the
+    // (shared) shortcuts and the keys of the word being composed. The core's
+    // word history (backspace after a space it was sent) is not kept.
+    // Returns: false if nothing was freed (already evicted, older core, or a
+    // word too long to replay)
+    bool evict();
+    bool evicted() const { return handle_ == nullptr && !remote_; }
+    // Runs in the engine daemon (see RustBridge::connectService)
+    bool remote() const { return remote_ != nullptr; }
+
+    // Bytes held for this engine: the core engine (none while evicted or in
+    // the daemon) and what rebuilds it
+    size_t memoryBytes() const;
+
+    // Keys of a word that are kept for rebuilding; a longer word pins the
+    // engine until it ends
+    static constexpr size_t MAX_REPLAY_KEYS = 64;
+
+private:
+    // Forget the summary: the engine changed outside processKey
+    void dropState() { state_ = 0; }
+
+    // The core engine, rebuilt first if evicted
+    ImeEngine* core() const {
+        if (!handle_) {
+            rebuild();
+        }
+        return handle_;
+    }
+    void rebuild() const;
+    // Leave the daemon: the next call rebuilds the engine in-process
+    void detach() const;
+    // Send config_ to the engine in the daemon
+    void pushConfig();
+    // A key the core processed, for rebuilding
+    void logKey(uint16_t keyCode, bool caps, bool ctrl, bool shift);
+    // Word boundary: nothing is left to replay
+    void endReplay() {
+        replayCount_ = 0;
+        seed_.clear();
+        replayable_ = true;
+    }
+
+    // Settings as set, reapplied on rebuild (defaults of the core's Engine::new)
+    struct Config {
+        InputMethod method = InputMethod::Telex;
+        bool enabled = true;
+        bool modern = true;
+        bool freeTone = false;
+        bool englishAutoRestore = false;
+        bool autoCapitalize = false;
+        bool allowForeignConsonants = false;
+        bool escRestore = false;
+        bool skipWShortcut = false;
+        bool bracketShortcut = false;
+    };
+
+    mutable ImeEngine* handle_;
+    uint8_t state_ = 0;  // IME_STATE_* after the last key
+    uint64_t skippedKeys_ = 0;
+    Config config_;
+    mutable ImeShortcutTable* parkedShortcuts_ = nullptr;  // Shortcuts while evicted or remote
+    mutable std::shared_ptr<GoNhanh::EngineClient> remote_;  // Null: in-process
+    mutable uint32_t remoteId_ = 0;
+    ImeKeyEvent replay_[MAX_REPLAY_KEYS];  // Keys since the word began (no allocation per key)
+    uint8_t replayCount_ = 0;
+    std::string seed_;                     // Resumed text the keys continue (resumeWord)
+    bool replayable_ = true;               // replay_ + seed_ rebuild the word
 };
 
 #endif // GONHANH_RUST_BRIDGE_H
@@ -0,0 +1,334 @@
+#include "Settings.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+namespace GoNhanh {
+
+static std::string trim(const std::string& s) {
+    const char* ws = " \t\r";
+    size_t begin = s.find_first_not_of(ws);
+    if (begin == std::string::npos) return {};
+    size_t end = s.find_last_not_of(ws);
+    return s.substr(begin, end - begin + 1);
+}
+
+static std::optional<bool> parseOptionalBool(const std::string& value) {
+    if (value == "true" || value == "on" || value == "1") return true;
+    if (value == "false" || value == "off" || value == "0") return false;
+    return std::nullopt;
+}
+
+static bool parseBool(const std::string& value, bool fallback) {
+    return parseOptionalBool(value).value_or(fallback);
+}
+
+static uint32_t parseUint(const std::string& value, uint32_t fallback) {
+    if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) {
+        return fallback;
+    }
+    unsigned long n = std::strtoul(value.c_str(), nullptr, 10);
+    return n > UINT32_MAX ? fallback : static_cast<uint32_t>(n);
+}
+
+static std::optional<InputMethod> parseOptionalMethod(const std::string& value) {
+    if (value == "telex" || value == "Telex") return InputMethod::Telex;
+    if (value == "vni" || value == "VNI") return InputMethod::VNI;
+    return std::nullopt;
+}
+
+static InputMethod parseMethod(const std::string& value, InputMethod fallback) {
+    return parseOptionalMethod(value).value_or(fallback);
+}
+
+static std::optional<CompositionMode> parseMode(const std::string& value) {
+    if (value == "surrounding") return CompositionMode::Surrounding;
+    if (value == "preedit") return CompositionMode::Preedit;
+    return std::nullopt;
+}
+
+static std::vector<std::string> parseList(const std::string& value) {
+    std::vector<std::string> items;
+    size_t begin = 0;
+    while (begin <= value.size()) {
+        size_t end = value.find(',', begin);
+        if (end == std::string::npos) end = value.size();
+        std::string item = trim(value.substr(begin, end - begin));
+        if (!item.empty()) items.push_back(std::move(item));
+        begin = end + 1;
+    }
+    return items;
+}
+
+std::vector<std::string> Settings::defaultTerminalApps() {
+    return {
+        "gnome-terminal-server", "konsole", "xterm", "alacritty", "kitty",
+        "foot", "wezterm-gui", "tilix", "xfce4-terminal", "terminator",
+        "ptyxis", "ghostty",
+    };
+}
+
+bool AppProfile::operator==(const AppProfile& other) const {
+    return enabled == other.enabled &&
+           method == other.method &&
+           mode == other.mode &&
+           englishAutoRestore == other.englishAutoRestore;
+}
+
+bool Settings::operator==(const Settings& other) const {
+    return method == other.method &&
+           modern == other.modern &&
+           freeTone == other.freeTone &&
+           englishAutoRestore == other.englishAutoRestore &&
+           autoCapitalize == other.autoCapitalize &&
+           allowForeignConsonants == other.allowForeignConsonants &&
+           escRestore == other.escRestore &&
+           skipWShortcut == other.skipWShortcut &&
+           bracketShortcut == other.bracketShortcut &&
+           terminalApps == other.terminalApps &&
+           asyncCommit == other.asyncCommit &&
+           candidates == other.candidates &&
+           keepWarm == other.keepWarm &&
+           lockMemory == other.lockMemory &&
+           evictIdle == other.evictIdle &&
+           keyTrace == other.keyTrace &&
+           keyRecord == other.keyRecord &&
+           keyLogSample == other.keyLogSample &&
+           shortcuts == other.shortcuts &&
+           apps == other.apps;
+}
+
+bool Settings::isTerminal(const std::string& program) const {
+    for (const auto& app : terminalApps) {
+        if (app == program) return true;
+    }
+    return false;
+}
+
+ResolvedProfile Settings::profileFor(const std::string& program, bool preeditApp) const {
+    ResolvedProfile profile;
+    profile.method = method;
+    profile.englishAutoRestore = englishAutoRestore && !isTerminal(program);
+    profile.mode = preeditApp ? CompositionMode::Preedit : CompositionMode::Surrounding;
+
+    auto it = apps.find(program);
+    if (it != apps.end()) {
+        const AppProfile& app = it->second;
+        profile.enabled = app.enabled.value_or(profile.enabled);
+        profile.method = app.method.value_or(profile.method);
+        profile.mode = app.mode.value_or(profile.mode);
+        profile.englishAutoRestore = app.englishAutoRestore.value_or(profile.englishAutoRestore);
+    }
+    return profile;
+}
+
+void Settings::applyTo(RustEngine& engine, const ResolvedProfile& profile) const {
+    engine.setMethod(profile.method);
+    engine.setModern(modern);
+    engine.setFreeTone(freeTone);
+    engine.setEnglishAutoRestore(profile.englishAutoRestore);
+    engine.setAutoCapitalize(autoCapitalize);
+    engine.setAllowForeignConsonants(allowForeignConsonants);
+    engine.setEscRestore(escRestore);
+    engine.setSkipWShortcut(skipWShortcut);
+    engine.setBracketShortcut(bracketShortcut);
+}
+
+std::string configDir() {
+    const char* home = std::getenv("HOME");
+    if (!home) return {};
+    return std::string(home) + "/.config/gonhanh";
+}
+
+void parseSettings(std::istream& in, Settings& settings) {
+    std::string section;  // Empty for top-level keys
+    bool shortcutsSeen = false;
+    std::string line;
+
+    while (std::getline(in, line)) {
+        line = trim(line);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        if (line.front() == '[' && line.back() == ']') {
+            section = trim(line.substr(1, line.size() - 2));
+            continue;
+        }
+
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            continue;
+        }
+        std::string key = trim(line.substr(0, eq));
+        std::string value = trim(line.substr(eq + 1));
+
+        if (section == "shortcuts") {
+            // A shortcuts section replaces the previous list as a whole
+            if (!shortcutsSeen) {
+                settings.shortcuts.clear();
+                shortcutsSeen = true;
+            }
+            if (!key.empty() && !value.empty()) {
+                settings.shortcuts.emplace_back(std::move(key), std::move(value));
+            }
+        } else if (section.compare(0, 4, "app ") == 0) {
+            std::string program = trim(section.substr(4));
+            if (program.empty()) continue;
+            AppProfile& app = settings.apps[program];
+            if (key == "enabled") {
+                app.enabled = parseOptionalBool(value);
+            } else if (key == "method") {
+                app.method = parseOptionalMethod(value);
+            } else if (key == "composition") {
+                app.mode = parseMode(value);
+            } else if (key == "english_auto_restore") {
+                app.englishAutoRestore = parseOptionalBool(value);
+            }
+        } else if (!section.empty()) {
+            continue;  // Unknown section
+        } else if (key == "method") {
+            settings.method = parseMethod(value, settings.method);
+        } else if (key == "modern") {
+            settings.modern = parseBool(value, settings.modern);
+        } else if (key == "free_tone") {
+            settings.freeTone = parseBool(value, settings.freeTone);
+        } else if (key == "english_auto_restore") {
+            settings.englishAutoRestore = parseBool(value, settings.englishAutoRestore);
+        } else if (key == "auto_capitalize") {
+            settings.autoCapitalize = parseBool(value, settings.autoCapitalize);
+        } else if (key == "allow_foreign_consonants") {
+            settings.allowForeignConsonants = parseBool(value, settings.allowForeignConsonants);
+        } else if (key == "esc_restore") {
+            settings.escRestore = parseBool(value, settings.escRestore);
+        } else if (key == "skip_w_shortcut") {
+            settings.skipWShortcut = parseBool(value, settings.skipWShortcut);
+        } else if (key == "bracket_shortcut") {
+            settings.bracketShortcut = parseBool(value, settings.bracketShortcut);
+        } else if (key == "terminal_apps") {
+            settings.terminalApps = parseList(value);
+        } else if (key == "async_commit") {
+            settings.asyncCommit = parseBool(value, settings.asyncCommit);
+        } else if (key == "candidates") {
+            settings.candidates = std::min(parseUint(value, settings.candidates),
+                                           Settings::MAX_CANDIDATES);
+        } else if (key == "keep_warm") {
+            settings.keepWarm = parseBool(value, settings.keepWarm);
+        } else if (key == "lock_memory") {
+            settings.lockMemory = parseBool(value, settings.lockMemory);
+        } else if (key == "evict_idle") {
+            settings.evictIdle = std::min(parseUint(value, settings.evictIdle),
+                                          Settings::MAX_EVICT_IDLE);
+        } else if (key == "key_trace") {
+            settings.keyTrace = parseBool(value, settings.keyTrace);
+        } else if (key == "key_record") {
+            settings.keyRecord = parseBool(value, settings.keyRecord);
+        } else if (key == "key_log_sample") {
+            settings.keyLogSample = parseUint(value, settings.keyLogSample);
+        }
+    }
+}
+
+bool saveSettings(const std::string& dir, const Settings& settings) {
+    if (dir.empty()) return false;
+
+    auto flag = [](bool value) { return value ? "true" : "false"; };
+    std::string path = dir + "/settings";
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out) return false;
+
+        out << "method=" << (settings.method == InputMethod::VNI ? "vni" : "telex") << '\n'
+            << "modern=" << flag(settings.modern) << '\n'
+            << "free_tone=" << flag(settings.freeTone) << '\n'
+            << "english_auto_restore=" << flag(settings.englishAutoRestore) << '\n'
+            << "auto_capitalize=" << flag(settings.autoCapitalize) << '\n'
+            << "allow_foreign_consonants=" << flag(settings.allowForeignConsonants) << '\n'
+            << "esc_restore=" << flag(settings.escRestore) << '\n'
+            << "skip_w_shortcut=" << flag(settings.skipWShortcut) << '\n'
+            << "bracket_shortcut=" << flag(settings.bracketShortcut) << '\n'
+            << "terminal_apps=";
+        for (size_t i = 0; i < settings.terminalApps.size(); ++i) {
+            out << (i ? "," : "") << settings.terminalApps[i];
+        }
+        out << '\n'
+            << "async_commit=" << flag(settings.asyncCommit) << '\n'
+            << "candidates=" << settings.candidates << '\n'
+            << "keep_warm=" << flag(settings.keepWarm) << '\n'
+            << "lock_memory=" << flag(settings.lockMemory) << '\n'
+            << "evict_idle=" << settings.evictIdle << '\n'
+            << "key_trace=" << flag(settings.keyTrace) << '\n'
+            << "key_record=" << flag(settings.keyRecord) << '\n'
+            << "key_log_sample=" << settings.keyLogSample << '\n';
+
+        if (!settings.shortcuts.empty()) {
+            out << "\n[shortcuts]\n";
+            for (const auto& [trigger, replacement] : settings.shortcuts) {
+                out << trigger << '=' << replacement << '\n';
+            }
+        }
+        for (const auto& [program, app] : settings.apps) {
+            out << "\n[app " << program << "]\n";
+            if (app.enabled) out << "enabled=" << flag(*app.enabled) << '\n';
+            if (app.method) {
+                out << "method=" << (*app.method == InputMethod::VNI ? "vni" : "telex") << '\n';
+            }
+            if (app.mode) {
+                out << "composition="
+                    << (*app.mode == CompositionMode::Preedit ? "preedit" : "surrounding") << '\n';
+            }
+            if (app.englishAutoRestore) {
+                out << "english_auto_restore=" << flag(*app.englishAutoRestore) << '\n';
+            }
+        }
+        if (!out.flush()) return false;
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+Settings loadSettings(const std::string& dir) {
+    Settings settings;
+    if (dir.empty()) return settings;
+
+    std::ifstream methodFile(dir + "/method");
+    std::string method;
+    if (std::getline(methodFile, method)) {
+        settings.method = parseMethod(trim(method), settings.method);
+    }
+
+    std::ifstream file(dir + "/settings");
+    parseSettings(file, settings);
+    return settings;
+}
+
+ShortcutTable loadShortcuts(const std::string& dir, const Settings& settings) {
+    ShortcutTable table;
+    for (const auto& [trigger, replacement] : settings.shortcuts) {
+        table.add(trigger, replacement);
+    }
+    if (dir.empty()) return table;
+
+    int fd = open((dir + "/shortcuts").c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return table;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        size_t size = static_cast<size_t>(st.st_size);
+        void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            table.load(std::string_view(static_cast<const char*>(data), size));
+            munmap(data, size);
+        }
+    }
+    close(fd);
+    return table;
+}
+
+} // namespace GoNhanh
@@ -0,0 +1,150 @@
+#ifndef GONHANH_SETTINGS_H
+#define GONHANH_SETTINGS_H
+
+#include <istream>
+#include <map>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "RustBridge.h"
+
+namespace GoNhanh {
+
+// How transformations are applied to the client
+enum class CompositionMode : uint8_t {
+    Surrounding = 0,  // deleteSurroundingText + commitString on every key (default)
+    Preedit = 1       // keep current word in preedit, commit only on word break
+};
+
+// Per-application overrides from an `[app <program>]` section, keyed by
+// InputContext::program(). Unset fields follow the global settings.
+struct AppProfile {
+    std::optional<bool> enabled;
+    std::optional<InputMethod> method;
+    std::optional<CompositionMode> mode;
+    std::optional<bool> englishAutoRestore;
+
+    bool operator==(const AppProfile& other) const;
+    bool operator!=(const AppProfile& other) const { return !(*this == other); }
+};
+
+// Effective settings of one program (resolved once per input context)
+struct ResolvedProfile {
+    bool enabled = true;  // false: keys bypass the engine entirely
+    InputMethod method = InputMethod::Telex;
+    CompositionMode mode = CompositionMode::Surrounding;
+    bool englishAutoRestore = false;
+};
+
+// User settings from ~/.config/gonhanh/settings
+//
+// File format (key=value, '#' comments, shortcuts in their own section):
+//   method=telex
+//   modern=true
+//   free_tone=false
+//   english_auto_restore=false
+//   auto_capitalize=false
+//   allow_foreign_consonants=false
+//   esc_restore=false
+//   skip_w_shortcut=false
+//   bracket_shortcut=false
+//   terminal_apps=konsole,kitty
+//   async_commit=true
+//   candidates=0
+//   keep_warm=false
+//   lock_memory=false
+//   evict_idle=300
+//   key_trace=false
+//   key_record=false
+//   key_log_sample=1
+//
+//   [shortcuts]
+//   vn=Việt Nam
+//
+//   [app code]
+//   enabled=true
+//   method=vni
+//   composition=preedit
+//   english_auto_restore=false
+//
+// Defaults match the Rust core's Engine::new()
+struct Settings {
+    InputMethod method = InputMethod::Telex;
+    bool modern = true;
+    bool freeTone = false;
+    bool englishAutoRestore = false;
+    bool autoCapitalize = false;
+    bool allowForeignConsonants = false;
+    bool escRestore = false;
+    bool skipWShortcut = false;
+    bool bracketShortcut = false;
+    // Programs where English auto-restore is always off (shell input is
+    // mostly commands and paths, so per-key English validation is wasted)
+    std::vector<std::string> terminalApps = defaultTerminalApps();
+    // Apply edits on the next event loop iteration, merged per context
+    // (EditQueue) instead of inside keyEvent
+    bool asyncCommit = true;
+    // Word completions shown for the composing word (WordDict), 0 = off
+    uint32_t candidates = 0;
+    static constexpr uint32_t MAX_CANDIDATES = 9;
+    // On activate (and so focus-in), page the core's key path back in so the
+    // first key after an idle period does not pay for the page faults
+    bool keepWarm = false;
+    // Lock the core library's code and tables in memory (mlock)
+    bool lockMemory = false;
+    // Seconds without a key after which a context's engine is evicted to the
+    // keys that rebuild it (RustEngine::evict), 0 = never
+    uint32_t evictIdle = 300;
+    static constexpr uint32_t MAX_EVICT_IDLE = 86400;
+    // Record keys into the in-memory KeyTrace ring (password fields never are)
+    bool keyTrace = false;
+    // Record keys and results to the KeyRecorder ring file (same exclusions)
+    bool keyRecord = false;
+    // Builds with GONHANH_KEY_DEBUG_LOG: log 1 of every N keys (0 = none)
+    uint32_t keyLogSample = 1;
+    std::vector<std::pair<std::string, std::string>> shortcuts;
+    std::map<std::string, AppProfile> apps;  // Keyed by program name
+
+    static std::vector<std::string> defaultTerminalApps();
+
+    bool operator==(const Settings& other) const;
+    bool operator!=(const Settings& other) const { return !(*this == other); }
+
+    bool isTerminal(const std::string& program) const;
+
+    // Global settings, then terminalApps (no auto-restore), then
+    // `preeditApp` (the preedit-apps file), then the program's [app] section
+    ResolvedProfile profileFor(const std::string& program, bool preeditApp = false) const;
+
+    // Apply to an engine instance (settings only - buffer is kept)
+    // `profile` provides the method and auto-restore of the engine's program.
+    // Shortcuts are installed separately (see loadShortcuts).
+    void applyTo(RustEngine& engine, const ResolvedProfile& profile) const;
+    void applyTo(RustEngine& engine) const { applyTo(engine, profileFor({})); }
+};
+
+// Config directory (~/.config/gonhanh), empty if HOME is unset
+std::string configDir();
+
+// Parse settings text into `settings`: keys present override its values,
+// unknown keys and malformed lines are ignored
+void parseSettings(std::istream& in, Settings& settings);
+
+// Write `settings` to `dir`/settings (atomic replace)
+// Returns: false if the file could not be written
+bool saveSettings(const std::string& dir, const Settings& settings);
+
+// Load settings from `dir`. The legacy `method` file (written by older
+// gn versions) is read first; `settings` overrides it.
+Settings loadSettings(const std::string& dir);
+
+// Compile the [shortcuts] section of `settings` and the shortcut file
+// `dir`/shortcuts (trigger=replacement lines, memory-mapped and parsed in
+// place) into one table; file entries override the section.
+ShortcutTable loadShortcuts(const std::string& dir, const Settings& settings);
+
+} // namespace GoNhanh
+
+#endif // GONHANH_SETTINGS_H
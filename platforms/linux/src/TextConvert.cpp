@@ -0,0 +1,263 @@
+// gonhanh-convert: convert text typed with Telex/VNI keys into Vietnamese
+//
+//   gonhanh-convert [--settings DIR] [--method telex|vni] [--threads N]
+//                   [--output FILE] [--stats] [file...]
+//
+// Converts each file (stdin if none, or "-") as if every byte were typed
+// into a fresh window with the settings in DIR (default ~/.config/gonhanh),
+// --method overriding theirs; see TextConverter for what counts as a word.
+// Regular files are memory-mapped; stdin, pipes and other files are read in
+// blocks cut after the last word break. An output that is also an input is
+// refused. Output goes to stdout (or FILE) with writev straight from the
+// input and the converter's buffers. --stats prints bytes/s to stderr.
+//
+// Exit status: 0 on success, 1 if an input cannot be read or the output
+// cannot be written, 2 on bad usage (including --output naming an input).
+
+#include "Settings.h"
+#include "TextConverter.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace GoNhanh;
+
+namespace {
+
+struct Options {
+    std::string settingsDir = configDir();
+    std::optional<InputMethod> method;
+    size_t threads = 0;  // One per CPU
+    const char* output = nullptr;
+    bool stats = false;
+    std::vector<const char*> inputs;
+};
+
+// Streams (stdin, pipes) are converted a block at a time
+constexpr size_t STREAM_BLOCK = 16 << 20;
+
+bool parseArgs(int argc, char** argv, Options& opts) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (arg[0] != '-' || std::strcmp(arg, "-") == 0) {
+            opts.inputs.push_back(arg);
+            continue;
+        }
+        if (std::strcmp(arg, "--stats") == 0) {
+            opts.stats = true;
+            continue;
+        }
+        const char* value = i + 1 < argc ? argv[++i] : nullptr;
+        if (!value) {
+            return false;
+        }
+        if (std::strcmp(arg, "--settings") == 0) {
+            opts.settingsDir = value;
+        } else if (std::strcmp(arg, "--threads") == 0) {
+            opts.threads = std::strtoull(value, nullptr, 10);
+        } else if (std::strcmp(arg, "--output") == 0) {
+            opts.output = value;
+        } else if (std::strcmp(arg, "--method") == 0 && std::strcmp(value, "telex") == 0) {
+            opts.method = InputMethod::Telex;
+        } else if (std::strcmp(arg, "--method") == 0 && std::strcmp(value, "vni") == 0) {
+            opts.method = InputMethod::VNI;
+        } else {
+            return false;
+        }
+    }
+    if (opts.inputs.empty()) {
+        opts.inputs.push_back("-");
+    }
+    return true;
+}
+
+// Write every piece, IOV_MAX at a time, resuming after short writes
+bool writePieces(int fd, const std::string_view* pieces, size_t n) {
+    struct iovec iov[IOV_MAX];
+    size_t next = 0;
+    size_t skip = 0;  // Bytes of pieces[next] already written
+    while (next < n) {
+        int count = 0;
+        for (size_t i = next; i < n && count < IOV_MAX; ++i, ++count) {
+            size_t offset = i == next ? skip : 0;
+            iov[count].iov_base = const_cast<char*>(pieces[i].data() + offset);
+            iov[count].iov_len = pieces[i].size() - offset;
+        }
+        ssize_t written = writev(fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        size_t left = static_cast<size_t>(written);
+        while (next < n && left >= pieces[next].size() - skip) {
+            left -= pieces[next].size() - skip;
+            skip = 0;
+            ++next;
+        }
+        skip += left;
+    }
+    return true;
+}
+
+// Convert what `fd` reads, a block at a time; the word a block ends in
+// moves to the next
+bool convertStream(TextConverter& converter, int fd, const TextConverter::Sink& sink,
+                   size_t& bytes) {
+    std::string block(STREAM_BLOCK, '\0');
+    size_t filled = 0;
+    bool eof = false;
+    while (!eof || filled > 0) {
+        while (!eof && filled < block.size()) {
+            ssize_t got = read(fd, &block[filled], block.size() - filled);
+            if (got < 0 && errno == EINTR) continue;
+            if (got < 0) return false;
+            eof = got == 0;
+            filled += static_cast<size_t>(got);
+        }
+        // Cut after the last gap byte (a word longer than a block is cut anyway)
+        size_t cut = filled;
+        if (!eof) {
+            while (cut > 0 && TextConverter::wordLength(&block[cut - 1], 1) == 1) {
+                --cut;
+            }
+            if (cut == 0) cut = filled;
+        }
+        if (!converter.convert(std::string_view(block.data(), cut), sink)) {
+            return false;
+        }
+        bytes += cut;
+        block.erase(0, cut);
+        filled -= cut;
+        block.resize(STREAM_BLOCK);
+    }
+    return true;
+}
+
+// Map a regular file; anything else (a pipe, a tty, /proc, whose size says
+// nothing) is read as a stream
+bool convertFile(TextConverter& converter, const char* path, const TextConverter::Sink& sink,
+                 size_t& bytes) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    if (!S_ISREG(st.st_mode) || size == 0) {
+        bool ok = convertStream(converter, fd, sink, bytes);
+        close(fd);
+        return ok;
+    }
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+    madvise(map, size, MADV_SEQUENTIAL);
+    bool ok = converter.convert(std::string_view(static_cast<const char*>(map), size), sink);
+    munmap(map, size);
+    bytes += size;
+    return ok;
+}
+
+// Whether `output` is one of the inputs, which opening it would truncate
+// before it is read
+bool outputIsInput(const Options& opts) {
+    struct stat out;
+    if (!opts.output || stat(opts.output, &out) != 0 || !S_ISREG(out.st_mode)) {
+        return false;
+    }
+    for (const char* input : opts.inputs) {
+        struct stat in;
+        bool isStdin = std::strcmp(input, "-") == 0;
+        if ((isStdin ? fstat(STDIN_FILENO, &in) : stat(input, &in)) == 0 &&
+            in.st_dev == out.st_dev && in.st_ino == out.st_ino) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opts;
+    if (!parseArgs(argc, argv, opts)) {
+        std::fprintf(stderr,
+                     "usage: %s [--settings DIR] [--method telex|vni] [--threads N] "
+                     "[--output FILE] [--stats] [file...]\n",
+                     argv[0]);
+        return 2;
+    }
+
+    if (outputIsInput(opts)) {
+        std::fprintf(stderr, "%s is also an input\n", opts.output);
+        return 2;
+    }
+    int out = STDOUT_FILENO;
+    if (opts.output) {
+        out = open(opts.output, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (out < 0) {
+            std::fprintf(stderr, "cannot write %s\n", opts.output);
+            return 1;
+        }
+    }
+    std::signal(SIGPIPE, SIG_IGN);  // A closed pipe is a write error, not a kill
+
+    Settings settings = loadSettings(opts.settingsDir);
+    RustBridge::warmUp();  // Dictionaries once, before the workers need them
+    TextConverter converter(opts.threads, [&](RustEngine& engine) {
+        settings.applyTo(engine);
+        if (opts.method) {
+            engine.setMethod(*opts.method);
+        }
+    });
+
+    bool writeFailed = false;
+    TextConverter::Sink sink = [&](const std::string_view* pieces, size_t n) {
+        writeFailed = !writePieces(out, pieces, n);
+        return !writeFailed;
+    };
+
+    size_t bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const char* input : opts.inputs) {
+        bool isStdin = std::strcmp(input, "-") == 0;
+        bool ok = isStdin ? convertStream(converter, STDIN_FILENO, sink, bytes)
+                          : convertFile(converter, input, sink, bytes);
+        if (writeFailed) {
+            std::fprintf(stderr, "cannot write %s\n", opts.output ? opts.output : "stdout");
+            return 1;
+        }
+        if (!ok) {
+            std::fprintf(stderr, "cannot read %s\n", isStdin ? "stdin" : input);
+            return 1;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (opts.output && close(out) != 0) {
+        std::fprintf(stderr, "cannot write %s\n", opts.output);
+        return 1;
+    }
+    if (opts.stats) {
+        std::fprintf(stderr, "%zu bytes in %.3f s: %.1f MB/s on %zu threads\n", bytes, seconds,
+                     seconds > 0 ? bytes / seconds / 1e6 : 0.0, converter.threads());
+    }
+    return 0;
+}
@@ -0,0 +1,460 @@
+#include "TextConverter.h"
+#include "KeycodeMap.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace GoNhanh {
+
+// Bytes of typed text as keys: printable ASCII is its own keysym, so the
+// word/gap split is KeycodeMap's break and unknown classes
+namespace {
+
+struct ByteTable {
+    bool word[256];          // Neither a break key nor unknown (not a key)
+    ImeKeyEvent key[128];    // Engine event of a word byte
+};
+
+constexpr ByteTable makeByteTable() {
+    ByteTable table{};
+    for (unsigned c = 0x20; c < 0x7F; ++c) {
+        auto info = KeycodeMap::lookup(c);
+        if (info.isBreak() || info.isUnknown()) {
+            continue;
+        }
+        // Shifted digits (!@#...) are typed with Shift, like capitals
+        bool upper = info.isUpper();
+        bool symbol = !info.isLetter() && !info.isNumber();
+        table.word[c] = true;
+        table.key[c] = ImeKeyEvent{info.keycode(), upper, false, upper || symbol, 0};
+    }
+    return table;
+}
+
+constexpr ByteTable BYTES = makeByteTable();
+
+static_assert(BYTES.word['a'] && BYTES.word['Z'] && BYTES.word['7'] && BYTES.word['^'],
+              "letters, digits and shifted digits are word bytes");
+static_assert(!BYTES.word[' '] && !BYTES.word['\n'] && !BYTES.word['_'] && !BYTES.word[0x7F] &&
+              !BYTES.word[0xC3], "breaks and non-keys end words");
+
+#if defined(__SSE2__)
+// Word bytes of 16 at p as a bitmask. The ranges are BYTES.word spelled out
+// (TextConverterTest checks every byte); bytes >= 0x80 compare negative.
+inline uint32_t wordMask(const char* p) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    auto range = [v](char lo, char hi) {
+        return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(static_cast<char>(lo - 1))),
+                             _mm_cmplt_epi8(v, _mm_set1_epi8(static_cast<char>(hi + 1))));
+    };
+    __m128i word = _mm_or_si128(
+        _mm_or_si128(_mm_or_si128(range('!', '!'), range('#', '&')),
+                     _mm_or_si128(range('(', '*'), range('0', '9'))),
+        _mm_or_si128(_mm_or_si128(range('@', 'Z'), range('^', '^')), range('a', 'z')));
+    return static_cast<uint32_t>(_mm_movemask_epi8(word));
+}
+#endif
+
+// Converted words. A word's conversion depends only on its keys (the
+// engine is reset before each), so text repeating its words mostly skips
+// the core.
+// Open addressing, doubled as it fills up to `maxSlots`; full at that size
+// (or `maxBytes` of words and text), it starts over.
+class WordCache {
+public:
+    static constexpr size_t MIN_SLOTS = 1 << 12;
+    static constexpr size_t MAX_WORD = 32;  // Longer words are not cached
+
+    explicit WordCache(size_t maxSlots, size_t maxBytes)
+        : maxSlots_(maxSlots), maxBytes_(maxBytes) {}
+
+    static uint64_t hash(std::string_view word) {
+        uint64_t h = 14695981039346656037ull;  // FNV-1a
+        for (char c : word) {
+            h = (h ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+        }
+        return h;
+    }
+
+    // Returns: false if `word` is not cached; else `same` if it converts to
+    // itself, otherwise its conversion in `text`
+    bool find(std::string_view word, uint64_t hash, bool& same, std::string_view& text) const {
+        for (size_t i = hash & mask(); entries_[i].wordLength; i = (i + 1) & mask()) {
+            const Entry& e = entries_[i];
+            if (e.hash == tag(hash) && e.wordLength == word.size() &&
+                std::memcmp(bytes_.data() + e.offset, word.data(), word.size()) == 0) {
+                same = e.same;
+                text = std::string_view(bytes_.data() + e.offset + e.wordLength, e.textLength);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool contains(std::string_view word, uint64_t hash) const {
+        bool same;
+        std::string_view text;
+        return find(word, hash, same, text);
+    }
+
+    // `word` must not be cached yet; `text` must not point into this cache
+    // Returns: the cached copy of `text`
+    std::string_view insert(std::string_view word, uint64_t hash, bool same,
+                            std::string_view text) {
+        if (same) {
+            text = {};
+        }
+        if (text.size() > UINT16_MAX) {
+            return text;
+        }
+        if (count_ + 1 > entries_.size() * 3 / 4) {
+            grow();
+        }
+        if (bytes_.size() + word.size() + text.size() > maxBytes_) {
+            entries_.assign(entries_.size(), Entry{});
+            bytes_.clear();
+            count_ = 0;
+        }
+        place({tag(hash), static_cast<uint32_t>(bytes_.size()), static_cast<uint16_t>(word.size()),
+               static_cast<uint16_t>(text.size()), same},
+              hash);
+        bytes_.append(word);
+        bytes_.append(text);
+        ++count_;
+        return std::string_view(bytes_).substr(bytes_.size() - text.size());
+    }
+
+private:
+    struct Entry {
+        uint32_t hash = 0;         // High bits (the low ones pick the slot)
+        uint32_t offset = 0;       // Word, then text, in bytes_
+        uint16_t wordLength = 0;   // 0 = empty slot
+        uint16_t textLength = 0;
+        bool same = false;
+    };
+
+    static uint32_t tag(uint64_t hash) { return static_cast<uint32_t>(hash >> 32); }
+    size_t mask() const { return entries_.size() - 1; }
+
+    void place(const Entry& entry, uint64_t hash) {
+        size_t i = hash & mask();
+        while (entries_[i].wordLength) {
+            i = (i + 1) & mask();
+        }
+        entries_[i] = entry;
+    }
+
+    void grow() {
+        if (entries_.size() >= maxSlots_) {
+            entries_.assign(entries_.size(), Entry{});
+            bytes_.clear();
+            count_ = 0;
+            return;
+        }
+        std::vector<Entry> old(entries_.size() * 2);
+        old.swap(entries_);
+        for (const Entry& e : old) {
+            if (e.wordLength) {
+                place(e, hash(std::string_view(bytes_.data() + e.offset, e.wordLength)));
+            }
+        }
+    }
+
+    size_t maxSlots_;
+    size_t maxBytes_;
+    std::vector<Entry> entries_ = std::vector<Entry>(MIN_SLOTS);
+    size_t count_ = 0;
+    std::string bytes_;
+};
+
+} // namespace
+
+// Each worker keeps its hot words (up to 5 MiB) in front of the cache of
+// all its converter's workers, so a word goes through the core about once
+// however many threads see it
+struct TextConverter::Worker {
+    RustEngine engine;
+    WordCache cache{1 << 16, 4 << 20};
+    std::vector<ImeKeyEvent> events;
+};
+
+// Up to 16 shards x 5 MiB (786k words)
+struct TextConverter::SharedWords {
+    static constexpr size_t SHARDS = 16;
+
+    struct Shard {
+        std::mutex mutex;
+        WordCache cache{1 << 16, 4 << 20};
+    };
+
+    Shard& shard(uint64_t hash) { return shards[(hash >> 28) & (SHARDS - 1)]; }
+
+    Shard shards[SHARDS];
+};
+
+// One chunk's output: spans of the input (runs the engine left as they
+// were) and of `text` (converted words, and runs too short to be worth a
+// piece of their own), turned into pieces once `text` is final
+struct TextConverter::Output {
+    static constexpr size_t MIN_SHARED = 256;  // Shorter runs are copied
+
+    struct Span {
+        bool converted;   // In `text`, else in the input
+        size_t offset;
+        size_t length;
+    };
+
+    std::string_view in;
+    std::string text;
+    std::vector<Span> spans;
+    std::vector<std::string_view> pieces;
+    bool ready = false;  // Converted, not yet given to the sink
+
+    void clear(std::string_view input) {
+        in = input;
+        text.clear();
+        spans.clear();
+        pieces.clear();
+        runLength_ = 0;
+    }
+
+    // Bytes at `offset` are output as they are (always right after the last)
+    void unchanged(size_t offset, size_t length) {
+        if (!runLength_) {
+            runOffset_ = offset;
+        }
+        runLength_ += length;
+    }
+
+    void converted(std::string_view word) {
+        placeRun();
+        append(word);
+    }
+
+    void finish() {
+        placeRun();
+        for (const Span& span : spans) {
+            pieces.push_back(span.converted ? std::string_view(text).substr(span.offset, span.length)
+                                            : in.substr(span.offset, span.length));
+        }
+    }
+
+private:
+    void append(std::string_view bytes) {
+        if (!spans.empty() && spans.back().converted) {
+            spans.back().length += bytes.size();
+        } else {
+            spans.push_back({true, text.size(), bytes.size()});
+        }
+        text.append(bytes);
+    }
+
+    void placeRun() {
+        if (runLength_ >= MIN_SHARED) {
+            spans.push_back({false, runOffset_, runLength_});
+        } else if (runLength_) {
+            append(in.substr(runOffset_, runLength_));
+        }
+        runLength_ = 0;
+    }
+
+    size_t runOffset_ = 0;
+    size_t runLength_ = 0;  // Unchanged bytes not placed yet
+};
+
+size_t TextConverter::wordLength(const char* p, size_t n) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= n; i += 16) {
+        uint32_t gap = ~wordMask(p + i) & 0xFFFF;
+        if (gap) {
+            return i + __builtin_ctz(gap);
+        }
+    }
+#endif
+    while (i < n && BYTES.word[static_cast<uint8_t>(p[i])]) {
+        ++i;
+    }
+    return i;
+}
+
+size_t TextConverter::gapLength(const char* p, size_t n) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= n; i += 16) {
+        uint32_t word = wordMask(p + i);
+        if (word) {
+            return i + __builtin_ctz(word);
+        }
+    }
+#endif
+    while (i < n && !BYTES.word[static_cast<uint8_t>(p[i])]) {
+        ++i;
+    }
+    return i;
+}
+
+TextConverter::TextConverter(size_t threads, const std::function<void(RustEngine&)>& setup)
+    : shared_(std::make_unique<SharedWords>()) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+        if (setup) {
+            setup(workers_.back()->engine);
+        }
+    }
+}
+
+TextConverter::~TextConverter() = default;
+
+void TextConverter::convertChunk(Worker& worker, std::string_view text, size_t begin, size_t end,
+                                 Output& out) {
+    out.clear(text);
+    const char* data = text.data();
+    size_t pos = begin;
+    while (pos < end) {
+        size_t gap = gapLength(data + pos, end - pos);
+        if (gap) {
+            out.unchanged(pos, gap);
+            pos += gap;
+            continue;
+        }
+        size_t length = wordLength(data + pos, end - pos);
+        std::string_view word(data + pos, length);
+        bool cacheable = length <= WordCache::MAX_WORD;
+        uint64_t hash = cacheable ? WordCache::hash(word) : 0;
+        bool same = false;
+        std::string_view cached;
+        bool found = cacheable && worker.cache.find(word, hash, same, cached);
+        if (cacheable && !found) {
+            auto& shard = shared_->shard(hash);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if ((found = shard.cache.find(word, hash, same, cached))) {
+                cached = worker.cache.insert(word, hash, same, cached);
+            }
+        }
+        if (found) {
+            same ? out.unchanged(pos, length) : out.converted(cached);
+            pos += length;
+            continue;
+        }
+
+        worker.events.clear();
+        for (char c : word) {
+            worker.events.push_back(BYTES.key[static_cast<uint8_t>(c)]);
+        }
+        worker.engine.clearAll();  // What the core keeps past clear() would make
+                                   // a word's output depend on the one before
+        BatchOutput result = worker.engine.processKeys(worker.events.data(), length);
+        // Word bytes are all batchable and the word starts empty; keep the
+        // typed text if the core says otherwise
+        same = result.consumed != length || result.backspace != 0 || result.text == word;
+        same ? out.unchanged(pos, length) : out.converted(result.text);
+        if (cacheable) {
+            worker.cache.insert(word, hash, same, result.text);
+            auto& shard = shared_->shard(hash);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if (!shard.cache.contains(word, hash)) {  // Another worker may have raced us
+                shard.cache.insert(word, hash, same, result.text);
+            }
+        }
+        pos += length;
+    }
+    out.finish();
+}
+
+bool TextConverter::convert(std::string_view text, const Sink& sink) {
+    // A chunk every CHUNK_BYTES, extended to the end of the word there
+    std::vector<size_t> bounds{0};
+    while (bounds.back() < text.size()) {
+        size_t at = std::min(bounds.back() + CHUNK_BYTES, text.size());
+        bounds.push_back(at + wordLength(text.data() + at, text.size() - at));
+    }
+    size_t chunks = bounds.size() - 1;
+    size_t threads = std::min(workers_.size(), chunks);
+
+    if (threads <= 1) {
+        Output out;
+        for (size_t i = 0; i < chunks; ++i) {
+            convertChunk(*workers_[0], text, bounds[i], bounds[i + 1], out);
+            if (!sink(out.pieces.data(), out.pieces.size())) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Workers take chunks in order, at most `window` ahead of the sink;
+    // chunk i only ever goes to window[i % window.size()]
+    std::vector<Output> window(2 * threads);
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t next = 0;
+    size_t emitted = 0;
+    bool stop = false;
+
+    auto work = [&](Worker& worker) {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            changed.wait(lock, [&] {
+                return stop || next >= chunks || next < emitted + window.size();
+            });
+            if (stop || next >= chunks) {
+                return;
+            }
+            size_t i = next++;
+            Output& out = window[i % window.size()];
+            lock.unlock();
+            convertChunk(worker, text, bounds[i], bounds[i + 1], out);
+            lock.lock();
+            out.ready = true;
+            changed.notify_all();
+        }
+    };
+    std::vector<std::thread> pool;
+    for (size_t t = 0; t < threads; ++t) {
+        pool.emplace_back(work, std::ref(*workers_[t]));
+    }
+
+    bool completed = true;
+    for (size_t i = 0; i < chunks && completed; ++i) {
+        Output& out = window[i % window.size()];
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&] { return out.ready; });
+        }
+        completed = sink(out.pieces.data(), out.pieces.size());
+        std::lock_guard<std::mutex> lock(mutex);
+        out.ready = false;
+        ++emitted;
+        stop = !completed;
+        changed.notify_all();
+    }
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    return completed;
+}
+
+std::string TextConverter::convert(std::string_view text) {
+    std::string result;
+    result.reserve(text.size() + text.size() / 4);
+    convert(text, [&result](const std::string_view* pieces, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            result.append(pieces[i]);
+        }
+        return true;
+    });
+    return result;
+}
+
+} // namespace GoNhanh
@@ -0,0 +1,72 @@
+#ifndef GONHANH_TEXT_CONVERTER_H
+#define GONHANH_TEXT_CONVERTER_H
+
+// Bulk conversion of text typed with the method's keys ("vieetj" -> "việt"):
+// chat exports, legacy documents, anything typed without the IME. Each
+// byte is a key. Words are the runs between break keys
+// (KeycodeMap::isBreakKey) and bytes that are not keys (UTF-8 text, control
+// characters); those are copied as they are and end the word, as a break
+// key does in the addon. Each word is typed into a reset engine (clearAll),
+// so it converts the same wherever it appears. Shortcuts are not expanded
+// (they fire on a break key, which never reaches the core).
+//
+// The input is cut into chunks at word ends, converted on `threads` engines
+// and handed out in input order. Output pieces point into the input for
+// text the engine leaves as it is, so mostly-unchanged text is not copied.
+
+#include "RustBridge.h"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace GoNhanh {
+
+class TextConverter {
+public:
+    // Input bytes per unit of work
+    static constexpr size_t CHUNK_BYTES = 256 * 1024;
+
+    // Receives one chunk's output: `n` pieces, valid until it returns.
+    // Returns: false to stop converting
+    using Sink = std::function<bool(const std::string_view* pieces, size_t n)>;
+
+    // `threads` engines (0: one per CPU), each configured by `setup`
+    // (settings, method) before any conversion
+    explicit TextConverter(size_t threads = 0,
+                           const std::function<void(RustEngine&)>& setup = {});
+    ~TextConverter();
+
+    TextConverter(const TextConverter&) = delete;
+    TextConverter& operator=(const TextConverter&) = delete;
+
+    // Convert `text`, chunk by chunk, into `sink` (called on this thread)
+    // Returns: false if the sink stopped it
+    bool convert(std::string_view text, const Sink& sink);
+    std::string convert(std::string_view text);
+
+    size_t threads() const { return workers_.size(); }
+
+    // Bytes at the start of [p, p + n) that belong to a word / to the gap
+    // between words (SSE2 where available, 16 bytes per step)
+    static size_t wordLength(const char* p, size_t n);
+    static size_t gapLength(const char* p, size_t n);
+
+private:
+    struct Worker;
+    struct SharedWords;
+    struct Output;
+
+    void convertChunk(Worker& worker, std::string_view text, size_t begin, size_t end,
+                      Output& out);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::unique_ptr<SharedWords> shared_;
+};
+
+} // namespace GoNhanh
+
+#endif // GONHANH_TEXT_CONVERTER_H
@@ -0,0 +1,411 @@
+#include "WordDict.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+
+namespace GoNhanh {
+
+// =============================================================================
+// Vietnamese letters
+// =============================================================================
+
+enum Mark : uint8_t { NO_MARK = 0, BREVE, CIRCUMFLEX, HORN, STROKE };
+
+// 12 vowel groups x 6 tones (none, huyền, sắc, hỏi, ngã, nặng)
+static constexpr char32_t VOWELS_LOWER[] =
+    U"aàáảãạăằắẳẵặâầấẩẫậeèéẻẽẹêềếểễệiìíỉĩịoòóỏõọôồốổỗộơờớởỡợuùúủũụưừứửữựyỳýỷỹỵ";
+static constexpr char32_t VOWELS_UPPER[] =
+    U"AÀÁẢÃẠĂẰẮẲẴẶÂẦẤẨẪẬEÈÉẺẼẸÊỀẾỂỄỆIÌÍỈĨỊOÒÓỎÕỌÔỒỐỔỖỘƠỜỚỞỠỢUÙÚỦŨỤƯỪỨỬỮỰYỲÝỶỸỴ";
+static constexpr size_t VOWEL_COUNT = 72;
+static constexpr char GROUP_BASE[] = "aaaeeiooouuy";
+static constexpr Mark GROUP_MARK[] = {NO_MARK, BREVE, CIRCUMFLEX, NO_MARK, CIRCUMFLEX, NO_MARK,
+                                      NO_MARK, CIRCUMFLEX, HORN, NO_MARK, HORN, NO_MARK};
+
+struct Letter {
+    char base = 0;      // Folded ASCII letter, 0 if not a letter
+    Mark mark = NO_MARK;
+    uint8_t tone = 0;   // 0 = none
+    bool upper = false;
+};
+
+static Letter decompose(char32_t cp) {
+    if (cp < 0x80) {
+        char c = static_cast<char>(cp);
+        if (c >= 'a' && c <= 'z') return {c, NO_MARK, 0, false};
+        if (c >= 'A' && c <= 'Z') return {static_cast<char>(c - 'A' + 'a'), NO_MARK, 0, true};
+        return {};
+    }
+    if (cp == U'đ') return {'d', STROKE, 0, false};
+    if (cp == U'Đ') return {'d', STROKE, 0, true};
+    for (size_t i = 0; i < VOWEL_COUNT; ++i) {
+        if (VOWELS_LOWER[i] == cp || VOWELS_UPPER[i] == cp) {
+            return {GROUP_BASE[i / 6], GROUP_MARK[i / 6], static_cast<uint8_t>(i % 6),
+                    VOWELS_UPPER[i] == cp};
+        }
+    }
+    return {};
+}
+
+static char32_t toUpper(char32_t cp) {
+    if (cp >= 'a' && cp <= 'z') return cp - 'a' + 'A';
+    if (cp == U'đ') return U'Đ';
+    for (size_t i = 0; i < VOWEL_COUNT; ++i) {
+        if (VOWELS_LOWER[i] == cp) return VOWELS_UPPER[i];
+    }
+    return cp;
+}
+
+static char32_t toLower(char32_t cp) {
+    if (cp >= 'A' && cp <= 'Z') return cp - 'A' + 'a';
+    if (cp == U'Đ') return U'đ';
+    for (size_t i = 0; i < VOWEL_COUNT; ++i) {
+        if (VOWELS_UPPER[i] == cp) return VOWELS_LOWER[i];
+    }
+    return cp;
+}
+
+// Decode the codepoint at s[i] and advance i (invalid bytes decode as themselves)
+static char32_t nextCodepoint(std::string_view s, size_t& i) {
+    unsigned char c = static_cast<unsigned char>(s[i++]);
+    int extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+    char32_t cp = extra ? c & (0x3F >> extra) : c;
+    for (; extra > 0 && i < s.size(); --extra) {
+        cp = (cp << 6) | (static_cast<unsigned char>(s[i++]) & 0x3F);
+    }
+    return cp;
+}
+
+static void appendUtf8(std::string& out, char32_t cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+// Fold `text` into out[0..cap); other characters are kept as UTF-8
+// Returns: folded length, or SIZE_MAX if it does not fit
+static size_t foldInto(std::string_view text, char* out, size_t cap) {
+    size_t len = 0;
+    for (size_t i = 0; i < text.size();) {
+        size_t start = i;
+        Letter letter = decompose(nextCodepoint(text, i));
+        size_t bytes = letter.base ? 1 : i - start;
+        if (len + bytes > cap) return SIZE_MAX;
+        if (letter.base) {
+            out[len] = letter.base;
+        } else {
+            std::memcpy(out + len, text.data() + start, bytes);
+        }
+        len += bytes;
+    }
+    return len;
+}
+
+std::string WordDict::fold(std::string_view text) {
+    std::string out(text.size(), '\0');
+    out.resize(foldInto(text, out.data(), out.size()));
+    return out;
+}
+
+std::string WordDict::matchCase(std::string_view word, std::string_view typed) {
+    size_t letters = 0;
+    size_t uppers = 0;
+    bool firstUpper = false;
+    for (size_t i = 0; i < typed.size();) {
+        Letter letter = decompose(nextCodepoint(typed, i));
+        if (!letter.base) continue;
+        firstUpper |= letters == 0 && letter.upper;
+        ++letters;
+        uppers += letter.upper;
+    }
+    bool allCaps = letters >= 2 && uppers == letters;
+    if (!firstUpper) {
+        return std::string(word);
+    }
+
+    std::string out;
+    out.reserve(word.size());
+    for (size_t i = 0; i < word.size();) {
+        char32_t cp = nextCodepoint(word, i);
+        appendUtf8(out, allCaps || out.empty() ? toUpper(cp) : cp);
+    }
+    return out;
+}
+
+// Typed marks match position by position; a typed tone must be the tone of
+// the word's first syllable (the engine may place it on another vowel)
+static bool diacriticsMatch(std::string_view typed, std::string_view word) {
+    uint8_t typedTone = 0;
+    size_t w = 0;
+    for (size_t t = 0; t < typed.size() && w < word.size();) {
+        Letter a = decompose(nextCodepoint(typed, t));
+        Letter b = decompose(nextCodepoint(word, w));
+        if (a.mark != NO_MARK && a.mark != b.mark) return false;
+        if (a.tone) typedTone = a.tone;
+    }
+    if (!typedTone) return true;
+
+    uint8_t wordTone = 0;
+    for (size_t i = 0; i < word.size() && word[i] != ' ';) {
+        Letter letter = decompose(nextCodepoint(word, i));
+        if (letter.tone) wordTone = letter.tone;
+    }
+    return wordTone == typedTone;
+}
+
+// `typed` is `word` apart from case (the candidate adds nothing)
+static bool equalsIgnoringCase(std::string_view typed, std::string_view word) {
+    size_t t = 0;
+    size_t w = 0;
+    while (t < typed.size() && w < word.size()) {
+        if (toLower(nextCodepoint(typed, t)) != nextCodepoint(word, w)) return false;
+    }
+    return t == typed.size() && w == word.size();
+}
+
+// =============================================================================
+// Compiled image
+// =============================================================================
+
+std::string WordDict::compile(std::string_view lines) {
+    std::map<std::string, uint32_t> counts;
+    while (!lines.empty()) {
+        size_t eol = lines.find('\n');
+        std::string_view line = lines.substr(0, eol);
+        lines = eol == std::string_view::npos ? std::string_view() : lines.substr(eol + 1);
+
+        uint32_t count = 1;
+        size_t tab = line.find('\t');
+        if (tab != std::string_view::npos) {
+            count = static_cast<uint32_t>(std::strtoul(std::string(line.substr(tab + 1)).c_str(), nullptr, 10));
+            line = line.substr(0, tab);
+        }
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) line.remove_suffix(1);
+        while (!line.empty() && line.front() == ' ') line.remove_prefix(1);
+        if (line.empty() || line.front() == '#') continue;
+
+        uint32_t& slot = counts[std::string(line)];
+        slot = std::max(slot, count);
+    }
+
+    struct Entry {
+        std::string key;
+        const std::string* text;
+        uint32_t freq;
+    };
+    std::vector<Entry> entries;
+    entries.reserve(counts.size());
+    for (const auto& [text, freq] : counts) {
+        entries.push_back({fold(text), &text, freq});
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.key != b.key ? a.key < b.key : *a.text < *b.text;
+    });
+
+    uint32_t n = static_cast<uint32_t>(entries.size());
+    std::vector<uint32_t> keyOffsets{0}, textOffsets{0}, freq, tree(2 * n);
+    std::string keys, text;
+    for (uint32_t i = 0; i < n; ++i) {
+        keys += entries[i].key;
+        text += *entries[i].text;
+        keyOffsets.push_back(static_cast<uint32_t>(keys.size()));
+        textOffsets.push_back(static_cast<uint32_t>(text.size()));
+        freq.push_back(entries[i].freq);
+        tree[n + i] = i;
+    }
+    auto better = [&](uint32_t a, uint32_t b) {
+        return freq[b] > freq[a] || (freq[b] == freq[a] && b < a) ? b : a;
+    };
+    for (uint32_t i = n - 1; i >= 1 && i < n; --i) {
+        tree[i] = better(tree[2 * i], tree[2 * i + 1]);
+    }
+
+    WordDictHeader header = {{'G', 'N', 'W', 'D'}, FORMAT_VERSION, 0, n,
+                             static_cast<uint32_t>(keys.size()), static_cast<uint32_t>(text.size())};
+    std::string image(reinterpret_cast<const char*>(&header), sizeof(header));
+    auto append = [&image](const std::vector<uint32_t>& v) {
+        image.append(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(uint32_t));
+    };
+    append(keyOffsets);
+    append(textOffsets);
+    append(freq);
+    append(tree);
+    image += keys;
+    image += text;
+    return image;
+}
+
+bool WordDict::attach(const char* data, size_t size) {
+    WordDictHeader header;
+    if (size < sizeof(header)) return false;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, "GNWD", 4) != 0 || header.version != FORMAT_VERSION) {
+        return false;
+    }
+
+    uint64_t n = header.count;
+    uint64_t tables = (2 * (n + 1) + n + 2 * n) * sizeof(uint32_t);
+    if (size != sizeof(header) + tables + header.keyBytes + header.textBytes) {
+        return false;
+    }
+    const auto* words = reinterpret_cast<const uint32_t*>(data + sizeof(header));
+    if (words[n] != header.keyBytes || words[2 * n + 1] != header.textBytes) {
+        return false;
+    }
+
+    count_ = header.count;
+    keyOffsets_ = words;
+    textOffsets_ = words + n + 1;
+    freq_ = words + 2 * (n + 1);
+    tree_ = freq_ + n;
+    keys_ = data + sizeof(header) + tables;
+    text_ = keys_ + header.keyBytes;
+    return true;
+}
+
+bool WordDict::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        size_t size = static_cast<size_t>(st.st_size);
+        void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data != MAP_FAILED) {
+            map_ = data;
+            mapSize_ = size;
+        }
+    }
+    ::close(fd);
+    if (!map_ || !attach(static_cast<const char*>(map_), mapSize_)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool WordDict::load(std::string image) {
+    close();
+    image_ = std::move(image);
+    if (!attach(image_.data(), image_.size())) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void WordDict::close() {
+    if (map_) {
+        munmap(map_, mapSize_);
+    }
+    map_ = nullptr;
+    mapSize_ = 0;
+    image_.clear();
+    count_ = 0;
+}
+
+WordDict::~WordDict() {
+    close();
+}
+
+WordDict& WordDict::operator=(WordDict&& other) noexcept {
+    if (this == &other) return *this;
+    close();
+    if (other.map_) {
+        map_ = other.map_;
+        mapSize_ = other.mapSize_;
+        other.map_ = nullptr;
+        attach(static_cast<const char*>(map_), mapSize_);
+    } else if (other.count_) {
+        image_ = std::move(other.image_);
+        attach(image_.data(), image_.size());
+    }
+    other.close();
+    return *this;
+}
+
+// =============================================================================
+// Lookup
+// =============================================================================
+
+uint32_t WordDict::best(uint32_t l, uint32_t r) const {
+    uint32_t found = UINT32_MAX;
+    for (l += count_, r += count_; l < r; l >>= 1, r >>= 1) {
+        if (l & 1) found = better(found, tree_[l++]);
+        if (r & 1) found = better(found, tree_[--r]);
+    }
+    return found;
+}
+
+size_t WordDict::lookup(std::string_view prefix, size_t k, std::string_view* out) const {
+    char folded[MAX_PREFIX_BYTES];
+    size_t len = foldInto(prefix, folded, sizeof(folded));
+    if (count_ == 0 || k == 0 || len == 0 || len == SIZE_MAX) {
+        return 0;
+    }
+    std::string_view p(folded, len);
+
+    // Keys are sorted, so keys cut to the prefix length are sorted too
+    auto cut = [&](uint32_t i) { return key(i).substr(0, len); };
+    uint32_t lo = 0, hi = count_;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        (cut(mid) < p ? lo = mid + 1 : hi = mid);
+    }
+    uint32_t end = count_;
+    for (uint32_t l = lo; l < end;) {
+        uint32_t mid = l + (end - l) / 2;
+        (cut(mid) == p ? l = mid + 1 : end = mid);
+    }
+
+    // Best-first over subranges: take the range whose best word is most
+    // frequent, emit that word, split the range around it
+    struct Range {
+        uint32_t l, r, top;
+    };
+    Range pending[MAX_VISITS + 1];
+    size_t pendingCount = 0;
+    auto push = [&](uint32_t l, uint32_t r) {
+        if (l < r) pending[pendingCount++] = {l, r, best(l, r)};
+    };
+    push(lo, end);
+
+    size_t found = 0;
+    for (size_t visits = 0; found < k && pendingCount > 0 && visits < MAX_VISITS; ++visits) {
+        size_t pick = 0;
+        for (size_t i = 1; i < pendingCount; ++i) {
+            if (better(pending[pick].top, pending[i].top) == pending[i].top) pick = i;
+        }
+        Range range = pending[pick];
+        pending[pick] = pending[--pendingCount];
+
+        std::string_view word = text(range.top);
+        if (diacriticsMatch(prefix, word) && !equalsIgnoringCase(prefix, word)) {
+            out[found++] = word;
+        }
+        push(range.l, range.top);
+        push(range.top + 1, range.r);
+    }
+    return found;
+}
+
+} // namespace GoNhanh
@@ -0,0 +1,116 @@
+#ifndef GONHANH_WORD_DICT_H
+#define GONHANH_WORD_DICT_H
+
+// Word completion dictionary (`candidates` setting)
+// A file compiled by gonhanh-dictc, memory-mapped read-only and shared by
+// every input context. Words are sorted by their folded key (lowercase,
+// diacritics removed), so a typed prefix selects one contiguous range; a
+// segment tree over the frequencies pulls that range's top-k without
+// scanning it.
+//
+// File layout (little-endian host layout):
+//   WordDictHeader
+//   uint32_t keyOffsets[count + 1]   into keys
+//   uint32_t textOffsets[count + 1]  into text
+//   uint32_t freq[count]
+//   uint32_t tree[2 * count]         tree[count + i] = i, inner nodes: argmax of children
+//   char keys[keyBytes]
+//   char text[textBytes]
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace GoNhanh {
+
+struct WordDictHeader {
+    char magic[4];         // "GNWD"
+    uint16_t version;      // WordDict::FORMAT_VERSION
+    uint16_t _pad;
+    uint32_t count;
+    uint32_t keyBytes;
+    uint32_t textBytes;
+};
+
+static_assert(sizeof(WordDictHeader) == 20, "WordDictHeader is part of the file format");
+
+class WordDict {
+public:
+    static constexpr uint16_t FORMAT_VERSION = 1;
+    // Longest folded prefix looked up; longer buffers get no candidates
+    static constexpr size_t MAX_PREFIX_BYTES = 64;
+    // Ranges examined per lookup (words rejected for diacritics included)
+    static constexpr size_t MAX_VISITS = 64;
+
+    WordDict() = default;
+    ~WordDict();
+    WordDict(WordDict&& other) noexcept { *this = std::move(other); }
+    WordDict& operator=(WordDict&& other) noexcept;
+    WordDict(const WordDict&) = delete;
+    WordDict& operator=(const WordDict&) = delete;
+
+    // Compile word list lines into a dictionary image
+    // Line format: `word` or `word<TAB>count` (count defaults to 1);
+    // blank lines and `#` comments are skipped, duplicates keep the larger count
+    static std::string compile(std::string_view lines);
+
+    // Map a compiled file
+    // Returns: false if missing or invalid (the dictionary is then empty)
+    bool open(const std::string& path);
+
+    // Use a compiled image held in memory (tests)
+    // Returns: false if invalid (the dictionary is then empty)
+    bool load(std::string image);
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+    // Up to `k` words starting with `prefix` (composed text, any case),
+    // most frequent first, written to `out` as views into the dictionary.
+    // Marks typed so far (â, ơ, đ...) must match position by position and a
+    // typed tone must be the first syllable's tone; untyped ones match
+    // anything. The prefix itself is not returned.
+    // Returns: number of words written
+    size_t lookup(std::string_view prefix, size_t k, std::string_view* out) const;
+
+    // Lookup key of `text`: lowercase, no tone or marks, đ -> d
+    static std::string fold(std::string_view text);
+
+    // `word` with the case of `typed`: all caps if `typed` is 2+ letters,
+    // all uppercase; capitalized if it starts with an uppercase letter
+    static std::string matchCase(std::string_view word, std::string_view typed);
+
+private:
+    bool attach(const char* data, size_t size);
+    void close();
+
+    std::string_view key(uint32_t i) const {
+        return {keys_ + keyOffsets_[i], keyOffsets_[i + 1] - keyOffsets_[i]};
+    }
+    std::string_view text(uint32_t i) const {
+        return {text_ + textOffsets_[i], textOffsets_[i + 1] - textOffsets_[i]};
+    }
+    // Most frequent word in [l, r) (lowest index on ties), or UINT32_MAX if empty
+    uint32_t best(uint32_t l, uint32_t r) const;
+    uint32_t better(uint32_t a, uint32_t b) const {
+        if (a == UINT32_MAX) return b;
+        if (b == UINT32_MAX) return a;
+        return freq_[b] > freq_[a] || (freq_[b] == freq_[a] && b < a) ? b : a;
+    }
+
+    void* map_ = nullptr;  // mmap'd file, or nullptr
+    size_t mapSize_ = 0;
+    std::string image_;    // load() image
+    uint32_t count_ = 0;
+    const uint32_t* keyOffsets_ = nullptr;
+    const uint32_t* textOffsets_ = nullptr;
+    const uint32_t* freq_ = nullptr;
+    const uint32_t* tree_ = nullptr;
+    const char* keys_ = nullptr;
+    const char* text_ = nullptr;
+};
+
+} // namespace GoNhanh
+
+#endif // GONHANH_WORD_DICT_H
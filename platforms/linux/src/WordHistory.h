@@ -0,0 +1,131 @@
+#ifndef GONHANH_WORD_HISTORY_H
+#define GONHANH_WORD_HISTORY_H
+
+// Committed-word history of one input context
+// Break keys end the word and clear the engine, so its keys would be gone
+// by the time Backspace erases the space after it. The history keeps the
+// raw keys and committed text of the last WORDS words, plus how many
+// characters were typed after each. When Backspace brings the cursor back
+// to the end of a word, replaying its keys gives the engine the state it
+// had (ESC restore included) in O(word length), with no surrounding text
+// to parse. Fixed-size arrays only: the memory per context never grows.
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "RustBridge.h"
+
+namespace GoNhanh {
+
+class WordHistory {
+public:
+    static constexpr size_t WORDS = 8;      // Committed words kept
+    static constexpr size_t MAX_KEYS = 32;  // Words typed with more keys are not kept
+    static constexpr size_t MAX_TEXT = 64;  // Committed text bytes (UTF-8)
+
+    struct Word {
+        ImeKeyEvent keys[MAX_KEYS];
+        uint8_t keyCount = 0;
+        uint8_t textBytes = 0;
+        uint8_t gap = 0;  // Characters typed after the word
+        char bytes[MAX_TEXT];
+
+        std::string_view text() const { return {bytes, textBytes}; }
+    };
+
+    // A key the engine processed for the word being composed
+    void type(uint16_t key, bool caps, bool shift) {
+        if (open_.keyCount == MAX_KEYS) {
+            broken_ = true;
+            return;
+        }
+        open_.keys[open_.keyCount++] = ImeKeyEvent{key, caps, false, shift, 0};
+    }
+
+    // The engine was seeded from elsewhere (resumed word): the word being
+    // composed no longer follows from its keys
+    void breakOpenWord() { broken_ = true; }
+
+    // Word boundary: `text` is what the word being composed committed. An
+    // empty word (typed, then erased) leaves the history as it is; one that
+    // cannot be kept hides the words before it, so they are dropped.
+    void commit(std::string_view text) {
+        if (!text.empty()) {
+            if (broken_ || open_.keyCount == 0 || text.size() > MAX_TEXT) {
+                count_ = 0;
+            } else {
+                Word& word = words_[(first_ + count_) % WORDS];
+                word = open_;
+                word.textBytes = static_cast<uint8_t>(text.size());
+                word.gap = 0;
+                text.copy(word.bytes, text.size());
+                if (count_ == WORDS) {
+                    first_ = (first_ + 1) % WORDS;
+                } else {
+                    ++count_;
+                }
+            }
+        }
+        dropOpenWord();
+    }
+
+    // A printable break key (space, punctuation) after the last word
+    void typeGap() {
+        if (count_ == 0) return;
+        Word& word = last();
+        if (word.gap == UINT8_MAX) {
+            count_ = 0;  // Nobody backspaces over that many
+        } else {
+            ++word.gap;
+        }
+    }
+
+    // Backspace with the word being composed empty, before the engine sees
+    // it: true if it erases a character typed after the last word
+    bool erasesGap() const { return count_ > 0 && last().gap > 0 && open_.keyCount == 0; }
+
+    // That backspace was applied. Returns: the word it brought the cursor
+    // back to, now the word being composed (replay its keys into the
+    // engine), or null while characters after it remain
+    const Word* eraseGap() {
+        if (!erasesGap()) return nullptr;
+        if (--last().gap > 0) return nullptr;
+        open_ = last();
+        --count_;
+        return &open_;
+    }
+
+    // The word being composed was erased entirely
+    void dropOpenWord() {
+        open_.keyCount = 0;
+        broken_ = false;
+    }
+
+    // The text around the cursor changed in a way not tracked here (cursor
+    // moved, shortcut, settings): forget every word
+    void reset() {
+        count_ = 0;
+        broken_ = broken_ || open_.keyCount > 0;
+    }
+
+    size_t size() const { return count_; }
+    // Keys recorded, or a word that cannot be kept, since the last commit
+    bool composing() const { return open_.keyCount > 0 || broken_; }
+    // Most recent first: word(0) is the last one committed
+    const Word& word(size_t i) const { return words_[(first_ + count_ - 1 - i) % WORDS]; }
+
+private:
+    Word& last() { return words_[(first_ + count_ - 1) % WORDS]; }
+    const Word& last() const { return words_[(first_ + count_ - 1) % WORDS]; }
+
+    Word words_[WORDS];
+    Word open_;            // Keys of the word being composed
+    bool broken_ = false;  // open_ cannot reproduce the engine state
+    size_t first_ = 0;     // Oldest word
+    size_t count_ = 0;
+};
+
+} // namespace GoNhanh
+
+#endif // GONHANH_WORD_HISTORY_H
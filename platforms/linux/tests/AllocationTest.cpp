@@ -0,0 +1,148 @@
+// Allocation tests for the RustBridge key path
+// Replaces global operator new to count heap allocations made while
+// processing keystrokes through the allocation-free processKey overloads
+
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <new>
+#include "../src/RustBridge.h"
+
+// =============================================================================
+// Counting Allocator
+// =============================================================================
+
+static thread_local size_t g_allocations = 0;
+
+void* operator new(std::size_t size) {
+    ++g_allocations;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    ++g_allocations;
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+// The default sized forms call these
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+
+// Counts allocations made on this thread while in scope
+class AllocationCounter {
+public:
+    AllocationCounter() : start_(g_allocations) {}
+    size_t count() const { return g_allocations - start_; }
+
+private:
+    size_t start_;
+};
+
+// =============================================================================
+// Key Streams
+// =============================================================================
+
+// macOS keycodes (see src/KeycodeMap.h)
+constexpr uint16_t KEY_A = 0;
+constexpr uint16_t KEY_S = 1;
+constexpr uint16_t KEY_D = 2;
+constexpr uint16_t KEY_E = 14;
+constexpr uint16_t KEY_T = 17;
+constexpr uint16_t KEY_I = 34;
+constexpr uint16_t KEY_J = 38;
+constexpr uint16_t KEY_N = 45;
+constexpr uint16_t KEY_V = 9;
+constexpr uint16_t KEY_W = 13;
+constexpr uint16_t KEY_O = 31;
+constexpr uint16_t KEY_U = 32;
+constexpr uint16_t KEY_C = 8;
+
+// "vieetj nam dduwowcj" - circumflex, tone marks, stroke and horn
+static const uint16_t kTelexStream[] = {
+    KEY_V, KEY_I, KEY_E, KEY_E, KEY_T, KEY_J,
+    KEY_N, KEY_A, KEY_S,
+    KEY_D, KEY_D, KEY_U, KEY_W, KEY_O, KEY_W, KEY_C, KEY_J,
+};
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+TEST(AllocationTest, CounterDetectsAllocations) {
+    AllocationCounter counter;
+    auto* text = new std::string(64, 'x');
+    delete text;
+    EXPECT_GT(counter.count(), 0u);
+}
+
+TEST(AllocationTest, RustEngineKeyPathDoesNotAllocate) {
+    RustEngine engine;
+    engine.setMethod(InputMethod::Telex);
+    KeyOutput output;
+
+    AllocationCounter counter;
+    size_t actions = 0;
+    for (int round = 0; round < 100; ++round) {
+        for (uint16_t key : kTelexStream) {
+            if (engine.processKey(key, false, false, false, output)) {
+                ++actions;
+            }
+        }
+        engine.clear();
+    }
+
+    EXPECT_EQ(counter.count(), 0u);
+    EXPECT_GT(actions, 0u);
+}
+
+TEST(AllocationTest, RustBridgeKeyPathDoesNotAllocate) {
+    RustBridge::initialize();
+    RustBridge::setMethod(InputMethod::Telex);
+    KeyOutput output;
+
+    AllocationCounter counter;
+    for (uint16_t key : kTelexStream) {
+        RustBridge::processKey(key, false, false, false, output);
+    }
+    RustBridge::clear();
+
+    EXPECT_EQ(counter.count(), 0u);
+}
+
+TEST(AllocationTest, OutputMatchesStringOverload) {
+    RustEngine fixed;
+    RustEngine legacy;
+    KeyOutput output;
+
+    for (uint16_t key : kTelexStream) {
+        bool action = fixed.processKey(key, false, false, false, output);
+        auto [backspace, text] = legacy.processKey(key, false, false, false);
+
+        EXPECT_EQ(action, backspace > 0 || !text.empty());
+        EXPECT_EQ(output.backspace, backspace);
+        EXPECT_EQ(std::string(output.view()), text);
+    }
+}
+
+TEST(AllocationTest, Utf8EncoderMatchesStringConversion) {
+    char buf[4];
+    for (uint32_t cp : {0x61u, 0xE1u, 0x1B0u, 0x1EC7u, 0x1F600u, 0xD800u}) {
+        size_t n = RustBridge::encodeUtf8(cp, buf);
+        EXPECT_EQ(std::string(buf, n), RustBridge::codePointToUtf8(cp));
+    }
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,149 @@
+#ifndef GONHANH_DIFF_HARNESS_H
+#define GONHANH_DIFF_HARNESS_H
+
+// Differential check of the Linux key path against the core
+// The bridge side runs RustBridge::processKey (global engine, one FFI call
+// and one CompactResult, or Utf8Result, per key); the core side runs the same events on an
+// engine handle through ime_engine_reference_replay, which encodes every
+// result in Rust from the raw UTF-32 chars. Both produce the record format
+// of core/src/engine/reference.rs and must match byte for byte.
+// Shared by gonhanh_diff (throughput runner) and gonhanh_fuzz (libFuzzer).
+
+#include "KeycodeMap.h"
+#include "RustBridge.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace GoNhanh::Diff {
+
+using namespace KeycodeMap;
+
+constexpr size_t RECORD_HEADER = 3;  // backspace (u8), text length (u16 LE)
+constexpr size_t RECORD_MAX = RECORD_HEADER + IME_MAX_UTF8;
+
+// Keys drawn by the generators; vowels and Telex/VNI modifiers repeat so
+// random sequences form syllables (and tone/mark edits) often
+constexpr uint16_t KEYS[] = {
+    MacKey::A, MacKey::A, MacKey::E, MacKey::E, MacKey::I, MacKey::O, MacKey::O,
+    MacKey::U, MacKey::U, MacKey::Y, MacKey::W, MacKey::W, MacKey::D, MacKey::D,
+    MacKey::S, MacKey::F, MacKey::R, MacKey::X, MacKey::J, MacKey::Z,
+    MacKey::B, MacKey::C, MacKey::G, MacKey::H, MacKey::K, MacKey::L, MacKey::M,
+    MacKey::N, MacKey::N, MacKey::P, MacKey::Q, MacKey::T, MacKey::T, MacKey::V,
+    MacKey::N0, MacKey::N1, MacKey::N2, MacKey::N3, MacKey::N4, MacKey::N5,
+    MacKey::N6, MacKey::N7, MacKey::N8, MacKey::N9,
+    MacKey::SPACE, MacKey::SPACE, MacKey::DELETE, MacKey::DELETE, MacKey::ESC,
+    MacKey::DOT, MacKey::COMMA, MacKey::LBRACKET, MacKey::RBRACKET, MacKey::RETURN,
+};
+constexpr size_t KEY_COUNT = sizeof(KEYS) / sizeof(KEYS[0]);
+
+// Event from two generator bytes: key index, modifier bits
+// (caps 1 in 4, shift 1 in 8, ctrl 1 in 32)
+inline ImeKeyEvent keyFromBytes(uint8_t key, uint8_t mods) {
+    ImeKeyEvent ev{};
+    ev.key = KEYS[key % KEY_COUNT];
+    ev.caps = (mods & 0x03) == 0x03;
+    ev.shift = (mods & 0x1C) == 0x1C;
+    ev.ctrl = (mods & 0xE0) == 0xE0 && (mods & 0x03) == 0;
+    return ev;
+}
+
+inline void appendRecord(std::string& out, int backspace, const char* text, size_t len) {
+    out.push_back(static_cast<char>(backspace));
+    out.push_back(static_cast<char>(len & 0xFF));
+    out.push_back(static_cast<char>(len >> 8));
+    out.append(text, len);
+}
+
+// Bridge side: one record per event from RustBridge::processKey
+inline void bridgeTrace(const ImeKeyEvent* events, size_t n, std::string& out) {
+    KeyOutput output;
+    for (size_t i = 0; i < n; ++i) {
+        const ImeKeyEvent& ev = events[i];
+        if (RustBridge::processKey(ev.key, ev.caps, ev.ctrl, ev.shift, output)) {
+            appendRecord(out, output.backspace, output.text, output.length);
+        } else {
+            appendRecord(out, 0, nullptr, 0);
+        }
+    }
+}
+
+// Core side: an engine handle with default settings, traced in Rust
+class Reference {
+public:
+    explicit Reference(InputMethod method) : engine_(ime_engine_new()) {
+        ime_engine_method(engine_, static_cast<uint8_t>(method));
+    }
+    ~Reference() { ime_engine_free(engine_); }
+    Reference(const Reference&) = delete;
+    Reference& operator=(const Reference&) = delete;
+
+    // Forget buffer and word history (fresh sequence)
+    void clear() { ime_engine_clear_all(engine_); }
+
+    void trace(const ImeKeyEvent* events, size_t n, std::string& out) {
+        if (scratch_.size() < n * RECORD_MAX) {
+            scratch_.resize(n * RECORD_MAX);
+        }
+        size_t len = ime_engine_reference_replay(engine_, events, n,
+                                                 scratch_.data(), scratch_.size());
+        out.append(reinterpret_cast<const char*>(scratch_.data()), len);
+    }
+
+private:
+    ImeEngine* engine_;
+    std::vector<uint8_t> scratch_;
+};
+
+// Point the global engine at `method` with no state carried over
+inline void resetBridge(InputMethod method) {
+    RustBridge::initialize();
+    RustBridge::setMethod(method);
+    ime_clear_all();
+}
+
+// Index of the first record that differs, or SIZE_MAX if the traces match
+// `offset` is set to that record's byte offset in both traces
+inline size_t firstMismatch(const std::string& a, const std::string& b, size_t& offset) {
+    size_t index = 0;
+    offset = 0;
+    while (offset + RECORD_HEADER <= a.size() && offset + RECORD_HEADER <= b.size()) {
+        size_t lenA = static_cast<uint8_t>(a[offset + 1]) | static_cast<uint8_t>(a[offset + 2]) << 8;
+        size_t lenB = static_cast<uint8_t>(b[offset + 1]) | static_cast<uint8_t>(b[offset + 2]) << 8;
+        if (lenA != lenB || a.compare(offset, RECORD_HEADER + lenA, b, offset, RECORD_HEADER + lenB) != 0) {
+            return index;
+        }
+        offset += RECORD_HEADER + lenA;
+        ++index;
+    }
+    return a.size() == b.size() ? SIZE_MAX : index;
+}
+
+// "bs=2 text="ệt"" for the record at `offset`
+inline std::string describeRecord(const std::string& trace, size_t offset) {
+    if (offset + RECORD_HEADER > trace.size()) {
+        return "<missing>";
+    }
+    size_t len = static_cast<uint8_t>(trace[offset + 1]) | static_cast<uint8_t>(trace[offset + 2]) << 8;
+    return "bs=" + std::to_string(static_cast<uint8_t>(trace[offset])) +
+           " text=\"" + trace.substr(offset + RECORD_HEADER, len) + "\"";
+}
+
+// Print the failing key and its lead-up to stderr
+inline void reportMismatch(const ImeKeyEvent* events, size_t index,
+                           const std::string& bridge, const std::string& core, size_t offset) {
+    std::fprintf(stderr, "mismatch at key %zu\n  keys:", index);
+    for (size_t i = index > 16 ? index - 16 : 0; i <= index; ++i) {
+        std::fprintf(stderr, " %u%s%s%s", events[i].key, events[i].caps ? "C" : "",
+                     events[i].shift ? "S" : "", events[i].ctrl ? "^" : "");
+    }
+    std::fprintf(stderr, "\n  bridge: %s\n  core:   %s\n",
+                 describeRecord(bridge, offset).c_str(), describeRecord(core, offset).c_str());
+}
+
+} // namespace GoNhanh::Diff
+
+#endif // GONHANH_DIFF_HARNESS_H
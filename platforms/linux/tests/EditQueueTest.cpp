@@ -0,0 +1,100 @@
+// Unit tests for EditQueue
+// Tests coalescing of consecutive edits and flush behavior
+
+#include <gtest/gtest.h>
+#include "../src/EditQueue.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using GoNhanh::EditQueue;
+
+struct Applied {
+    int backspace;
+    std::string text;
+};
+
+static std::vector<Applied> flushAll(EditQueue& queue) {
+    std::vector<Applied> applied;
+    queue.flush([&](int backspace, const std::string& text) {
+        applied.push_back({backspace, text});
+    });
+    return applied;
+}
+
+// =============================================================================
+// Coalescing
+// =============================================================================
+
+TEST(EditQueueTest, EmptyFlushIsNoop) {
+    EditQueue queue;
+    EXPECT_TRUE(queue.empty());
+    EXPECT_FALSE(queue.shouldFlushNow());
+    EXPECT_TRUE(flushAll(queue).empty());
+}
+
+TEST(EditQueueTest, ConcatenatesText) {
+    EditQueue queue;
+    queue.push(0, "vi");
+    queue.push(0, "ệt");
+
+    auto applied = flushAll(queue);
+    ASSERT_EQ(applied.size(), 1u);
+    EXPECT_EQ(applied[0].backspace, 0);
+    EXPECT_EQ(applied[0].text, "việt");
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(EditQueueTest, BackspaceCancelsPendingText) {
+    EditQueue queue;
+    // "vie" + "e" -> "viê" + "t" -> "viêt" + "j" -> "việt", one edit per key
+    queue.push(0, "vie");
+    queue.push(1, "ê");
+    queue.push(0, "t");
+    queue.push(2, "ệt");
+
+    EXPECT_EQ(queue.backspace(), 0);
+    EXPECT_EQ(queue.text(), "việt");
+}
+
+TEST(EditQueueTest, BackspaceBeyondPendingTextIsKept) {
+    EditQueue queue;
+    queue.push(1, "á");   // Replaces committed "a"
+    queue.push(3, "xy");  // Removes "á" and two more committed characters
+
+    auto applied = flushAll(queue);
+    ASSERT_EQ(applied.size(), 1u);
+    EXPECT_EQ(applied[0].backspace, 3);
+    EXPECT_EQ(applied[0].text, "xy");
+}
+
+TEST(EditQueueTest, DeleteOnlyEdit) {
+    EditQueue queue;
+    queue.push(2, "");
+    EXPECT_FALSE(queue.empty());
+
+    auto applied = flushAll(queue);
+    ASSERT_EQ(applied.size(), 1u);
+    EXPECT_EQ(applied[0].backspace, 2);
+    EXPECT_EQ(applied[0].text, "");
+}
+
+// =============================================================================
+// Flush triggers
+// =============================================================================
+
+TEST(EditQueueTest, FlushNowAfterDeadline) {
+    EditQueue queue;
+    queue.push(0, "a");
+    EXPECT_FALSE(queue.shouldFlushNow());
+
+    std::this_thread::sleep_for(EditQueue::DEADLINE + std::chrono::milliseconds(2));
+    EXPECT_TRUE(queue.shouldFlushNow());
+}
+
+TEST(EditQueueTest, FlushNowWhenTextIsLarge) {
+    EditQueue queue;
+    queue.push(0, std::string(EditQueue::MAX_PENDING_BYTES + 1, 'a'));
+    EXPECT_TRUE(queue.shouldFlushNow());
+}
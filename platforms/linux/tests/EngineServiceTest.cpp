@@ -0,0 +1,239 @@
+// Unit tests for EngineService / EngineClient
+// Tests the shared-memory ring, engines run by a service thread of this
+// process, and the in-process fallback when the service stops
+
+#include <gtest/gtest.h>
+#include "../src/EngineService.h"
+
+#include <sys/stat.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace GoNhanh;
+
+namespace {
+
+// macOS virtual keycodes (see KeycodeMap.h)
+constexpr uint16_t KEY_A = 0, KEY_S = 1, KEY_E = 14, KEY_T = 17, KEY_V = 9, KEY_I = 34,
+                   KEY_J = 38, KEY_N = 45, KEY_SPACE = 49;
+
+// "vieetj" then "as": việt, á
+const std::vector<uint16_t> WORDS = {KEY_V, KEY_I, KEY_E, KEY_E, KEY_T, KEY_J, KEY_SPACE,
+                                     KEY_A, KEY_S};
+
+std::vector<std::pair<int, std::string>> typeAll(RustEngine& engine,
+                                                 const std::vector<uint16_t>& keys) {
+    std::vector<std::pair<int, std::string>> out;
+    for (uint16_t key : keys) {
+        out.push_back(engine.processKey(key, false, false, false));
+    }
+    return out;
+}
+
+} // namespace
+
+TEST(ServiceRingTest, WrapsAround) {
+    auto ring = std::make_unique<ServiceRing>();
+    ring->reset();
+    std::string payload(1000, 'x');
+    uint8_t read[ServiceRing::MAX_PAYLOAD];
+    ServiceMessage message;
+
+    // Well past BYTES, one message in flight at a time
+    for (uint32_t i = 0; i < 200; ++i) {
+        payload[0] = static_cast<char>(i);
+        ASSERT_TRUE(ring->push(7, i, payload.data(), 500, payload.data() + 500, 500));
+        ASSERT_TRUE(ring->pop(message, read));
+        EXPECT_EQ(message.op, 7);
+        EXPECT_EQ(message.id, i);
+        ASSERT_EQ(message.size, 1000);
+        EXPECT_EQ(std::string(reinterpret_cast<char*>(read), 1000), payload);
+    }
+    EXPECT_FALSE(ring->pop(message, read));
+}
+
+TEST(ServiceRingTest, FullRingRefusesPush) {
+    auto ring = std::make_unique<ServiceRing>();
+    ring->reset();
+    std::string payload(ServiceRing::MAX_PAYLOAD, 'x');
+    size_t pushed = 0;
+    while (ring->push(1, 0, payload.data(), payload.size())) {
+        ++pushed;
+    }
+    EXPECT_EQ(pushed, ServiceRing::BYTES / (sizeof(ServiceMessage) + ServiceRing::MAX_PAYLOAD));
+    EXPECT_FALSE(ring->push(1, 0, payload.data(), ServiceRing::MAX_PAYLOAD + 1));
+
+    uint8_t read[ServiceRing::MAX_PAYLOAD];
+    ServiceMessage message;
+    ASSERT_TRUE(ring->pop(message, read));
+    EXPECT_TRUE(ring->push(1, 0, payload.data(), payload.size()));
+}
+
+class EngineServiceTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        path_ = testing::TempDir() + "gonhanh_engine_test";
+        std::remove(path_.c_str());
+        ASSERT_TRUE(service_.open(path_));
+        serving_ = std::thread([this] { service_.serve(); });
+    }
+
+    void TearDown() override {
+        RustBridge::disconnectService();
+        stopService();
+    }
+
+    void stopService() {
+        if (serving_.joinable()) {
+            service_.stop();
+            serving_.join();
+        }
+        service_.close();
+    }
+
+    std::string path_;
+    EngineService service_;
+    std::thread serving_;
+};
+
+TEST_F(EngineServiceTest, SecondDaemonIsRefused) {
+    EngineService other;
+    EXPECT_FALSE(other.open(path_));
+}
+
+TEST_F(EngineServiceTest, RemoteEngineMatchesInProcess) {
+    RustEngine local;
+    ASSERT_FALSE(local.remote());
+    ASSERT_TRUE(RustBridge::connectService(path_));
+    RustEngine remote;
+    ASSERT_TRUE(remote.remote());
+
+    EXPECT_EQ(typeAll(remote, WORDS), typeAll(local, WORDS));
+    std::string a, b;
+    EXPECT_EQ(remote.getBuffer(a), local.getBuffer(b));
+    EXPECT_EQ(a, b);
+
+    // Batches and settings go through the daemon too
+    remote.clear();
+    local.clear();
+    remote.setMethod(InputMethod::VNI);
+    local.setMethod(InputMethod::VNI);
+    std::vector<ImeKeyEvent> events;
+    for (uint16_t key : {KEY_V, KEY_I, KEY_E, static_cast<uint16_t>(KEY_S)}) {
+        events.push_back({key, false, false, false, 0});
+    }
+    BatchOutput fromRemote = remote.processKeys(events.data(), events.size());
+    BatchOutput fromLocal = local.processKeys(events.data(), events.size());
+    EXPECT_EQ(fromRemote.text, fromLocal.text);
+    EXPECT_EQ(fromRemote.backspace, fromLocal.backspace);
+    EXPECT_EQ(fromRemote.consumed, fromLocal.consumed);
+    EXPECT_TRUE(remote.remote());
+}
+
+TEST_F(EngineServiceTest, ResumesWordInDaemon) {
+    ASSERT_TRUE(RustBridge::connectService(path_));
+    RustEngine engine;
+    ASSERT_EQ(engine.resumeWord("viêt", 4), 4u);
+    engine.processKey(KEY_S, false, false, false);
+    std::string word;
+    engine.getBuffer(word);
+    EXPECT_EQ(word, "viết");
+    EXPECT_TRUE(engine.remote());
+}
+
+TEST_F(EngineServiceTest, SharedShortcutTable) {
+    ASSERT_TRUE(RustBridge::connectService(path_));
+    ShortcutTable table;
+    ASSERT_EQ(table.load("vn=Việt Nam\n"), 1u);
+    RustEngine engine;
+    engine.setShortcuts(table);
+    ASSERT_TRUE(engine.remote());
+
+    typeAll(engine, {KEY_V, KEY_N});
+    EXPECT_EQ(engine.processKey(KEY_SPACE, false, false, false),
+              std::make_pair(2, std::string("Việt Nam ")));
+    EXPECT_TRUE(engine.remote());
+}
+
+TEST_F(EngineServiceTest, FallsBackWhenDaemonStops) {
+    RustEngine local;
+    ASSERT_TRUE(RustBridge::connectService(path_));
+    RustEngine engine;
+    ASSERT_TRUE(engine.remote());
+    ShortcutTable table;
+    table.add("vn", "Việt Nam");
+    engine.setShortcuts(table);
+    local.setShortcuts(table);
+
+    // Mid-word: the in-process engine replays the keys the daemon had
+    std::vector<uint16_t> before(WORDS.begin(), WORDS.begin() + 4);
+    std::vector<uint16_t> after(WORDS.begin() + 4, WORDS.end());
+    EXPECT_EQ(typeAll(engine, before), typeAll(local, before));
+    stopService();
+
+    EXPECT_EQ(typeAll(engine, after), typeAll(local, after));
+    EXPECT_FALSE(engine.remote());
+    EXPECT_EQ(RustBridge::service(), nullptr);
+
+    // Shortcuts came along
+    engine.clear();
+    typeAll(engine, {KEY_V, KEY_N});
+    EXPECT_EQ(engine.processKey(KEY_SPACE, false, false, false),
+              std::make_pair(2, std::string("Việt Nam ")));
+
+    RustEngine later;
+    EXPECT_FALSE(later.remote());
+}
+
+TEST_F(EngineServiceTest, RefusesFileOthersCanOpen) {
+    // Anyone who can open the file sees the keys: not connected, in-process
+    ASSERT_EQ(chmod(path_.c_str(), 0644), 0);
+    EXPECT_FALSE(RustBridge::connectService(path_));
+    RustEngine engine;
+    EXPECT_FALSE(engine.remote());
+
+    ASSERT_EQ(chmod(path_.c_str(), 0600), 0);
+    EXPECT_TRUE(RustBridge::connectService(path_));
+}
+
+TEST_F(EngineServiceTest, SlotFreedOnDisconnect) {
+    ASSERT_TRUE(RustBridge::connectService(path_));
+    {
+        RustEngine engine;
+        engine.processKey(KEY_A, false, false, false);
+        EXPECT_EQ(service_.clients(), 1u);
+    }
+    RustBridge::disconnectService();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (service_.clients() != 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(service_.clients(), 0u);
+}
+
+TEST(EngineServiceNoDaemonTest, NoPathWithoutRuntimeDir) {
+    const char* runtime = std::getenv("XDG_RUNTIME_DIR");
+    std::string saved = runtime ? runtime : "";
+    unsetenv("XDG_RUNTIME_DIR");
+    EXPECT_EQ(servicePath(), "");
+    EXPECT_FALSE(RustBridge::connectService(servicePath()));
+    if (runtime) {
+        setenv("XDG_RUNTIME_DIR", saved.c_str(), 1);
+    }
+}
+
+TEST(EngineServiceNoDaemonTest, EnginesStayInProcess) {
+    std::string path = testing::TempDir() + "gonhanh_engine_none";
+    std::remove(path.c_str());
+    EXPECT_FALSE(RustBridge::connectService(path));
+    RustEngine engine;
+    EXPECT_FALSE(engine.remote());
+    EXPECT_EQ(engine.processKey(KEY_A, false, false, false), std::make_pair(0, std::string()));
+}
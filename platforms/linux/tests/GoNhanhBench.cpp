@@ -0,0 +1,329 @@
+// Benchmarks for the Linux addon hot path
+// Streams are generated from the core test corpora (Vietnamese words typed
+// in Telex/VNI, English words typed as-is). One benchmark iteration = one key,
+// so reported time is ns/key; allocs_per_key counts C++ heap allocations.
+//
+// Usage: ./gonhanh_bench [--benchmark_filter=...] [--benchmark_format=json]
+
+#include <benchmark/benchmark.h>
+
+#include "../src/KeycodeMap.h"
+#include "../src/RustBridge.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifndef GONHANH_DATA_DIR
+#define GONHANH_DATA_DIR "../../core/tests/data"
+#endif
+
+// =============================================================================
+// Allocation counting
+// =============================================================================
+
+static size_t g_allocations = 0;
+
+void* operator new(size_t size) {
+    ++g_allocations;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+// =============================================================================
+// Key streams
+// =============================================================================
+
+struct StreamKey {
+    uint32_t keysym;
+    bool shift;
+};
+
+enum Corpus { VIETNAMESE = 0, ENGLISH = 1 };
+
+// Vowels by tone: none, huyền, sắc, hỏi, ngã, nặng
+static const char* const VOWEL_ROWS[] = {
+    "aàáảãạ", "ăằắẳẵặ", "âầấẩẫậ", "eèéẻẽẹ", "êềếểễệ", "iìíỉĩị",
+    "oòóỏõọ", "ôồốổỗộ", "ơờớởỡợ", "uùúủũụ", "ưừứửữự", "yỳýỷỹỵ",
+    "AÀÁẢÃẠ", "ĂẰẮẲẴẶ", "ÂẦẤẨẪẬ", "EÈÉẺẼẸ", "ÊỀẾỂỄỆ", "IÌÍỈĨỊ",
+    "OÒÓỎÕỌ", "ÔỒỐỔỖỘ", "ƠỜỚỞỠỢ", "UÙÚỦŨỤ", "ƯỪỨỬỮỰ", "YỲÝỶỸỴ",
+};
+
+static std::vector<uint32_t> decodeUtf8(const std::string& s) {
+    std::vector<uint32_t> out;
+    for (size_t i = 0; i < s.size();) {
+        unsigned char c = s[i];
+        int len = c < 0x80 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+        uint32_t cp = len == 1 ? c : c & (0x7F >> len);
+        for (int k = 1; k < len && i + k < s.size(); ++k) {
+            cp = (cp << 6) | (s[i + k] & 0x3F);
+        }
+        out.push_back(cp);
+        i += len;
+    }
+    return out;
+}
+
+// Base letter, modifier keys and tone index of a Vietnamese character
+struct Spelling {
+    char base;
+    const char* telexMod;
+    const char* vniMod;
+    int tone;
+};
+
+static bool spell(uint32_t cp, Spelling& out) {
+    static const char* const MODS[][3] = {
+        // base, telex, vni for the 12 vowel rows
+        {"a", "", ""}, {"a", "w", "8"}, {"a", "a", "6"}, {"e", "", ""}, {"e", "e", "6"},
+        {"i", "", ""}, {"o", "", ""}, {"o", "o", "6"}, {"o", "w", "7"}, {"u", "", ""},
+        {"u", "w", "7"}, {"y", "", ""},
+    };
+    for (size_t row = 0; row < sizeof(VOWEL_ROWS) / sizeof(VOWEL_ROWS[0]); ++row) {
+        std::vector<uint32_t> cps = decodeUtf8(VOWEL_ROWS[row]);
+        for (int tone = 0; tone < 6; ++tone) {
+            if (cps[tone] == cp) {
+                const auto& m = MODS[row % 12];
+                char base = m[0][0];
+                out = {row >= 12 ? static_cast<char>(base - 'a' + 'A') : base, m[1], m[2], tone};
+                return true;
+            }
+        }
+    }
+    if (cp == 0x0111 || cp == 0x0110) {  // đ Đ
+        out = {cp == 0x0110 ? 'D' : 'd', "d", "9", 0};
+        return true;
+    }
+    if (cp < 0x80) {
+        out = {static_cast<char>(cp), "", "", 0};
+        return true;
+    }
+    return false;
+}
+
+static void pushChar(std::vector<StreamKey>& keys, char c) {
+    bool upper = c >= 'A' && c <= 'Z';
+    keys.push_back({static_cast<uint32_t>(static_cast<unsigned char>(c)), upper});
+}
+
+// Keys to type one word; false if it has characters the methods cannot type
+static bool typeWord(const std::string& word, InputMethod method, std::vector<StreamKey>& keys) {
+    static const char TELEX_TONES[] = {0, 'f', 's', 'r', 'x', 'j'};
+    static const char VNI_TONES[] = {0, '2', '1', '3', '4', '5'};
+
+    std::vector<StreamKey> out;
+    std::vector<Spelling> spellings;
+    int tone = 0;
+    for (uint32_t cp : decodeUtf8(word)) {
+        Spelling sp;
+        if (!spell(cp, sp)) return false;
+        spellings.push_back(sp);
+    }
+    for (size_t i = 0; i < spellings.size(); ++i) {
+        const Spelling& sp = spellings[i];
+        // "ươ" is typed with one horn key after "uo" (uow / uo7)
+        bool hornPair = (sp.base == 'u' || sp.base == 'U') && sp.vniMod[0] == '7' &&
+                        i + 1 < spellings.size() && spellings[i + 1].vniMod[0] == '7';
+        pushChar(out, sp.base);
+        const char* mod = method == InputMethod::Telex ? sp.telexMod : sp.vniMod;
+        for (const char* m = hornPair ? "" : mod; *m; ++m) {
+            pushChar(out, *m);
+        }
+        if (sp.tone) tone = sp.tone;
+    }
+    if (tone) {
+        pushChar(out, method == InputMethod::Telex ? TELEX_TONES[tone] : VNI_TONES[tone]);
+    }
+    keys.insert(keys.end(), out.begin(), out.end());
+    return true;
+}
+
+static const std::vector<StreamKey>& stream(Corpus corpus, InputMethod method) {
+    static std::vector<StreamKey> cache[2][2];
+    auto& keys = cache[corpus][static_cast<int>(method)];
+    if (!keys.empty()) return keys;
+
+    std::string path = std::string(GONHANH_DATA_DIR) +
+                       (corpus == VIETNAMESE ? "/vietnamese_22k.txt" : "/english_100k.txt");
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t begin = 0;
+        while (begin < line.size()) {
+            size_t end = line.find(' ', begin);
+            if (end == std::string::npos) end = line.size();
+            if (end > begin && typeWord(line.substr(begin, end - begin), method, keys)) {
+                keys.push_back({XKB_KEY_space, false});
+            }
+            begin = end + 1;
+        }
+    }
+    return keys;
+}
+
+static InputMethod methodArg(const benchmark::State& state) {
+    return state.range(1) ? InputMethod::VNI : InputMethod::Telex;
+}
+
+static void setLabel(benchmark::State& state) {
+    state.SetLabel(std::string(state.range(0) == VIETNAMESE ? "vietnamese_22k" : "english_100k") +
+                   (state.range(1) ? "/vni" : "/telex"));
+}
+
+// =============================================================================
+// Mocked GoNhanhEngine::keyEvent
+// =============================================================================
+
+// Client text as seen through deleteSurroundingText + commitString
+struct MockInputContext {
+    std::string text;
+
+    void deleteSurroundingText(int count) {
+        while (count-- > 0 && !text.empty()) {
+            size_t end = text.size() - 1;
+            while (end > 0 && (static_cast<unsigned char>(text[end]) & 0xC0) == 0x80) --end;
+            text.resize(end);
+        }
+    }
+
+    void commitString(const std::string& s) { text += s; }
+};
+
+// Same steps as GoNhanhEngine::keyEvent for the Surrounding composition mode
+static bool mockKeyEvent(RustEngine& engine, MockInputContext& ic, const StreamKey& key) {
+    auto info = KeycodeMap::lookup(key.keysym);
+    if (info.isBreak()) {
+        engine.clear();
+        return false;
+    }
+    if (info.isUnknown()) return false;
+
+    bool caps = info.isLetter() ? key.shift : false;
+    KeyOutput output;
+    if (!engine.processKey(info.keycode(), caps, false, key.shift, output)) {
+        return false;
+    }
+
+    std::string text(output.view());
+    if (output.backspace > 0) ic.deleteSurroundingText(output.backspace);
+    if (!text.empty()) ic.commitString(text);
+    return true;
+}
+
+// =============================================================================
+// Benchmarks
+// =============================================================================
+
+static void BM_RustBridgeProcessKey(benchmark::State& state) {
+    const auto& keys = stream(static_cast<Corpus>(state.range(0)), methodArg(state));
+    RustBridge::initialize();
+    RustBridge::setMethod(methodArg(state));
+    RustBridge::clear();
+
+    size_t i = 0;
+    size_t allocations = g_allocations;
+    for (auto _ : state) {
+        const StreamKey& key = keys[i];
+        i = i + 1 == keys.size() ? 0 : i + 1;
+
+        auto info = KeycodeMap::lookup(key.keysym);
+        KeyOutput output;
+        benchmark::DoNotOptimize(RustBridge::processKey(
+            info.keycode(), info.isLetter() && key.shift, false, key.shift, output));
+        benchmark::DoNotOptimize(output);
+    }
+    state.counters["allocs_per_key"] = benchmark::Counter(
+        static_cast<double>(g_allocations - allocations), benchmark::Counter::kAvgIterations);
+    setLabel(state);
+}
+
+static void BM_KeyEventMock(benchmark::State& state) {
+    const auto& keys = stream(static_cast<Corpus>(state.range(0)), methodArg(state));
+    RustEngine engine;
+    engine.setMethod(methodArg(state));
+    MockInputContext ic;
+    ic.text.reserve(1 << 20);
+
+    size_t i = 0;
+    size_t allocations = g_allocations;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(mockKeyEvent(engine, ic, keys[i]));
+        if (++i == keys.size()) {
+            i = 0;
+            state.PauseTiming();
+            ic.text.clear();
+            state.ResumeTiming();
+        }
+    }
+    // std::string text(output.view()) is the only expected allocation
+    // (short outputs fit the small-string buffer)
+    state.counters["allocs_per_key"] = benchmark::Counter(
+        static_cast<double>(g_allocations - allocations), benchmark::Counter::kAvgIterations);
+    setLabel(state);
+}
+
+// Per-key cost with a shared shortcut table of range(0) entries
+// (cost should not depend on the table size)
+static void BM_KeyEventShortcuts(benchmark::State& state) {
+    const auto& keys = stream(VIETNAMESE, InputMethod::Telex);
+    std::string lines;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        lines += "zq" + std::to_string(i) + "=expansion " + std::to_string(i) + "\n";
+    }
+    ShortcutTable table;
+    table.load(lines);
+    RustEngine engine;
+    engine.setShortcuts(table);
+    MockInputContext ic;
+    ic.text.reserve(1 << 20);
+
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(mockKeyEvent(engine, ic, keys[i]));
+        if (++i == keys.size()) {
+            i = 0;
+            state.PauseTiming();
+            ic.text.clear();
+            state.ResumeTiming();
+        }
+    }
+    state.SetLabel(std::to_string(table.size()) + " shortcuts");
+}
+
+// KeycodeMap: dense table vs the reference switch statements
+template <bool Table>
+static void BM_KeycodeMap(benchmark::State& state) {
+    const auto& keys = stream(VIETNAMESE, InputMethod::Telex);
+    size_t i = 0;
+    for (auto _ : state) {
+        uint32_t keysym = keys[i].keysym;
+        i = i + 1 == keys.size() ? 0 : i + 1;
+        if (Table) {
+            auto info = KeycodeMap::lookup(keysym);
+            benchmark::DoNotOptimize(info.isBreak() ? 0 : info.keycode() + info.isLetter());
+        } else {
+            benchmark::DoNotOptimize(KeycodeMap::detail::switchIsBreak(keysym)
+                ? 0 : KeycodeMap::detail::switchKeycode(keysym) +
+                      KeycodeMap::detail::rangeIsLetter(keysym));
+        }
+    }
+}
+
+// Args: {corpus, method}
+static void corpusArgs(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"corpus", "vni"});
+    b->Args({VIETNAMESE, 0})->Args({VIETNAMESE, 1})->Args({ENGLISH, 0})->Args({ENGLISH, 1});
+}
+
+BENCHMARK(BM_RustBridgeProcessKey)->Apply(corpusArgs);
+BENCHMARK(BM_KeyEventMock)->Apply(corpusArgs);
+BENCHMARK(BM_KeyEventShortcuts)->Arg(10)->Arg(10000);
+BENCHMARK_TEMPLATE(BM_KeycodeMap, false)->Name("BM_KeycodeMapSwitch");
+BENCHMARK_TEMPLATE(BM_KeycodeMap, true)->Name("BM_KeycodeMapTable");
+
+BENCHMARK_MAIN();
@@ -0,0 +1,127 @@
+// Differential throughput runner: RustBridge::processKey vs the pure-Rust engine
+// Feeds the same random key stream through both sides (see DiffHarness.h),
+// requires byte-identical traces and reports keys/sec for each side.
+//
+//   gonhanh_diff [--keys N] [--seed S] [--method telex|vni|both]
+//
+// Exit status: 0 if every trace matched, 1 on a mismatch, 2 on bad usage.
+
+#include "DiffHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+using namespace GoNhanh::Diff;
+
+namespace {
+
+// Keys per FFI call on the core side; the bridge side is per key anyway
+constexpr size_t CHUNK = 256;
+
+struct Options {
+    size_t keys = 1000000;
+    uint32_t seed = 1;
+    bool telex = true;
+    bool vni = true;
+};
+
+std::vector<ImeKeyEvent> randomKeys(size_t n, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<ImeKeyEvent> events(n);
+    for (auto& ev : events) {
+        uint32_t bits = rng();
+        ev = keyFromBytes(static_cast<uint8_t>(bits), static_cast<uint8_t>(bits >> 8));
+    }
+    return events;
+}
+
+double keysPerSec(size_t keys, std::chrono::steady_clock::duration elapsed) {
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    return seconds > 0 ? keys / seconds : 0;
+}
+
+// Returns: true if both traces matched
+bool run(const char* name, InputMethod method, const std::vector<ImeKeyEvent>& events) {
+    std::string bridge;
+    std::string core;
+    bridge.reserve(events.size() * 8);
+    core.reserve(events.size() * 8);
+
+    resetBridge(method);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < events.size(); i += CHUNK) {
+        bridgeTrace(events.data() + i, std::min(CHUNK, events.size() - i), bridge);
+    }
+    auto bridgeTime = std::chrono::steady_clock::now() - start;
+
+    Reference reference(method);
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < events.size(); i += CHUNK) {
+        reference.trace(events.data() + i, std::min(CHUNK, events.size() - i), core);
+    }
+    auto coreTime = std::chrono::steady_clock::now() - start;
+
+    double bridgeRate = keysPerSec(events.size(), bridgeTime);
+    double coreRate = keysPerSec(events.size(), coreTime);
+    std::printf("%-5s %zu keys: bridge %.2f Mkeys/s, core %.2f Mkeys/s (bridge/core %.2f), trace %zu bytes\n",
+                name, events.size(), bridgeRate / 1e6, coreRate / 1e6,
+                coreRate > 0 ? bridgeRate / coreRate : 0, bridge.size());
+
+    size_t offset = 0;
+    size_t index = firstMismatch(bridge, core, offset);
+    if (index != SIZE_MAX) {
+        reportMismatch(events.data(), index, bridge, core, offset);
+        return false;
+    }
+    return true;
+}
+
+bool parseArgs(int argc, char** argv, Options& opts) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value) {
+            return false;
+        }
+        if (std::strcmp(arg, "--keys") == 0) {
+            opts.keys = std::strtoull(value, nullptr, 10);
+        } else if (std::strcmp(arg, "--seed") == 0) {
+            opts.seed = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        } else if (std::strcmp(arg, "--method") == 0) {
+            opts.telex = std::strcmp(value, "vni") != 0;
+            opts.vni = std::strcmp(value, "telex") != 0;
+            if (!opts.telex && !opts.vni) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+        ++i;
+    }
+    return opts.keys > 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opts;
+    if (!parseArgs(argc, argv, opts)) {
+        std::fprintf(stderr, "usage: %s [--keys N] [--seed S] [--method telex|vni|both]\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<ImeKeyEvent> events = randomKeys(opts.keys, opts.seed);
+    RustBridge::warmUp();  // Keep dictionary builds out of the timings
+
+    bool ok = true;
+    if (opts.telex) {
+        ok &= run("telex", InputMethod::Telex, events);
+    }
+    if (opts.vni) {
+        ok &= run("vni", InputMethod::VNI, events);
+    }
+    return ok ? 0 : 1;
+}
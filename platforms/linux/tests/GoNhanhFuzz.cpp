@@ -0,0 +1,42 @@
+// libFuzzer target: RustBridge::processKey must match the pure-Rust engine
+// Input: first byte picks the method, then (key, modifier) byte pairs (see
+// DiffHarness.h keyFromBytes). Each input starts from a cleared engine.
+//
+//   ./gonhanh_fuzz -max_len=512 corpus/
+
+#include "DiffHarness.h"
+
+#include <cstdlib>
+
+using namespace GoNhanh::Diff;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    static Reference telex(InputMethod::Telex);
+    static Reference vni(InputMethod::VNI);
+    if (size < 3) {
+        return 0;
+    }
+
+    InputMethod method = (data[0] & 1) ? InputMethod::VNI : InputMethod::Telex;
+    Reference& reference = method == InputMethod::VNI ? vni : telex;
+    std::vector<ImeKeyEvent> events;
+    events.reserve(size / 2);
+    for (size_t i = 1; i + 1 < size; i += 2) {
+        events.push_back(keyFromBytes(data[i], data[i + 1]));
+    }
+
+    resetBridge(method);
+    reference.clear();
+    std::string bridge;
+    std::string core;
+    bridgeTrace(events.data(), events.size(), bridge);
+    reference.trace(events.data(), events.size(), core);
+
+    size_t offset = 0;
+    size_t index = firstMismatch(bridge, core, offset);
+    if (index != SIZE_MAX) {
+        reportMismatch(events.data(), index, bridge, core, offset);
+        std::abort();
+    }
+    return 0;
+}
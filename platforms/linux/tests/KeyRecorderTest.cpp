@@ -0,0 +1,141 @@
+// Unit tests for KeyRecorder / KeyRecording
+// Tests the mapped ring file: round trip, wrap-around, reopening and limits
+
+#include <gtest/gtest.h>
+#include "../src/KeyRecorder.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+using namespace GoNhanh;
+
+class KeyRecorderTest : public ::testing::Test {
+protected:
+    void SetUp() override { path_ = testing::TempDir() + "gonhanh_keys.rec"; std::remove(path_.c_str()); }
+    void TearDown() override { std::remove(path_.c_str()); }
+
+    static void recordKey(KeyRecorder& recorder, uint32_t keysym, std::string_view text = {}) {
+        recorder.record(keysym * 1000, 500, keysym, 0, TRACE_CHANGED, 0, 0, 0, 1, text);
+    }
+
+    std::string path_;
+};
+
+TEST_F(KeyRecorderTest, RoundTrip) {
+    {
+        KeyRecorder recorder;
+        ASSERT_TRUE(recorder.open(path_, 16));
+        uint8_t code = recorder.programId("code");
+        EXPECT_EQ(code, 1);
+        EXPECT_EQ(recorder.programId("firefox"), 2);
+        EXPECT_EQ(recorder.programId("code"), code);
+        EXPECT_EQ(recorder.programId(""), 0);
+
+        recorder.record(100, 2500, 'a', 0, TRACE_CHANGED, code, 3, 1, 0, "a");
+        recorder.record(200, 4000, 's', 1, TRACE_CHANGED | TRACE_SHIFT, code, 3, 1, 1, "á");
+        recorder.record(300, 100, ' ', 0, TRACE_WORD_BREAK, 2, 4, 0, 0, {});
+    }
+
+    KeyRecording recording;
+    ASSERT_TRUE(recording.open(path_));
+    ASSERT_EQ(recording.size(), 3u);
+    const KeyRecord& r = recording[1];
+    EXPECT_EQ(r.timeNs, 200u);
+    EXPECT_EQ(r.latencyNs, 4000u);
+    EXPECT_EQ(r.keysym, static_cast<uint32_t>('s'));
+    EXPECT_EQ(r.macKey, 1);
+    EXPECT_EQ(r.flags, TRACE_CHANGED | TRACE_SHIFT);
+    EXPECT_EQ(r.context, 3);
+    EXPECT_EQ(r.method, 1);
+    EXPECT_EQ(r.backspace, 1);
+    EXPECT_EQ(std::string(r.text, r.textBytes), "á");
+    EXPECT_EQ(recording.program(r.program), "code");
+    EXPECT_EQ(recording.program(recording[2].program), "firefox");
+    EXPECT_EQ(recording.program(0), "");
+}
+
+TEST_F(KeyRecorderTest, WrapsKeepingNewest) {
+    KeyRecorder recorder;
+    ASSERT_TRUE(recorder.open(path_, 8));
+    for (uint32_t i = 0; i < 20; ++i) {
+        recordKey(recorder, i);
+    }
+
+    KeyRecording recording;
+    ASSERT_TRUE(recording.open(path_));
+    ASSERT_EQ(recording.size(), 8u);
+    for (size_t i = 0; i < recording.size(); ++i) {
+        EXPECT_EQ(recording[i].keysym, 12 + i);
+    }
+}
+
+TEST_F(KeyRecorderTest, ReopenAppendsOrRestarts) {
+    {
+        KeyRecorder recorder;
+        ASSERT_TRUE(recorder.open(path_, 8));
+        recorder.programId("kate");
+        recordKey(recorder, 1);
+    }
+    {
+        KeyRecorder recorder;
+        ASSERT_TRUE(recorder.open(path_, 8));  // Same capacity: appended
+        EXPECT_EQ(recorder.programId("kate"), 1);
+        recordKey(recorder, 2);
+    }
+    KeyRecording recording;
+    ASSERT_TRUE(recording.open(path_));
+    EXPECT_EQ(recording.size(), 2u);
+
+    KeyRecorder recorder;
+    ASSERT_TRUE(recorder.open(path_, 32));  // Other capacity: started over
+    EXPECT_EQ(recorder.programId("gedit"), 1);
+    ASSERT_TRUE(recording.open(path_));
+    EXPECT_EQ(recording.size(), 0u);
+}
+
+TEST_F(KeyRecorderTest, TruncatesLongOutput) {
+    KeyRecorder recorder;
+    ASSERT_TRUE(recorder.open(path_, 4));
+    std::string text(100, 'x');
+    recordKey(recorder, 'x', text);
+    recorder.record(0, 0, 'y', 0, 0, 0, 0, 0, 300, {});  // Backspace saturates
+
+    KeyRecording recording;
+    ASSERT_TRUE(recording.open(path_));
+    EXPECT_EQ(recording[0].textBytes, sizeof(KeyRecord::text));
+    EXPECT_TRUE(recording[0].flags & RECORD_TRUNCATED);
+    EXPECT_FALSE(recording[1].flags & RECORD_TRUNCATED);
+    EXPECT_EQ(recording[1].backspace, 255);
+}
+
+TEST_F(KeyRecorderTest, ProgramTableFull) {
+    KeyRecorder recorder;
+    ASSERT_TRUE(recorder.open(path_, 4));
+    for (size_t i = 0; i < KeyRecordHeader::MAX_PROGRAMS; ++i) {
+        EXPECT_EQ(recorder.programId("app" + std::to_string(i)), i + 1);
+    }
+    EXPECT_EQ(recorder.programId("one-too-many"), 0);
+    // Long names are stored truncated and still map to one id
+    std::string longName(KeyRecordHeader::PROGRAM_BYTES + 8, 'p');
+    recorder.close();
+    std::remove(path_.c_str());
+    ASSERT_TRUE(recorder.open(path_, 4));
+    uint8_t id = recorder.programId(longName);
+    EXPECT_EQ(recorder.programId(longName), id);
+
+    KeyRecording recording;
+    ASSERT_TRUE(recording.open(path_));
+    EXPECT_EQ(recording.program(id), longName.substr(0, KeyRecordHeader::PROGRAM_BYTES));
+}
+
+TEST_F(KeyRecorderTest, RejectsInvalidFiles) {
+    KeyRecording recording;
+    EXPECT_FALSE(recording.open(path_));  // Missing
+    {
+        std::ofstream out(path_, std::ios::binary);
+        out << std::string(4096, 'x');
+    }
+    EXPECT_FALSE(recording.open(path_));
+    EXPECT_EQ(recording.size(), 0u);
+}
@@ -0,0 +1,81 @@
+// Unit tests for KeyTrace
+// Tests ring buffer wrap-around and the binary dump format
+
+#include <gtest/gtest.h>
+#include "../src/KeyTrace.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <unistd.h>
+
+using namespace GoNhanh;
+
+TEST(KeyTraceTest, EmptyTrace) {
+    KeyTrace trace;
+    EXPECT_EQ(trace.size(), 0u);
+    EXPECT_TRUE(trace.records().empty());
+    EXPECT_EQ(trace.format(), "key trace empty\n");
+}
+
+TEST(KeyTraceTest, RecordsInOrder) {
+    auto trace = std::make_unique<KeyTrace>();
+    trace->record('a', 0, TRACE_CHANGED, 0, 1);
+    trace->record('s', 1, TRACE_CHANGED | TRACE_SHIFT, 1, 2);
+
+    auto recs = trace->records();
+    ASSERT_EQ(recs.size(), 2u);
+    EXPECT_EQ(recs[0].keysym, static_cast<uint32_t>('a'));
+    EXPECT_EQ(recs[1].macKey, 1);
+    EXPECT_EQ(recs[1].backspace, 1);
+    EXPECT_EQ(recs[1].outputBytes, 2);
+    EXPECT_LE(recs[0].timeNs, recs[1].timeNs);
+    EXPECT_NE(trace->format().find("shift changed"), std::string::npos);
+}
+
+TEST(KeyTraceTest, WrapsKeepingNewest) {
+    auto trace = std::make_unique<KeyTrace>();
+    for (uint32_t i = 0; i < KeyTrace::CAPACITY + 10; ++i) {
+        trace->record(i, 0, 0, 300, 0);
+    }
+
+    auto recs = trace->records();
+    ASSERT_EQ(recs.size(), KeyTrace::CAPACITY);
+    EXPECT_EQ(recs.front().keysym, 10u);
+    EXPECT_EQ(recs.back().keysym, KeyTrace::CAPACITY + 9);
+    EXPECT_EQ(recs.back().backspace, 255);  // Saturated
+
+    trace->clear();
+    EXPECT_EQ(trace->size(), 0u);
+}
+
+TEST(KeyTraceTest, BinaryDump) {
+    auto trace = std::make_unique<KeyTrace>();
+    trace->record(0x61, 0, TRACE_CAPS, 0, 1);
+    trace->record(0x20, 0xFFFF, TRACE_WORD_BREAK, 0, 0);
+
+    char path[] = "/tmp/gonhanh-trace-XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    ASSERT_TRUE(trace->dump(path));
+
+    std::ifstream in(path, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::remove(path);
+
+    ASSERT_EQ(data.size(), sizeof(KeyTraceHeader) + 2 * sizeof(KeyTraceRecord));
+    KeyTraceHeader header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    EXPECT_EQ(std::string(header.magic, 4), "GNKT");
+    EXPECT_EQ(header.version, KeyTrace::FORMAT_VERSION);
+    EXPECT_EQ(header.recordSize, sizeof(KeyTraceRecord));
+    EXPECT_EQ(header.count, 2u);
+
+    KeyTraceRecord second;
+    std::memcpy(&second, data.data() + sizeof(header) + sizeof(KeyTraceRecord), sizeof(second));
+    EXPECT_EQ(second.keysym, 0x20u);
+    EXPECT_EQ(second.flags, TRACE_WORD_BREAK);
+}
@@ -233,6 +233,34 @@ TEST(KeycodeMapTest, VNIVowelKeys) {
     EXPECT_EQ(keysymToMacKeycode(XKB_KEY_8), MacKey::N8);  // ă
 }
 
+// =============================================================================
+// Lookup Table Tests
+// =============================================================================
+
+TEST(KeycodeMapTest, TableMatchesSwitch) {
+    // Every keysym in the tabled pages, plus a sample above them
+    for (uint32_t keysym = 0; keysym < 0x10000; ++keysym) {
+        ASSERT_EQ(keysymToMacKeycode(keysym), detail::switchKeycode(keysym)) << keysym;
+        ASSERT_EQ(isBreakKey(keysym), detail::switchIsBreak(keysym)) << keysym;
+        ASSERT_EQ(isLetterKey(keysym), detail::rangeIsLetter(keysym)) << keysym;
+        ASSERT_EQ(isNumberKey(keysym), detail::rangeIsNumber(keysym)) << keysym;
+    }
+    for (uint32_t keysym : {0x1000041u, 0x1001EA1u, 0x10000FFu, 0xFFFFFFFFu}) {
+        EXPECT_EQ(keysymToMacKeycode(keysym), detail::switchKeycode(keysym));
+        EXPECT_FALSE(isBreakKey(keysym));
+    }
+}
+
+TEST(KeycodeMapTest, LookupPacksCase) {
+    EXPECT_TRUE(lookup(XKB_KEY_A).isUpper());
+    EXPECT_TRUE(lookup(XKB_KEY_A).isLetter());
+    EXPECT_FALSE(lookup(XKB_KEY_a).isUpper());
+    EXPECT_EQ(lookup(XKB_KEY_A).keycode(), lookup(XKB_KEY_a).keycode());
+    EXPECT_TRUE(lookup(XKB_KEY_5).isNumber());
+    EXPECT_TRUE(lookup(XKB_KEY_Escape).isBreak());
+    EXPECT_TRUE(lookup(XKB_KEY_F1).isUnknown());
+}
+
 // =============================================================================
 // Main
 // =============================================================================
@@ -0,0 +1,110 @@
+// Unit tests for LatencyStats
+// Tests histogram bucketing, percentiles and per-thread aggregation
+
+#include <gtest/gtest.h>
+#include "../src/LatencyStats.h"
+
+#include <thread>
+#include <vector>
+
+using namespace GoNhanh;
+
+static const LatencySummary& total(const LatencySnapshot& s) {
+    return s.stages[static_cast<size_t>(LatencyStage::Total)];
+}
+
+// =============================================================================
+// Bucketing
+// =============================================================================
+
+TEST(LatencyHistogramTest, SmallValuesAreExact) {
+    for (uint64_t v = 0; v < LatencyHistogram::SUB_COUNT * 2; ++v) {
+        size_t b = LatencyHistogram::bucketFor(v);
+        EXPECT_EQ(LatencyHistogram::bucketFloor(b), v);
+    }
+}
+
+TEST(LatencyHistogramTest, BucketsAreMonotonicAndBounded) {
+    size_t prev = 0;
+    for (uint64_t v = 1; v < (uint64_t(1) << 40); v = v * 3 / 2 + 1) {
+        size_t b = LatencyHistogram::bucketFor(v);
+        EXPECT_GE(b, prev);
+        EXPECT_LE(LatencyHistogram::bucketFloor(b), v);
+        EXPECT_GT(LatencyHistogram::bucketFloor(b + 1), v);
+        // Relative bucket width stays within 1/16
+        EXPECT_LE(LatencyHistogram::bucketFloor(b + 1) - LatencyHistogram::bucketFloor(b),
+                  v / LatencyHistogram::SUB_COUNT + 1);
+        prev = b;
+    }
+    EXPECT_EQ(LatencyHistogram::bucketFor(UINT64_MAX), LatencyHistogram::BUCKETS - 1);
+}
+
+// =============================================================================
+// Snapshots
+// =============================================================================
+
+TEST(LatencyStatsTest, PercentilesFromRecordedValues) {
+    resetLatency();
+    auto& stats = threadLatency();
+    auto& hist = stats.stages[static_cast<size_t>(LatencyStage::Total)];
+    for (uint64_t i = 1; i <= 1000; ++i) {
+        hist.record(i * 1000);  // 1us .. 1ms
+    }
+
+    LatencySnapshot s = latencySnapshot();
+    EXPECT_EQ(total(s).count, 1000u);
+    EXPECT_NEAR(static_cast<double>(total(s).p50), 500000.0, 500000.0 / 16);
+    EXPECT_NEAR(static_cast<double>(total(s).p99), 990000.0, 990000.0 / 16);
+    EXPECT_GE(total(s).max, 1000000u);
+
+    resetLatency();
+    EXPECT_EQ(total(latencySnapshot()).count, 0u);
+}
+
+TEST(LatencyStatsTest, MergesAllThreads) {
+    resetLatency();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([] {
+            for (int i = 0; i < 100; ++i) {
+                KeyLatencyProbe probe;
+                probe.mark(LatencyStage::Ffi);
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    LatencySnapshot s = latencySnapshot();
+    EXPECT_EQ(total(s).count, 400u);
+    EXPECT_EQ(s.stages[static_cast<size_t>(LatencyStage::Ffi)].count, 400u);
+    EXPECT_EQ(s.stages[static_cast<size_t>(LatencyStage::Commit)].count, 0u);
+}
+
+TEST(LatencyStatsTest, CountsSlowKeys) {
+    resetLatency();
+    {
+        KeyLatencyProbe probe;
+        std::this_thread::sleep_for(std::chrono::nanoseconds(SLOW_KEY_NS * 2));
+    }
+    { KeyLatencyProbe fast; }
+
+    LatencySnapshot s = latencySnapshot();
+    EXPECT_EQ(s.slowKeys, 1u);
+    EXPECT_NE(formatLatency(s).find("slow keys"), std::string::npos);
+}
+
+TEST(LatencyStatsTest, RecordsFirstKeyAfterIdle) {
+    resetLatency();
+    auto& stats = threadLatency();
+    { KeyLatencyProbe first; }
+    EXPECT_EQ(latencySnapshot().afterIdle.count, 0u);  // Back-to-back keys
+
+    stats.lastKeyNs -= IDLE_KEY_NS + 1;  // As if the thread had idled
+    { KeyLatencyProbe afterIdle; }
+    { KeyLatencyProbe next; }
+
+    LatencySnapshot s = latencySnapshot();
+    EXPECT_EQ(s.afterIdle.count, 1u);
+    EXPECT_EQ(total(s).count, 3u);
+    EXPECT_NE(formatLatency(s).find("idle"), std::string::npos);
+}
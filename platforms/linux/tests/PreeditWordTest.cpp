@@ -0,0 +1,149 @@
+// Unit tests for PreeditWord
+// Types text through the core into a simulated preedit-mode client: what is
+// committed, what stays in the preedit and which keys reach the client
+
+#include <gtest/gtest.h>
+#include "../src/KeycodeMap.h"
+#include "../src/PreeditWord.h"
+#include "../src/RustBridge.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+using GoNhanh::EditQueue;
+using GoNhanh::PreeditWord;
+
+namespace {
+
+// A client in preedit mode, driven the way GoNhanhState drives one
+struct Client {
+    RustEngine engine;
+    PreeditWord preedit;
+    std::string committed;
+
+    void apply(int backspace, const std::string& text) {
+        for (; backspace > 0 && !committed.empty(); --backspace) {
+            while ((static_cast<unsigned char>(committed.back()) & 0xC0) == 0x80) {
+                committed.pop_back();
+            }
+            committed.pop_back();
+        }
+        committed += text;
+    }
+
+    // One key: break keys and keys KeycodeMap does not know (Home, é) end
+    // the word and reach the client after it, where they put `typed`;
+    // others go through the engine and PreeditWord::update, and reach the
+    // client only if not absorbed
+    void press(uint32_t keysym, std::string_view typed) {
+        auto info = KeycodeMap::lookup(keysym);
+        if (info.isBreak() || info.isUnknown()) {
+            committed += preedit.take();
+            engine.clear();
+            committed += typed;
+            return;
+        }
+        bool shift = info.isUpper() || (!info.isLetter() && !info.isNumber());
+        KeyOutput output;
+        engine.processKey(info.keycode(), info.isUpper(), false, shift, output);
+        std::string word;
+        size_t length = engine.getBuffer(word);
+
+        EditQueue commit;
+        bool absorbed =
+            preedit.update(std::move(word), length, output.backspace, output.view(), commit);
+        commit.flush([this](int backspace, const std::string& text) { apply(backspace, text); });
+        if (!absorbed) {
+            committed += typed;
+        }
+    }
+
+    // ASCII typed one byte per key
+    void type(std::string_view text) {
+        for (char c : text) {
+            press(static_cast<unsigned char>(c), std::string_view(&c, 1));
+        }
+    }
+};
+
+} // namespace
+
+TEST(PreeditWordTest, WordStaysInPreeditUntilBreak) {
+    Client client;
+    client.type("vieetj");
+    EXPECT_EQ(client.committed, "");
+    EXPECT_EQ(client.preedit.text(), "việt");
+    EXPECT_EQ(client.preedit.length(), 4u);
+
+    client.type(" ");
+    EXPECT_EQ(client.committed, "việt ");
+    EXPECT_TRUE(client.preedit.empty());
+}
+
+TEST(PreeditWordTest, KeyEndingWordCommitsItAndPassesThrough) {
+    // Telex "!", "@" and "^" leave the buffer empty without changing anything
+    Client client;
+    client.type("a!");
+    EXPECT_EQ(client.committed, "a!");
+    EXPECT_TRUE(client.preedit.empty());
+
+    client.type("vieetj@ b^");
+    EXPECT_EQ(client.committed, "a!việt@ b^");
+    EXPECT_TRUE(client.preedit.empty());
+}
+
+TEST(PreeditWordTest, UnknownKeyCommitsWordFirst) {
+    // Keys outside KeycodeMap reach the client after the word, not inside it
+    Client client;
+    client.type("vieetj");
+    client.press(XKB_KEY_Home, "<Home>");
+    EXPECT_EQ(client.committed, "việt<Home>");
+    EXPECT_TRUE(client.preedit.empty());
+
+    client.type("tooi");
+    client.press(XKB_KEY_eacute, "é");
+    client.type("a");
+    EXPECT_EQ(client.committed, "việt<Home>tôié");
+    EXPECT_EQ(client.preedit.text(), "a");
+}
+
+TEST(PreeditWordTest, PassThroughWithoutWord) {
+    Client client;
+    client.type("!!");
+    EXPECT_EQ(client.committed, "!!");
+    EXPECT_TRUE(client.preedit.empty());
+}
+
+TEST(PreeditWordTest, EndedWordIsEditedByOutput) {
+    // The output rewrites the end of the word that leaves the preedit
+    PreeditWord preedit;
+    preedit.set("việt", 4);
+    EditQueue commit;
+    EXPECT_TRUE(preedit.update({}, 0, 2, "et!", commit));
+    EXPECT_TRUE(preedit.empty());
+
+    int backspace = -1;
+    std::string text;
+    commit.flush([&](int b, const std::string& t) {
+        backspace = b;
+        text = t;
+    });
+    EXPECT_EQ(backspace, 0);
+    EXPECT_EQ(text, "viet!");
+}
+
+TEST(PreeditWordTest, DeletionsBeyondPreeditReachCommittedText) {
+    PreeditWord preedit;
+    preedit.set("a", 1);
+    EditQueue commit;
+    EXPECT_TRUE(preedit.update("b", 1, 3, "b", commit));
+    EXPECT_EQ(preedit.text(), "b");
+
+    int backspace = -1;
+    commit.flush([&](int b, const std::string& text) {
+        backspace = b;
+        EXPECT_EQ(text, "");
+    });
+    EXPECT_EQ(backspace, 2);
+}
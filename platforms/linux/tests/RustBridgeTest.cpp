@@ -1,9 +1,12 @@
-// Unit tests for RustBridge UTF-8 conversion
-// Tests codePointToUtf8() function for Vietnamese character handling
+// Unit tests for RustBridge
+// Tests codePointToUtf8() and per-context RustEngine instances
 
 #include <gtest/gtest.h>
 #include "../src/RustBridge.h"
 
+#include <thread>
+#include <vector>
+
 // =============================================================================
 // UTF-8 Conversion Tests - ASCII
 // =============================================================================
@@ -174,6 +177,328 @@ TEST(RustBridgeTest, Utf8CommonVietnameseChars) {
     EXPECT_EQ(RustBridge::codePointToUtf8(0x00F2), "\xC3\xB2");      // ò
 }
 
+// =============================================================================
+// Per-Context Engine Tests
+// =============================================================================
+
+// macOS keycodes (see src/KeycodeMap.h)
+constexpr uint16_t KEY_A = 0;
+constexpr uint16_t KEY_S = 1;
+constexpr uint16_t KEY_N1 = 18;
+
+TEST(RustEngineTest, TelexToneMark) {
+    RustEngine engine;
+    engine.setMethod(InputMethod::Telex);
+
+    EXPECT_EQ(engine.processKey(KEY_A, false, false, false), std::make_pair(0, std::string()));
+    // "as" -> "á": delete 'a', insert 'á'
+    EXPECT_EQ(engine.processKey(KEY_S, false, false, false), std::make_pair(1, std::string("\xC3\xA1")));
+}
+
+TEST(RustEngineTest, InstancesKeepIndependentBuffers) {
+    RustEngine first;
+    RustEngine second;
+
+    // Start a word in the first context, then switch to the second
+    first.processKey(KEY_A, false, false, false);
+    second.processKey(KEY_A, false, false, false);
+    second.clear();
+
+    // Clearing the second context must not wipe the first one's buffer
+    auto [backspace, text] = first.processKey(KEY_S, false, false, false);
+    EXPECT_EQ(backspace, 1);
+    EXPECT_EQ(text, "\xC3\xA1");
+}
+
+TEST(RustEngineTest, InstancesKeepIndependentSettings) {
+    RustEngine telex;
+    RustEngine vni;
+    vni.setMethod(InputMethod::VNI);
+
+    telex.processKey(KEY_A, false, false, false);
+    vni.processKey(KEY_A, false, false, false);
+
+    // '1' is a VNI tone key but plain text in Telex
+    EXPECT_EQ(vni.processKey(KEY_N1, false, false, false).second, "\xC3\xA1");
+    EXPECT_EQ(telex.processKey(KEY_N1, false, false, false).first, 0);
+}
+
+TEST(RustEngineTest, Utf8OutputFromCore) {
+    constexpr uint16_t KEY_D = 2;
+    RustEngine engine;
+    KeyOutput output;
+
+    // "dd" -> "đ" (U+0111), delivered as UTF-8 bytes by the core
+    EXPECT_FALSE(engine.processKey(KEY_D, true, false, false, output));
+    EXPECT_TRUE(engine.processKey(KEY_D, false, false, false, output));
+    EXPECT_EQ(output.backspace, 1);
+    EXPECT_EQ(output.view(), "\xC4\x90");  // Đ (first key was uppercase)
+}
+
+TEST(RustEngineTest, CompactResultsSpillLongText) {
+    constexpr uint16_t KEY_V = 9, KEY_N = 45, KEY_SPACE = 49;
+    EXPECT_TRUE(RustBridge::compactResults());  // Core built from this tree
+
+    // Longer than the compact result's inline bytes: arrives via the spill
+    ShortcutTable table;
+    table.add("vn", "Cộng hòa Xã hội chủ nghĩa Việt Nam");
+    RustEngine engine;
+    engine.setShortcuts(table);
+    KeyOutput output;
+    engine.processKey(KEY_V, false, false, false, output);
+    engine.processKey(KEY_N, false, false, false, output);
+    EXPECT_TRUE(engine.processKey(KEY_SPACE, false, false, false, output));
+    EXPECT_EQ(output.backspace, 2);
+    EXPECT_EQ(output.view(), "Cộng hòa Xã hội chủ nghĩa Việt Nam ");
+    EXPECT_GT(output.length, static_cast<size_t>(IME_COMPACT_INLINE));
+}
+
+TEST(RustEngineTest, BackspaceRunSkipsCore) {
+    constexpr uint16_t KEY_DELETE = 51;
+    RustEngine engine;
+    KeyOutput output;
+
+    // The first Backspace after a word goes in; the rest are proven no-ops
+    EXPECT_FALSE(engine.passesThrough(KEY_DELETE, false));
+    EXPECT_FALSE(engine.processKey(KEY_DELETE, false, false, false, output));
+    EXPECT_TRUE(engine.passesThrough(KEY_DELETE, false));
+    EXPECT_FALSE(engine.passesThrough(KEY_DELETE, true));
+    EXPECT_FALSE(engine.passesThrough(KEY_A, false));
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_FALSE(engine.processKey(KEY_DELETE, false, false, false, output));
+        EXPECT_TRUE(output.empty());
+    }
+    EXPECT_EQ(engine.skippedKeys(), 3u);
+
+    // Typing resumes as if every Backspace had reached the core
+    engine.processKey(KEY_A, false, false, false, output);
+    EXPECT_FALSE(engine.passesThrough(KEY_DELETE, false));
+    EXPECT_TRUE(engine.processKey(KEY_S, false, false, false, output));
+    EXPECT_EQ(output.view(), "á");
+
+    // Changing the engine drops the summary
+    engine.processKey(KEY_DELETE, false, false, false, output);
+    engine.processKey(KEY_DELETE, false, false, false, output);
+    EXPECT_TRUE(engine.passesThrough(KEY_DELETE, false));
+    engine.setEnabled(false);
+    EXPECT_FALSE(engine.passesThrough(KEY_DELETE, false));
+}
+
+TEST(RustEngineTest, BatchCoalescesEdits) {
+    constexpr uint16_t KEY_V = 9, KEY_I = 34, KEY_E = 14, KEY_T = 17, KEY_J = 38;
+    RustEngine engine;
+
+    // "vieetj" as one burst: a single net insert instead of six edits
+    const ImeKeyEvent events[] = {
+        {KEY_V, false, false, false, 0}, {KEY_I, false, false, false, 0},
+        {KEY_E, false, false, false, 0}, {KEY_E, false, false, false, 0},
+        {KEY_T, false, false, false, 0}, {KEY_J, false, false, false, 0},
+    };
+    BatchOutput output = engine.processKeys(events, 6);
+    EXPECT_EQ(output.consumed, 6u);
+    EXPECT_EQ(output.backspace, 0);
+    EXPECT_EQ(output.text, "vi\xE1\xBB\x87t");  // việt
+}
+
+TEST(RustEngineTest, BatchDeletesTextBeforeBurst) {
+    RustEngine engine;
+    engine.processKey(KEY_A, false, false, false);  // "a" already committed
+
+    const ImeKeyEvent events[] = {{KEY_S, false, false, false, 0}};
+    BatchOutput output = engine.processKeys(events, 1);
+    EXPECT_EQ(output.backspace, 1);
+    EXPECT_EQ(output.text, "\xC3\xA1");
+}
+
+TEST(RustEngineTest, BatchStopsAtControlKey) {
+    constexpr uint16_t KEY_LEFT = 123;
+    RustEngine engine;
+
+    const ImeKeyEvent events[] = {
+        {KEY_A, false, false, false, 0}, {KEY_LEFT, false, false, false, 0},
+        {KEY_A, false, false, false, 0},
+    };
+    BatchOutput output = engine.processKeys(events, 3);
+    EXPECT_EQ(output.consumed, 1u);
+    EXPECT_EQ(output.text, "a");
+}
+
+TEST(RustEngineTest, DisabledPassesThrough) {
+    RustEngine engine;
+    engine.setEnabled(false);
+
+    engine.processKey(KEY_A, false, false, false);
+    EXPECT_EQ(engine.processKey(KEY_S, false, false, false), std::make_pair(0, std::string()));
+}
+
+TEST(RustEngineTest, SharedShortcutTable) {
+    constexpr uint16_t KEY_V = 9, KEY_N = 45, KEY_SPACE = 49;
+    ShortcutTable table;
+    EXPECT_EQ(table.load("# comment\nvn=Việt Nam\nhn=Hà Nội"), 2u);
+    table.add("->", "→");
+    EXPECT_EQ(table.size(), 3u);
+
+    RustEngine first;
+    RustEngine second;
+    first.setShortcuts(table);
+    second.setShortcuts(table);
+    table = ShortcutTable();  // Engines keep the shared entries
+    EXPECT_EQ(table.size(), 0u);
+
+    for (RustEngine* engine : {&first, &second}) {
+        engine->processKey(KEY_V, false, false, false);
+        engine->processKey(KEY_N, false, false, false);
+        auto [backspace, text] = engine->processKey(KEY_SPACE, false, false, false);
+        EXPECT_EQ(backspace, 2);
+        EXPECT_EQ(text, "Việt Nam ");
+    }
+}
+
+TEST(RustEngineTest, ResumeWordBeforeCursor) {
+    RustEngine engine;
+    engine.setMethod(InputMethod::Telex);
+
+    // "tôi viêt| nam": cursor (codepoint offset 8) right after "viêt"
+    EXPECT_EQ(engine.resumeWord("tôi viêt nam", 8), 4u);
+    std::string word;
+    engine.processKey(KEY_S, false, false, false);
+    engine.getBuffer(word);
+    EXPECT_EQ(word, "viết");
+}
+
+TEST(RustEngineTest, ResumeWordSkipsMidWordAndLongWords) {
+    RustEngine engine;
+    std::string word;
+
+    EXPECT_EQ(engine.resumeWord("viêt", 2), 0u);            // Cursor inside the word
+    EXPECT_EQ(engine.resumeWord("tôi ", 4), 0u);            // After a break
+    EXPECT_EQ(engine.resumeWord("keyboards", 9), 0u);       // Longer than a syllable
+    EXPECT_EQ(engine.resumeWord("nghiêng", 7), 7u);         // Longest syllable fits
+    EXPECT_EQ(engine.resumeWord("ab", 99), 0u);             // Already composing
+    engine.getBuffer(word);
+    EXPECT_EQ(word, "nghiêng");
+}
+
+TEST(RustEngineTest, ReplayedKeysRestoreWordState) {
+    // What WordHistory replays: unlike resumeWord, the raw keys bring back
+    // the transform, so a repeated tone key still undoes it
+    RustEngine engine;
+    engine.setMethod(InputMethod::Telex);
+    const ImeKeyEvent keys[] = {{KEY_A, false, false, false, 0}, {KEY_S, false, false, false, 0}};
+    engine.processKeys(keys, 2);
+    engine.clear();
+    engine.processKeys(keys, 2);
+
+    EXPECT_EQ(engine.processKey(KEY_S, false, false, false), std::make_pair(1, std::string("as")));
+}
+
+TEST(RustEngineTest, EvictedEngineResumesTheWord) {
+    RustEngine engine;
+    engine.setMethod(InputMethod::Telex);
+    engine.processKey(KEY_A, false, false, false);
+    size_t live = engine.memoryBytes();
+
+    ASSERT_TRUE(engine.evict());
+    EXPECT_TRUE(engine.evicted());
+    EXPECT_LT(engine.memoryBytes(), live);
+
+    // The next key rebuilds the engine from the settings and keys kept
+    EXPECT_EQ(engine.processKey(KEY_S, false, false, false), std::make_pair(1, std::string("\xC3\xA1")));
+    EXPECT_FALSE(engine.evicted());
+}
+
+TEST(RustEngineTest, EvictedEngineKeepsSettingsAndShortcuts) {
+    constexpr uint16_t KEY_V = 9, KEY_N = 45, KEY_SPACE = 49;
+    RustEngine engine;
+    engine.setMethod(InputMethod::Telex);
+    ASSERT_TRUE(engine.evict());
+
+    // Changes while evicted are recorded without rebuilding the engine
+    engine.setMethod(InputMethod::VNI);
+    ShortcutTable table;
+    table.load("vn=Việt Nam");
+    engine.setShortcuts(table);
+    engine.clear();
+    EXPECT_TRUE(engine.evicted());
+    std::string word;
+    EXPECT_EQ(engine.getBuffer(word), 0u);
+    EXPECT_TRUE(engine.evicted());
+
+    EXPECT_EQ(engine.processKey(KEY_A, false, false, false), std::make_pair(0, std::string()));
+    EXPECT_EQ(engine.processKey(KEY_N1, false, false, false), std::make_pair(1, std::string("\xC3\xA1")));
+    engine.clear();
+    ASSERT_TRUE(engine.evict());
+    engine.processKey(KEY_V, false, false, false);
+    engine.processKey(KEY_N, false, false, false);
+    EXPECT_EQ(engine.processKey(KEY_SPACE, false, false, false),
+              std::make_pair(2, std::string("Việt Nam ")));
+}
+
+TEST(RustEngineTest, EvictionKeepsResumedWord) {
+    RustEngine engine;
+    engine.setMethod(InputMethod::Telex);
+    ASSERT_EQ(engine.resumeWord("viêt", 4), 4u);
+    ASSERT_TRUE(engine.evict());
+
+    std::string word;
+    engine.processKey(KEY_S, false, false, false);
+    engine.getBuffer(word);
+    EXPECT_EQ(word, "viết");
+}
+
+// =============================================================================
+// Global Bridge Tests
+// =============================================================================
+
+TEST(RustBridgeTest, KeysAndSettingsFromManyThreads) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([] {
+            KeyOutput output;
+            for (int i = 0; i < 2000; ++i) {
+                RustBridge::processKey(i % 2 ? KEY_S : KEY_A, false, false, false, output);
+            }
+        });
+    }
+    threads.emplace_back([] {
+        for (int i = 0; i < 2000; ++i) {
+            RustBridge::setMethod(i % 2 ? InputMethod::VNI : InputMethod::Telex);
+            RustBridge::setEnabled(i % 3 != 0);
+        }
+    });
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    // The last settings stored win
+    RustBridge::setEnabled(true);
+    RustBridge::setMethod(InputMethod::VNI);
+    RustBridge::clear();
+    KeyOutput output;
+    RustBridge::processKey(KEY_A, false, false, false, output);
+    EXPECT_TRUE(RustBridge::processKey(KEY_N1, false, false, false, output));
+    EXPECT_EQ(output.view(), "\xC3\xA1");
+    RustBridge::clear();
+}
+
+TEST(RustBridgeTest, PrefetchKeepsTheWordBeingTyped) {
+    RustBridge::setMethod(InputMethod::Telex);
+    RustBridge::clear();
+    RustBridge::processKey(KEY_A, false, false, false);
+    RustBridge::prefetch();
+    EXPECT_EQ(RustBridge::processKey(KEY_S, false, false, false),
+              std::make_pair(1, std::string("\xC3\xA1")));
+    RustBridge::clear();
+}
+
+TEST(RustBridgeTest, LocksCoreMemory) {
+    size_t locked = RustBridge::lockCoreMemory();
+    if (locked == 0) {
+        GTEST_SKIP() << "mlock not permitted here (RLIMIT_MEMLOCK)";
+    }
+    EXPECT_EQ(RustBridge::lockCoreMemory(false), locked);
+}
+
 // =============================================================================
 // Main
 // =============================================================================
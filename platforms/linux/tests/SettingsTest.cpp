@@ -0,0 +1,247 @@
+// Unit tests for Settings
+// Tests settings file parsing and legacy method file fallback
+
+#include <gtest/gtest.h>
+#include "../src/Settings.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+using GoNhanh::Settings;
+
+static Settings parse(const std::string& text, Settings settings = {}) {
+    std::istringstream in(text);
+    GoNhanh::parseSettings(in, settings);
+    return settings;
+}
+
+// =============================================================================
+// Parsing
+// =============================================================================
+
+TEST(SettingsTest, DefaultsWhenEmpty) {
+    EXPECT_EQ(parse(""), Settings{});
+}
+
+TEST(SettingsTest, ParsesAllKeys) {
+    Settings s = parse(
+        "# comment\n"
+        "method=vni\n"
+        "modern = false\n"
+        "free_tone=on\n"
+        "english_auto_restore=1\n"
+        "auto_capitalize=true\r\n"
+        "\n"
+        "[shortcuts]\n"
+        "vn=Việt Nam\n"
+        "->=→\n");
+
+    EXPECT_EQ(s.method, InputMethod::VNI);
+    EXPECT_FALSE(s.modern);
+    EXPECT_TRUE(s.freeTone);
+    EXPECT_TRUE(s.englishAutoRestore);
+    EXPECT_TRUE(s.autoCapitalize);
+    ASSERT_EQ(s.shortcuts.size(), 2u);
+    EXPECT_EQ(s.shortcuts[0].first, "vn");
+    EXPECT_EQ(s.shortcuts[0].second, "Việt Nam");
+    EXPECT_EQ(s.shortcuts[1].first, "->");
+}
+
+TEST(SettingsTest, ParsesEngineToggles) {
+    Settings s = parse(
+        "allow_foreign_consonants=true\n"
+        "esc_restore=true\n"
+        "skip_w_shortcut=true\n"
+        "bracket_shortcut=true\n"
+        "terminal_apps= konsole , kitty,,\n"
+        "async_commit=false\n"
+        "candidates=5\n"
+        "keep_warm=true\n"
+        "lock_memory=true\n"
+        "evict_idle=60\n"
+        "key_trace=true\n"
+        "key_record=true\n"
+        "key_log_sample=50\n");
+
+    EXPECT_TRUE(s.allowForeignConsonants);
+    EXPECT_TRUE(s.escRestore);
+    EXPECT_TRUE(s.skipWShortcut);
+    EXPECT_TRUE(s.bracketShortcut);
+    EXPECT_EQ(s.terminalApps, (std::vector<std::string>{"konsole", "kitty"}));
+    EXPECT_FALSE(s.asyncCommit);
+    EXPECT_EQ(s.candidates, 5u);
+    EXPECT_TRUE(s.keepWarm);
+    EXPECT_TRUE(s.lockMemory);
+    EXPECT_EQ(s.evictIdle, 60u);
+    EXPECT_TRUE(s.keyTrace);
+    EXPECT_TRUE(s.keyRecord);
+    EXPECT_EQ(s.keyLogSample, 50u);
+    EXPECT_TRUE(s.isTerminal("kitty"));
+    EXPECT_FALSE(s.isTerminal("firefox"));
+}
+
+TEST(SettingsTest, DefaultsMatchCore) {
+    Settings s;
+    EXPECT_EQ(s.method, InputMethod::Telex);
+    EXPECT_TRUE(s.modern);
+    EXPECT_FALSE(s.englishAutoRestore);
+    EXPECT_TRUE(s.isTerminal("gnome-terminal-server"));
+}
+
+TEST(SettingsTest, InvalidValuesKeepPrevious) {
+    Settings base;
+    base.method = InputMethod::VNI;
+    base.modern = false;
+
+    Settings s = parse("method=dvorak\nmodern=maybe\nkey_log_sample=-1\nunknown=1\ngarbage\n", base);
+    EXPECT_EQ(s.method, InputMethod::VNI);
+    EXPECT_FALSE(s.modern);
+    EXPECT_EQ(s.keyLogSample, 1u);
+    EXPECT_EQ(parse("candidates=50\n").candidates, Settings::MAX_CANDIDATES);
+}
+
+TEST(SettingsTest, ShortcutSectionReplacesList) {
+    Settings base;
+    base.shortcuts = {{"old", "cũ"}};
+
+    EXPECT_EQ(parse("free_tone=true\n", base).shortcuts, base.shortcuts);
+    Settings s = parse("[shortcuts]\nhn=Hà Nội\n", base);
+    ASSERT_EQ(s.shortcuts.size(), 1u);
+    EXPECT_EQ(s.shortcuts[0].first, "hn");
+}
+
+TEST(SettingsTest, KeysAfterOtherSectionAreIgnored) {
+    Settings s = parse("[ui]\nfree_tone=true\n");
+    EXPECT_FALSE(s.freeTone);
+}
+
+// =============================================================================
+// Per-app profiles
+// =============================================================================
+
+TEST(SettingsTest, ParsesAppProfiles) {
+    Settings s = parse(
+        "method=telex\n"
+        "[app code]\n"
+        "method=vni\n"
+        "composition=preedit\n"
+        "[app kitty]\n"
+        "enabled=false\n"
+        "[app ]\n"
+        "enabled=false\n");
+
+    ASSERT_EQ(s.apps.size(), 2u);
+    EXPECT_EQ(s.apps["code"].method, InputMethod::VNI);
+    EXPECT_EQ(s.apps["code"].mode, GoNhanh::CompositionMode::Preedit);
+    EXPECT_FALSE(s.apps["code"].enabled.has_value());
+    EXPECT_EQ(s.apps["kitty"].enabled, false);
+    EXPECT_EQ(s.method, InputMethod::Telex);  // Sections do not touch globals
+}
+
+TEST(SettingsTest, ProfileLayersOverGlobals) {
+    Settings s = parse(
+        "english_auto_restore=true\n"
+        "[app firefox]\n"
+        "method=vni\n"
+        "[app konsole]\n"
+        "english_auto_restore=true\n");
+
+    auto plain = s.profileFor("gedit");
+    EXPECT_TRUE(plain.enabled);
+    EXPECT_EQ(plain.method, InputMethod::Telex);
+    EXPECT_EQ(plain.mode, GoNhanh::CompositionMode::Surrounding);
+    EXPECT_TRUE(plain.englishAutoRestore);
+
+    EXPECT_FALSE(s.profileFor("kitty").englishAutoRestore);   // Terminal
+    EXPECT_TRUE(s.profileFor("konsole").englishAutoRestore);  // Profile wins
+    EXPECT_EQ(s.profileFor("firefox").method, InputMethod::VNI);
+    EXPECT_EQ(s.profileFor("gedit", true).mode, GoNhanh::CompositionMode::Preedit);
+}
+
+
+// =============================================================================
+// Loading from a config directory
+// =============================================================================
+
+class SettingsDirTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        char tmpl[] = "/tmp/gonhanh-settings-XXXXXX";
+        ASSERT_NE(mkdtemp(tmpl), nullptr);
+        dir_ = tmpl;
+    }
+
+    void TearDown() override {
+        std::remove((dir_ + "/method").c_str());
+        std::remove((dir_ + "/settings").c_str());
+        std::remove((dir_ + "/shortcuts").c_str());
+        rmdir(dir_.c_str());
+    }
+
+    void write(const std::string& name, const std::string& text) {
+        std::ofstream(dir_ + "/" + name) << text;
+    }
+
+    std::string dir_;
+};
+
+TEST_F(SettingsDirTest, MissingFilesGiveDefaults) {
+    EXPECT_EQ(GoNhanh::loadSettings(dir_), Settings{});
+    EXPECT_EQ(GoNhanh::loadSettings(""), Settings{});
+}
+
+TEST_F(SettingsDirTest, LegacyMethodFile) {
+    write("method", "vni\n");
+    EXPECT_EQ(GoNhanh::loadSettings(dir_).method, InputMethod::VNI);
+}
+
+TEST_F(SettingsDirTest, SettingsFileOverridesLegacyMethod) {
+    write("method", "vni\n");
+    write("settings", "free_tone=true\n");
+    EXPECT_EQ(GoNhanh::loadSettings(dir_).method, InputMethod::VNI);
+
+    write("settings", "method=telex\n");
+    EXPECT_EQ(GoNhanh::loadSettings(dir_).method, InputMethod::Telex);
+}
+
+TEST_F(SettingsDirTest, ShortcutFileMergesWithSection) {
+    Settings settings;
+    settings.shortcuts = {{"vn", "Việt Nam"}, {"hn", "Hà Nội"}};
+    EXPECT_EQ(GoNhanh::loadShortcuts(dir_, settings).size(), 2u);
+
+    std::string file = "# user list\nvn=Viet Nam\n";
+    for (int i = 0; i < 10000; ++i) {
+        file += "k" + std::to_string(i) + "=expansion " + std::to_string(i) + "\n";
+    }
+    write("shortcuts", file);
+    EXPECT_EQ(GoNhanh::loadShortcuts(dir_, settings).size(), 10002u);
+    EXPECT_EQ(GoNhanh::loadShortcuts("", settings).size(), 2u);
+}
+
+TEST_F(SettingsDirTest, SaveRoundTrips) {
+    Settings settings;
+    settings.method = InputMethod::VNI;
+    settings.modern = false;
+    settings.escRestore = true;
+    settings.terminalApps = {"foot"};
+    settings.asyncCommit = false;
+    settings.candidates = 3;
+    settings.keepWarm = true;
+    settings.lockMemory = true;
+    settings.evictIdle = 0;
+    settings.keyTrace = true;
+    settings.keyRecord = true;
+    settings.keyLogSample = 100;
+    settings.shortcuts = {{"vn", "Việt Nam"}};
+    settings.apps["code"].mode = GoNhanh::CompositionMode::Preedit;
+    settings.apps["kitty"].enabled = false;
+    settings.apps["kitty"].englishAutoRestore = true;
+    settings.apps["firefox"].method = InputMethod::VNI;
+
+    ASSERT_TRUE(GoNhanh::saveSettings(dir_, settings));
+    EXPECT_EQ(GoNhanh::loadSettings(dir_), settings);
+    EXPECT_FALSE(GoNhanh::saveSettings("", settings));
+}
@@ -0,0 +1,135 @@
+// Unit tests for TextConverter
+// Tests the word scanner against KeycodeMap, conversion of typed text, and
+// that the word cache, chunking and threads change nothing but speed
+
+#include <gtest/gtest.h>
+#include "../src/KeycodeMap.h"
+#include "../src/TextConverter.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+using GoNhanh::TextConverter;
+
+namespace {
+
+// A byte that reaches the engine: a key that neither breaks words nor is
+// unknown (printable ASCII is its own keysym)
+bool isWordByte(unsigned char c) {
+    return c >= 0x20 && c < 0x7F && !KeycodeMap::isBreakKey(c) &&
+           !KeycodeMap::lookup(c).isUnknown();
+}
+
+// Reference: every word typed into one reset engine, no cache, no threads
+std::string convertSlowly(const std::string& text) {
+    RustEngine engine;
+    std::string out;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        if (!isWordByte(text[pos])) {
+            out += text[pos++];
+            continue;
+        }
+        std::vector<ImeKeyEvent> events;
+        size_t start = pos;
+        for (; pos < text.size() && isWordByte(text[pos]); ++pos) {
+            auto info = KeycodeMap::lookup(static_cast<unsigned char>(text[pos]));
+            bool shift = info.isUpper() || (!info.isLetter() && !info.isNumber());
+            events.push_back({info.keycode(), info.isUpper(), false, shift, 0});
+        }
+        engine.clearAll();
+        BatchOutput result = engine.processKeys(events.data(), events.size());
+        out += result.consumed == events.size() && result.backspace == 0
+                   ? result.text
+                   : text.substr(start, pos - start);
+    }
+    return out;
+}
+
+// Telex-typed words, punctuation and text that is already Vietnamese
+std::string sampleText(size_t bytes, unsigned seed) {
+    static const char* const words[] = {
+        "Vieetj", "Nam", "xin", "chaof", "tooi", "ddi", "hocj", "theories", "laureate",
+        "dduwowcj", "khoong", "ngheef", "truwowngf", "the", "and", "windows", "2024",
+        "100%", "A", "uw", "oo", "phở", "việt", "qqq", "HOCJ", "Tieengs"};
+    static const char* const breaks[] = {" ", " ", " ", ", ", ". ", "\n", "\t", "-", "\"", "…"};
+    std::mt19937 rng(seed);
+    std::string text;
+    while (text.size() < bytes) {
+        text += words[rng() % (sizeof(words) / sizeof(words[0]))];
+        text += breaks[rng() % (sizeof(breaks) / sizeof(breaks[0]))];
+    }
+    return text;
+}
+
+} // namespace
+
+TEST(TextConverterTest, ScannerMatchesKeycodeMap) {
+    // Every byte at every offset of a 16-byte step and the scalar tail
+    for (unsigned b = 0; b < 256; ++b) {
+        for (size_t at = 0; at < 40; ++at) {
+            std::string words(48, 'a');
+            words[at] = static_cast<char>(b);
+            std::string gaps(48, ' ');
+            gaps[at] = static_cast<char>(b);
+            bool word = isWordByte(static_cast<unsigned char>(b));
+            ASSERT_EQ(TextConverter::wordLength(words.data(), words.size()), word ? 48 : at)
+                << "byte " << b << " at " << at;
+            ASSERT_EQ(TextConverter::gapLength(gaps.data(), gaps.size()), word ? at : 48)
+                << "byte " << b << " at " << at;
+        }
+    }
+    EXPECT_EQ(TextConverter::wordLength("abc", 0), 0u);
+}
+
+TEST(TextConverterTest, ConvertsWordsBetweenBreaks) {
+    TextConverter converter(1);
+    EXPECT_EQ(converter.convert("Vieetj Nam, xin chaof. Tooi ddi hocj.\n"),
+              "Việt Nam, xin chào. Tôi đi học.\n");
+    // Text that is not keys stays as it is and ends the word
+    EXPECT_EQ(converter.convert("Hà Nội 99%\x01"), "Hà Nội 99%\x01");
+    EXPECT_EQ(converter.convert(""), "");
+}
+
+TEST(TextConverterTest, EnginesConfiguredBySetup) {
+    TextConverter converter(2, [](RustEngine& engine) { engine.setMethod(InputMethod::VNI); });
+    EXPECT_EQ(converter.threads(), 2u);
+    EXPECT_EQ(converter.convert("Vie65t Nam"), "Việt Nam");
+}
+
+TEST(TextConverterTest, CacheAndThreadsMatchOneEngine) {
+    // Several chunks, each word seen many times
+    std::string text = sampleText(3 * TextConverter::CHUNK_BYTES, 1);
+    std::string expected = convertSlowly(text);
+    for (size_t threads : {1, 3}) {
+        TextConverter converter(threads);
+        EXPECT_EQ(converter.convert(text), expected) << threads << " threads";
+        EXPECT_EQ(converter.convert(text), expected) << threads << " threads, warm cache";
+    }
+}
+
+TEST(TextConverterTest, LongUnchangedRunsAreNotCopied) {
+    std::string text = std::string(1000, '1') + " vieetj";
+    TextConverter converter(1);
+    std::vector<std::string_view> pieces;
+    converter.convert(text, [&](const std::string_view* p, size_t n) {
+        pieces.assign(p, p + n);
+        return true;
+    });
+    ASSERT_EQ(pieces.size(), 2u);
+    EXPECT_EQ(pieces[0].data(), text.data());
+    EXPECT_EQ(pieces[0].size(), 1001u);
+    EXPECT_EQ(pieces[1], "việt");
+}
+
+TEST(TextConverterTest, SinkStopsConversion) {
+    std::string text = sampleText(8 * TextConverter::CHUNK_BYTES, 2);
+    TextConverter converter(3);
+    size_t calls = 0;
+    EXPECT_FALSE(converter.convert(text, [&](const std::string_view*, size_t) {
+        ++calls;
+        return false;
+    }));
+    EXPECT_EQ(calls, 1u);
+}
@@ -0,0 +1,132 @@
+// Unit tests for WordDict
+// Tests compilation, prefix top-k lookup, diacritic matching and file mapping
+
+#include <gtest/gtest.h>
+#include "../src/WordDict.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using GoNhanh::WordDict;
+
+static WordDict compiled(const std::string& lines) {
+    WordDict dict;
+    EXPECT_TRUE(dict.load(WordDict::compile(lines)));
+    return dict;
+}
+
+static std::vector<std::string> lookup(const WordDict& dict, const std::string& prefix, size_t k = 5) {
+    std::string_view out[16];
+    size_t n = dict.lookup(prefix, k, out);
+    return std::vector<std::string>(out, out + n);
+}
+
+// =============================================================================
+// Folding and case
+// =============================================================================
+
+TEST(WordDictTest, FoldRemovesDiacritics) {
+    EXPECT_EQ(WordDict::fold("Việt Nam"), "viet nam");
+    EXPECT_EQ(WordDict::fold("đường"), "duong");
+    EXPECT_EQ(WordDict::fold("ẤY"), "ay");
+}
+
+TEST(WordDictTest, MatchCaseFollowsTypedText) {
+    EXPECT_EQ(WordDict::matchCase("việt nam", "vi"), "việt nam");
+    EXPECT_EQ(WordDict::matchCase("việt nam", "Vi"), "Việt nam");
+    EXPECT_EQ(WordDict::matchCase("đường", "ĐƯ"), "ĐƯỜNG");
+    EXPECT_EQ(WordDict::matchCase("điện", "Đ"), "Điện");
+}
+
+// =============================================================================
+// Lookup
+// =============================================================================
+
+TEST(WordDictTest, MostFrequentFirst) {
+    WordDict dict = compiled("việc\t50\nviệt\t80\nviết\t30\nviệt nam\t60\nvề\t90\n");
+    EXPECT_EQ(dict.size(), 5u);
+    EXPECT_EQ(lookup(dict, "vi"), (std::vector<std::string>{"việt", "việt nam", "việc", "viết"}));
+    EXPECT_EQ(lookup(dict, "vi", 2), (std::vector<std::string>{"việt", "việt nam"}));
+}
+
+TEST(WordDictTest, TypedDiacriticsMustMatch) {
+    WordDict dict = compiled("việc\t50\nviệt\t80\nviết\t30\nviên\t20\n"
+                             "ngôi\t50\nngọt\t40\nngon\t30\n");
+    // ô typed: only circumflex words; untyped marks match anything
+    EXPECT_EQ(lookup(dict, "ngô"), (std::vector<std::string>{"ngôi"}));
+    EXPECT_EQ(lookup(dict, "ngo"), (std::vector<std::string>{"ngôi", "ngọt", "ngon"}));
+    // Tone typed before the word is complete (nặng)
+    EXPECT_EQ(lookup(dict, "việ"), (std::vector<std::string>{"việt", "việc"}));
+}
+
+TEST(WordDictTest, ToneMatchesAnywhereInFirstSyllable) {
+    WordDict dict = compiled("hóa\t10\nhoa\t5\n");
+    EXPECT_EQ(lookup(dict, "hoá"), (std::vector<std::string>{"hóa"}));
+}
+
+TEST(WordDictTest, SkipsTypedWordAndUnknownPrefixes) {
+    WordDict dict = compiled("an\t10\nanh\t5\n");
+    EXPECT_EQ(lookup(dict, "An"), (std::vector<std::string>{"anh"}));
+    EXPECT_TRUE(lookup(dict, "x").empty());
+    EXPECT_TRUE(lookup(dict, "").empty());
+}
+
+TEST(WordDictTest, DefaultCountsRankAlphabetically) {
+    WordDict dict = compiled("# comment\nbạn\nba\nbà\n\nba\t3\n");
+    EXPECT_EQ(dict.size(), 3u);  // Duplicate "ba" keeps the larger count
+    EXPECT_EQ(lookup(dict, "b"), (std::vector<std::string>{"ba", "bà", "bạn"}));
+}
+
+TEST(WordDictTest, RejectsInvalidImages) {
+    WordDict dict;
+    EXPECT_FALSE(dict.load("not a dictionary"));
+    std::string image = WordDict::compile("a\nb\n");
+    image.pop_back();
+    EXPECT_FALSE(dict.load(image));
+    EXPECT_TRUE(dict.empty());
+    EXPECT_TRUE(lookup(dict, "a").empty());
+}
+
+// =============================================================================
+// Mapped word list
+// =============================================================================
+
+TEST(WordDictTest, MapsCompiledWordList) {
+    std::ifstream in(GONHANH_WORD_LIST);
+    std::string lines((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    ASSERT_FALSE(lines.empty());
+
+    std::string path = testing::TempDir() + "gonhanh_words.dict";
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << WordDict::compile(lines);
+    }
+    WordDict dict;
+    ASSERT_TRUE(dict.open(path));
+    EXPECT_GT(dict.size(), 20000u);
+
+    WordDict moved = std::move(dict);
+    EXPECT_TRUE(dict.empty());
+    auto words = lookup(moved, "ngư", 9);
+    ASSERT_FALSE(words.empty());
+    for (const auto& w : words) {
+        EXPECT_EQ(WordDict::fold(w).rfind("ngu", 0), 0u) << w;
+    }
+
+    // Per-key budget: one-letter prefixes select the largest ranges
+    const char* prefixes[] = {"n", "ng", "ngư", "t", "th", "thư", "v", "vi", "việ"};
+    std::string_view out[9];
+    auto start = std::chrono::steady_clock::now();
+    constexpr int ROUNDS = 2000;
+    for (int i = 0; i < ROUNDS; ++i) {
+        for (const char* p : prefixes) {
+            moved.lookup(p, 9, out);
+        }
+    }
+    auto perLookup = (std::chrono::steady_clock::now() - start) / (ROUNDS * 9);
+    EXPECT_LT(perLookup, std::chrono::microseconds(50));
+    std::remove(path.c_str());
+}
@@ -0,0 +1,155 @@
+// Unit tests for WordHistory
+// Tests committing, gap tracking, rejoining with Backspace and the bounds
+
+#include <gtest/gtest.h>
+#include "../src/WordHistory.h"
+
+#include <string>
+
+using GoNhanh::WordHistory;
+
+// macOS keycodes (see src/KeycodeMap.h)
+constexpr uint16_t KEY_A = 0;
+constexpr uint16_t KEY_S = 1;
+constexpr uint16_t KEY_DELETE = 51;
+
+static void typeWord(WordHistory& history, std::string_view text, size_t keys = 2) {
+    for (size_t i = 0; i < keys; ++i) {
+        history.type(i % 2 ? KEY_S : KEY_A, false, false);
+    }
+    history.commit(text);
+}
+
+// =============================================================================
+// Committing
+// =============================================================================
+
+TEST(WordHistoryTest, KeepsKeysAndText) {
+    WordHistory history;
+    history.type(KEY_A, true, false);
+    history.type(KEY_S, false, true);
+    EXPECT_TRUE(history.composing());
+    history.commit("\xC3\x81");  // Á
+
+    ASSERT_EQ(history.size(), 1u);
+    const auto& word = history.word(0);
+    ASSERT_EQ(word.keyCount, 2);
+    EXPECT_EQ(word.keys[0].key, KEY_A);
+    EXPECT_TRUE(word.keys[0].caps);
+    EXPECT_TRUE(word.keys[1].shift);
+    EXPECT_FALSE(word.keys[1].ctrl);
+    EXPECT_EQ(word.text(), "\xC3\x81");
+    EXPECT_EQ(word.gap, 0);
+    EXPECT_FALSE(history.composing());
+}
+
+TEST(WordHistoryTest, ErasedWordLeavesHistoryAlone) {
+    WordHistory history;
+    typeWord(history, "a");
+    history.typeGap();
+    // "s" typed, then erased: the next break is the second character after "a"
+    history.type(KEY_S, false, false);
+    history.type(KEY_DELETE, false, false);
+    history.commit("");
+    history.typeGap();
+
+    ASSERT_EQ(history.size(), 1u);
+    EXPECT_EQ(history.word(0).gap, 2);
+}
+
+TEST(WordHistoryTest, KeepsLastWords) {
+    WordHistory history;
+    for (size_t i = 0; i < WordHistory::WORDS + 3; ++i) {
+        typeWord(history, std::to_string(i));
+        history.typeGap();
+    }
+    ASSERT_EQ(history.size(), WordHistory::WORDS);
+    EXPECT_EQ(history.word(0).text(), std::to_string(WordHistory::WORDS + 2));
+    EXPECT_EQ(history.word(WordHistory::WORDS - 1).text(), "3");
+}
+
+TEST(WordHistoryTest, UnkeepableWordDropsOlderOnes) {
+    WordHistory history;
+    typeWord(history, "a");
+    history.typeGap();
+    typeWord(history, "long", WordHistory::MAX_KEYS + 1);
+    EXPECT_EQ(history.size(), 0u);
+
+    typeWord(history, std::string(WordHistory::MAX_TEXT + 1, 'x'));
+    EXPECT_EQ(history.size(), 0u);
+}
+
+TEST(WordHistoryTest, ResumedWordIsNotKept) {
+    WordHistory history;
+    history.breakOpenWord();
+    EXPECT_TRUE(history.composing());
+    typeWord(history, "as");
+    EXPECT_EQ(history.size(), 0u);
+
+    typeWord(history, "as");  // The next word is kept again
+    EXPECT_EQ(history.size(), 1u);
+}
+
+// =============================================================================
+// Backspace
+// =============================================================================
+
+TEST(WordHistoryTest, BackspaceRejoinsWord) {
+    WordHistory history;
+    typeWord(history, "\xC3\xA1");  // á
+    history.typeGap();
+    history.typeGap();
+
+    ASSERT_TRUE(history.erasesGap());
+    EXPECT_EQ(history.eraseGap(), nullptr);  // One space left
+    ASSERT_TRUE(history.erasesGap());
+    const auto* word = history.eraseGap();
+    ASSERT_NE(word, nullptr);
+    EXPECT_EQ(word->keyCount, 2);
+    EXPECT_EQ(word->text(), "\xC3\xA1");
+
+    // It is the word being composed again
+    EXPECT_EQ(history.size(), 0u);
+    EXPECT_TRUE(history.composing());
+    EXPECT_FALSE(history.erasesGap());
+    history.type(KEY_DELETE, false, false);
+    history.commit("a");
+    EXPECT_EQ(history.word(0).keyCount, 3);
+}
+
+TEST(WordHistoryTest, BackspaceThroughSeveralWords) {
+    WordHistory history;
+    typeWord(history, "a");
+    history.typeGap();
+    typeWord(history, "b");
+    history.typeGap();
+
+    ASSERT_NE(history.eraseGap(), nullptr);  // Back at "b"
+    history.dropOpenWord();                  // "b" erased by the engine
+    ASSERT_TRUE(history.erasesGap());
+    const auto* word = history.eraseGap();
+    ASSERT_NE(word, nullptr);
+    EXPECT_EQ(word->text(), "a");
+}
+
+TEST(WordHistoryTest, NoGapNoRejoin) {
+    WordHistory history;
+    EXPECT_FALSE(history.erasesGap());
+    EXPECT_EQ(history.eraseGap(), nullptr);
+
+    typeWord(history, "a");  // Ended by a key that typed nothing
+    EXPECT_FALSE(history.erasesGap());
+}
+
+TEST(WordHistoryTest, ResetForgetsWords) {
+    WordHistory history;
+    typeWord(history, "a");
+    history.typeGap();
+    history.type(KEY_S, false, false);
+    history.reset();
+    EXPECT_EQ(history.size(), 0u);
+
+    // The word being composed at the reset is not kept either
+    history.commit("s");
+    EXPECT_EQ(history.size(), 0u);
+}